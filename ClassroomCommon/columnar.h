@@ -0,0 +1,317 @@
+#ifndef CLASSROOM_COLUMNAR_H
+#define CLASSROOM_COLUMNAR_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+#include <cstring>
+#include "schema.h"
+
+// 同步数据的列式字典编码。
+// 每张表按列存放：文本列先给出去重后的字典，再给出每行的字典下标；整数列直接存放每行的值。
+// 下标与整数都用变长整数（zigzag + 7 位一组），字典不超过 128 项时每行只占 1 字节。
+//
+// 布局：魔数 "CSC1" | 格式版本(1B) | 附加信息 JSON 长度(varint) + UTF-8 JSON
+//       | 表数量(1B) | 每张表：表编号(1B) 行数(varint) 列数(1B) 各列
+// 列：类型(1B, 0=文本 1=整数)
+//       文本：字典项数(varint) 各项(长度 varint + UTF-8) | 行数个下标(varint)
+//       整数：行数个值(zigzag varint)
+// 列的顺序和类型与 Schema 描述一致，解码时逐列校验。
+namespace Columnar {
+
+inline constexpr char kMagic[4] = {'C', 'S', 'C', '1'};
+inline constexpr quint8 kVersion = 1;
+
+// 校历两张表只在请求带 horizon_days 时下发，旧版班牌不会收到超出其 TableCount 的表
+enum TableId : quint8 {
+    ScheduleTable = 0, ClassroomTable = 1, AnnouncementTable = 2,
+    CalendarDayTable = 3, OccurrenceTable = 4,
+    TableCount = 5
+};
+inline constexpr int kBaseTableCount = 3;  // 不含校历时的表数量
+
+struct ColumnData {
+    QVector<QString> dictionary;  // 文本列：去重后的取值
+    QVector<quint32> codes;       // 文本列：每行对应的字典下标
+    QVector<qint64> integers;     // 整数列：每行的值
+};
+
+struct TableData {
+    bool present = false;
+    int rowCount = 0;
+    QVector<ColumnData> columns;  // 顺序与 Schema 描述一致
+
+    // 返回字典中的共享字符串，不复制字符数据
+    const QString &text(int column, int row) const {
+        const ColumnData &data = columns[column];
+        return data.dictionary[data.codes[row]];
+    }
+    qint64 integer(int column, int row) const { return columns[column].integers[row]; }
+};
+
+struct Snapshot {
+    QJsonObject meta;             // version、next_poll_ms 等附加信息
+    TableData tables[TableCount];
+};
+
+inline bool isColumnar(const QByteArray &payload) {
+    return payload.size() >= int(sizeof(kMagic)) && std::memcmp(payload.constData(), kMagic, sizeof(kMagic)) == 0;
+}
+
+namespace detail {
+
+inline void putVarint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(char(quint8(value) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+inline quint64 zigzag(qint64 value) { return (quint64(value) << 1) ^ quint64(value >> 63); }
+inline qint64 unzigzag(quint64 value) { return qint64(value >> 1) ^ -qint64(value & 1); }
+
+inline void putText(QByteArray &out, const QString &text) {
+    QByteArray utf8 = text.toUtf8();
+    putVarint(out, quint64(utf8.size()));
+    out.append(utf8);
+}
+
+// 读取越界或格式不符时置 ok = false，之后的读取都返回空值
+struct Reader {
+    const uchar *pos;
+    const uchar *end;
+    bool ok = true;
+
+    quint64 remaining() const { return quint64(end - pos); }
+
+    quint8 byte() {
+        if (pos >= end) { ok = false; return 0; }
+        return *pos++;
+    }
+
+    quint64 varint() {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+            quint8 b = *pos++;
+            value |= quint64(b & 0x7f) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    QString text() {
+        quint64 length = varint();
+        if (!ok || length > remaining()) { ok = false; return QString(); }
+        QString value = QString::fromUtf8(reinterpret_cast<const char *>(pos), qsizetype(length));
+        pos += length;
+        return value;
+    }
+};
+
+} // namespace detail
+
+// 逐行收集一张表，最后按列写出
+template <const Schema::Table &T>
+class TableEncoder
+{
+public:
+    TableEncoder() : columns(T.columnCount), dictionaryIndex(T.columnCount) {}
+
+    // 从 Select 语句的当前行取值；firstColumn 用于跳过 SelectWithId 的 id 列
+    void appendRow(const QSqlQuery &query, int firstColumn = 0) {
+        for (int i = 0; i < T.columnCount; ++i) {
+            QVariant value = query.value(firstColumn + i);
+            if (T.columns[i].type == Schema::ColumnType::Integer) {
+                columns[i].integers.append(value.toLongLong());
+            } else {
+                appendText(i, value.toString());
+            }
+        }
+        ++rows;
+    }
+
+    // 从同步 JSON 的一行取值，用于转发已收到的数据（如楼宇中继）
+    void appendJson(const QJsonObject &obj) {
+        for (int i = 0; i < T.columnCount; ++i) {
+            QJsonValue value = obj.value(QLatin1String(T.columns[i].name));
+            if (T.columns[i].type == Schema::ColumnType::Integer) {
+                columns[i].integers.append(value.toInteger());
+            } else {
+                appendText(i, value.toString());
+            }
+        }
+        ++rows;
+    }
+
+    void appendText(int column, const QString &value) {
+        QHash<QString, quint32> &index = dictionaryIndex[column];
+        auto it = index.constFind(value);
+        if (it == index.constEnd()) {
+            it = index.insert(value, quint32(columns[column].dictionary.size()));
+            columns[column].dictionary.append(value);
+        }
+        columns[column].codes.append(it.value());
+    }
+
+    int rowCount() const { return rows; }
+
+    void writeTo(QByteArray &out, TableId id) const {
+        out.append(char(id));
+        detail::putVarint(out, quint64(rows));
+        out.append(char(T.columnCount));
+        for (int i = 0; i < T.columnCount; ++i) {
+            const ColumnData &data = columns[i];
+            if (T.columns[i].type == Schema::ColumnType::Integer) {
+                out.append(char(1));
+                for (qint64 value : data.integers) {
+                    detail::putVarint(out, detail::zigzag(value));
+                }
+            } else {
+                out.append(char(0));
+                detail::putVarint(out, quint64(data.dictionary.size()));
+                for (const QString &entry : data.dictionary) {
+                    detail::putText(out, entry);
+                }
+                for (quint32 code : data.codes) {
+                    detail::putVarint(out, code);
+                }
+            }
+        }
+    }
+
+private:
+    int rows = 0;
+    QVector<ColumnData> columns;
+    QVector<QHash<QString, quint32>> dictionaryIndex;
+};
+
+// 写出魔数、版本和附加信息，之后由调用方写表数量和各表
+inline QByteArray beginPayload(const QJsonObject &meta, int tableCount) {
+    QByteArray out(kMagic, sizeof(kMagic));
+    out.append(char(kVersion));
+    QByteArray metaJson = QJsonDocument(meta).toJson(QJsonDocument::Compact);
+    detail::putVarint(out, quint64(metaJson.size()));
+    out.append(metaJson);
+    out.append(char(tableCount));
+    return out;
+}
+
+namespace detail {
+
+inline const Schema::Table &tableSchema(quint8 id) {
+    switch (id) {
+    case ClassroomTable: return Schema::Classrooms;
+    case AnnouncementTable: return Schema::Announcements;
+    case CalendarDayTable: return Schema::CalendarDays;
+    case OccurrenceTable: return Schema::Occurrences;
+    default: return Schema::Schedules;
+    }
+}
+
+inline bool readTable(Reader &reader, TableData &table, const Schema::Table &schema, QString *error) {
+    quint64 rows = reader.varint();
+    quint8 columnCount = reader.byte();
+    // 每行每列至少占 1 字节，行数超出剩余长度说明数据已损坏，避免据此分配内存
+    if (!reader.ok || columnCount != schema.columnCount || rows > reader.remaining()) {
+        if (error) *error = QString("表 %1 的行数或列数不符").arg(QLatin1String(schema.name));
+        return false;
+    }
+
+    table.rowCount = int(rows);
+    table.columns.resize(columnCount);
+    for (int i = 0; i < columnCount; ++i) {
+        ColumnData &data = table.columns[i];
+        quint8 kind = reader.byte();
+        bool integer = schema.columns[i].type == Schema::ColumnType::Integer;
+        if (!reader.ok || kind != (integer ? 1 : 0)) {
+            if (error) *error = QString("列 %1 的类型不符").arg(QLatin1String(schema.columns[i].name));
+            return false;
+        }
+
+        if (integer) {
+            data.integers.resize(table.rowCount);
+            for (int r = 0; r < table.rowCount; ++r) {
+                data.integers[r] = unzigzag(reader.varint());
+            }
+        } else {
+            quint64 dictionarySize = reader.varint();
+            if (!reader.ok || dictionarySize > reader.remaining()) {
+                if (error) *error = QString("列 %1 的字典长度不符").arg(QLatin1String(schema.columns[i].name));
+                return false;
+            }
+            data.dictionary.reserve(int(dictionarySize));
+            for (quint64 d = 0; d < dictionarySize && reader.ok; ++d) {
+                data.dictionary.append(reader.text());
+            }
+            data.codes.resize(table.rowCount);
+            for (int r = 0; r < table.rowCount; ++r) {
+                quint64 code = reader.varint();
+                if (code >= dictionarySize) {
+                    reader.ok = false;
+                    break;
+                }
+                data.codes[r] = quint32(code);
+            }
+        }
+        if (!reader.ok) {
+            if (error) *error = QString("列 %1 的数据不完整").arg(QLatin1String(schema.columns[i].name));
+            return false;
+        }
+    }
+    table.present = true;
+    return true;
+}
+
+} // namespace detail
+
+// 解码完整的列式数据；格式不符时返回 false，snapshot 内容不可使用
+inline bool decode(const QByteArray &payload, Snapshot &snapshot, QString *error = nullptr) {
+    if (!isColumnar(payload)) {
+        if (error) *error = "不是列式数据";
+        return false;
+    }
+
+    detail::Reader reader{reinterpret_cast<const uchar *>(payload.constData()) + sizeof(kMagic),
+                          reinterpret_cast<const uchar *>(payload.constData()) + payload.size()};
+    if (reader.byte() != kVersion) {
+        if (error) *error = "列式数据版本不符";
+        return false;
+    }
+
+    quint64 metaLength = reader.varint();
+    if (!reader.ok || metaLength > reader.remaining()) {
+        if (error) *error = "附加信息长度不符";
+        return false;
+    }
+    snapshot.meta = QJsonDocument::fromJson(
+                        QByteArray::fromRawData(reinterpret_cast<const char *>(reader.pos), qsizetype(metaLength)))
+                        .object();
+    reader.pos += metaLength;
+
+    quint8 tableCount = reader.byte();
+    for (int t = 0; t < tableCount && reader.ok; ++t) {
+        quint8 id = reader.byte();
+        if (!reader.ok || id >= TableCount || snapshot.tables[id].present) {
+            if (error) *error = "表编号不符";
+            return false;
+        }
+        if (!detail::readTable(reader, snapshot.tables[id], detail::tableSchema(id), error)) {
+            return false;
+        }
+    }
+    if (!reader.ok) {
+        if (error) *error = "列式数据不完整";
+        return false;
+    }
+    return true;
+}
+
+} // namespace Columnar
+
+#endif // CLASSROOM_COLUMNAR_H
@@ -0,0 +1,75 @@
+#ifndef CLASSROOM_LANEFRAMES_H
+#define CLASSROOM_LANEFRAMES_H
+
+#include <QByteArray>
+#include <QtEndian>
+#include <cstring>
+
+// 同步连接上的分道帧。
+// 旧协议每个响应是一帧：4 字节大端长度 + 数据。班牌在请求中带 "lanes":true 时，服务器改用分道帧：
+// 长度字的最高位置 1，第 24-30 位是帧类型，低 24 位是数据长度。完整数据被切成小块（BulkChunk），
+// 紧急公告（Urgent）可以插在任意两块之间发送，不必等整份数据发完。
+// 新版本通知（Version）只带变更编号，收到后按自己的节奏尽快拉取；不认识该类型的旧班牌直接忽略。
+// 公告到了生效或过期时刻，服务器推送当时有效的全部公告（Announcements），班牌直接替换本地公告表，不必拉取完整数据。
+// 班牌在同一连接上发送签到批次（CHECKIN 请求），服务器写入数据库后以 CheckinAck 确认，不占用完整数据的通道。
+// 签到人数变化时服务器推送所在教室当前节次的出勤（Attendance），每个连接每秒最多一次。
+// 旧格式的长度不会达到 2GB，最高位始终为 0，因此同一个解析器可以同时处理两种帧。
+namespace Lane {
+
+enum FrameType : quint8 {
+    Legacy = 0,       // 旧协议的整帧响应
+    BulkChunk = 1,    // 完整数据的中间块
+    BulkEnd = 2,      // 完整数据的最后一块
+    Urgent = 3,       // 紧急公告（JSON 对象）
+    Version = 4,      // 新版本已发布（JSON 对象，含 change_id）
+    Announcements = 5, // 当前有效的公告集合（JSON 对象，announcements 数组）
+    CheckinAck = 6,   // 签到批次已写入（JSON 对象，含 batch）
+    Attendance = 7,   // 出勤人数（JSON 对象，rooms 数组，每项一间教室）
+};
+
+inline constexpr quint32 kLaneFlag = 0x80000000u;
+inline constexpr quint32 kMaxLanePayload = 0x00FFFFFFu;
+inline constexpr int kChunkBytes = 16 * 1024;
+
+inline QByteArray frame(FrameType type, const QByteArray &payload) {
+    QByteArray framed(4 + payload.size(), Qt::Uninitialized);
+    quint32 word = kLaneFlag | (quint32(type) << 24) | (quint32(payload.size()) & kMaxLanePayload);
+    qToBigEndian<quint32>(word, framed.data());
+    std::memcpy(framed.data() + 4, payload.constData(), payload.size());
+    return framed;
+}
+
+// 从缓冲区头部取出一个完整帧；数据不足时返回 false 并保留缓冲区
+inline bool takeFrame(QByteArray &buffer, FrameType &type, QByteArray &payload) {
+    if (buffer.size() < 4) {
+        return false;
+    }
+    quint32 word = qFromBigEndian<quint32>(buffer.constData());
+    qint64 size;
+    if (word & kLaneFlag) {
+        type = FrameType((word >> 24) & 0x7F);
+        size = word & kMaxLanePayload;
+    } else {
+        type = Legacy;
+        size = word;
+    }
+    if (buffer.size() - 4 < size) {
+        return false;
+    }
+    payload = buffer.mid(4, int(size));
+    buffer.remove(0, int(4 + size));
+    return true;
+}
+
+// 帧头声明的数据长度，头部不完整时返回 -1；用于显示接收进度
+inline qint64 pendingFrameSize(const QByteArray &buffer) {
+    if (buffer.size() < 4) {
+        return -1;
+    }
+    quint32 word = qFromBigEndian<quint32>(buffer.constData());
+    return (word & kLaneFlag) ? qint64(word & kMaxLanePayload) : qint64(word);
+}
+
+} // namespace Lane
+
+#endif // CLASSROOM_LANEFRAMES_H
@@ -0,0 +1,300 @@
+#ifndef CLASSROOM_SCHEMA_H
+#define CLASSROOM_SCHEMA_H
+
+#include <QSqlQuery>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLatin1String>
+#include <QVariant>
+#include <cstddef>
+#include <iterator>
+
+// 服务端与班牌共用的表结构描述。
+// 列的名称、顺序和类型只在这里定义一次；建表语句、INSERT/UPSERT/SELECT/UPDATE 语句
+// 在编译期由描述生成，绑定与编解码按列下标进行，不在每行重复拼接或查找字符串。
+//
+// 同一张表在两端的列顺序一致。班牌本地列名同时是同步 JSON 的键；
+// 服务端课程表沿用历史列名（room/course），由 serverName 区分。
+namespace Schema {
+
+enum class Side { Client, Server };
+enum class ColumnType { Text, Integer };
+
+struct Column {
+    const char *name;        // 班牌本地列名，同时是同步 JSON 的键
+    const char *serverName;  // 服务端列名
+    ColumnType type;
+    const char *clientExtra; // 只用于班牌本地表的附加约束，如 "UNIQUE"、"DEFAULT 0"
+};
+
+struct Table {
+    const char *name;        // 班牌本地表名
+    const char *serverName;  // 服务端表名
+    const Column *columns;
+    int columnCount;
+    int keyColumn;           // 业务主键列下标，没有时为 -1（按 id 更新）
+};
+
+// ---- 课程表 ----
+inline constexpr Column scheduleColumns[] = {
+    {"room_name",   "room",       ColumnType::Text,    ""},
+    {"course_name", "course",     ColumnType::Text,    ""},
+    {"teacher",     "teacher",    ColumnType::Text,    ""},
+    {"time_slot",   "time_slot",  ColumnType::Text,    ""},
+    {"start_time",  "start_time", ColumnType::Text,    ""},
+    {"end_time",    "end_time",   ColumnType::Text,    ""},
+    {"weekday",     "weekday",    ColumnType::Integer, ""},
+    {"is_next",     "is_next",    ColumnType::Integer, "DEFAULT 0"},
+};
+namespace ScheduleCol {
+enum : int { RoomName, CourseName, Teacher, TimeSlot, StartTime, EndTime, Weekday, IsNext };
+}
+inline constexpr Table Schedules{"schedules", "master_schedules", scheduleColumns,
+                                 int(std::size(scheduleColumns)), -1};
+
+// ---- 教室 ----
+inline constexpr Column classroomColumns[] = {
+    {"room_name",     "room_name",     ColumnType::Text,    "UNIQUE"},
+    {"class_name",    "class_name",    ColumnType::Text,    ""},
+    {"capacity",      "capacity",      ColumnType::Integer, ""},
+    {"building",      "building",      ColumnType::Text,    ""},
+    {"floor",         "floor",         ColumnType::Integer, ""},
+    {"current_class", "current_class", ColumnType::Text,    ""},
+};
+namespace ClassroomCol {
+enum : int { RoomName, ClassName, Capacity, Building, Floor, CurrentClass };
+}
+inline constexpr Table Classrooms{"classrooms", "classrooms", classroomColumns,
+                                  int(std::size(classroomColumns)), ClassroomCol::RoomName};
+
+// ---- 公告 ----
+inline constexpr Column announcementColumns[] = {
+    {"title",        "title",        ColumnType::Text,    ""},
+    {"content",      "content",      ColumnType::Text,    ""},
+    {"priority",     "priority",     ColumnType::Integer, "DEFAULT 0"},
+    {"publish_time", "publish_time", ColumnType::Text,    ""},
+    {"expire_time",  "expire_time",  ColumnType::Text,    ""},
+};
+namespace AnnouncementCol {
+enum : int { Title, Content, Priority, PublishTime, ExpireTime };
+}
+inline constexpr Table Announcements{"announcements", "announcements", announcementColumns,
+                                     int(std::size(announcementColumns)), -1};
+
+// ---- 校历展开后的每日信息 ----
+// 服务端按学期、节假日、调课等规则逐日展开；kind 为 teaching/holiday/exam/makeup/break，
+// weekday 是当天实际执行的星期课表（调课日为被替换的那一天，无课时为 0），week 是教学周（未配置学期时为 0）
+inline constexpr Column calendarDayColumns[] = {
+    {"date",    "date",    ColumnType::Text,    "UNIQUE"},
+    {"kind",    "kind",    ColumnType::Text,    ""},
+    {"weekday", "weekday", ColumnType::Integer, ""},
+    {"week",    "week",    ColumnType::Integer, ""},
+    {"note",    "note",    ColumnType::Text,    ""},
+};
+namespace CalendarDayCol {
+enum : int { Date, Kind, Weekday, Week, Note };
+}
+inline constexpr Table CalendarDays{"calendar_days", "calendar_days", calendarDayColumns,
+                                    int(std::size(calendarDayColumns)), CalendarDayCol::Date};
+
+// ---- 按日期展开的课程 ----
+// 服务端只存 (日期, 课程 id)，occurrence_view 联表展开为与班牌本地表相同的列
+inline constexpr Column occurrenceColumns[] = {
+    {"date",        "date",       ColumnType::Text, ""},
+    {"room_name",   "room",       ColumnType::Text, ""},
+    {"course_name", "course",     ColumnType::Text, ""},
+    {"teacher",     "teacher",    ColumnType::Text, ""},
+    {"time_slot",   "time_slot",  ColumnType::Text, ""},
+    {"start_time",  "start_time", ColumnType::Text, ""},
+    {"end_time",    "end_time",   ColumnType::Text, ""},
+};
+namespace OccurrenceCol {
+enum : int { Date, RoomName, CourseName, Teacher, TimeSlot, StartTime, EndTime };
+}
+inline constexpr Table Occurrences{"occurrences", "occurrence_view", occurrenceColumns,
+                                   int(std::size(occurrenceColumns)), -1};
+
+// ---- 班牌同步日志（仅本地） ----
+inline constexpr Column syncLogColumns[] = {
+    {"sync_time",   "sync_time",   ColumnType::Text,    ""},
+    {"status",      "status",      ColumnType::Text,    ""},
+    {"items_count", "items_count", ColumnType::Integer, ""},
+};
+inline constexpr Table SyncLog{"sync_log", "sync_log", syncLogColumns, int(std::size(syncLogColumns)), -1};
+
+// ---- 等待上传的签到（仅本地） ----
+// checked_at_ms 为毫秒时间戳，超出 int 范围，读写时按 qint64 绑定，不经过 bindJson/encodeRow
+inline constexpr Column pendingCheckinColumns[] = {
+    {"card_id",       "card_id",       ColumnType::Text,    ""},
+    {"room_name",     "room_name",     ColumnType::Text,    ""},
+    {"checked_at_ms", "checked_at_ms", ColumnType::Integer, ""},
+};
+namespace PendingCheckinCol {
+enum : int { CardId, RoomName, CheckedAtMs };
+}
+inline constexpr Table PendingCheckins{"pending_checkins", "pending_checkins", pendingCheckinColumns,
+                                       int(std::size(pendingCheckinColumns)), -1};
+
+enum class Statement {
+    Create,         // CREATE TABLE IF NOT EXISTS t (id ..., 各列)
+    Insert,         // INSERT INTO t (各列) VALUES (?, ...)
+    Upsert,         // INSERT OR REPLACE INTO t (各列) VALUES (?, ...)
+    Select,         // SELECT 各列 FROM t
+    SelectWithId,   // SELECT id, 各列 FROM t
+    UpdateById,     // UPDATE t SET 各列=? WHERE id=?
+    UpdateByKey,    // UPDATE t SET 非主键列=? WHERE 主键列=?
+};
+
+namespace detail {
+
+constexpr const char *tableName(const Table &table, Side side) {
+    return side == Side::Server ? table.serverName : table.name;
+}
+
+constexpr const char *columnName(const Column &column, Side side) {
+    return side == Side::Server ? column.serverName : column.name;
+}
+
+// 两遍生成：out 为空时只统计长度，否则写入字符
+struct Writer {
+    char *out;
+    std::size_t pos = 0;
+
+    constexpr void put(const char *text) {
+        for (std::size_t i = 0; text[i] != '\0'; ++i) {
+            if (out) out[pos] = text[i];
+            ++pos;
+        }
+    }
+};
+
+constexpr void writeColumnList(Writer &w, const Table &table, Side side) {
+    for (int i = 0; i < table.columnCount; ++i) {
+        if (i > 0) w.put(", ");
+        w.put(columnName(table.columns[i], side));
+    }
+}
+
+constexpr void writeStatement(Writer &w, const Table &table, Side side, Statement kind) {
+    switch (kind) {
+    case Statement::Create:
+        w.put("CREATE TABLE IF NOT EXISTS ");
+        w.put(tableName(table, side));
+        w.put(" (id INTEGER PRIMARY KEY AUTOINCREMENT");
+        for (int i = 0; i < table.columnCount; ++i) {
+            const Column &column = table.columns[i];
+            w.put(", ");
+            w.put(columnName(column, side));
+            w.put(column.type == ColumnType::Integer ? " INTEGER" : " TEXT");
+            if (side == Side::Client && column.clientExtra[0] != '\0') {
+                w.put(" ");
+                w.put(column.clientExtra);
+            }
+        }
+        w.put(")");
+        break;
+    case Statement::Insert:
+    case Statement::Upsert:
+        w.put(kind == Statement::Upsert ? "INSERT OR REPLACE INTO " : "INSERT INTO ");
+        w.put(tableName(table, side));
+        w.put(" (");
+        writeColumnList(w, table, side);
+        w.put(") VALUES (");
+        for (int i = 0; i < table.columnCount; ++i) {
+            w.put(i > 0 ? ", ?" : "?");
+        }
+        w.put(")");
+        break;
+    case Statement::Select:
+    case Statement::SelectWithId:
+        w.put(kind == Statement::SelectWithId ? "SELECT id, " : "SELECT ");
+        writeColumnList(w, table, side);
+        w.put(" FROM ");
+        w.put(tableName(table, side));
+        break;
+    case Statement::UpdateById:
+    case Statement::UpdateByKey: {
+        bool byKey = kind == Statement::UpdateByKey && table.keyColumn >= 0;
+        w.put("UPDATE ");
+        w.put(tableName(table, side));
+        w.put(" SET ");
+        bool first = true;
+        for (int i = 0; i < table.columnCount; ++i) {
+            if (byKey && i == table.keyColumn) continue;
+            if (!first) w.put(", ");
+            w.put(columnName(table.columns[i], side));
+            w.put("=?");
+            first = false;
+        }
+        w.put(" WHERE ");
+        w.put(byKey ? columnName(table.columns[table.keyColumn], side) : "id");
+        w.put("=?");
+        break;
+    }
+    }
+}
+
+template <std::size_t N>
+struct FixedString {
+    char data[N + 1] = {};
+};
+
+template <const Table &T, Side S, Statement K>
+constexpr std::size_t statementLength() {
+    Writer w{nullptr};
+    writeStatement(w, T, S, K);
+    return w.pos;
+}
+
+template <const Table &T, Side S, Statement K>
+constexpr FixedString<statementLength<T, S, K>()> buildStatement() {
+    FixedString<statementLength<T, S, K>()> text{};
+    Writer w{text.data};
+    writeStatement(w, T, S, K);
+    return text;
+}
+
+template <const Table &T, Side S, Statement K>
+inline constexpr auto statementText = buildStatement<T, S, K>();
+
+} // namespace detail
+
+// 编译期生成的 SQL 语句，例如 Schema::sql<Schema::Schedules, Schema::Side::Client, Schema::Statement::Insert>()
+template <const Table &T, Side S, Statement K>
+inline QString sql() {
+    return QLatin1String(detail::statementText<T, S, K>.data, qsizetype(detail::statementLength<T, S, K>()));
+}
+
+// 把同步 JSON 中的一行按列下标绑定到 INSERT/UPSERT 语句（占位符顺序与列顺序一致）
+template <const Table &T>
+inline void bindJson(QSqlQuery &query, const QJsonObject &obj) {
+    for (int i = 0; i < T.columnCount; ++i) {
+        const Column &column = T.columns[i];
+        QJsonValue value = obj.value(QLatin1String(column.name));
+        if (column.type == ColumnType::Integer) {
+            query.bindValue(i, value.toInt());
+        } else {
+            query.bindValue(i, value.toString());
+        }
+    }
+}
+
+// 把 Select 语句的当前行编码为同步 JSON；firstColumn 用于跳过 SelectWithId 的 id 列
+template <const Table &T>
+inline QJsonObject encodeRow(const QSqlQuery &query, int firstColumn = 0) {
+    QJsonObject obj;
+    for (int i = 0; i < T.columnCount; ++i) {
+        const Column &column = T.columns[i];
+        QVariant value = query.value(firstColumn + i);
+        if (column.type == ColumnType::Integer) {
+            obj.insert(QLatin1String(column.name), value.toInt());
+        } else {
+            obj.insert(QLatin1String(column.name), value.toString());
+        }
+    }
+    return obj;
+}
+
+} // namespace Schema
+
+#endif // CLASSROOM_SCHEMA_H
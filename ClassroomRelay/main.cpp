@@ -0,0 +1,19 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include "relayconfig.h"
+#include "relaynode.h"
+
+// 用法：ClassroomRelay [配置文件]，默认读取工作目录下的 relay_config.ini
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QStringList args = app.arguments();
+    RelayConfig config = args.size() > 1 ? RelayConfig::load(args.at(1)) : RelayConfig::load();
+
+    RelayNode node(config);
+    if (!node.start()) {
+        return 1;
+    }
+    return app.exec();
+}
@@ -0,0 +1,31 @@
+#include "relayconfig.h"
+#include <QSettings>
+#include <QFileInfo>
+#include <QDebug>
+
+RelayConfig RelayConfig::load(const QString &path) {
+    RelayConfig config;
+    config.upstream = SignConfig::load(path);
+
+    if (QFileInfo::exists(path)) {
+        QSettings settings(path, QSettings::IniFormat);
+
+        QString relayId = settings.value("relay/id").toString().trimmed();
+        if (!relayId.isEmpty()) {
+            config.upstream.signId = relayId;
+        }
+        config.building = settings.value("relay/building").toString().trimmed();
+        config.cachePath = settings.value("relay/cache_path", config.cachePath).toString();
+
+        int port = settings.value("relay/listen_port", config.listenPort).toInt();
+        if (port > 0 && port <= 65535) {
+            config.listenPort = quint16(port);
+        } else {
+            qDebug() << "忽略无效的监听端口:" << port;
+        }
+    }
+
+    qDebug() << "中继" << config.upstream.signId << "楼宇:" << (config.building.isEmpty() ? "全部" : config.building)
+             << "监听端口:" << config.listenPort;
+    return config;
+}
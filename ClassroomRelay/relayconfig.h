@@ -0,0 +1,27 @@
+#ifndef RELAYCONFIG_H
+#define RELAYCONFIG_H
+
+#include <QString>
+#include "signconfig.h"
+
+// 楼宇中继的配置，来自 relay_config.ini（可在命令行指定其他路径），文件不存在时使用默认值。
+// 上游服务器地址与超时沿用班牌配置的 [server] 小节。
+//
+// [relay]
+// id=relay-A
+// building=A栋
+// listen_port=12346
+// cache_path=relay_cache.json
+//
+// [server]
+// endpoints=10.0.0.2:12345
+struct RelayConfig {
+    SignConfig upstream;           // 上游服务器；signId 即中继编号
+    QString building;              // 只转发该楼宇的教室和课程，为空时转发全部
+    quint16 listenPort = 12346;    // 本楼宇班牌连接的端口
+    QString cachePath = "relay_cache.json"; // 最近一次上游数据，断开上游后重启仍可服务
+
+    static RelayConfig load(const QString &path = "relay_config.ini");
+};
+
+#endif // RELAYCONFIG_H
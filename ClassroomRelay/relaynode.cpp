@@ -0,0 +1,478 @@
+#include "relaynode.h"
+#include "columnar.h"
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QFile>
+#include <QSet>
+#include <QDateTime>
+#include <QDebug>
+
+// 班牌在中继下一次拉取上游之后不久再来，尽快拿到新数据
+static const int kRelayGraceMs = 2000;
+// 尚无数据时让班牌较快重试
+static const int kNoDataPollMs = 5000;
+// 向上游请求的校历天数，与班牌请求的天数一致
+static const int kHorizonDays = 14;
+// 转发的签到批次超过该时间未确认即不再等待，班牌自己会超时重发
+static const qint64 kCheckinForwardTimeoutMs = 60000;
+// 上游不可用时建议班牌重发签到前等待的时间
+static const int kCheckinRetryMs = 5000;
+
+RelayNode::RelayNode(const RelayConfig &config, QObject *parent)
+    : QObject(parent), config(config), syncService(new SyncService(this)),
+      uplink(new Uplink(config.upstream, this)) {
+    PollPolicy policy;
+    policy.boundaryGraceMs = kRelayGraceMs;
+    pollAdvisor.setPolicy(policy);
+
+    connect(syncService, &SyncService::logMessage, this, [](const QString &message) {
+        qDebug().noquote() << message;
+    });
+    connect(syncService, &SyncService::syncRequested, this, &RelayNode::onSyncRequested);
+    connect(syncService, &SyncService::syncServed, this, &RelayNode::onSyncServed);
+    syncService->setPayloadProvider([this](const QJsonObject &args, qint64 requestAtMs) {
+        return payloadFor(args, requestAtMs);
+    });
+    syncService->addAsyncCommand("CHECKIN", [this](quint64 connection, const QJsonObject &args) {
+        forwardCheckin(connection, args);
+    });
+
+    uplink->setArgsProvider([this]() { return uplinkArgs(); });
+    connect(uplink, &Uplink::snapshotReceived, this, &RelayNode::onSnapshotReceived);
+    connect(uplink, &Uplink::urgentReceived, this, [this](const QByteArray &payload) {
+        // 只转给投放范围内的班牌；上游未附带范围时视为全部
+        AnnouncementTarget target;
+        AnnouncementTarget::parse(QJsonDocument::fromJson(payload).object().value("target").toString(), target);
+        int sent = syncService->pushUrgent([this, &target, &payload](const QJsonObject &args) {
+            return audience.reaches(target, AudienceIndex::Audience::fromArgs(args)) ? payload : QByteArray();
+        });
+        qDebug() << "紧急公告已转发给" << sent << "个连接";
+    });
+    connect(uplink, &Uplink::versionReceived, this, &RelayNode::onVersionReceived);
+    connect(uplink, &Uplink::announcementsReceived, this, &RelayNode::onAnnouncementsReceived);
+    connect(uplink, &Uplink::checkinAckReceived, this, &RelayNode::onCheckinAck);
+    connect(uplink, &Uplink::attendanceReceived, this, &RelayNode::onAttendanceReceived);
+    connect(uplink, &Uplink::uplinkFailed, this, [this]() {
+        qDebug() << "上游不可用，继续下发变更" << changeId() << "的缓存数据";
+    });
+}
+
+bool RelayNode::start() {
+    if (loadCache()) {
+        qDebug() << "已加载中继缓存，变更编号:" << changeId();
+    }
+
+    if (!syncService->listen(QHostAddress::Any, config.listenPort)) {
+        qDebug() << "中继监听失败:" << syncService->errorString();
+        return false;
+    }
+    qDebug() << "中继已启动，监听端口:" << syncService->serverPort();
+
+    uplink->start();
+    return true;
+}
+
+void RelayNode::onSnapshotReceived(const QJsonObject &rootObj) {
+    reportsInFlight.clear();
+    signsInFlight.clear();
+
+    QJsonObject version = rootObj["version"].toObject();
+    QJsonObject filtered = filterBuilding(rootObj);
+    // 当前班级等字段不经过变更记录也会更新，因此比较内容而不只比较变更编号
+    if (!hasSnapshot() || version.value("change_id").toInteger() != changeId() || filtered != tables) {
+        adopt(filtered, version);
+        saveCache();
+        qDebug() << "中继数据已更新，变更编号:" << changeId();
+        emit snapshotUpdated(changeId());
+    }
+
+    if (pendingVersion.isEmpty()) {
+        return;
+    }
+    qint64 pendingId = QJsonDocument::fromJson(pendingVersion).object().value("change_id").toInteger();
+    if (changeId() < pendingId) {
+        uplink->refresh();  // 这次拉到的还是旧数据（通知到达时已在拉取中），再拉一次
+        return;
+    }
+    int sent = syncService->pushVersion(pendingVersion);
+    pendingVersion.clear();
+    qDebug() << "新版本通知已转发给" << sent << "个连接";
+}
+
+void RelayNode::onVersionReceived(const QByteArray &payload) {
+    // 先从上游拿到新数据再通知本楼宇班牌，班牌来拉取时中继已经有了
+    if (QJsonDocument::fromJson(payload).object().value("change_id").toInteger() <= changeId()) {
+        return;
+    }
+    pendingVersion = payload;
+    uplink->refresh();
+}
+
+void RelayNode::onAnnouncementsReceived(const QByteArray &payload) {
+    QJsonObject update = QJsonDocument::fromJson(payload).object();
+    if (!update["announcements"].isArray()) {
+        qDebug() << "上游公告推送格式错误，忽略";
+        return;
+    }
+    // 上游已按楼宇筛选；替换缓存中的公告后，每个班牌只收到适用于所在教室的部分
+    if (!hasSnapshot()) {
+        int sent = syncService->pushAnnouncements(payload);
+        qDebug() << "公告更新已转发给" << sent << "个连接";
+        return;
+    }
+    QJsonObject updated = tables;
+    updated["announcements"] = update["announcements"];
+    adopt(updated, upstreamVersion);
+    saveCache();
+
+    QHash<QString, QByteArray> payloads;
+    int sent = syncService->pushAnnouncements([&](const QJsonObject &args) {
+        AudienceIndex::Audience who = AudienceIndex::Audience::fromArgs(args);
+        auto it = payloads.find(who.key());
+        if (it == payloads.end()) {
+            QJsonObject forward = update;
+            forward["announcements"] = audienceSlice(who).announcements;
+            it = payloads.insert(who.key(), QJsonDocument(forward).toJson(QJsonDocument::Compact));
+        }
+        return it.value();
+    });
+    qDebug() << "公告更新已转发给" << sent << "个连接";
+}
+
+void RelayNode::forwardCheckin(quint64 connection, const QJsonObject &args) {
+    // 上游一直没有确认的批次不再等待，避免上游断开时表无限增长
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    for (auto it = forwardedCheckins.begin(); it != forwardedCheckins.end();) {
+        if (nowMs - it->forwardedAtMs > kCheckinForwardTimeoutMs) {
+            it = forwardedCheckins.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QJsonObject forwarded = args;
+    qint64 tag = nextCheckinTag++;
+    forwarded["tag"] = tag;
+    if (uplink->sendCommand("CHECKIN", forwarded)) {
+        forwardedCheckins.insert(tag, ForwardedCheckin{connection, args.value("tag"), nowMs});
+        return;
+    }
+
+    // 上游暂时不可用：班牌保留本地记录，稍后重发
+    QJsonObject ack;
+    ack["batch"] = args["batch"];
+    if (args.contains("tag")) {
+        ack["tag"] = args["tag"];
+    }
+    ack["ok"] = false;
+    ack["error"] = "上游不可用";
+    ack["retry_ms"] = kCheckinRetryMs;
+    syncService->reply(connection, Lane::CheckinAck, QJsonDocument(ack).toJson(QJsonDocument::Compact));
+}
+
+void RelayNode::onCheckinAck(const QByteArray &payload) {
+    QJsonObject ack = QJsonDocument::fromJson(payload).object();
+    auto it = forwardedCheckins.find(ack.value("tag").toInteger());
+    if (it == forwardedCheckins.end()) {
+        return;
+    }
+    if (it->tag.isUndefined()) {
+        ack.remove("tag");
+    } else {
+        ack["tag"] = it->tag;
+    }
+    syncService->reply(it->connection, Lane::CheckinAck, QJsonDocument(ack).toJson(QJsonDocument::Compact));
+    forwardedCheckins.erase(it);
+}
+
+void RelayNode::onAttendanceReceived(const QByteArray &payload) {
+    // 上游已按楼宇筛选并合并过；班牌只收到所在教室的一项，下级中继收到所辖楼宇的各项
+    QJsonObject update = QJsonDocument::fromJson(payload).object();
+    const QJsonArray rooms = update["rooms"].toArray();
+    if (rooms.isEmpty()) {
+        return;
+    }
+    for (const QJsonValue &value : rooms) {
+        attendanceRooms.insert(value.toObject().value("room").toString(), value.toObject());
+    }
+    QHash<QString, QByteArray> payloads;
+    syncService->pushAttendance([&](const QJsonObject &args) {
+        AudienceIndex::Audience who = AudienceIndex::Audience::fromArgs(args);
+        if (who.kind == AudienceIndex::Audience::Everyone) {
+            return payload;
+        }
+        auto it = payloads.find(who.key());
+        if (it == payloads.end()) {
+            QJsonArray matched;
+            const char *key = who.kind == AudienceIndex::Audience::Room ? "room" : "building";
+            for (const QJsonValue &value : rooms) {
+                if (value.toObject().value(key).toString() == who.name) {
+                    matched.append(value);
+                }
+            }
+            QByteArray forward;
+            if (!matched.isEmpty()) {
+                QJsonObject filtered = update;
+                filtered["rooms"] = matched;
+                forward = QJsonDocument(filtered).toJson(QJsonDocument::Compact);
+            }
+            it = payloads.insert(who.key(), forward);
+        }
+        return it.value();
+    });
+}
+
+void RelayNode::onSyncRequested(const QJsonObject &args, qint64 requestAtMs) {
+    pollAdvisor.recordRequest(requestAtMs);
+    ++servedCount;
+
+    // 传播耗时留到下一次拉取上游时一并转发；同一班牌只保留最新一条
+    if (args.contains("report")) {
+        pendingReports.insert(args["sign_id"].toString(), args["report"].toObject());
+    }
+    const QJsonArray reports = args["reports"].toArray();
+    for (const QJsonValue &value : reports) {
+        QJsonObject entry = value.toObject();
+        pendingReports.insert(entry["sign_id"].toString(), entry["report"].toObject());
+    }
+}
+
+void RelayNode::onSyncServed(const QJsonObject &args, const QString &peer, qint64 bytes) {
+    dirtySigns.insert(signs.observe(args, peer, bytes, QDateTime::currentMSecsSinceEpoch()));
+
+    // 刚订阅的班牌先收到所在教室最近的出勤人数，之后随上游推送更新
+    auto attendance = attendanceRooms.constFind(args["room"].toString());
+    if (args["lanes"].toBool() && !args.contains("relay") && attendance != attendanceRooms.constEnd()) {
+        QJsonObject update;
+        update["rooms"] = QJsonArray{attendance.value()};
+        const QByteArray payload = QJsonDocument(update).toJson(QJsonDocument::Compact);
+        const QString signId = args["sign_id"].toString();
+        syncService->pushAttendance([&](const QJsonObject &client) {
+            return client["sign_id"].toString() == signId ? payload : QByteArray();
+        });
+    }
+
+    // 下级中继转发来的班牌状态一并向上转发
+    const QJsonArray relayed = args["signs"].toArray();
+    QString relayId = args["sign_id"].toString();
+    for (const QJsonValue &value : relayed) {
+        int row = signs.observeRelayed(value.toObject(), relayId);
+        if (row >= 0) {
+            dirtySigns.insert(row);
+        }
+    }
+}
+
+QByteArray RelayNode::payloadFor(const QJsonObject &args, qint64 requestAtMs) {
+    QJsonObject meta;
+    if (!hasSnapshot()) {
+        meta["next_poll_ms"] = kNoDataPollMs;
+        return QJsonDocument(meta).toJson(QJsonDocument::Compact);
+    }
+
+    // request_at_ms 取班牌请求到达中继的时间，等待时间因此包含上游和中继两段
+    QJsonObject version = upstreamVersion;
+    version["request_at_ms"] = requestAtMs;
+    meta["version"] = version;
+    meta["next_poll_ms"] = pollAdvisor.advise(QDateTime::currentMSecsSinceEpoch(), uplink->msToNextPoll());
+
+    // 只有请求了校历的班牌才能解码校历两张表
+    bool withCalendar = args.contains("horizon_days") && tables.contains("calendar_days");
+    const AudienceSlice &slice = audienceSlice(AudienceIndex::Audience::fromArgs(args));
+    if (args["accept"].toString() == "columnar") {
+        if (withCalendar) {
+            return Columnar::beginPayload(meta, Columnar::TableCount) + columnarTables + slice.columnar
+                + columnarCalendar;
+        }
+        return Columnar::beginPayload(meta, Columnar::kBaseTableCount) + columnarTables + slice.columnar;
+    }
+
+    QJsonObject rootObj = tables;
+    rootObj["announcements"] = slice.announcements;
+    if (!withCalendar) {
+        rootObj.remove("calendar_days");
+        rootObj.remove("occurrences");
+    }
+    for (auto it = meta.constBegin(); it != meta.constEnd(); ++it) {
+        rootObj.insert(it.key(), it.value());
+    }
+    return QJsonDocument(rootObj).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject RelayNode::uplinkArgs() {
+    // 上一次未确认的上报与新的上报合并后一起发出，上游按变更编号去重
+    for (auto it = pendingReports.constBegin(); it != pendingReports.constEnd(); ++it) {
+        reportsInFlight.insert(it.key(), it.value());
+    }
+    pendingReports.clear();
+
+    QJsonArray reports;
+    for (auto it = reportsInFlight.constBegin(); it != reportsInFlight.constEnd(); ++it) {
+        QJsonObject entry;
+        entry["sign_id"] = it.key();
+        entry["report"] = it.value();
+        reports.append(entry);
+    }
+
+    // 只转发有变化的班牌状态；最后在线时间按中继的时钟记录
+    signsInFlight.unite(dirtySigns);
+    dirtySigns.clear();
+    QJsonArray statuses;
+    for (int row : std::as_const(signsInFlight)) {
+        statuses.append(FleetRegistry::toJson(signs.at(row)));
+    }
+
+    QJsonObject args;
+    args["relay"] = config.building.isEmpty() ? QString("*") : config.building;
+    args["horizon_days"] = kHorizonDays;
+    if (!reports.isEmpty()) {
+        args["reports"] = reports;
+    }
+    if (!statuses.isEmpty()) {
+        args["signs"] = statuses;
+    }
+    return args;
+}
+
+QJsonObject RelayNode::filterBuilding(const QJsonObject &rootObj) const {
+    QJsonObject filtered;
+    filtered["announcements"] = rootObj["announcements"].toArray();
+    if (rootObj.contains("calendar_days")) {
+        filtered["calendar_days"] = rootObj["calendar_days"].toArray();
+    }
+    if (config.building.isEmpty()) {
+        filtered["schedules"] = rootObj["schedules"].toArray();
+        filtered["classrooms"] = rootObj["classrooms"].toArray();
+        if (rootObj.contains("occurrences")) {
+            filtered["occurrences"] = rootObj["occurrences"].toArray();
+        }
+        return filtered;
+    }
+
+    QSet<QString> rooms;
+    QJsonArray classrooms;
+    for (const QJsonValue &value : rootObj["classrooms"].toArray()) {
+        QJsonObject obj = value.toObject();
+        if (obj["building"].toString() == config.building) {
+            rooms.insert(obj["room_name"].toString());
+            classrooms.append(obj);
+        }
+    }
+
+    QJsonArray schedules;
+    for (const QJsonValue &value : rootObj["schedules"].toArray()) {
+        if (rooms.contains(value.toObject().value("room_name").toString())) {
+            schedules.append(value);
+        }
+    }
+
+    filtered["schedules"] = schedules;
+    filtered["classrooms"] = classrooms;
+    if (rootObj.contains("occurrences")) {
+        QJsonArray occurrences;
+        for (const QJsonValue &value : rootObj["occurrences"].toArray()) {
+            if (rooms.contains(value.toObject().value("room_name").toString())) {
+                occurrences.append(value);
+            }
+        }
+        filtered["occurrences"] = occurrences;
+    }
+    return filtered;
+}
+
+const RelayNode::AudienceSlice &RelayNode::audienceSlice(const AudienceIndex::Audience &who) {
+    auto it = audienceSlices.find(who.key());
+    if (it != audienceSlices.end()) {
+        return it.value();
+    }
+    // 公告保留上游附带的投放范围，下级中继据此再筛选；班牌忽略这一项
+    const QJsonArray all = tables["announcements"].toArray();
+    AudienceSlice slice;
+    Columnar::TableEncoder<Schema::Announcements> encoder;
+    for (int row : audience.lookup(who)) {
+        encoder.appendJson(all.at(row).toObject());
+        slice.announcements.append(all.at(row));
+    }
+    encoder.writeTo(slice.columnar, Columnar::AnnouncementTable);
+    return audienceSlices.insert(who.key(), slice).value();
+}
+
+// 编码各表并替换当前数据；列式编码只在数据变化时做一次，每个班牌请求只需拼接头部和所在教室的公告
+void RelayNode::adopt(const QJsonObject &tablesObj, const QJsonObject &version) {
+    Columnar::TableEncoder<Schema::Schedules> schedules;
+    Columnar::TableEncoder<Schema::Classrooms> classrooms;
+    audience.clear();
+    for (const QJsonValue &value : tablesObj["schedules"].toArray()) {
+        schedules.appendJson(value.toObject());
+    }
+    for (const QJsonValue &value : tablesObj["classrooms"].toArray()) {
+        QJsonObject obj = value.toObject();
+        classrooms.appendJson(obj);
+        audience.setRoom(obj["room_name"].toString(), obj["building"].toString(), obj["floor"].toInt());
+    }
+    const QJsonArray announcements = tablesObj["announcements"].toArray();
+    for (int i = 0; i < announcements.size(); ++i) {
+        AnnouncementTarget target;
+        AnnouncementTarget::parse(announcements.at(i).toObject().value("target").toString(), target);
+        audience.setAnnouncement(i, target);
+    }
+    audienceSlices.clear();
+
+    QByteArray encoded;
+    schedules.writeTo(encoded, Columnar::ScheduleTable);
+    classrooms.writeTo(encoded, Columnar::ClassroomTable);
+
+    QByteArray calendar;
+    if (tablesObj.contains("calendar_days")) {
+        Columnar::TableEncoder<Schema::CalendarDays> days;
+        Columnar::TableEncoder<Schema::Occurrences> occurrences;
+        for (const QJsonValue &value : tablesObj["calendar_days"].toArray()) {
+            days.appendJson(value.toObject());
+        }
+        for (const QJsonValue &value : tablesObj["occurrences"].toArray()) {
+            occurrences.appendJson(value.toObject());
+        }
+        days.writeTo(calendar, Columnar::CalendarDayTable);
+        occurrences.writeTo(calendar, Columnar::OccurrenceTable);
+    }
+
+    tables = tablesObj;
+    upstreamVersion = version;
+    upstreamVersion.remove("request_at_ms");
+    columnarTables = encoded;
+    columnarCalendar = calendar;
+}
+
+bool RelayNode::loadCache() {
+    QFile file(config.cachePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonObject cache = QJsonDocument::fromJson(file.readAll()).object();
+    if (cache["building"].toString() != config.building || !cache.contains("tables")) {
+        qDebug() << "中继缓存与当前楼宇不符，忽略";
+        return false;
+    }
+    adopt(cache["tables"].toObject(), cache["version"].toObject());
+    return true;
+}
+
+void RelayNode::saveCache() const {
+    QJsonObject cache;
+    cache["building"] = config.building;
+    cache["version"] = upstreamVersion;
+    cache["tables"] = tables;
+    cache["saved_at_ms"] = QDateTime::currentMSecsSinceEpoch();
+
+    QSaveFile file(config.cachePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "无法写入中继缓存:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(cache).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qDebug() << "中继缓存写入失败:" << file.errorString();
+    }
+}
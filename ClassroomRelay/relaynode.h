@@ -0,0 +1,90 @@
+#ifndef RELAYNODE_H
+#define RELAYNODE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "relayconfig.h"
+#include "syncservice.h"
+#include "pollpolicy.h"
+#include "fleetregistry.h"
+#include "uplink.h"
+#include "audienceindex.h"
+
+// 楼宇中继：向上游只保持一个订阅，缓存本楼宇的最新数据，用与中心服务器相同的协议服务本楼宇的班牌。
+// 中心服务器的负载因此只与楼宇数量有关；上游断开时继续下发最后一份数据，缓存写入磁盘，重启后仍可服务。
+// 上游也可以是另一个中继，形成多级结构。
+class RelayNode : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RelayNode(const RelayConfig &config, QObject *parent = nullptr);
+
+    bool start();                      // 加载磁盘缓存、开始监听并连接上游
+    quint16 serverPort() const { return syncService->serverPort(); }
+    bool hasSnapshot() const { return !columnarTables.isEmpty(); }
+    qint64 changeId() const { return upstreamVersion.value("change_id").toInteger(); }
+    int announcementCount() const { return tables.value("announcements").toArray().size(); }
+    int requestsServed() const { return servedCount; }
+
+signals:
+    void snapshotUpdated(qint64 changeId);
+
+private slots:
+    void onSnapshotReceived(const QJsonObject &rootObj);
+    void onVersionReceived(const QByteArray &payload);
+    void onAnnouncementsReceived(const QByteArray &payload);
+    void onSyncRequested(const QJsonObject &args, qint64 requestAtMs);
+    void onSyncServed(const QJsonObject &args, const QString &peer, qint64 bytes);
+    void onCheckinAck(const QByteArray &payload);
+    void onAttendanceReceived(const QByteArray &payload);
+
+private:
+    QByteArray payloadFor(const QJsonObject &args, qint64 requestAtMs);
+    QJsonObject uplinkArgs();
+    void forwardCheckin(quint64 connection, const QJsonObject &args); // 班牌的签到批次转给上游
+    QJsonObject filterBuilding(const QJsonObject &rootObj) const;
+    // 某个班牌（按教室）或下级中继适用的公告，JSON 与列式编码各一份
+    struct AudienceSlice {
+        QJsonArray announcements;
+        QByteArray columnar;
+    };
+    const AudienceSlice &audienceSlice(const AudienceIndex::Audience &who);
+    void adopt(const QJsonObject &tablesObj, const QJsonObject &version);
+    bool loadCache();
+    void saveCache() const;
+
+    RelayConfig config;
+    SyncService *syncService;
+    Uplink *uplink;
+    PollAdvisor pollAdvisor;           // 下发给本楼宇班牌的轮询间隔
+
+    QJsonObject tables;                // 本楼宇的 schedules/classrooms/announcements，上游下发校历时还有 calendar_days/occurrences
+    QJsonObject upstreamVersion;       // 上游下发的 version，原样转给班牌
+    QByteArray columnarTables;         // 课程表和教室的列式编码，收到新数据时生成一次
+    QByteArray columnarCalendar;       // 校历两张表的列式编码，只发给请求了校历的班牌
+    AudienceIndex audience;            // 按上游附带的投放范围登记，公告以在数组中的下标为 id
+    QHash<QString, AudienceSlice> audienceSlices; // 受众 -> 适用的公告，数据更新时清空
+    QByteArray pendingVersion;         // 上游的新版本通知，拿到对应数据后再转发给本楼宇班牌
+    QHash<QString, QJsonObject> pendingReports;   // 班牌编号 -> 尚未转发的传播耗时
+    QHash<QString, QJsonObject> reportsInFlight;  // 已随上游请求发出、等待确认
+    FleetRegistry signs;               // 本楼宇班牌的状态，变化的行随上游请求转发
+    QSet<int> dirtySigns;              // 上次转发后有更新的行
+    QSet<int> signsInFlight;           // 已随上游请求发出、等待确认
+
+    // 已转给上游、等待确认的签到批次：中继标记 -> 来源连接；确认带回标记后转给原连接
+    struct ForwardedCheckin {
+        quint64 connection = 0;
+        QJsonValue tag;                // 下级中继附加的标记，转回时恢复
+        qint64 forwardedAtMs = 0;
+    };
+    QHash<qint64, ForwardedCheckin> forwardedCheckins;
+    QHash<QString, QJsonObject> attendanceRooms; // 教室 -> 最近一次推送的出勤，新订阅的班牌先收到这一份
+    qint64 nextCheckinTag = 1;
+    int servedCount = 0;
+};
+
+#endif // RELAYNODE_H
@@ -0,0 +1,629 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTcpSocket>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QtEndian>
+#include <QAtomicInt>
+#include <functional>
+#include "relaynode.h"
+#include "syncservice.h"
+#include "columnar.h"
+#include "laneframes.h"
+
+// 多中继联调测试：本机启动一个模拟中心服务器和三个楼宇中继，每个中继下挂若干班牌。
+// 要求：每个班牌只收到本楼宇的数据（JSON 与列式两种格式）；中心服务器只收到每个中继的一次拉取；
+// 紧急公告经中继在 500 毫秒内到达所有保持连接的班牌，并且能插到正在发送的大块数据之前；
+// 上游发布新版本后，中继先拉到新数据再把版本通知转发给班牌；
+// 公告过期时上游推送的有效公告集合由中继更新缓存并转发，不再拉取完整数据；
+// 带投放范围的公告只下发给范围内教室的班牌；
+// 班牌的签到批次经中继转给上游，上游的确认经中继送回原连接；上游推送的出勤人数只转给所在教室的班牌；
+// 上游停止后，重启的中继从磁盘缓存继续服务。
+
+static const char *kBuildings[] = {"A栋", "B栋", "C栋"};
+static const int kBuildingCount = 3;
+static const int kRoomsPerBuilding = 5;
+static const int kSlotsPerRoom = 25;
+static const int kSignsPerRelay = 10;
+static const qint64 kUrgentDeadlineMs = 500;
+static const int kLargeBulkBytes = 8 * 1024 * 1024;
+
+// 响应中的公告条数，JSON 与列式两种格式；无法解析时返回 -1
+static int announcementCount(const QByteArray &payload) {
+    if (Columnar::isColumnar(payload)) {
+        Columnar::Snapshot snapshot;
+        QString error;
+        return Columnar::decode(payload, snapshot, &error) ? snapshot.tables[Columnar::AnnouncementTable].rowCount : -1;
+    }
+    QJsonObject rootObj = QJsonDocument::fromJson(payload).object();
+    return rootObj.contains("announcements") ? rootObj["announcements"].toArray().size() : -1;
+}
+
+static QJsonObject makeCampus() {
+    QJsonArray schedules;
+    QJsonArray classrooms;
+    for (int b = 0; b < kBuildingCount; ++b) {
+        for (int r = 0; r < kRoomsPerBuilding; ++r) {
+            QString room = QString("%1-%2").arg(QChar('A' + b)).arg(101 + r);
+
+            QJsonObject classroom;
+            classroom["room_name"] = room;
+            classroom["class_name"] = QString("班级%1").arg(b * kRoomsPerBuilding + r);
+            classroom["capacity"] = 50;
+            classroom["building"] = QString::fromUtf8(kBuildings[b]);
+            classroom["floor"] = 1 + r / 2;
+            classroom["current_class"] = "";
+            classrooms.append(classroom);
+
+            for (int s = 0; s < kSlotsPerRoom; ++s) {
+                QJsonObject obj;
+                obj["room_name"] = room;
+                obj["course_name"] = QString("课程%1").arg(s % 7);
+                obj["teacher"] = QString("教师%1").arg((r + s) % 9);
+                obj["time_slot"] = QString("第%1节").arg(s % 5 + 1);
+                obj["start_time"] = QString("%1:00").arg(8 + 2 * (s % 5), 2, 10, QChar('0'));
+                obj["end_time"] = QString("%1:40").arg(9 + 2 * (s % 5), 2, 10, QChar('0'));
+                obj["weekday"] = 1 + s / 5;
+                obj["is_next"] = 0;
+                schedules.append(obj);
+            }
+        }
+    }
+
+    QJsonObject announcement;
+    announcement["title"] = "测试公告";
+    announcement["content"] = "全校通知";
+    announcement["priority"] = 1;
+    announcement["publish_time"] = "2025-01-01 00:00:00";
+    announcement["expire_time"] = "2099-01-01 00:00:00";
+
+    QJsonObject rootObj;
+    rootObj["schedules"] = schedules;
+    rootObj["classrooms"] = classrooms;
+    rootObj["announcements"] = QJsonArray{announcement};
+    return rootObj;
+}
+
+// 以阻塞方式模拟一次班牌拉取，只能在工作线程中调用
+static QByteArray fetch(quint16 port, const QJsonObject &args) {
+    QTcpSocket socket;
+    socket.connectToHost("127.0.0.1", port);
+    if (!socket.waitForConnected(3000)) {
+        return QByteArray();
+    }
+    socket.write("GET_SCHEDULE " + QJsonDocument(args).toJson(QJsonDocument::Compact) + "\n");
+
+    QByteArray buffer;
+    while (socket.waitForReadyRead(5000)) {
+        buffer.append(socket.readAll());
+        if (buffer.size() >= 4) {
+            qint64 size = qFromBigEndian<quint32>(buffer.constData());
+            if (buffer.size() >= 4 + size) {
+                return buffer.mid(4, int(size));
+            }
+        }
+    }
+    return QByteArray();
+}
+
+// 分道连接上阻塞读取下一帧，超时返回 false；只能在工作线程中调用
+static bool readFrame(QTcpSocket &socket, QByteArray &buffer, Lane::FrameType &type, QByteArray &payload,
+                      int timeoutMs) {
+    QElapsedTimer clock;
+    clock.start();
+    while (!Lane::takeFrame(buffer, type, payload)) {
+        qint64 left = timeoutMs - clock.elapsed();
+        if (left <= 0 || !socket.waitForReadyRead(int(left))) {
+            return false;
+        }
+        buffer.append(socket.readAll());
+    }
+    return true;
+}
+
+// 处理事件直到条件成立或超时
+static bool waitFor(const std::function<bool()> &condition, int timeoutMs) {
+    QElapsedTimer clock;
+    clock.start();
+    while (!condition()) {
+        if (clock.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+    }
+    return true;
+}
+
+// 班牌在工作线程中阻塞拉取，主线程继续处理中继的事件
+static void runOffThread(const std::function<void()> &body) {
+    QThread *thread = QThread::create(body);
+    thread->start();
+    waitFor([thread]() { return thread->isFinished(); }, 60000);
+    thread->wait();
+    delete thread;
+}
+
+// 检查响应只包含该楼宇的数据，并且带有上游的变更编号
+static bool checkResponse(const QByteArray &payload, const QString &building, qint64 changeId, QString *why) {
+    if (payload.isEmpty()) {
+        *why = "没有收到响应";
+        return false;
+    }
+
+    int schedules = 0;
+    int classrooms = 0;
+    QJsonObject version;
+    if (Columnar::isColumnar(payload)) {
+        Columnar::Snapshot snapshot;
+        if (!Columnar::decode(payload, snapshot, why)) {
+            return false;
+        }
+        const Columnar::TableData &rooms = snapshot.tables[Columnar::ClassroomTable];
+        for (int r = 0; r < rooms.rowCount; ++r) {
+            if (rooms.text(Schema::ClassroomCol::Building, r) != building) {
+                *why = "列式数据中混入了其他楼宇的教室";
+                return false;
+            }
+        }
+        schedules = snapshot.tables[Columnar::ScheduleTable].rowCount;
+        classrooms = rooms.rowCount;
+        version = snapshot.meta["version"].toObject();
+    } else {
+        QJsonObject rootObj = QJsonDocument::fromJson(payload).object();
+        for (const QJsonValue &value : rootObj["classrooms"].toArray()) {
+            if (value.toObject().value("building").toString() != building) {
+                *why = "JSON 数据中混入了其他楼宇的教室";
+                return false;
+            }
+        }
+        schedules = rootObj["schedules"].toArray().size();
+        classrooms = rootObj["classrooms"].toArray().size();
+        version = rootObj["version"].toObject();
+    }
+
+    if (classrooms != kRoomsPerBuilding || schedules != kRoomsPerBuilding * kSlotsPerRoom) {
+        *why = QString("教室 %1 条、课程 %2 条，与预期不符").arg(classrooms).arg(schedules);
+        return false;
+    }
+    if (version.value("change_id").toInteger() != changeId || version.value("request_at_ms").toInteger() <= 0) {
+        *why = "版本信息不符";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir workDir;
+
+    int failed = 0;
+    auto check = [&failed](bool condition, const QString &what) {
+        if (!condition) {
+            qDebug().noquote() << "FAIL:" << what;
+            ++failed;
+        }
+    };
+
+    // 模拟中心服务器：固定数据，统计收到的同步请求
+    const qint64 kChangeId = 7;
+    qint64 upstreamChangeId = kChangeId;
+    const QJsonObject campus = makeCampus();
+    int upstreamRequests = 0;
+    SyncService *upstream = new SyncService;
+    upstream->setPayloadProvider([&](const QJsonObject &, qint64 requestAtMs) {
+        ++upstreamRequests;
+        QJsonObject version;
+        version["change_id"] = upstreamChangeId;
+        version["committed_at_ms"] = requestAtMs - 1000;
+        version["request_at_ms"] = requestAtMs;
+        QJsonObject rootObj = campus;
+        rootObj["version"] = version;
+        rootObj["next_poll_ms"] = 600000;  // 测试期间中继不会再次拉取
+        return QJsonDocument(rootObj).toJson(QJsonDocument::Compact);
+    });
+    check(upstream->listen(QHostAddress::LocalHost, 0), "模拟中心服务器监听失败");
+
+    QVector<RelayConfig> configs;
+    QVector<RelayNode *> relays;
+    for (int b = 0; b < kBuildingCount; ++b) {
+        RelayConfig config;
+        config.upstream.signId = QString("relay-%1").arg(b);
+        config.upstream.endpoints = {ServerEndpoint{"127.0.0.1", upstream->serverPort()}};
+        config.building = QString::fromUtf8(kBuildings[b]);
+        config.listenPort = 0;
+        config.cachePath = workDir.filePath(QString("relay_%1.json").arg(b));
+        configs.append(config);
+
+        RelayNode *relay = new RelayNode(config);
+        check(relay->start(), QString("中继 %1 启动失败").arg(b));
+        relays.append(relay);
+    }
+
+    check(waitFor([&relays]() {
+        for (RelayNode *relay : relays) {
+            if (!relay->hasSnapshot()) return false;
+        }
+        return true;
+    }, 10000), "中继未收到上游数据");
+
+    // 每个中继下挂若干班牌，一半请求列式编码
+    QVector<quint16> ports;
+    for (RelayNode *relay : relays) {
+        ports.append(relay->serverPort());
+    }
+    QVector<QByteArray> responses(kBuildingCount * kSignsPerRelay);
+    runOffThread([&]() {
+        for (int b = 0; b < kBuildingCount; ++b) {
+            for (int s = 0; s < kSignsPerRelay; ++s) {
+                QJsonObject args;
+                args["sign_id"] = QString("%1-sign-%2").arg(b).arg(s);
+                if (s % 2) {
+                    args["accept"] = "columnar";
+                }
+                responses[b * kSignsPerRelay + s] = fetch(ports[b], args);
+            }
+        }
+    });
+
+    for (int i = 0; i < responses.size(); ++i) {
+        QString why;
+        check(checkResponse(responses[i], QString::fromUtf8(kBuildings[i / kSignsPerRelay]), kChangeId, &why),
+              QString("班牌 %1: %2").arg(i).arg(why));
+    }
+
+    int served = 0;
+    for (RelayNode *relay : relays) {
+        served += relay->requestsServed();
+    }
+    check(served == responses.size(), QString("中继共处理 %1 次请求，应为 %2").arg(served).arg(responses.size()));
+    check(upstreamRequests == kBuildingCount,
+          QString("中心服务器收到 %1 次请求，应为 %2（每个中继一次）").arg(upstreamRequests).arg(kBuildingCount));
+
+    // 紧急通道：每个中继下挂的分道连接都应在期限内收到上游推送的公告
+    QAtomicInt lanesReady(0);
+    QVector<qint64> urgentLatency(kBuildingCount * kSignsPerRelay, -1);
+    QThread *laneThread = QThread::create([&]() {
+        QVector<QTcpSocket *> sockets;
+        QVector<QByteArray> buffers(urgentLatency.size());
+        Lane::FrameType type;
+        QByteArray payload;
+        for (int i = 0; i < urgentLatency.size(); ++i) {
+            QTcpSocket *socket = new QTcpSocket;
+            socket->connectToHost("127.0.0.1", ports[i / kSignsPerRelay]);
+            sockets.append(socket);
+            if (!socket->waitForConnected(3000)) continue;
+            socket->write("GET_SCHEDULE {\"lanes\":true,\"accept\":\"columnar\"}\n");
+            while (readFrame(*socket, buffers[i], type, payload, 5000) && type != Lane::BulkEnd) {
+            }
+        }
+        lanesReady = 1;
+        for (int i = 0; i < sockets.size(); ++i) {
+            while (readFrame(*sockets[i], buffers[i], type, payload, 3000)) {
+                if (type == Lane::Urgent) {
+                    qint64 sentAtMs = QJsonDocument::fromJson(payload).object().value("sent_at_ms").toInteger();
+                    urgentLatency[i] = QDateTime::currentMSecsSinceEpoch() - sentAtMs;
+                    break;
+                }
+            }
+        }
+        qDeleteAll(sockets);
+    });
+    laneThread->start();
+    check(waitFor([&lanesReady]() { return lanesReady.loadRelaxed() == 1; }, 30000), "分道连接未完成首次同步");
+
+    QJsonObject urgent;
+    urgent["title"] = "紧急疏散";
+    urgent["content"] = "请立即离开教学楼";
+    urgent["priority"] = 10;
+    urgent["sent_at_ms"] = QDateTime::currentMSecsSinceEpoch();
+    check(upstream->pushUrgent(QJsonDocument(urgent).toJson(QJsonDocument::Compact)) == kBuildingCount,
+          "中心服务器应向每个中继推送一次紧急公告");
+    waitFor([laneThread]() { return laneThread->isFinished(); }, 30000);
+    laneThread->wait();
+    delete laneThread;
+
+    qint64 worstLatency = 0;
+    for (int i = 0; i < urgentLatency.size(); ++i) {
+        check(urgentLatency[i] >= 0, QString("班牌 %1 没有收到紧急公告").arg(i));
+        worstLatency = qMax(worstLatency, urgentLatency[i]);
+    }
+    check(worstLatency <= kUrgentDeadlineMs, QString("紧急公告最长 %1 ms 才送达").arg(worstLatency));
+    qDebug() << "紧急公告经中继送达最长耗时:" << worstLatency << "ms";
+
+    // 新版本：中心服务器发布后推送通知，中继各拉取一次，再把通知转给本楼宇保持连接的班牌
+    QAtomicInt versionLanesReady(0);
+    QVector<qint64> notifiedVersion(kBuildingCount * kSignsPerRelay, -1);
+    QThread *versionThread = QThread::create([&]() {
+        QVector<QTcpSocket *> sockets;
+        QVector<QByteArray> buffers(notifiedVersion.size());
+        Lane::FrameType type;
+        QByteArray payload;
+        for (int i = 0; i < notifiedVersion.size(); ++i) {
+            QTcpSocket *socket = new QTcpSocket;
+            socket->connectToHost("127.0.0.1", ports[i / kSignsPerRelay]);
+            sockets.append(socket);
+            if (!socket->waitForConnected(3000)) continue;
+            socket->write("GET_SCHEDULE {\"lanes\":true,\"accept\":\"columnar\"}\n");
+            while (readFrame(*socket, buffers[i], type, payload, 5000) && type != Lane::BulkEnd) {
+            }
+        }
+        versionLanesReady = 1;
+        for (int i = 0; i < sockets.size(); ++i) {
+            while (readFrame(*sockets[i], buffers[i], type, payload, 5000)) {
+                if (type == Lane::Version) {
+                    notifiedVersion[i] = QJsonDocument::fromJson(payload).object().value("change_id").toInteger();
+                    break;
+                }
+            }
+        }
+        qDeleteAll(sockets);
+    });
+    versionThread->start();
+    check(waitFor([&versionLanesReady]() { return versionLanesReady.loadRelaxed() == 1; }, 30000),
+          "分道连接未完成首次同步");
+
+    int requestsBeforeVersion = upstreamRequests;
+    upstreamChangeId = kChangeId + 1;
+    QJsonObject published;
+    published["change_id"] = upstreamChangeId;
+    check(upstream->pushVersion(QJsonDocument(published).toJson(QJsonDocument::Compact)) == kBuildingCount,
+          "中心服务器应向每个中继推送一次新版本通知");
+    waitFor([versionThread]() { return versionThread->isFinished(); }, 30000);
+    versionThread->wait();
+    delete versionThread;
+
+    for (int i = 0; i < notifiedVersion.size(); ++i) {
+        check(notifiedVersion[i] == upstreamChangeId, QString("班牌 %1 没有收到新版本通知").arg(i));
+    }
+    for (int b = 0; b < kBuildingCount; ++b) {
+        check(relays[b]->changeId() == upstreamChangeId, QString("中继 %1 转发通知前没有拉到新版本").arg(b));
+    }
+    check(upstreamRequests - requestsBeforeVersion == kBuildingCount,
+          QString("新版本发布后中心服务器收到 %1 次请求，应为 %2")
+              .arg(upstreamRequests - requestsBeforeVersion).arg(kBuildingCount));
+
+    // 公告到期：上游推送当前有效的公告集合（这里为空），中继替换缓存中的公告并转发，不再向上游拉取
+    QAtomicInt announcementLanesReady(0);
+    QVector<int> pushedAnnouncements(kBuildingCount, -1);
+    QThread *announcementThread = QThread::create([&]() {
+        QVector<QTcpSocket *> sockets;
+        QVector<QByteArray> buffers(kBuildingCount);
+        Lane::FrameType type;
+        QByteArray payload;
+        for (int b = 0; b < kBuildingCount; ++b) {
+            QTcpSocket *socket = new QTcpSocket;
+            socket->connectToHost("127.0.0.1", ports[b]);
+            sockets.append(socket);
+            if (!socket->waitForConnected(3000)) continue;
+            socket->write("GET_SCHEDULE {\"lanes\":true,\"accept\":\"columnar\"}\n");
+            while (readFrame(*socket, buffers[b], type, payload, 5000) && type != Lane::BulkEnd) {
+            }
+        }
+        announcementLanesReady = 1;
+        for (int b = 0; b < sockets.size(); ++b) {
+            while (readFrame(*sockets[b], buffers[b], type, payload, 5000)) {
+                if (type == Lane::Announcements) {
+                    pushedAnnouncements[b] = QJsonDocument::fromJson(payload).object()["announcements"].toArray().size();
+                    break;
+                }
+            }
+        }
+        qDeleteAll(sockets);
+    });
+    announcementThread->start();
+    check(waitFor([&announcementLanesReady]() { return announcementLanesReady.loadRelaxed() == 1; }, 30000),
+          "分道连接未完成首次同步");
+
+    int requestsBeforeAnnouncements = upstreamRequests;
+    QJsonObject effective;
+    effective["announcements"] = QJsonArray();
+    effective["change_id"] = upstreamChangeId;
+    check(upstream->pushAnnouncements(QJsonDocument(effective).toJson(QJsonDocument::Compact)) == kBuildingCount,
+          "中心服务器应向每个中继推送一次公告集合");
+    waitFor([announcementThread]() { return announcementThread->isFinished(); }, 30000);
+    announcementThread->wait();
+    delete announcementThread;
+
+    for (int b = 0; b < kBuildingCount; ++b) {
+        check(pushedAnnouncements[b] == 0, QString("中继 %1 的班牌没有收到公告集合").arg(b));
+        check(relays[b]->announcementCount() == 0, QString("中继 %1 的缓存中仍有已过期的公告").arg(b));
+    }
+    check(upstreamRequests == requestsBeforeAnnouncements, "公告推送后中继不应再向上游拉取");
+
+    // 定向公告：上游附带投放范围，中继按班牌所在的教室筛选。每栋的 x-101、x-102 在 1 楼
+    auto targetedAnnouncement = [](const QString &title, const QString &target) {
+        QJsonObject obj;
+        obj["title"] = title;
+        obj["content"] = title;
+        obj["priority"] = 1;
+        obj["publish_time"] = "2025-01-01 00:00:00";
+        obj["expire_time"] = "2099-01-01 00:00:00";
+        obj["target"] = target;
+        return obj;
+    };
+    QJsonObject targeted;
+    targeted["announcements"] = QJsonArray{targetedAnnouncement("全校通知", ""),
+                                           targetedAnnouncement("A栋一楼停水", "floor:A栋/1"),
+                                           targetedAnnouncement("B-103 调课", "rooms:B-103")};
+    targeted["change_id"] = upstreamChangeId;
+    upstream->pushAnnouncements(QJsonDocument(targeted).toJson(QJsonDocument::Compact));
+    check(waitFor([&relays]() {
+        for (RelayNode *relay : relays) {
+            if (relay->announcementCount() != 3) return false;
+        }
+        return true;
+    }, 5000), "中继没有收到定向公告");
+
+    struct TargetedCase {
+        int building;
+        QString room;
+        int expected;
+    };
+    const QVector<TargetedCase> targetedCases = {
+        {0, "A-101", 2}, {0, "A-102", 2}, {0, "A-104", 1}, {1, "B-103", 2}, {1, "B-101", 1}, {2, "C-101", 1},
+    };
+    QVector<int> targetedCounts(targetedCases.size(), -1);
+    runOffThread([&]() {
+        for (int i = 0; i < targetedCases.size(); ++i) {
+            QJsonObject args;
+            args["sign_id"] = "targeted-" + targetedCases[i].room;
+            args["room"] = targetedCases[i].room;
+            if (i % 2) {
+                args["accept"] = "columnar";
+            }
+            targetedCounts[i] = announcementCount(fetch(ports[targetedCases[i].building], args));
+        }
+    });
+    for (int i = 0; i < targetedCases.size(); ++i) {
+        check(targetedCounts[i] == targetedCases[i].expected,
+              QString("教室 %1 收到 %2 条公告，应为 %3")
+                  .arg(targetedCases[i].room).arg(targetedCounts[i]).arg(targetedCases[i].expected));
+    }
+
+    // 签到批次经中继转发：上游看到班牌编号和中继附加的标记，班牌收到的确认带回自己的批次号、不带标记
+    QJsonObject upstreamCheckin;
+    upstream->addAsyncCommand("CHECKIN", [&](quint64 connection, const QJsonObject &args) {
+        upstreamCheckin = args;
+        QJsonObject ack;
+        ack["batch"] = args["batch"];
+        ack["tag"] = args["tag"];
+        ack["ok"] = true;
+        ack["accepted"] = args["events"].toArray().size();
+        ack["duplicates"] = 0;
+        upstream->reply(connection, Lane::CheckinAck, QJsonDocument(ack).toJson(QJsonDocument::Compact));
+
+        // 写入后上游推送两栋楼的出勤，中继只转发本楼宇、班牌只收到自己教室的一项
+        QJsonObject here;
+        here["room"] = args["room"];
+        here["building"] = QString::fromUtf8(kBuildings[0]);
+        here["capacity"] = 40;
+        here["present"] = ack["accepted"];
+        here["course"] = "高等数学";
+        QJsonObject elsewhere = here;
+        elsewhere["room"] = "B-101";
+        elsewhere["building"] = QString::fromUtf8(kBuildings[1]);
+        QJsonObject attendance;
+        attendance["rooms"] = QJsonArray{here, elsewhere};
+        const QByteArray payload = QJsonDocument(attendance).toJson(QJsonDocument::Compact);
+        upstream->pushAttendance([&payload](const QJsonObject &) { return payload; });
+    });
+    QJsonObject signAck;
+    QJsonArray signAttendance;
+    bool signSynced = false;
+    runOffThread([&]() {
+        QTcpSocket socket;
+        socket.connectToHost("127.0.0.1", ports[0]);
+        if (!socket.waitForConnected(3000)) return;
+        socket.write("GET_SCHEDULE {\"lanes\":true,\"sign_id\":\"checkin-sign\",\"room\":\"A-101\"}\n");
+        QByteArray buffer;
+        Lane::FrameType type;
+        QByteArray payload;
+        while (!signSynced && readFrame(socket, buffer, type, payload, 5000)) {
+            signSynced = type == Lane::BulkEnd;
+        }
+        if (!signSynced) return;
+
+        QJsonObject first;
+        first["card"] = "20240001";
+        first["at_ms"] = QDateTime::currentMSecsSinceEpoch();
+        QJsonObject second;
+        second["card"] = "20240002";
+        second["at_ms"] = QDateTime::currentMSecsSinceEpoch() + 1;
+        QJsonObject args;
+        args["sign_id"] = "checkin-sign";
+        args["room"] = "A-101";
+        args["batch"] = 7;
+        args["events"] = QJsonArray{first, second};
+        socket.write("CHECKIN " + QJsonDocument(args).toJson(QJsonDocument::Compact) + "\n");
+        while (readFrame(socket, buffer, type, payload, 5000)) {
+            if (type == Lane::CheckinAck) {
+                signAck = QJsonDocument::fromJson(payload).object();
+            } else if (type == Lane::Attendance) {
+                signAttendance = QJsonDocument::fromJson(payload).object().value("rooms").toArray();
+            }
+            if (!signAck.isEmpty() && !signAttendance.isEmpty()) {
+                break;
+            }
+        }
+    });
+    check(signSynced, "签到班牌没有完成同步");
+    check(upstreamCheckin.value("sign_id").toString() == "checkin-sign" && upstreamCheckin.contains("tag"),
+          "上游没有收到带中继标记的签到批次");
+    check(signAck.value("batch").toInt() == 7 && signAck.value("ok").toBool() && signAck.value("accepted").toInt() == 2
+              && !signAck.contains("tag"),
+          "班牌收到的签到确认不正确: " + QString::fromUtf8(QJsonDocument(signAck).toJson(QJsonDocument::Compact)));
+    check(signAttendance.size() == 1 && signAttendance.at(0).toObject().value("room").toString() == "A-101"
+              && signAttendance.at(0).toObject().value("present").toInt() == 2,
+          "班牌收到的出勤推送不正确: " + QString::fromUtf8(QJsonDocument(signAttendance).toJson(QJsonDocument::Compact)));
+
+    // 正在发送大块数据时推送的紧急公告应先于数据末块到达
+    SyncService bulkServer;
+    bulkServer.setPayloadProvider([](const QJsonObject &, qint64) { return QByteArray(kLargeBulkBytes, 'x'); });
+    check(bulkServer.listen(QHostAddress::LocalHost, 0), "大块数据服务器监听失败");
+    quint16 bulkPort = bulkServer.serverPort();
+    QAtomicInt bulkStarted(0);
+    bool urgentBeforeEnd = false;
+    bool bulkCompleted = false;
+    QThread *bulkThread = QThread::create([&]() {
+        QTcpSocket socket;
+        socket.connectToHost("127.0.0.1", bulkPort);
+        if (!socket.waitForConnected(3000)) return;
+        socket.write("GET_SCHEDULE {\"lanes\":true}\n");
+        QByteArray buffer;
+        Lane::FrameType type;
+        QByteArray payload;
+        while (readFrame(socket, buffer, type, payload, 5000)) {
+            bulkStarted = 1;
+            if (type == Lane::Urgent) {
+                urgentBeforeEnd = true;
+            } else if (type == Lane::BulkEnd) {
+                bulkCompleted = true;
+                return;
+            }
+        }
+    });
+    bulkThread->start();
+    check(waitFor([&bulkStarted]() { return bulkStarted.loadRelaxed() == 1; }, 10000), "大块数据未开始发送");
+    bulkServer.pushUrgent(QJsonDocument(urgent).toJson(QJsonDocument::Compact));
+    waitFor([bulkThread]() { return bulkThread->isFinished(); }, 60000);
+    bulkThread->wait();
+    delete bulkThread;
+    check(bulkCompleted, "大块数据没有完整收到");
+    check(urgentBeforeEnd, "紧急公告没有插到大块数据之前");
+
+    // 上游停止后：运行中的中继继续服务，重启的中继从磁盘缓存恢复
+    delete upstream;
+    delete relays[0];
+    relays[0] = new RelayNode(configs[0]);
+    check(relays[0]->start(), "中继重启失败");
+    check(relays[0]->hasSnapshot() && relays[0]->changeId() == upstreamChangeId, "重启的中继没有从缓存恢复数据");
+
+    QByteArray restarted;
+    QByteArray running;
+    quint16 restartedPort = relays[0]->serverPort();
+    quint16 runningPort = relays[1]->serverPort();
+    runOffThread([&]() {
+        QJsonObject args;
+        args["sign_id"] = "offline-sign";
+        args["accept"] = "columnar";
+        restarted = fetch(restartedPort, args);
+        running = fetch(runningPort, args);
+    });
+
+    QString why;
+    check(checkResponse(restarted, QString::fromUtf8(kBuildings[0]), upstreamChangeId, &why),
+          "上游断开后重启的中继: " + why);
+    check(checkResponse(running, QString::fromUtf8(kBuildings[1]), upstreamChangeId, &why),
+          "上游断开后运行中的中继: " + why);
+
+    qDeleteAll(relays);
+
+    qDebug() << (failed ? "测试失败" : "测试通过");
+    return failed;
+}
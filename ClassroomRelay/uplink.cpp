@@ -0,0 +1,259 @@
+#include "uplink.h"
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QDebug>
+#include "laneframes.h"
+#include <QRandomGenerator>
+#include <QMetaObject>
+
+static const double kPollJitterRatio = 0.1;
+static const int kBackoffBaseMs = 2000;
+static const int kBackoffCeilingMs = 60000;
+static const int kResubscribeDelayMs = 1000;
+
+Uplink::Uplink(const SignConfig &config, QObject *parent)
+    : QObject(parent), config(config), socket(new QTcpSocket(this)),
+      receiveTimer(new QTimer(this)), pollTimer(new QTimer(this)) {
+    endpointPool.setEndpoints(config.endpoints);
+
+    receiveTimer->setSingleShot(true);
+    pollTimer->setSingleShot(true);
+
+    connect(socket, &QTcpSocket::connected, this, &Uplink::onConnected);
+    connect(socket, &QTcpSocket::readyRead, this, &Uplink::onReadyRead);
+    connect(socket, &QTcpSocket::errorOccurred, this, &Uplink::onError);
+    connect(socket, &QTcpSocket::disconnected, this, &Uplink::onDisconnected);
+    connect(receiveTimer, &QTimer::timeout, this, &Uplink::onReceiveTimeout);
+    connect(pollTimer, &QTimer::timeout, this, &Uplink::poll);
+}
+
+void Uplink::setArgsProvider(ArgsProvider provider) {
+    argsProvider = std::move(provider);
+}
+
+void Uplink::start() {
+    poll();
+}
+
+qint64 Uplink::msToNextPoll() const {
+    return pollTimer->isActive() ? pollTimer->remainingTime() : -1;
+}
+
+void Uplink::refresh() {
+    if (attemptFinished) {
+        pollTimer->start(0);
+    }
+}
+
+void Uplink::poll() {
+    // 新一轮拉取：所有上游地址都可再次尝试
+    triedEndpoints.fill(false, endpointPool.size());
+    attemptFinished = false;
+
+    // 分道连接仍然打开时直接在原连接上请求
+    if (laneConnection && socket->state() == QAbstractSocket::ConnectedState && currentEndpoint >= 0) {
+        triedEndpoints[currentEndpoint] = true;
+        firstByteSeen = false;
+        attemptClock.start();
+        sendRequest();
+        return;
+    }
+    tryNextEndpoint();
+}
+
+void Uplink::tryNextEndpoint() {
+    if (attemptFinished) {
+        return;
+    }
+
+    int index = endpointPool.pick(QDateTime::currentMSecsSinceEpoch(), triedEndpoints);
+    if (index < 0) {
+        qDebug() << "所有上游服务器均不可用，继续使用缓存数据";
+        emit uplinkFailed();
+        scheduleNextPoll(false);
+        return;
+    }
+    triedEndpoints[index] = true;
+    currentEndpoint = index;
+
+    if (socket->state() != QAbstractSocket::UnconnectedState) {
+        socket->abort();
+    }
+    buffer.clear();
+    bulkBuffer.clear();
+    receivingData = false;
+    laneConnection = false;
+    firstByteSeen = false;
+
+    const ServerEndpoint &endpoint = endpointPool.endpoint(index);
+    receiveTimer->start(config.connectTimeoutMs);
+    attemptClock.start();
+    qDebug() << "中继正在连接上游" << endpoint.host << endpoint.port;
+    socket->connectToHost(endpoint.host, endpoint.port);
+}
+
+void Uplink::onConnected() {
+    buffer.clear();
+    bulkBuffer.clear();
+    sendRequest();
+}
+
+void Uplink::sendRequest() {
+    receivingData = true;
+    receiveTimer->start(config.firstByteTimeoutMs);
+
+    QJsonObject args = argsProvider ? argsProvider() : QJsonObject();
+    args["sign_id"] = config.signId;
+    args["lanes"] = true;
+    socket->write("GET_SCHEDULE " + QJsonDocument(args).toJson(QJsonDocument::Compact) + "\n");
+    socket->flush();
+}
+
+bool Uplink::sendCommand(const QByteArray &command, const QJsonObject &args) {
+    if (!laneConnection || socket->state() != QAbstractSocket::ConnectedState) {
+        return false;
+    }
+    socket->write(command + ' ' + QJsonDocument(args).toJson(QJsonDocument::Compact) + '\n');
+    return true;
+}
+
+void Uplink::onReadyRead() {
+    buffer.append(socket->readAll());
+    if (receivingData) {
+        if (!firstByteSeen) {
+            firstByteSeen = true;
+            endpointPool.reportSuccess(currentEndpoint, attemptClock.elapsed());
+        }
+        receiveTimer->start(config.receiveTimeoutMs);
+    }
+
+    Lane::FrameType type;
+    QByteArray payload;
+    while (Lane::takeFrame(buffer, type, payload)) {
+        switch (type) {
+        case Lane::Urgent:
+            emit urgentReceived(payload);
+            break;
+        case Lane::Version:
+            emit versionReceived(payload);
+            break;
+        case Lane::Announcements:
+            emit announcementsReceived(payload);
+            break;
+        case Lane::CheckinAck:
+            emit checkinAckReceived(payload);
+            break;
+        case Lane::Attendance:
+            emit attendanceReceived(payload);
+            break;
+        case Lane::BulkChunk:
+            bulkBuffer.append(payload);
+            break;
+        case Lane::BulkEnd:
+            laneConnection = true;
+            bulkBuffer.append(payload);
+            payload = bulkBuffer;
+            bulkBuffer.clear();
+            finishPoll(payload);
+            break;
+        case Lane::Legacy:
+            laneConnection = false;
+            finishPoll(payload);
+            break;
+        default:
+            break;
+        }
+        if (socket->state() != QAbstractSocket::ConnectedState) {
+            return;
+        }
+    }
+}
+
+void Uplink::finishPoll(const QByteArray &payload) {
+    if (!receivingData) {
+        return;
+    }
+    receiveTimer->stop();
+    receivingData = false;
+    if (!laneConnection) {
+        socket->disconnectFromHost();
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(payload);
+    if (!doc.isObject()) {
+        qDebug() << "上游数据格式错误，忽略本次拉取";
+        socket->abort();
+        failCurrentEndpoint();
+        return;
+    }
+
+    QJsonObject rootObj = doc.object();
+    // 与班牌相同，防御性地限制在 1 秒到 1 小时之间
+    if (rootObj.contains("next_poll_ms")) {
+        advisedPollMs = qBound(1000, rootObj["next_poll_ms"].toInt(advisedPollMs), 3600000);
+    }
+    scheduleNextPoll(true);
+    emit snapshotReceived(rootObj);
+}
+
+void Uplink::onDisconnected() {
+    bool wasLane = laneConnection;
+    laneConnection = false;
+    buffer.clear();
+    bulkBuffer.clear();
+
+    // 空闲时被断开的分道连接尽快重连，以免错过紧急公告
+    if (wasLane && attemptFinished
+        && (!pollTimer->isActive() || pollTimer->remainingTime() > kResubscribeDelayMs)) {
+        pollTimer->start(kResubscribeDelayMs);
+    }
+}
+
+void Uplink::onError(QAbstractSocket::SocketError socketError) {
+    Q_UNUSED(socketError);
+    // 拉取完成后上游关闭连接也会触发错误，只有未完成的拉取才计为失败
+    if (attemptFinished) {
+        return;
+    }
+    qDebug() << "上游连接错误:" << socket->errorString();
+    failCurrentEndpoint();
+}
+
+void Uplink::onReceiveTimeout() {
+    qDebug() << "上游响应超时";
+    socket->abort();
+    failCurrentEndpoint();
+}
+
+void Uplink::failCurrentEndpoint() {
+    receiveTimer->stop();
+    buffer.clear();
+    bulkBuffer.clear();
+    receivingData = false;
+
+    if (attemptFinished) {
+        return;
+    }
+    if (currentEndpoint >= 0) {
+        endpointPool.reportFailure(currentEndpoint, QDateTime::currentMSecsSinceEpoch());
+    }
+
+    // 在套接字信号处理函数中不直接重连，排队到事件循环再切换
+    QMetaObject::invokeMethod(this, &Uplink::tryNextEndpoint, Qt::QueuedConnection);
+}
+
+void Uplink::scheduleNextPoll(bool succeeded) {
+    attemptFinished = true;
+
+    int delayMs;
+    if (succeeded) {
+        consecutiveFailures = 0;
+        double factor = 1.0 + kPollJitterRatio * (QRandomGenerator::global()->generateDouble() * 2.0 - 1.0);
+        delayMs = int(advisedPollMs * factor);
+    } else {
+        consecutiveFailures = qMin(consecutiveFailures + 1, 16);
+        qint64 backoff = qMin<qint64>(qint64(kBackoffBaseMs) << (consecutiveFailures - 1), kBackoffCeilingMs);
+        delayMs = int(backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1));
+    }
+    pollTimer->start(delayMs);
+}
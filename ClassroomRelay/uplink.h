@@ -0,0 +1,78 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QVector>
+#include <functional>
+#include "signconfig.h"
+#include "endpointpool.h"
+
+// 中继到上游服务器的同步连接，协议与班牌相同。
+// 每次拉取一份完整数据，之后按上游建议的间隔轮询；上游不可用时按指数退避重试，
+// 多个上游地址之间的选择与班牌一样交给 EndpointPool。
+// 上游支持分道帧时连接保持打开，紧急公告到达后立即交给中继转发。
+class Uplink : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 每次发出请求前调用，返回附加在请求行上的参数
+    using ArgsProvider = std::function<QJsonObject()>;
+
+    explicit Uplink(const SignConfig &config, QObject *parent = nullptr);
+
+    void setArgsProvider(ArgsProvider provider);
+    void start();                  // 立即拉取一次，之后自动轮询
+    qint64 msToNextPoll() const;   // 距下一次拉取的毫秒数，未安排时返回 -1
+    void refresh();                // 上游发布了新版本：空闲时立即拉取，正在拉取时不重复发起
+    // 在保持打开的分道连接上发送一条命令（如转发班牌的 CHECKIN），没有分道连接时返回 false
+    bool sendCommand(const QByteArray &command, const QJsonObject &args);
+
+signals:
+    void snapshotReceived(const QJsonObject &rootObj);
+    void uplinkFailed();           // 本轮所有上游地址都失败
+    void urgentReceived(const QByteArray &payload); // 上游推送的紧急公告，原样转发
+    void versionReceived(const QByteArray &payload); // 上游推送的新版本通知
+    void announcementsReceived(const QByteArray &payload); // 上游推送的当前有效公告集合
+    void checkinAckReceived(const QByteArray &payload); // 上游对转发的签到批次的确认
+    void attendanceReceived(const QByteArray &payload); // 上游推送的出勤人数
+
+private slots:
+    void poll();
+    void tryNextEndpoint();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError socketError);
+    void onReceiveTimeout();
+
+private:
+    void sendRequest();
+    void finishPoll(const QByteArray &payload);
+    void failCurrentEndpoint();
+    void scheduleNextPoll(bool succeeded);
+
+    SignConfig config;
+    EndpointPool endpointPool;
+    ArgsProvider argsProvider;
+    QTcpSocket *socket;
+    QTimer *receiveTimer;          // 连接、首字节和接收三个阶段的超时
+    QTimer *pollTimer;             // 下一次拉取
+    QElapsedTimer attemptClock;
+    QVector<bool> triedEndpoints;
+    QByteArray buffer;             // 尚未凑成完整帧的数据
+    QByteArray bulkBuffer;         // 分道连接上已收到的数据块
+    bool receivingData = false;
+    bool laneConnection = false;   // 上游使用分道帧，连接在两次拉取之间保持打开
+    int currentEndpoint = -1;
+    int advisedPollMs = 30000;
+    int consecutiveFailures = 0;
+    bool firstByteSeen = false;
+    bool attemptFinished = true;
+};
+
+#endif // UPLINK_H
@@ -8,11 +8,50 @@ TARGET = ClassroomServer
 TEMPLATE = app
 
 SOURCES += \
+    attendancetracker.cpp \
+    audienceindex.cpp \
+    calendarengine.cpp \
+    checkiningest.cpp \
+    conflictengine.cpp \
+    fleetmodel.cpp \
+    fleetregistry.cpp \
+    intervaltree.cpp \
     main.cpp \
-    serverwindow.cpp
+    occupancyindex.cpp \
+    pollpolicy.cpp \
+    propagationstats.cpp \
+    serverwindow.cpp \
+    snapshotbuilder.cpp \
+    syncframing.cpp \
+    syncservice.cpp \
+    timetablegenerator.cpp \
+    timetableversions.cpp \
+    timerwheel.cpp
+
+INCLUDEPATH += ../ClassroomCommon
 
 HEADERS += \
-    serverwindow.h
+    ../ClassroomCommon/columnar.h \
+    ../ClassroomCommon/laneframes.h \
+    ../ClassroomCommon/schema.h \
+    attendancetracker.h \
+    audienceindex.h \
+    calendarengine.h \
+    checkiningest.h \
+    conflictengine.h \
+    fleetmodel.h \
+    fleetregistry.h \
+    intervaltree.h \
+    occupancyindex.h \
+    pollpolicy.h \
+    propagationstats.h \
+    serverwindow.h \
+    snapshotbuilder.h \
+    syncframing.h \
+    syncservice.h \
+    timetablegenerator.h \
+    timetableversions.h \
+    timerwheel.h
 
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
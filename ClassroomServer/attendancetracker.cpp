@@ -0,0 +1,352 @@
+#include "attendancetracker.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QTime>
+#include <algorithm>
+
+// 课程表中的 "HH:mm" 或 "HH:mm:ss" 转为 date 当天的绝对毫秒数，格式不符或尚未重建（date 无效）返回 -1
+static qint64 timeOnDate(const QDate &date, const QString &text) {
+    QTime time = QTime::fromString(text, "HH:mm");
+    if (!time.isValid()) {
+        time = QTime::fromString(text, "HH:mm:ss");
+    }
+    return time.isValid() && date.isValid() ? QDateTime(date, time).toMSecsSinceEpoch() : -1;
+}
+
+bool AttendanceTracker::rebuild(QSqlDatabase db, const QDate &date, bool useCalendar, qint64 nowMs, QString *error) {
+    clear();
+    day = date;
+    clockMs = nowMs;
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT room_name, building, capacity FROM classrooms")) {
+        if (error) *error = "读取教室失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        setRoom(query.value(0).toString(), query.value(1).toString(), query.value(2).toInt());
+    }
+
+    // 需要课程 id，校历模式下不经 occurrence_view 而直接联表
+    if (useCalendar) {
+        query.prepare("SELECT s.id, s.room, s.course, s.teacher, s.start_time, s.end_time FROM schedule_occurrences o "
+                      "JOIN master_schedules s ON s.id = o.schedule_id WHERE o.date = ?");
+        query.addBindValue(date.toString(Qt::ISODate));
+    } else {
+        query.prepare("SELECT id, room, course, teacher, start_time, end_time FROM master_schedules WHERE weekday = ?");
+        query.addBindValue(date.dayOfWeek());
+    }
+    if (!query.exec()) {
+        if (error) *error = "读取当天课程失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        setSession(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString(),
+                   query.value(3).toString(), query.value(4).toString(), query.value(5).toString());
+    }
+    advance(nowMs);
+
+    // 当天已写入的签到按时间重放一遍，之后只随新写入的签到累加
+    query.prepare("SELECT room_name, card_id, checked_at_ms FROM checkins WHERE checked_at_ms >= ? AND checked_at_ms < ?");
+    query.addBindValue(date.startOfDay().toMSecsSinceEpoch());
+    query.addBindValue(date.addDays(1).startOfDay().toMSecsSinceEpoch());
+    if (!query.exec()) {
+        if (error) *error = "读取当天签到失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        record(query.value(0).toString(), query.value(1).toString(), query.value(2).toLongLong());
+    }
+    markAllDirty();
+    return true;
+}
+
+void AttendanceTracker::clear() {
+    day = QDate();
+    rooms.clear();
+    buildings.clear();
+    sessionRooms.clear();
+    transitions.clear();
+    nextTransition = 0;
+    transitionsSorted = true;
+    clockMs = 0;
+    sessions = 0;
+    dirty.clear();
+}
+
+void AttendanceTracker::setRoom(const QString &room, const QString &building, int capacity) {
+    auto it = rooms.find(room);
+    if (it == rooms.end()) {
+        it = rooms.insert(room, Room());
+    } else {
+        attach(it.value(), -1);
+        Totals &old = buildings[it->building];
+        if (--old.rooms == 0) {
+            buildings.remove(it->building);
+        }
+    }
+    it->building = building;
+    it->capacity = capacity;
+    ++buildings[building].rooms;
+    attach(it.value(), 1);
+    dirty.insert(room);
+}
+
+void AttendanceTracker::removeRoom(const QString &room) {
+    auto it = rooms.find(room);
+    if (it == rooms.end()) {
+        return;
+    }
+    attach(it.value(), -1);
+    Totals &totals = buildings[it->building];
+    if (--totals.rooms == 0) {
+        buildings.remove(it->building);
+    }
+    sessions -= it->sessions.size();
+    for (const Session &session : std::as_const(it->sessions)) {
+        sessionRooms.remove(session.id);
+    }
+    rooms.erase(it);
+    dirty.remove(room);
+}
+
+void AttendanceTracker::addSession(int id, const QString &room, const QString &course, const QString &teacher,
+                                   qint64 startMs, qint64 endMs) {
+    QSet<QString> cards = takeSession(id);
+
+    // 课程表里有而教室表里没有的教室也统计，楼栋记为空
+    if (!rooms.contains(room)) {
+        setRoom(room, QString(), 0);
+    }
+    Room &target = rooms[room];
+
+    Session session;
+    session.id = id;
+    session.cards = std::move(cards);
+    session.course = course;
+    session.teacher = teacher;
+    session.startMs = startMs;
+    session.endMs = endMs;
+    auto pos = std::upper_bound(target.sessions.begin(), target.sessions.end(), startMs,
+                                [](qint64 value, const Session &s) { return value < s.startMs; });
+    int index = int(pos - target.sessions.begin());
+    target.sessions.insert(index, session);
+    if (target.current >= index) {
+        ++target.current;
+    }
+    ++sessions;
+    sessionRooms.insert(id, room);
+
+    transitions.append(Transition{startMs - kEarlyMs, room});
+    transitions.append(Transition{endMs + 1, room});
+    transitionsSorted = false;
+
+    // 白天临时加课时当前节次可能立即变化
+    int current = sessionAt(target, clockMs);
+    if (current != target.current) {
+        switchCurrent(room, target, current);
+    }
+}
+
+void AttendanceTracker::setSession(int id, const QString &room, const QString &course, const QString &teacher,
+                                   const QString &startTime, const QString &endTime) {
+    qint64 startMs = timeOnDate(day, startTime);
+    qint64 endMs = timeOnDate(day, endTime);
+    if (startMs >= 0 && endMs > startMs) {
+        addSession(id, room, course, teacher, startMs, endMs);
+    } else {
+        removeSession(id);
+    }
+}
+
+void AttendanceTracker::removeSession(int id) {
+    takeSession(id);
+}
+
+QSet<QString> AttendanceTracker::takeSession(int id) {
+    auto found = sessionRooms.find(id);
+    if (found == sessionRooms.end()) {
+        return QSet<QString>();
+    }
+    const QString name = found.value();
+    sessionRooms.erase(found);
+    Room &room = rooms[name];
+    int index = 0;
+    while (index < room.sessions.size() && room.sessions[index].id != id) {
+        ++index;
+    }
+    if (index == room.sessions.size()) {
+        return QSet<QString>();
+    }
+
+    // 先把当前节次移出楼栋合计，删除后按时间重新确定当前节次
+    attach(room, -1);
+    QSet<QString> cards = std::move(room.sessions[index].cards);
+    room.sessions.remove(index);
+    --sessions;
+    room.current = sessionAt(room, clockMs);
+    attach(room, 1);
+    dirty.insert(name);
+    return cards;
+}
+
+// 优先取时间落在课程时间内的一节；不在任何一节课内时取开课前的签到时段
+int AttendanceTracker::sessionAt(const Room &room, qint64 atMs) const {
+    int early = -1;
+    for (int i = 0; i < room.sessions.size(); ++i) {
+        const Session &session = room.sessions[i];
+        if (atMs >= session.startMs && atMs <= session.endMs) {
+            return i;
+        }
+        if (early < 0 && atMs >= session.startMs - kEarlyMs && atMs < session.startMs) {
+            early = i;
+        }
+    }
+    return early;
+}
+
+void AttendanceTracker::switchCurrent(const QString &name, Room &room, int index) {
+    attach(room, -1);
+    room.current = index;
+    attach(room, 1);
+    dirty.insert(name);
+}
+
+void AttendanceTracker::attach(const Room &room, int sign) {
+    if (room.current < 0) {
+        return;
+    }
+    Totals &totals = buildings[room.building];
+    totals.activeRooms += sign;
+    totals.activeCapacity += sign * room.capacity;
+    totals.present += sign * int(room.sessions[room.current].cards.size());
+}
+
+bool AttendanceTracker::record(const QString &room, const QString &cardId, qint64 atMs) {
+    auto it = rooms.find(room);
+    if (it == rooms.end()) {
+        return false;
+    }
+    int index = sessionAt(it.value(), atMs);
+    if (index < 0) {
+        return false;
+    }
+    QSet<QString> &cards = it->sessions[index].cards;
+    const qsizetype before = cards.size();
+    cards.insert(cardId);
+    if (cards.size() == before) {
+        return false;
+    }
+    // 补传的早先节次的签到只计入那一节，不影响教室和楼栋的当前人数
+    if (index == it->current) {
+        ++buildings[it->building].present;
+        dirty.insert(room);
+    }
+    return true;
+}
+
+void AttendanceTracker::advance(qint64 nowMs) {
+    clockMs = nowMs;
+    if (!transitionsSorted) {
+        // 只有尚未处理的部分需要排序，新登记的时刻都追加在这里
+        std::sort(transitions.begin() + nextTransition, transitions.end(),
+                  [](const Transition &a, const Transition &b) { return a.atMs < b.atMs; });
+        transitionsSorted = true;
+    }
+    while (nextTransition < transitions.size() && transitions[nextTransition].atMs <= nowMs) {
+        const QString &name = transitions[nextTransition].room;
+        auto it = rooms.find(name);
+        if (it != rooms.end()) {
+            int current = sessionAt(it.value(), nowMs);
+            if (current != it->current) {
+                switchCurrent(name, it.value(), current);
+            }
+        }
+        ++nextTransition;
+    }
+}
+
+QStringList AttendanceTracker::takeDirty() {
+    QStringList names(dirty.cbegin(), dirty.cend());
+    dirty.clear();
+    return names;
+}
+
+void AttendanceTracker::markAllDirty() {
+    for (auto it = rooms.constBegin(); it != rooms.constEnd(); ++it) {
+        dirty.insert(it.key());
+    }
+}
+
+void AttendanceTracker::markDirty(const QString &room) {
+    if (rooms.contains(room)) {
+        dirty.insert(room);
+    }
+}
+
+void AttendanceTracker::markBuildingDirty(const QString &building) {
+    for (auto it = rooms.constBegin(); it != rooms.constEnd(); ++it) {
+        if (it->building == building) {
+            dirty.insert(it.key());
+        }
+    }
+}
+
+AttendanceTracker::RoomView AttendanceTracker::roomView(const QString &room) const {
+    RoomView view;
+    view.room = room;
+    auto it = rooms.constFind(room);
+    if (it == rooms.constEnd()) {
+        return view;
+    }
+    view.building = it->building;
+    view.capacity = it->capacity;
+    if (it->current >= 0) {
+        const Session &session = it->sessions[it->current];
+        view.course = session.course;
+        view.teacher = session.teacher;
+        view.startMs = session.startMs;
+        view.endMs = session.endMs;
+        view.present = int(session.cards.size());
+    }
+    return view;
+}
+
+AttendanceTracker::BuildingView AttendanceTracker::buildingView(const QString &building) const {
+    BuildingView view;
+    view.building = building;
+    auto it = buildings.constFind(building);
+    if (it != buildings.constEnd()) {
+        view.rooms = it->rooms;
+        view.activeRooms = it->activeRooms;
+        view.activeCapacity = it->activeCapacity;
+        view.present = it->present;
+    }
+    return view;
+}
+
+QVector<AttendanceTracker::BuildingView> AttendanceTracker::buildingViews() const {
+    QStringList names = buildings.keys();
+    std::sort(names.begin(), names.end());
+    QVector<BuildingView> views;
+    views.reserve(names.size());
+    for (const QString &name : names) {
+        views.append(buildingView(name));
+    }
+    return views;
+}
+
+QJsonObject AttendanceTracker::toJson(const RoomView &view) {
+    QJsonObject obj;
+    obj["room"] = view.room;
+    obj["building"] = view.building;
+    obj["capacity"] = view.capacity;
+    obj["present"] = view.present;
+    obj["course"] = view.course;
+    if (!view.course.isEmpty()) {
+        obj["start_ms"] = view.startMs;
+        obj["end_ms"] = view.endMs;
+    }
+    return obj;
+}
@@ -0,0 +1,130 @@
+#ifndef ATTENDANCETRACKER_H
+#define ATTENDANCETRACKER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QDate>
+#include <QJsonObject>
+#include <QSqlDatabase>
+
+// 实时出勤统计：按教室、按当天的每节课、按楼栋累计签到人数，签到写入后逐条累加，不做 COUNT(*) 查询。
+//
+// 每间教室登记当天的各节课，一节课记录已签到的卡号集合；同一张卡在同一节课只计一次，
+// 重发或重复刷卡因此不会多计。签到落在哪节课按时间判断：课程时间内或开课前 kEarlyMs 内。
+// 每间教室一天只有十来节课，查找是常数开销，加上一次集合插入，每条签到的代价为 O(1)。
+//
+// 教室的"当前节次"在开课前 kEarlyMs、下课时切换，切换时刻预先排好序，advance 只处理越过的时刻；
+// 楼栋合计随之加上新节次、减去旧节次的人数，同样不遍历教室。
+// 有变化的教室记入 dirty，由调用方按固定节奏取出并推送，同一秒内的多次变化合并为一次。
+class AttendanceTracker
+{
+public:
+    static constexpr qint64 kEarlyMs = 15 * 60 * 1000;  // 开课前多久开始签到
+
+    // 教室当前的出勤，界面和推送使用
+    struct RoomView {
+        QString room;
+        QString building;
+        int capacity = 0;
+        QString course;              // 当前节次，没有课时为空
+        QString teacher;
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        int present = 0;             // 当前节次已签到的人数
+    };
+
+    struct BuildingView {
+        QString building;
+        int rooms = 0;
+        int activeRooms = 0;         // 处于上课（或开课前签到）时段的教室
+        int activeCapacity = 0;      // 这些教室的容量合计
+        int present = 0;
+    };
+
+    // 重建 date 当天的教室、课程和已写入的签到；useCalendar 时课程取自校历展开的 occurrence_view
+    bool rebuild(QSqlDatabase db, const QDate &date, bool useCalendar, qint64 nowMs, QString *error = nullptr);
+    void clear();
+    QDate date() const { return day; }
+
+    // 教室增改删，对应 classrooms 表；已登记的课程和签到保留
+    void setRoom(const QString &room, const QString &building, int capacity);
+    void removeRoom(const QString &room);
+    // 登记一节课，id 为 master_schedules.id，时间为当天的绝对毫秒数；id 已登记时替换原来那节，已签到的卡号保留
+    void addSession(int id, const QString &room, const QString &course, const QString &teacher, qint64 startMs, qint64 endMs);
+    // 同上，时间为课程表中的 "HH:mm"，按 date() 当天换算；时间无效时等同 removeSession
+    void setSession(int id, const QString &room, const QString &course, const QString &teacher,
+                    const QString &startTime, const QString &endTime);
+    // 课程删除或改到别的日子：撤下这节课及其签到
+    void removeSession(int id);
+
+    // 一条新写入的签到；落在某节课内且该卡此前未签到时返回 true
+    bool record(const QString &room, const QString &cardId, qint64 atMs);
+    // 推进到 nowMs，切换越过开课或下课时刻的教室的当前节次
+    void advance(qint64 nowMs);
+
+    // 取出上次以来出勤有变化的教室
+    QStringList takeDirty();
+    void markAllDirty();
+    void markDirty(const QString &room);
+    void markBuildingDirty(const QString &building);   // 遍历全部教室，只在中继订阅时使用
+
+    int roomCount() const { return rooms.size(); }
+    int sessionCount() const { return sessions; }
+    bool hasRoom(const QString &room) const { return rooms.contains(room); }
+    RoomView roomView(const QString &room) const;
+    QVector<BuildingView> buildingViews() const;   // 按楼栋名排序
+    BuildingView buildingView(const QString &building) const;
+
+    // 推送给班牌和中继的一项：{"room","building","capacity","present","course","start_ms","end_ms"}
+    static QJsonObject toJson(const RoomView &view);
+
+private:
+    struct Session {
+        int id = 0;
+        QString course;
+        QString teacher;
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        QSet<QString> cards;
+    };
+
+    struct Room {
+        QString building;
+        int capacity = 0;
+        QVector<Session> sessions;   // 按开课时间升序
+        int current = -1;            // 当前节次的下标
+    };
+
+    struct Totals {
+        int rooms = 0;
+        int activeRooms = 0;
+        int activeCapacity = 0;
+        int present = 0;
+    };
+
+    struct Transition {
+        qint64 atMs;
+        QString room;
+    };
+
+    int sessionAt(const Room &room, qint64 atMs) const;
+    void switchCurrent(const QString &name, Room &room, int index);
+    void attach(const Room &room, int sign);   // 把教室当前节次计入（sign=1）或移出（sign=-1）楼栋合计
+    QSet<QString> takeSession(int id);         // 移除一节课并交回它的签到
+
+    QDate day;
+    QHash<QString, Room> rooms;
+    QHash<QString, Totals> buildings;
+    QHash<int, QString> sessionRooms;          // 课程 id -> 教室
+    QVector<Transition> transitions;           // 开课前 kEarlyMs 与下课后的切换时刻
+    int nextTransition = 0;
+    bool transitionsSorted = true;
+    qint64 clockMs = 0;                        // 最近一次 advance 的时刻
+    int sessions = 0;
+    QSet<QString> dirty;
+};
+
+#endif // ATTENDANCETRACKER_H
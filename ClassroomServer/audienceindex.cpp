@@ -0,0 +1,270 @@
+#include "audienceindex.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <algorithm>
+
+bool AnnouncementTarget::parse(const QString &text, AnnouncementTarget &target) {
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty() || trimmed == "all") {
+        target = AnnouncementTarget();
+        return true;
+    }
+
+    int colon = trimmed.indexOf(':');
+    if (colon <= 0) {
+        return false;
+    }
+    const QString kind = trimmed.left(colon).trimmed();
+    const QString value = trimmed.mid(colon + 1).trimmed();
+
+    AnnouncementTarget parsed;
+    if (kind == "building" && !value.isEmpty()) {
+        parsed.kind = Building;
+        parsed.building = value;
+    } else if (kind == "floor") {
+        // 楼栋名中可能有 '/'，楼层取最后一段
+        int slash = value.lastIndexOf('/');
+        bool ok = false;
+        parsed.floor = slash > 0 ? value.mid(slash + 1).trimmed().toInt(&ok) : 0;
+        if (!ok) {
+            return false;
+        }
+        parsed.kind = Floor;
+        parsed.building = value.left(slash).trimmed();
+    } else if (kind == "rooms") {
+        for (const QString &room : value.split(',')) {
+            if (!room.trimmed().isEmpty() && !parsed.rooms.contains(room.trimmed())) {
+                parsed.rooms.append(room.trimmed());
+            }
+        }
+        if (parsed.rooms.isEmpty()) {
+            return false;
+        }
+        parsed.kind = Rooms;
+    } else {
+        return false;
+    }
+    target = parsed;
+    return true;
+}
+
+QString AnnouncementTarget::toString() const {
+    switch (kind) {
+    case Building:
+        return "building:" + building;
+    case Floor:
+        return QString("floor:%1/%2").arg(building).arg(floor);
+    case Rooms:
+        return "rooms:" + rooms.join(',');
+    case All:
+        break;
+    }
+    return QString();
+}
+
+AudienceIndex::Audience AudienceIndex::Audience::fromArgs(const QJsonObject &args) {
+    Audience audience;
+    if (args.contains("relay")) {
+        QString building = args["relay"].toString();
+        audience.kind = building.isEmpty() || building == "*" ? Everyone : Building;
+        audience.name = audience.kind == Building ? building : QString();
+    } else {
+        // 没有上报教室的班牌只收到全部可见的公告
+        audience.kind = Room;
+        audience.name = args["room"].toString();
+    }
+    return audience;
+}
+
+QString AudienceIndex::Audience::key() const {
+    switch (kind) {
+    case Building:
+        return "building:" + name;
+    case Everyone:
+        return "*";
+    case Room:
+        break;
+    }
+    return "room:" + name;
+}
+
+void AudienceIndex::clear() {
+    places.clear();
+    targets.clear();
+    everyone.clear();
+    byBuilding.clear();
+    byFloor.clear();
+    byRoom.clear();
+}
+
+bool AudienceIndex::rebuild(QSqlDatabase db, QString *error) {
+    clear();
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT room_name, building, floor FROM classrooms")) {
+        if (error) *error = "读取教室失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        setRoom(query.value(0).toString(), query.value(1).toString(), query.value(2).toInt());
+    }
+
+    if (!query.exec("SELECT id, COALESCE(target, '') FROM announcements")) {
+        if (error) *error = "读取公告投放范围失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        // 无法识别的范围按全部可见处理，宁可多发也不漏发
+        AnnouncementTarget target;
+        AnnouncementTarget::parse(query.value(1).toString(), target);
+        setAnnouncement(query.value(0).toInt(), target);
+    }
+    return true;
+}
+
+void AudienceIndex::setRoom(const QString &room, const QString &building, int floor) {
+    Place &place = places[room];
+    place.building = building;
+    place.floor = floor;
+}
+
+void AudienceIndex::removeRoom(const QString &room) {
+    places.remove(room);
+}
+
+void AudienceIndex::setAnnouncement(int id, const AnnouncementTarget &target) {
+    removeAnnouncement(id);
+    targets.insert(id, target);
+    switch (target.kind) {
+    case AnnouncementTarget::All:
+        everyone.insert(id);
+        break;
+    case AnnouncementTarget::Building:
+        byBuilding[target.building].insert(id);
+        break;
+    case AnnouncementTarget::Floor:
+        byFloor[FloorKey(target.building, target.floor)].insert(id);
+        break;
+    case AnnouncementTarget::Rooms:
+        for (const QString &room : target.rooms) {
+            byRoom[room].insert(id);
+        }
+        break;
+    }
+}
+
+void AudienceIndex::removeAnnouncement(int id) {
+    auto it = targets.find(id);
+    if (it == targets.end()) {
+        return;
+    }
+    unlink(id, it.value());
+    targets.erase(it);
+}
+
+// 从登记的集合中摘下，集合空了就删除键，楼栋和教室的键数因此只与现存公告有关
+void AudienceIndex::unlink(int id, const AnnouncementTarget &target) {
+    auto drop = [id](auto &hash, const auto &key) {
+        auto it = hash.find(key);
+        if (it != hash.end()) {
+            it->remove(id);
+            if (it->isEmpty()) {
+                hash.erase(it);
+            }
+        }
+    };
+    switch (target.kind) {
+    case AnnouncementTarget::All:
+        everyone.remove(id);
+        break;
+    case AnnouncementTarget::Building:
+        drop(byBuilding, target.building);
+        break;
+    case AnnouncementTarget::Floor:
+        drop(byFloor, FloorKey(target.building, target.floor));
+        break;
+    case AnnouncementTarget::Rooms:
+        for (const QString &room : target.rooms) {
+            drop(byRoom, room);
+        }
+        break;
+    }
+}
+
+AnnouncementTarget AudienceIndex::target(int id) const {
+    return targets.value(id);
+}
+
+QVector<int> AudienceIndex::lookup(const Audience &audience) const {
+    QVector<int> ids;
+    auto merge = [&ids](const QSet<int> &set) {
+        for (int id : set) {
+            ids.append(id);
+        }
+    };
+
+    if (audience.kind == Audience::Everyone) {
+        ids.reserve(targets.size());
+        for (auto it = targets.constBegin(); it != targets.constEnd(); ++it) {
+            ids.append(it.key());
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    merge(everyone);
+    if (audience.kind == Audience::Room) {
+        auto place = places.constFind(audience.name);
+        if (place != places.constEnd()) {
+            merge(byBuilding.value(place->building));
+            merge(byFloor.value(FloorKey(place->building, place->floor)));
+        }
+        merge(byRoom.value(audience.name));
+    } else {
+        merge(byBuilding.value(audience.name));
+        for (auto it = byFloor.constBegin(); it != byFloor.constEnd(); ++it) {
+            if (it.key().first == audience.name) {
+                merge(it.value());
+            }
+        }
+        for (auto it = byRoom.constBegin(); it != byRoom.constEnd(); ++it) {
+            auto place = places.constFind(it.key());
+            if (place != places.constEnd() && place->building == audience.name) {
+                merge(it.value());
+            }
+        }
+    }
+
+    // 指定多个教室的公告可能从不同的键合并进来
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+bool AudienceIndex::reaches(const AnnouncementTarget &target, const Audience &audience) const {
+    if (target.kind == AnnouncementTarget::All || audience.kind == Audience::Everyone) {
+        return true;
+    }
+
+    if (audience.kind == Audience::Building) {
+        if (target.kind != AnnouncementTarget::Rooms) {
+            return target.building == audience.name;
+        }
+        for (const QString &room : target.rooms) {
+            auto place = places.constFind(room);
+            if (place != places.constEnd() && place->building == audience.name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (target.kind == AnnouncementTarget::Rooms) {
+        return target.rooms.contains(audience.name);
+    }
+    auto place = places.constFind(audience.name);
+    if (place == places.constEnd() || place->building != target.building) {
+        return false;
+    }
+    return target.kind == AnnouncementTarget::Building || place->floor == target.floor;
+}
@@ -0,0 +1,85 @@
+#ifndef AUDIENCEINDEX_H
+#define AUDIENCEINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QJsonObject>
+#include <QSqlDatabase>
+
+// 公告的投放范围，存放在服务端 announcements.target 列，文本形式：
+//   空或 all               全部班牌
+//   building:A栋           一栋楼
+//   floor:A栋/3            一栋楼的一层
+//   rooms:A-301,A-302      指定的教室
+struct AnnouncementTarget {
+    enum Kind { All, Building, Floor, Rooms };
+
+    Kind kind = All;
+    QString building;        // Building、Floor
+    int floor = 0;           // Floor
+    QStringList rooms;       // Rooms
+
+    // 格式不符时返回 false，target 不变
+    static bool parse(const QString &text, AnnouncementTarget &target);
+    QString toString() const;
+};
+
+// 公告受众的倒排索引：公告按投放范围登记在"全部 / 楼栋 / 楼层 / 教室"四级之一，
+// 某个教室适用的公告 = 全部 ∪ 所在楼栋 ∪ 所在楼层 ∪ 该教室，四次哈希查找后合并，不扫描公告表。
+// 教室的楼栋和楼层来自 classrooms 表，随教室增改删更新；公告增改删时只改动它登记的那一项。
+//
+// 服务端用公告 id 登记；中继没有数据库，用公告在下发数组中的下标登记。
+class AudienceIndex
+{
+public:
+    // 同步连接的受众：班牌按所在教室，中继按所辖楼宇（"*" 表示不分楼宇）
+    struct Audience {
+        enum Kind { Room, Building, Everyone };
+
+        Kind kind = Room;
+        QString name;
+
+        static Audience fromArgs(const QJsonObject &args);
+        QString key() const;     // 缓存各受众的下发数据时用作键
+    };
+
+    // 从 classrooms 和 announcements 两张表重建
+    bool rebuild(QSqlDatabase db, QString *error = nullptr);
+    void clear();
+
+    void setRoom(const QString &room, const QString &building, int floor);
+    void removeRoom(const QString &room);
+
+    void setAnnouncement(int id, const AnnouncementTarget &target);
+    void removeAnnouncement(int id);
+    AnnouncementTarget target(int id) const;   // 未登记的公告视为全部可见
+
+    // 受众适用的公告，按 id 升序。中继（楼栋）的查询还要合并该楼各层和各教室的登记，只在中继拉取时发生
+    QVector<int> lookup(const Audience &audience) const;
+    bool reaches(const AnnouncementTarget &target, const Audience &audience) const;
+
+    int announcementCount() const { return targets.size(); }
+    int roomCount() const { return places.size(); }
+
+private:
+    struct Place {
+        QString building;
+        int floor = 0;
+    };
+    using FloorKey = QPair<QString, int>;
+
+    void unlink(int id, const AnnouncementTarget &target);
+
+    QHash<QString, Place> places;                // 教室 -> 楼栋、楼层
+    QHash<int, AnnouncementTarget> targets;      // 公告 -> 投放范围
+    QSet<int> everyone;
+    QHash<QString, QSet<int>> byBuilding;
+    QHash<FloorKey, QSet<int>> byFloor;
+    QHash<QString, QSet<int>> byRoom;
+};
+
+#endif // AUDIENCEINDEX_H
@@ -0,0 +1,496 @@
+#include "calendarengine.h"
+#include "schema.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <algorithm>
+
+static QString isoDate(const QDate &date) {
+    return date.toString(Qt::ISODate);
+}
+
+static void setError(QString *error, const QString &what, const QSqlQuery &query) {
+    if (error) *error = what + ": " + query.lastError().text();
+}
+
+bool CalendarEngine::ensureSchema(QSqlDatabase db, QString *error) {
+    const QString ddl[] = {
+        "CREATE TABLE IF NOT EXISTS semesters (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, "
+        "start_date TEXT, end_date TEXT)",
+        "CREATE TABLE IF NOT EXISTS calendar_exceptions (id INTEGER PRIMARY KEY AUTOINCREMENT, kind TEXT, "
+        "start_date TEXT, end_date TEXT, follow_date TEXT, note TEXT)",
+        "CREATE TABLE IF NOT EXISTS schedule_weeks (schedule_id INTEGER PRIMARY KEY, parity INTEGER DEFAULT 0, "
+        "first_week INTEGER DEFAULT 1, last_week INTEGER DEFAULT 0)",
+        Schema::sql<Schema::CalendarDays, Schema::Side::Server, Schema::Statement::Create>(),
+        "CREATE UNIQUE INDEX IF NOT EXISTS idx_calendar_days_date ON calendar_days(date)",
+        "CREATE TABLE IF NOT EXISTS schedule_occurrences (date TEXT NOT NULL, schedule_id INTEGER NOT NULL, "
+        "PRIMARY KEY (date, schedule_id)) WITHOUT ROWID",
+        "CREATE INDEX IF NOT EXISTS idx_occurrences_schedule ON schedule_occurrences(schedule_id)",
+        // 列名与 Schema::Occurrences 的服务端列名一致，下发时按描述直接读取
+        "CREATE VIEW IF NOT EXISTS occurrence_view AS "
+        "SELECT o.date AS date, s.room AS room, s.course AS course, s.teacher AS teacher, "
+        "s.time_slot AS time_slot, s.start_time AS start_time, s.end_time AS end_time "
+        "FROM schedule_occurrences o JOIN master_schedules s ON s.id = o.schedule_id",
+    };
+
+    QSqlQuery query(db);
+    for (const QString &statement : ddl) {
+        if (!query.exec(statement)) {
+            setError(error, "创建校历表失败", query);
+            return false;
+        }
+    }
+    return true;
+}
+
+QString CalendarEngine::kindName(DayKind kind) {
+    switch (kind) {
+    case DayKind::Teaching: return "teaching";
+    case DayKind::Holiday: return "holiday";
+    case DayKind::Exam: return "exam";
+    case DayKind::Makeup: return "makeup";
+    case DayKind::Break: return "break";
+    }
+    return "teaching";
+}
+
+QString CalendarEngine::kindLabel(DayKind kind) {
+    switch (kind) {
+    case DayKind::Teaching: return "上课";
+    case DayKind::Holiday: return "放假";
+    case DayKind::Exam: return "考试周";
+    case DayKind::Makeup: return "调课";
+    case DayKind::Break: return "假期";
+    }
+    return "上课";
+}
+
+CalendarEngine::DayKind CalendarEngine::kindFromName(const QString &name) {
+    if (name == "holiday") return DayKind::Holiday;
+    if (name == "exam") return DayKind::Exam;
+    if (name == "makeup") return DayKind::Makeup;
+    if (name == "break") return DayKind::Break;
+    return DayKind::Teaching;
+}
+
+int CalendarEngine::weekOf(const QDate &date) const {
+    for (const Semester &semester : semesterList) {
+        if (date >= semester.start && date <= semester.end) {
+            QDate monday = semester.start.addDays(1 - semester.start.dayOfWeek());
+            return int(monday.daysTo(date) / 7) + 1;
+        }
+    }
+    return 0;
+}
+
+bool CalendarEngine::weekMatches(const WeekRule &rule, int week) {
+    if (week <= 0) return true;  // 未配置学期时单双周不生效
+    if (week < rule.firstWeek) return false;
+    if (rule.lastWeek > 0 && week > rule.lastWeek) return false;
+    if (rule.parity == 1) return week % 2 == 1;
+    if (rule.parity == 2) return week % 2 == 0;
+    return true;
+}
+
+CalendarEngine::Day CalendarEngine::resolve(const QDate &date) const {
+    Day day;
+    day.date = date;
+    day.weekday = date.dayOfWeek();
+    day.week = weekOf(date);
+    if (!semesterList.isEmpty() && day.week == 0) {
+        day.kind = DayKind::Break;
+        day.weekday = 0;
+    }
+
+    auto it = exceptionByDay.constFind(date.toJulianDay());
+    if (it != exceptionByDay.constEnd()) {
+        const Exception &exception = exceptionList[*it];
+        day.note = exception.note;
+        if (exception.kind == DayKind::Makeup) {
+            // 调课日按被替换那一天的星期和教学周上课
+            int followWeek = weekOf(exception.followDate);
+            day.kind = DayKind::Makeup;
+            day.weekday = exception.followDate.dayOfWeek();
+            day.week = followWeek > 0 ? followWeek : day.week;
+        } else {
+            day.kind = exception.kind;
+            day.weekday = 0;
+        }
+    }
+    return day;
+}
+
+bool CalendarEngine::occursOn(int courseId, const Day &day) const {
+    auto it = courses.constFind(courseId);
+    return it != courses.constEnd() && day.weekday != 0 && it->weekday == day.weekday
+           && weekMatches(it->weeks, day.week);
+}
+
+CalendarEngine::WeekRule CalendarEngine::weekRule(int courseId) const {
+    return courses.value(courseId).weeks;
+}
+
+void CalendarEngine::indexExceptions() {
+    exceptionByDay.clear();
+    for (int i = 0; i < exceptionList.size(); ++i) {
+        const Exception &exception = exceptionList[i];
+        for (QDate date = exception.start; date <= exception.end; date = date.addDays(1)) {
+            exceptionByDay.insert(date.toJulianDay(), i);
+        }
+    }
+}
+
+void CalendarEngine::placeCourse(int courseId, int weekday) {
+    auto it = courses.find(courseId);
+    if (it != courses.end()) {
+        if (it->weekday >= 1 && it->weekday <= 7) {
+            coursesByWeekday[it->weekday].removeOne(courseId);
+        }
+        it->weekday = weekday;
+    } else {
+        Course course;
+        course.weekday = weekday;
+        courses.insert(courseId, course);
+    }
+    if (weekday >= 1 && weekday <= 7) {
+        coursesByWeekday[weekday].append(courseId);
+    }
+}
+
+bool CalendarEngine::loadRules(QSqlDatabase db, QString *error) {
+    semesterList.clear();
+    exceptionList.clear();
+    courses.clear();
+    coursesByWeekday = QVector<QVector<int>>(8);
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT id, name, start_date, end_date FROM semesters ORDER BY start_date")) {
+        setError(error, "读取学期失败", query);
+        return false;
+    }
+    while (query.next()) {
+        Semester semester;
+        semester.id = query.value(0).toInt();
+        semester.name = query.value(1).toString();
+        semester.start = QDate::fromString(query.value(2).toString(), Qt::ISODate);
+        semester.end = QDate::fromString(query.value(3).toString(), Qt::ISODate);
+        if (semester.start.isValid() && semester.end >= semester.start) {
+            semesterList.append(semester);
+        }
+    }
+
+    if (!query.exec("SELECT id, kind, start_date, end_date, follow_date, note FROM calendar_exceptions ORDER BY id")) {
+        setError(error, "读取例外日期失败", query);
+        return false;
+    }
+    while (query.next()) {
+        Exception exception;
+        exception.id = query.value(0).toInt();
+        exception.kind = kindFromName(query.value(1).toString());
+        exception.start = QDate::fromString(query.value(2).toString(), Qt::ISODate);
+        exception.end = QDate::fromString(query.value(3).toString(), Qt::ISODate);
+        exception.followDate = QDate::fromString(query.value(4).toString(), Qt::ISODate);
+        exception.note = query.value(5).toString();
+        if (!exception.end.isValid()) exception.end = exception.start;
+        if (exception.start.isValid() && exception.end >= exception.start
+            && (exception.kind != DayKind::Makeup || exception.followDate.isValid())) {
+            exceptionList.append(exception);
+        }
+    }
+    indexExceptions();
+
+    // 课程删除后留下的单双周设置一并清理
+    query.exec("DELETE FROM schedule_weeks WHERE schedule_id NOT IN (SELECT id FROM master_schedules)");
+    if (!query.exec("SELECT s.id, s.weekday, w.parity, w.first_week, w.last_week FROM master_schedules s "
+                    "LEFT JOIN schedule_weeks w ON w.schedule_id = s.id")) {
+        setError(error, "读取课程失败", query);
+        return false;
+    }
+    while (query.next()) {
+        int id = query.value(0).toInt();
+        placeCourse(id, query.value(1).toInt());
+        if (!query.value(2).isNull()) {
+            WeekRule &rule = courses[id].weeks;
+            rule.parity = query.value(2).toInt();
+            rule.firstWeek = query.value(3).toInt();
+            rule.lastWeek = query.value(4).toInt();
+        }
+    }
+    return true;
+}
+
+bool CalendarEngine::rebuild(QSqlDatabase db, const QDate &today, QString *error) {
+    this->today = today;
+    return loadRules(db, error) && rematerializeAll(db, error);
+}
+
+bool CalendarEngine::rematerializeAll(QSqlDatabase db, QString *error) {
+    QSqlQuery query(db);
+    if (!query.exec("DELETE FROM schedule_occurrences") || !query.exec("DELETE FROM calendar_days")) {
+        setError(error, "清空校历失败", query);
+        return false;
+    }
+    rangeFrom = QDate();
+    rangeTo = QDate();
+    if (!isActive()) {
+        return true;
+    }
+
+    QDate from = today.addDays(-kKeepPastDays);
+    QDate to = today.addDays(kMaxHorizonDays);
+    for (const Semester &semester : std::as_const(semesterList)) {
+        from = qMin(from, semester.start);
+        to = qMax(to, semester.end);
+    }
+    return materialize(db, from, to, error);
+}
+
+bool CalendarEngine::ensureRange(QSqlDatabase db, const QDate &from, const QDate &to, QString *error) {
+    if (!isActive()) {
+        return true;
+    }
+    if (!rangeFrom.isValid()) {
+        return materialize(db, from, to, error);
+    }
+    if (from < rangeFrom && !materialize(db, from, rangeFrom.addDays(-1), error)) {
+        return false;
+    }
+    if (to > rangeTo && !materialize(db, rangeTo.addDays(1), to, error)) {
+        return false;
+    }
+    return true;
+}
+
+// 重算 [from, to] 内的每日信息和全部课程，结果与已展开的范围连续
+bool CalendarEngine::materialize(QSqlDatabase db, const QDate &from, const QDate &to, QString *error) {
+    if (!from.isValid() || to < from) {
+        return true;
+    }
+    if (!db.transaction()) {
+        if (error) *error = db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery clear(db);
+    QSqlQuery dayInsert(db);
+    QSqlQuery occurrenceInsert(db);
+    bool ok = clear.prepare("DELETE FROM calendar_days WHERE date BETWEEN ? AND ?");
+    clear.addBindValue(isoDate(from));
+    clear.addBindValue(isoDate(to));
+    ok = ok && clear.exec() && clear.prepare("DELETE FROM schedule_occurrences WHERE date BETWEEN ? AND ?");
+    clear.addBindValue(isoDate(from));
+    clear.addBindValue(isoDate(to));
+    ok = ok && clear.exec()
+         && dayInsert.prepare(Schema::sql<Schema::CalendarDays, Schema::Side::Server, Schema::Statement::Insert>())
+         && occurrenceInsert.prepare("INSERT INTO schedule_occurrences (date, schedule_id) VALUES (?, ?)");
+
+    for (QDate date = from; ok && date <= to; date = date.addDays(1)) {
+        const Day day = resolve(date);
+        const QString dateText = isoDate(date);
+        dayInsert.bindValue(Schema::CalendarDayCol::Date, dateText);
+        dayInsert.bindValue(Schema::CalendarDayCol::Kind, kindName(day.kind));
+        dayInsert.bindValue(Schema::CalendarDayCol::Weekday, day.weekday);
+        dayInsert.bindValue(Schema::CalendarDayCol::Week, day.week);
+        dayInsert.bindValue(Schema::CalendarDayCol::Note, day.note);
+        ok = dayInsert.exec();
+        if (day.weekday == 0) continue;
+
+        for (int courseId : std::as_const(coursesByWeekday[day.weekday])) {
+            if (!ok) break;
+            if (!weekMatches(courses[courseId].weeks, day.week)) continue;
+            occurrenceInsert.addBindValue(dateText);
+            occurrenceInsert.addBindValue(courseId);
+            ok = occurrenceInsert.exec();
+        }
+    }
+
+    if (!ok || !db.commit()) {
+        if (error) {
+            QSqlError failure = clear.lastError().isValid() ? clear.lastError()
+                              : dayInsert.lastError().isValid() ? dayInsert.lastError()
+                              : occurrenceInsert.lastError().isValid() ? occurrenceInsert.lastError()
+                              : db.lastError();
+            *error = "展开校历失败: " + failure.text();
+        }
+        db.rollback();
+        return false;
+    }
+
+    rangeFrom = rangeFrom.isValid() ? qMin(rangeFrom, from) : from;
+    rangeTo = rangeTo.isValid() ? qMax(rangeTo, to) : to;
+    return true;
+}
+
+// 规则变化只涉及已展开范围内的日期；范围外的日期在之后展开时自然使用新规则
+bool CalendarEngine::materializeIntersection(QSqlDatabase db, const QDate &from, const QDate &to, QString *error) {
+    if (!rangeFrom.isValid()) {
+        return rematerializeAll(db, error);
+    }
+    QDate first = qMax(from, rangeFrom);
+    QDate last = qMin(to, rangeTo);
+    return first > last || materialize(db, first, last, error);
+}
+
+bool CalendarEngine::materializeCourse(QSqlDatabase db, int courseId, QString *error) {
+    if (!db.transaction()) {
+        if (error) *error = db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM schedule_occurrences WHERE schedule_id = ?");
+    query.addBindValue(courseId);
+    bool ok = query.exec();
+
+    auto it = courses.constFind(courseId);
+    if (ok && isActive() && rangeFrom.isValid() && it != courses.constEnd() && it->weekday >= 1 && it->weekday <= 7) {
+        ok = query.prepare("INSERT INTO schedule_occurrences (date, schedule_id) VALUES (?, ?)");
+        for (QDate date = rangeFrom; ok && date <= rangeTo; date = date.addDays(1)) {
+            if (!occursOn(courseId, resolve(date))) continue;
+            query.addBindValue(isoDate(date));
+            query.addBindValue(courseId);
+            ok = query.exec();
+        }
+    }
+
+    if (!ok || !db.commit()) {
+        setError(error, "展开课程失败", query);
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool CalendarEngine::upsertCourse(QSqlDatabase db, int courseId, int weekday, QString *error) {
+    placeCourse(courseId, weekday);
+    return materializeCourse(db, courseId, error);
+}
+
+bool CalendarEngine::removeCourse(QSqlDatabase db, int courseId, QString *error) {
+    auto it = courses.find(courseId);
+    if (it != courses.end()) {
+        if (it->weekday >= 1 && it->weekday <= 7) {
+            coursesByWeekday[it->weekday].removeOne(courseId);
+        }
+        courses.erase(it);
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM schedule_weeks WHERE schedule_id = ?");
+    query.addBindValue(courseId);
+    if (!query.exec()) {
+        setError(error, "删除单双周设置失败", query);
+        return false;
+    }
+    return materializeCourse(db, courseId, error);
+}
+
+bool CalendarEngine::setWeekRule(QSqlDatabase db, int courseId, const WeekRule &rule, QString *error) {
+    if (!courses.contains(courseId)) {
+        if (error) *error = QString("课程不存在: ID=%1").arg(courseId);
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO schedule_weeks (schedule_id, parity, first_week, last_week) VALUES (?, ?, ?, ?)");
+    query.addBindValue(courseId);
+    query.addBindValue(rule.parity);
+    query.addBindValue(rule.firstWeek);
+    query.addBindValue(rule.lastWeek);
+    if (!query.exec()) {
+        setError(error, "保存单双周设置失败", query);
+        return false;
+    }
+    courses[courseId].weeks = rule;
+    return materializeCourse(db, courseId, error);
+}
+
+// 学期决定教学周编号和假期，变化时整体重算
+bool CalendarEngine::addSemester(QSqlDatabase db, const Semester &semester, QString *error) {
+    if (!semester.start.isValid() || semester.end < semester.start) {
+        if (error) *error = "学期日期无效";
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO semesters (name, start_date, end_date) VALUES (?, ?, ?)");
+    query.addBindValue(semester.name);
+    query.addBindValue(isoDate(semester.start));
+    query.addBindValue(isoDate(semester.end));
+    if (!query.exec()) {
+        setError(error, "添加学期失败", query);
+        return false;
+    }
+
+    Semester added = semester;
+    added.id = query.lastInsertId().toInt();
+    semesterList.append(added);
+    std::sort(semesterList.begin(), semesterList.end(), [](const Semester &a, const Semester &b) {
+        return a.start < b.start;
+    });
+    return rematerializeAll(db, error);
+}
+
+bool CalendarEngine::removeSemester(QSqlDatabase db, int id, QString *error) {
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM semesters WHERE id = ?");
+    query.addBindValue(id);
+    if (!query.exec()) {
+        setError(error, "删除学期失败", query);
+        return false;
+    }
+    semesterList.erase(std::remove_if(semesterList.begin(), semesterList.end(), [id](const Semester &semester) {
+        return semester.id == id;
+    }), semesterList.end());
+    return rematerializeAll(db, error);
+}
+
+bool CalendarEngine::addException(QSqlDatabase db, const Exception &exception, QString *error) {
+    Exception added = exception;
+    if (!added.end.isValid() || added.kind == DayKind::Makeup) added.end = added.start;
+    if (!added.start.isValid() || added.end < added.start
+        || (added.kind == DayKind::Makeup && !added.followDate.isValid())) {
+        if (error) *error = "例外日期无效";
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO calendar_exceptions (kind, start_date, end_date, follow_date, note) VALUES (?, ?, ?, ?, ?)");
+    query.addBindValue(kindName(added.kind));
+    query.addBindValue(isoDate(added.start));
+    query.addBindValue(isoDate(added.end));
+    query.addBindValue(added.followDate.isValid() ? isoDate(added.followDate) : QString());
+    query.addBindValue(added.note);
+    if (!query.exec()) {
+        setError(error, "添加例外日期失败", query);
+        return false;
+    }
+
+    bool wasActive = isActive();
+    added.id = query.lastInsertId().toInt();
+    exceptionList.append(added);
+    indexExceptions();
+    return wasActive ? materializeIntersection(db, added.start, added.end, error) : rematerializeAll(db, error);
+}
+
+bool CalendarEngine::removeException(QSqlDatabase db, int id, QString *error) {
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM calendar_exceptions WHERE id = ?");
+    query.addBindValue(id);
+    if (!query.exec()) {
+        setError(error, "删除例外日期失败", query);
+        return false;
+    }
+
+    auto it = std::find_if(exceptionList.begin(), exceptionList.end(), [id](const Exception &exception) {
+        return exception.id == id;
+    });
+    if (it == exceptionList.end()) {
+        return true;
+    }
+    QDate from = it->start;
+    QDate to = it->end;
+    exceptionList.erase(it);
+    indexExceptions();
+    return isActive() ? materializeIntersection(db, from, to, error) : rematerializeAll(db, error);
+}
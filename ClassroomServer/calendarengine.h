@@ -0,0 +1,117 @@
+#ifndef CALENDARENGINE_H
+#define CALENDARENGINE_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QDate>
+#include <QSqlDatabase>
+
+// 校历规则与按日期展开的课程。
+// 规则：学期（起止日期，第一周从开学所在周的周一算起）、例外日期（放假、考试周、调课）、
+// 每门课的单双周与起止周（schedule_weeks）。master_schedules 仍只按星期描述课程。
+//
+// 展开结果写入两张表：calendar_days 每天一行，记录当天类型和实际执行的星期课表；
+// schedule_occurrences 每次课一行，只存 (日期, 课程 id)，occurrence_view 联表得到完整信息。
+// 课程增删改只重算这门课，例外日期变化只重算涉及的日期，班牌只需按日期查表。
+//
+// 没有配置任何学期和例外日期时校历不生效：不展开，班牌继续按星期显示。
+class CalendarEngine
+{
+public:
+    enum class DayKind { Teaching, Holiday, Exam, Makeup, Break };
+
+    // 单双周：0 每周，1 单周，2 双周；lastWeek 为 0 表示到学期结束
+    struct WeekRule {
+        int parity = 0;
+        int firstWeek = 1;
+        int lastWeek = 0;
+    };
+
+    struct Semester {
+        int id = 0;
+        QString name;
+        QDate start;
+        QDate end;
+    };
+
+    struct Exception {
+        int id = 0;
+        DayKind kind = DayKind::Holiday;
+        QDate start;
+        QDate end;
+        QDate followDate;   // 调课：当天按这一天的课表上课
+        QString note;
+    };
+
+    struct Day {
+        QDate date;
+        DayKind kind = DayKind::Teaching;
+        int weekday = 0;    // 当天执行的星期课表，无课为 0
+        int week = 0;       // 教学周，不在学期内或未配置学期为 0
+        QString note;
+    };
+
+    static constexpr int kMaxHorizonDays = 60;  // 班牌一次最多取的天数，也是提前展开的天数
+    static constexpr int kKeepPastDays = 7;
+
+    static bool ensureSchema(QSqlDatabase db, QString *error = nullptr);
+
+    // 读入全部规则和课程，按学期范围与 [today - 7, today + 60] 重新展开
+    bool rebuild(QSqlDatabase db, const QDate &today, QString *error = nullptr);
+    // 日期变化后调用：只展开尚未覆盖的日期
+    bool ensureRange(QSqlDatabase db, const QDate &from, const QDate &to, QString *error = nullptr);
+
+    // 课程增改删：只重算这一门课
+    bool upsertCourse(QSqlDatabase db, int courseId, int weekday, QString *error = nullptr);
+    bool removeCourse(QSqlDatabase db, int courseId, QString *error = nullptr);
+    bool setWeekRule(QSqlDatabase db, int courseId, const WeekRule &rule, QString *error = nullptr);
+
+    // 规则增删：写库后重算受影响的日期
+    bool addSemester(QSqlDatabase db, const Semester &semester, QString *error = nullptr);
+    bool removeSemester(QSqlDatabase db, int id, QString *error = nullptr);
+    bool addException(QSqlDatabase db, const Exception &exception, QString *error = nullptr);
+    bool removeException(QSqlDatabase db, int id, QString *error = nullptr);
+
+    // 某一天的类型和执行的课表，只查内存
+    Day resolve(const QDate &date) const;
+    bool occursOn(int courseId, const Day &day) const;
+
+    bool isActive() const { return !semesterList.isEmpty() || !exceptionList.isEmpty(); }
+    const QVector<Semester> &semesters() const { return semesterList; }
+    const QVector<Exception> &exceptions() const { return exceptionList; }
+    WeekRule weekRule(int courseId) const;
+    QDate materializedFrom() const { return rangeFrom; }
+    QDate materializedTo() const { return rangeTo; }
+
+    static QString kindName(DayKind kind);          // 存库和下发用的英文名
+    static QString kindLabel(DayKind kind);         // 界面显示的中文名
+    static DayKind kindFromName(const QString &name);
+
+private:
+    struct Course {
+        int weekday = 0;
+        WeekRule weeks;
+    };
+
+    bool loadRules(QSqlDatabase db, QString *error);
+    bool materialize(QSqlDatabase db, const QDate &from, const QDate &to, QString *error);
+    bool materializeCourse(QSqlDatabase db, int courseId, QString *error);
+    bool rematerializeAll(QSqlDatabase db, QString *error);
+    bool materializeIntersection(QSqlDatabase db, const QDate &from, const QDate &to, QString *error);
+    void indexExceptions();
+    void placeCourse(int courseId, int weekday);
+    int weekOf(const QDate &date) const;   // 不在任何学期内返回 0
+    static bool weekMatches(const WeekRule &rule, int week);
+
+    QVector<Semester> semesterList;                 // 按开学日期排序
+    QVector<Exception> exceptionList;               // 按 id 排序，后添加的覆盖先添加的
+    QHash<qint64, int> exceptionByDay;              // 儒略日 -> exceptionList 下标
+    QHash<int, Course> courses;
+    QVector<QVector<int>> coursesByWeekday = QVector<QVector<int>>(8);
+    QDate today;
+    QDate rangeFrom;                                // 已展开的日期范围，未展开时无效
+    QDate rangeTo;
+};
+
+#endif // CALENDARENGINE_H
@@ -0,0 +1,277 @@
+#include "checkiningest.h"
+#include <QThread>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QDebug>
+
+static void setError(QString *error, const QString &what, const QSqlQuery &query) {
+    if (error) *error = what + ": " + query.lastError().text();
+}
+
+CheckinIngest::~CheckinIngest() {
+    stop();
+}
+
+bool CheckinIngest::ensureSchema(QSqlDatabase db, QString *error) {
+    const QString ddl[] = {
+        "CREATE TABLE IF NOT EXISTS checkins (id INTEGER PRIMARY KEY AUTOINCREMENT, sign_id TEXT NOT NULL, "
+        "room_name TEXT, card_id TEXT NOT NULL, checked_at_ms INTEGER NOT NULL, received_at_ms INTEGER, "
+        "UNIQUE (sign_id, card_id, checked_at_ms))",
+        // 按教室统计出勤、按学生查签到记录
+        "CREATE INDEX IF NOT EXISTS idx_checkins_room_time ON checkins(room_name, checked_at_ms)",
+        "CREATE INDEX IF NOT EXISTS idx_checkins_card_time ON checkins(card_id, checked_at_ms)",
+    };
+
+    QSqlQuery query(db);
+    for (const QString &statement : ddl) {
+        if (!query.exec(statement)) {
+            setError(error, "创建签到表失败", query);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckinIngest::parseBatch(const QJsonObject &args, Batch &batch, QString *error) {
+    batch.signId = args["sign_id"].toString().trimmed();
+    if (batch.signId.isEmpty()) {
+        if (error) *error = "签到批次缺少班牌编号";
+        return false;
+    }
+    if (!args["events"].isArray()) {
+        if (error) *error = "签到批次缺少 events";
+        return false;
+    }
+
+    const QString room = args["room"].toString();
+    const QJsonArray events = args["events"].toArray();
+    batch.events.clear();
+    batch.events.reserve(events.size());
+    for (const QJsonValue &value : events) {
+        const QJsonObject obj = value.toObject();
+        Event event;
+        event.cardId = obj["card"].toString().trimmed();
+        event.room = obj.contains("room") ? obj["room"].toString() : room;
+        event.checkedAtMs = obj["at_ms"].toInteger();
+        // 格式错误的单条签到丢弃，不让它拖住整个批次反复重发
+        if (event.cardId.isEmpty() || event.checkedAtMs <= 0) {
+            continue;
+        }
+        batch.events.append(event);
+    }
+    return true;
+}
+
+bool CheckinIngest::start(const QString &databasePath, CommitCallback commitCallback, const Options &ingestOptions,
+                          QString *error) {
+    if (thread) {
+        return true;
+    }
+    callback = std::move(commitCallback);
+    options = ingestOptions;
+    {
+        QMutexLocker locker(&mutex);
+        stopping = false;
+        openState = 0;
+        openError.clear();
+    }
+
+    thread = QThread::create([this, databasePath]() { run(databasePath); });
+    thread->start();
+
+    QMutexLocker locker(&mutex);
+    while (openState == 0) {
+        ready.wait(&mutex);
+    }
+    if (openState > 0) {
+        return true;
+    }
+    if (error) *error = openError;
+    locker.unlock();
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+    return false;
+}
+
+void CheckinIngest::stop() {
+    if (!thread) {
+        return;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        wake.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+quint64 CheckinIngest::submit(Batch batch) {
+    QMutexLocker locker(&mutex);
+    if (openState <= 0 || stopping || queued + batch.events.size() > options.maxQueuedEvents) {
+        return 0;
+    }
+    batch.ticket = nextTicket++;
+    if (batch.receivedAtMs <= 0) {
+        batch.receivedAtMs = QDateTime::currentMSecsSinceEpoch();
+    }
+    const quint64 ticket = batch.ticket;
+    queued += batch.events.size();
+    queue.append(std::move(batch));
+    wake.wakeOne();
+    return ticket;
+}
+
+qint64 CheckinIngest::committedEvents() const {
+    QMutexLocker locker(&mutex);
+    return committed;
+}
+
+qint64 CheckinIngest::commitCount() const {
+    QMutexLocker locker(&mutex);
+    return commits;
+}
+
+int CheckinIngest::queuedEvents() const {
+    QMutexLocker locker(&mutex);
+    return queued;
+}
+
+void CheckinIngest::run(const QString &databasePath) {
+    const QString name = QString("CheckinWriter-%1").arg(quintptr(this));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(databasePath);
+        bool ok = db.open();
+        if (ok) {
+            QSqlQuery query(db);
+            query.exec("PRAGMA journal_mode=WAL");
+            query.exec("PRAGMA busy_timeout = 5000");
+        }
+        {
+            QMutexLocker locker(&mutex);
+            openState = ok ? 1 : -1;
+            if (!ok) {
+                openError = "签到写入连接打开失败: " + db.lastError().text();
+            }
+            ready.wakeAll();
+        }
+
+        QVector<Batch> group;
+        QVector<Receipt> receipts;
+        while (ok) {
+            {
+                QMutexLocker locker(&mutex);
+                while (queue.isEmpty() && !stopping) {
+                    wake.wait(&mutex);
+                }
+                if (queue.isEmpty()) {
+                    break;     // 要求停止且队列已写完
+                }
+                // 取出队首的批次，至少一个，合计不超过单次提交的上限
+                int take = 0;
+                int events = 0;
+                while (take < queue.size()
+                       && (take == 0 || events + queue[take].events.size() <= options.maxEventsPerCommit)) {
+                    events += queue[take].events.size();
+                    ++take;
+                }
+                if (take == queue.size()) {
+                    group.swap(queue);
+                } else {
+                    group = queue.mid(0, take);
+                    queue.remove(0, take);
+                }
+                queued -= events;
+            }
+
+            QString error;
+            bool written = writeGroup(db, group, receipts, &error);
+            if (!written) {
+                qDebug() << error;
+                // 同一事务中的批次失败原因相同，随回执交给界面线程记入日志
+                for (Receipt &receipt : receipts) {
+                    receipt.error = error;
+                }
+            }
+            {
+                QMutexLocker locker(&mutex);
+                if (written) {
+                    for (const Receipt &receipt : receipts) {
+                        committed += receipt.accepted;
+                    }
+                    ++commits;
+                }
+            }
+            if (callback) {
+                callback(receipts);
+            }
+            group.clear();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+bool CheckinIngest::writeGroup(QSqlDatabase db, const QVector<Batch> &group, QVector<Receipt> &receipts,
+                               QString *error) {
+    receipts.resize(group.size());
+    for (int i = 0; i < group.size(); ++i) {
+        receipts[i] = Receipt();
+        receipts[i].ticket = group[i].ticket;
+    }
+    auto fail = [&](const QString &what, const QSqlQuery &query) {
+        setError(error, what, query);
+        db.rollback();
+        for (Receipt &receipt : receipts) {
+            receipt.accepted = 0;
+            receipt.duplicates = 0;
+            receipt.written.clear();
+        }
+        return false;
+    };
+
+    QSqlQuery insert(db);
+    if (!db.transaction()) {
+        if (error) *error = "签到写入事务开始失败: " + db.lastError().text();
+        return false;
+    }
+    if (!insert.prepare("INSERT OR IGNORE INTO checkins (sign_id, room_name, card_id, checked_at_ms, received_at_ms) "
+                        "VALUES (?, ?, ?, ?, ?)")) {
+        return fail("签到写入语句准备失败", insert);
+    }
+    for (int i = 0; i < group.size(); ++i) {
+        const Batch &batch = group[i];
+        Receipt &receipt = receipts[i];
+        for (const Event &event : batch.events) {
+            insert.bindValue(0, batch.signId);
+            insert.bindValue(1, event.room);
+            insert.bindValue(2, event.cardId);
+            insert.bindValue(3, event.checkedAtMs);
+            insert.bindValue(4, batch.receivedAtMs);
+            if (!insert.exec()) {
+                return fail("签到写入失败", insert);
+            }
+            // 唯一约束冲突时 INSERT OR IGNORE 不写入，影响行数为 0
+            if (insert.numRowsAffected() > 0) {
+                ++receipt.accepted;
+                receipt.written.append(event);
+            } else {
+                ++receipt.duplicates;
+            }
+        }
+    }
+    if (!db.commit()) {
+        fail("签到写入提交失败", insert);
+        if (error) *error = "签到写入提交失败: " + db.lastError().text();
+        return false;
+    }
+    for (Receipt &receipt : receipts) {
+        receipt.ok = true;
+    }
+    return true;
+}
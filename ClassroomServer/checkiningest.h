@@ -0,0 +1,101 @@
+#ifndef CHECKININGEST_H
+#define CHECKININGEST_H
+
+#include <QString>
+#include <QVector>
+#include <QJsonObject>
+#include <QSqlDatabase>
+#include <QMutex>
+#include <QWaitCondition>
+#include <functional>
+
+class QThread;
+
+// 班牌签到的写入管道。
+// 同步连接上收到的签到批次先进入内存队列，由单独的写线程取出；写线程每次把队列中已有的全部批次
+// （不超过 maxEventsPerCommit）合在一个事务里写入 checkins 表，即组提交：一次提交的落盘开销由这期间
+// 到达的所有签到分摊。上课前集中签到时，上一次提交进行期间积压的批次越多，下一次提交写入的行越多，
+// 吞吐随负载自动提高，空闲时单个批次也不必等待凑批。
+//
+// 事务提交成功后才回调确认各批次，班牌收到确认才删除本地队列中的记录。确认丢失时班牌会重发同一批次，
+// 表上 (sign_id, card_id, checked_at_ms) 唯一，重发的签到被忽略并计为重复，不会重复入库。
+class CheckinIngest
+{
+public:
+    struct Event {
+        QString cardId;
+        QString room;
+        qint64 checkedAtMs = 0;
+    };
+
+    struct Batch {
+        quint64 ticket = 0;          // submit 分配，确认时原样带回
+        QString signId;
+        qint64 receivedAtMs = 0;
+        QVector<Event> events;
+    };
+
+    struct Receipt {
+        quint64 ticket = 0;
+        bool ok = false;             // 所在事务已提交
+        int accepted = 0;            // 新写入的签到
+        int duplicates = 0;          // 此前已写入（班牌重发）的签到
+        QVector<Event> written;      // 本次新写入的签到，出勤统计据此累加
+        QString error;               // 事务失败的原因，ok 为 false 时填写
+    };
+
+    struct Options {
+        int maxEventsPerCommit = 8192;   // 单个事务最多写入的签到数
+        int maxQueuedEvents = 200000;    // 队列上限，超过时拒收新批次，班牌稍后重发
+    };
+
+    // 一次提交结束后在写线程中调用，每个批次一条
+    using CommitCallback = std::function<void(const QVector<Receipt> &receipts)>;
+
+    CheckinIngest() = default;
+    ~CheckinIngest();
+    CheckinIngest(const CheckinIngest &) = delete;
+    CheckinIngest &operator=(const CheckinIngest &) = delete;
+
+    static bool ensureSchema(QSqlDatabase db, QString *error = nullptr);
+    // 解析班牌的 CHECKIN 请求：{"sign_id":..., "room":..., "events":[{"card":..., "room":..., "at_ms":...}]}，
+    // 单条签到未给出教室时使用批次的 room
+    static bool parseBatch(const QJsonObject &args, Batch &batch, QString *error = nullptr);
+
+    // 写线程在 databasePath 上打开自己的连接；打开失败时返回 false
+    bool start(const QString &databasePath, CommitCallback callback, const Options &options = Options(),
+               QString *error = nullptr);
+    // 写完队列中已有的批次后停止
+    void stop();
+    bool isRunning() const { return thread != nullptr; }
+
+    // 线程安全；未启动或队列已满时返回 0，不接收该批次
+    quint64 submit(Batch batch);
+
+    // 统计，线程安全
+    qint64 committedEvents() const;
+    qint64 commitCount() const;
+    int queuedEvents() const;
+
+private:
+    void run(const QString &databasePath);
+    bool writeGroup(QSqlDatabase db, const QVector<Batch> &group, QVector<Receipt> &receipts, QString *error);
+
+    QThread *thread = nullptr;
+    CommitCallback callback;
+    Options options;
+
+    mutable QMutex mutex;
+    QWaitCondition wake;             // 有新批次或要求停止
+    QWaitCondition ready;            // 写线程已打开数据库（或失败）
+    QVector<Batch> queue;
+    int queued = 0;                  // 队列中的签到数
+    quint64 nextTicket = 1;
+    bool stopping = false;
+    int openState = 0;               // 写线程的数据库连接：0 正在打开，1 已打开，-1 打开失败
+    QString openError;
+    qint64 committed = 0;
+    qint64 commits = 0;
+};
+
+#endif // CHECKININGEST_H
@@ -0,0 +1,205 @@
+#include "conflictengine.h"
+#include "occupancyindex.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <algorithm>
+#include <climits>
+
+static const int kMinutesPerDay = 24 * 60;
+
+static const IntervalTree *treeFor(const QHash<QString, IntervalTree> &trees, const QString &name) {
+    if (name.isEmpty()) {
+        return nullptr;
+    }
+    auto it = trees.constFind(name);
+    return it == trees.constEnd() ? nullptr : &it.value();
+}
+
+ConflictEngine::Entry ConflictEngine::makeEntry(int id, const QString &room, const QString &course,
+                                                const QString &teacher, int weekday, const QString &startTime,
+                                                const QString &endTime) {
+    Entry entry;
+    entry.id = id;
+    entry.room = room;
+    entry.teacher = teacher;
+    entry.course = course;
+    entry.weekday = weekday;
+    entry.startMinute = OccupancyIndex::parseMinutes(startTime);
+    entry.endMinute = OccupancyIndex::parseMinutes(endTime);
+    return entry;
+}
+
+bool ConflictEngine::weekRange(const Entry &entry, int &start, int &end) {
+    if (entry.weekday < 1 || entry.weekday > 7 || entry.startMinute < 0 || entry.endMinute <= entry.startMinute) {
+        return false; // 时间不完整的课程不参与冲突检测
+    }
+    start = (entry.weekday - 1) * kMinutesPerDay + entry.startMinute;
+    end = (entry.weekday - 1) * kMinutesPerDay + entry.endMinute;
+    return true;
+}
+
+// 两条上课周规则是否有共同的一周：起止周求交集，再看交集内是否有两边单双周都允许的一周
+bool ConflictEngine::weeksIntersect(const CalendarEngine::WeekRule &a, const CalendarEngine::WeekRule &b) {
+    int first = qMax(a.firstWeek, b.firstWeek);
+    int last = qMin(a.lastWeek > 0 ? a.lastWeek : INT_MAX, b.lastWeek > 0 ? b.lastWeek : INT_MAX);
+    if (first > last) {
+        return false;
+    }
+    if (a.parity != 0 && b.parity != 0 && a.parity != b.parity) {
+        return false;
+    }
+    int parity = a.parity != 0 ? a.parity : b.parity;
+    if (parity == 0) {
+        return true;
+    }
+    int week = (first % 2 == 1) == (parity == 1) ? first : first + 1;
+    return week <= last;
+}
+
+bool ConflictEngine::rebuild(QSqlDatabase db, QString *error) {
+    roomTrees.clear();
+    teacherTrees.clear();
+    entries.clear();
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT s.id, s.room, s.course, s.teacher, s.weekday, s.start_time, s.end_time, "
+                    "w.parity, w.first_week, w.last_week FROM master_schedules s "
+                    "LEFT JOIN schedule_weeks w ON w.schedule_id = s.id")) {
+        if (error) *error = "读取课程表失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        Entry entry = makeEntry(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString(),
+                                query.value(3).toString(), query.value(4).toInt(), query.value(5).toString(),
+                                query.value(6).toString());
+        if (!query.value(7).isNull()) {
+            entry.weeks.parity = query.value(7).toInt();
+            entry.weeks.firstWeek = query.value(8).toInt();
+            entry.weeks.lastWeek = query.value(9).toInt();
+        }
+        upsert(entry);
+    }
+    return true;
+}
+
+void ConflictEngine::collect(const IntervalTree *tree, Resource resource, const QString &name, const Entry &entry,
+                             bool laterOnly, QVector<Conflict> &out) const {
+    int start = 0;
+    int end = 0;
+    if (!tree || !weekRange(entry, start, end)) {
+        return;
+    }
+    tree->forEachOverlap(start, end, [&](int otherId, int otherStart, int otherEnd) {
+        if (otherId == entry.id || (laterOnly && otherId < entry.id)) {
+            return;
+        }
+        const Entry &other = entries[otherId];
+        if (!weeksIntersect(entry.weeks, other.weeks)) {
+            return;
+        }
+        int overlapStart = qMax(start, otherStart);
+        int overlapEnd = qMin(end, otherEnd);
+        Conflict conflict;
+        conflict.resource = resource;
+        conflict.name = name;
+        conflict.weekday = overlapStart / kMinutesPerDay + 1;
+        conflict.startMinute = overlapStart % kMinutesPerDay;
+        conflict.endMinute = overlapEnd - (conflict.weekday - 1) * kMinutesPerDay;
+        conflict.courseId = entry.id;
+        conflict.course = entry.course;
+        conflict.otherId = otherId;
+        conflict.otherCourse = other.course;
+        out.append(conflict);
+    });
+}
+
+QVector<ConflictEngine::Conflict> ConflictEngine::check(const Entry &entry) const {
+    QVector<Conflict> result;
+    collect(treeFor(roomTrees, entry.room), Resource::Room, entry.room, entry, false, result);
+    collect(treeFor(teacherTrees, entry.teacher), Resource::Teacher, entry.teacher, entry, false, result);
+    return result;
+}
+
+void ConflictEngine::upsert(const Entry &entry) {
+    remove(entry.id);
+
+    int start = 0;
+    int end = 0;
+    if (!weekRange(entry, start, end)) {
+        return;
+    }
+    if (!entry.room.isEmpty()) {
+        roomTrees[entry.room].insert(start, end, entry.id);
+    }
+    if (!entry.teacher.isEmpty()) {
+        teacherTrees[entry.teacher].insert(start, end, entry.id);
+    }
+    entries.insert(entry.id, entry);
+}
+
+void ConflictEngine::remove(int id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+    int start = 0;
+    int end = 0;
+    weekRange(it.value(), start, end);
+    if (!it->room.isEmpty()) {
+        auto tree = roomTrees.find(it->room);
+        tree->remove(start, id);
+        if (tree->size() == 0) roomTrees.erase(tree);
+    }
+    if (!it->teacher.isEmpty()) {
+        auto tree = teacherTrees.find(it->teacher);
+        tree->remove(start, id);
+        if (tree->size() == 0) teacherTrees.erase(tree);
+    }
+    entries.erase(it);
+}
+
+void ConflictEngine::setWeekRule(int id, const CalendarEngine::WeekRule &rule) {
+    auto it = entries.find(id);
+    if (it != entries.end()) {
+        it->weeks = rule;   // 区间树只按时间索引，上课周在查询时比较，不需要重新插入
+    }
+}
+
+QVector<ConflictEngine::Conflict> ConflictEngine::conflicts() const {
+    QList<int> ids = entries.keys();
+    std::sort(ids.begin(), ids.end());
+
+    QVector<Conflict> result;
+    for (int id : std::as_const(ids)) {
+        const Entry &entry = entries[id];
+        collect(treeFor(roomTrees, entry.room), Resource::Room, entry.room, entry, true, result);
+        collect(treeFor(teacherTrees, entry.teacher), Resource::Teacher, entry.teacher, entry, true, result);
+    }
+    return result;
+}
+
+QVector<ConflictEngine::Conflict> ConflictEngine::validate(const QVector<Entry> &batch) {
+    // 逐行先查后插：每对冲突在较晚的一行被发现，总代价 O(n log n + k)
+    ConflictEngine engine;
+    engine.entries.reserve(batch.size());
+    QVector<Conflict> result;
+    for (const Entry &entry : batch) {
+        result += engine.check(entry);
+        engine.upsert(entry);
+    }
+    return result;
+}
+
+static QString clockText(int minutes) {
+    return QString("%1:%2").arg(minutes / 60, 2, 10, QChar('0')).arg(minutes % 60, 2, 10, QChar('0'));
+}
+
+QString ConflictEngine::describe(const Conflict &conflict) {
+    static const char *weekdayNames[] = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+    return QString("%1 %2 %3 %4-%5: %6 与 %7 冲突")
+        .arg(QString(conflict.resource == Resource::Room ? "教室" : "教师"), conflict.name,
+             QString(weekdayNames[qBound(1, conflict.weekday, 7) - 1]),
+             clockText(conflict.startMinute), clockText(conflict.endMinute),
+             conflict.course.isEmpty() ? QString("#%1").arg(conflict.courseId) : conflict.course,
+             conflict.otherCourse.isEmpty() ? QString("#%1").arg(conflict.otherId) : conflict.otherCourse);
+}
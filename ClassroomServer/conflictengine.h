@@ -0,0 +1,75 @@
+#ifndef CONFLICTENGINE_H
+#define CONFLICTENGINE_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSqlDatabase>
+#include "intervaltree.h"
+#include "calendarengine.h"
+
+// 排课冲突检测：每个教室、每位教师各一棵区间树，区间以"周内分钟"表示（星期与起止时间合成一个坐标）。
+// 增改课程前先查询重叠，O(log n + k)；整学期数据逐行先查后插，一遍完成全部校验。
+// 时间重叠的两门课若上课周没有交集（一单一双，或起止周不相交）则不算冲突。
+class ConflictEngine
+{
+public:
+    struct Entry {
+        int id = 0;              // master_schedules.id；新课程尚未入库时用 0
+        QString room;
+        QString teacher;
+        QString course;
+        int weekday = 0;
+        int startMinute = -1;
+        int endMinute = -1;
+        CalendarEngine::WeekRule weeks;   // 上课周（schedule_weeks），默认每周
+    };
+
+    enum class Resource { Room, Teacher };
+
+    struct Conflict {
+        Resource resource = Resource::Room;
+        QString name;            // 冲突的教室或教师
+        int weekday = 0;
+        int startMinute = 0;     // 重叠部分
+        int endMinute = 0;
+        int courseId = 0;
+        QString course;
+        int otherId = 0;
+        QString otherCourse;
+    };
+
+    static Entry makeEntry(int id, const QString &room, const QString &course, const QString &teacher,
+                           int weekday, const QString &startTime, const QString &endTime);
+
+    bool rebuild(QSqlDatabase db, QString *error = nullptr);
+
+    // entry 与已有课程的冲突；entry.id 对应的原记录（更新时）不计
+    QVector<Conflict> check(const Entry &entry) const;
+    void upsert(const Entry &entry);
+    void remove(int id);
+    void setWeekRule(int id, const CalendarEngine::WeekRule &rule);
+    int size() const { return entries.size(); }
+    bool contains(int id) const { return entries.contains(id); }
+    Entry entry(int id) const { return entries.value(id); }
+
+    // 当前全部冲突，每对课程在每种资源上只报告一次
+    QVector<Conflict> conflicts() const;
+
+    // 一遍校验整批数据（如导入的整学期课程），各行 id 需互不相同
+    static QVector<Conflict> validate(const QVector<Entry> &batch);
+
+    static QString describe(const Conflict &conflict);
+
+private:
+    static bool weekRange(const Entry &entry, int &start, int &end);
+    static bool weeksIntersect(const CalendarEngine::WeekRule &a, const CalendarEngine::WeekRule &b);
+    void collect(const IntervalTree *tree, Resource resource, const QString &name, const Entry &entry,
+                 bool laterOnly, QVector<Conflict> &out) const;
+
+    QHash<QString, IntervalTree> roomTrees;
+    QHash<QString, IntervalTree> teacherTrees;
+    QHash<int, Entry> entries;
+};
+
+#endif // CONFLICTENGINE_H
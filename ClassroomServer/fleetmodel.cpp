@@ -0,0 +1,169 @@
+#include "fleetmodel.h"
+#include <QColor>
+#include <QDateTime>
+#include <QLocale>
+
+FleetModel::FleetModel(const FleetRegistry *registry, QObject *parent)
+    : QAbstractTableModel(parent), registry(registry), nowMs(QDateTime::currentMSecsSinceEpoch())
+{
+}
+
+void FleetModel::setCurrentChange(qint64 id, qint64 committedAtMs) {
+    if (id == changeId && committedAtMs == changeAtMs) {
+        return;
+    }
+    changeId = id;
+    changeAtMs = committedAtMs;
+    if (knownRows > 0) {
+        emit dataChanged(index(0, LagColumn), index(knownRows - 1, HealthColumn));
+    }
+}
+
+void FleetModel::syncRowCount() {
+    if (registry->size() > knownRows) {
+        beginInsertRows(QModelIndex(), knownRows, registry->size() - 1);
+        knownRows = registry->size();
+        endInsertRows();
+    }
+}
+
+void FleetModel::rowUpdated(int row) {
+    if (row < 0) {
+        return;
+    }
+    if (row >= knownRows) {
+        syncRowCount();
+        return;
+    }
+    emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+}
+
+void FleetModel::refreshTimes() {
+    nowMs = QDateTime::currentMSecsSinceEpoch();
+    syncRowCount();
+    if (knownRows > 0) {
+        emit dataChanged(index(0, LastSeenColumn), index(knownRows - 1, HealthColumn));
+    }
+}
+
+FleetRegistry::Health FleetModel::health(int row) const {
+    return registry->health(registry->at(row), changeId, changeAtMs, nowMs);
+}
+
+int FleetModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : knownRows;
+}
+
+int FleetModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+static QString healthText(FleetRegistry::Health health) {
+    switch (health) {
+    case FleetRegistry::Health::Ok: return QString("正常");
+    case FleetRegistry::Health::Lagging: return QString("数据滞后");
+    case FleetRegistry::Health::Slow: return QString("同步缓慢");
+    case FleetRegistry::Health::Offline: return QString("离线");
+    }
+    return QString();
+}
+
+QVariant FleetModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= knownRows) {
+        return QVariant();
+    }
+
+    const SignStatus &status = registry->at(index.row());
+    FleetRegistry::Health state = health(index.row());
+
+    if (role == HealthRole) {
+        return int(state);
+    }
+    if (role == Qt::BackgroundRole) {
+        switch (state) {
+        case FleetRegistry::Health::Offline: return QColor(240, 200, 200);
+        case FleetRegistry::Health::Lagging: return QColor(250, 230, 190);
+        case FleetRegistry::Health::Slow: return QColor(250, 245, 200);
+        default: return QVariant();
+        }
+    }
+
+    qint64 lag = qMax<qint64>(0, changeId - status.dataVersion);
+    qint64 ageMs = nowMs - status.lastSeenMs;
+
+    if (role == SortRole) {
+        switch (index.column()) {
+        case DataVersionColumn: return status.dataVersion;
+        case LagColumn: return lag;
+        case LastSeenColumn: return ageMs;
+        case SyncTimeColumn: return status.lastSyncMs;
+        case BytesColumn: return status.bytesSent;
+        case RequestsColumn: return status.requests;
+        case HealthColumn: return int(state);
+        default: return data(index, Qt::DisplayRole);
+        }
+    }
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case SignColumn: return status.signId;
+    case RoomColumn: return status.room;
+    case VersionColumn: return status.softwareVersion;
+    case DataVersionColumn: return status.dataVersion;
+    case LagColumn: return lag;
+    case LastSeenColumn: return QString("%1 秒前").arg(qMax<qint64>(0, ageMs / 1000));
+    case SyncTimeColumn: return status.lastSyncMs < 0 ? QString("-") : QString::number(status.lastSyncMs);
+    case BytesColumn: return QLocale().formattedDataSize(status.bytesSent);
+    case RequestsColumn: return status.requests;
+    case SourceColumn: return status.viaRelay ? "中继 " + status.source : status.source;
+    case HealthColumn: return healthText(state);
+    default: return QVariant();
+    }
+}
+
+QVariant FleetModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case SignColumn: return QString("班牌编号");
+    case RoomColumn: return QString("教室");
+    case VersionColumn: return QString("软件版本");
+    case DataVersionColumn: return QString("数据版本");
+    case LagColumn: return QString("落后变更数");
+    case LastSeenColumn: return QString("最后在线");
+    case SyncTimeColumn: return QString("同步耗时(ms)");
+    case BytesColumn: return QString("累计下发");
+    case RequestsColumn: return QString("请求次数");
+    case SourceColumn: return QString("来源");
+    case HealthColumn: return QString("状态");
+    default: return QVariant();
+    }
+}
+
+FleetFilterProxyModel::FleetFilterProxyModel(QObject *parent) : QSortFilterProxyModel(parent)
+{
+    setSortRole(FleetModel::SortRole);
+}
+
+void FleetFilterProxyModel::setHealthFilter(int filter) {
+    if (filter == healthFilter) {
+        return;
+    }
+    healthFilter = filter;
+    invalidateFilter();
+}
+
+bool FleetFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const {
+    if (healthFilter == AllSigns) {
+        return true;
+    }
+    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    int state = sourceModel()->data(index, FleetModel::HealthRole).toInt();
+    if (healthFilter == AbnormalSigns) {
+        return state != int(FleetRegistry::Health::Ok);
+    }
+    return state == healthFilter;
+}
@@ -0,0 +1,66 @@
+#ifndef FLEETMODEL_H
+#define FLEETMODEL_H
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include "fleetregistry.h"
+
+// 班牌状态表的视图模型，直接读取 FleetRegistry 的行，不复制数据。
+// 视图只请求可见行，两千台班牌时每次刷新的代价仍只与屏幕上的行数有关。
+class FleetModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        SignColumn, RoomColumn, VersionColumn, DataVersionColumn, LagColumn, LastSeenColumn,
+        SyncTimeColumn, BytesColumn, RequestsColumn, SourceColumn, HealthColumn, ColumnCount
+    };
+    enum Role { SortRole = Qt::UserRole, HealthRole };
+
+    explicit FleetModel(const FleetRegistry *registry, QObject *parent = nullptr);
+
+    void setCurrentChange(qint64 changeId, qint64 committedAtMs);
+    // 登记表某一行更新后调用；新出现的班牌在此插入
+    void rowUpdated(int row);
+    // 定时调用：时间相关的列（最后在线、状态）随时间变化
+    void refreshTimes();
+
+    FleetRegistry::Health health(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    void syncRowCount();
+
+    const FleetRegistry *registry;
+    int knownRows = 0;             // 已通知视图的行数，登记表先追加行再通知
+    qint64 changeId = 0;
+    qint64 changeAtMs = 0;
+    qint64 nowMs = 0;              // 本轮显示使用的时间，同一次刷新内各行一致
+};
+
+// 按状态筛选的代理模型，同时提供数值排序
+class FleetFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    enum Filter { AllSigns = -1, AbnormalSigns = -2 };
+
+    explicit FleetFilterProxyModel(QObject *parent = nullptr);
+
+    // AllSigns、AbnormalSigns 或某个 FleetRegistry::Health 的值
+    void setHealthFilter(int filter);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    int healthFilter = AllSigns;
+};
+
+#endif // FLEETMODEL_H
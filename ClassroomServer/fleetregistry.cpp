@@ -0,0 +1,139 @@
+#include "fleetregistry.h"
+
+int FleetRegistry::rowFor(const QString &signId) {
+    auto it = index.constFind(signId);
+    if (it != index.constEnd()) {
+        return it.value();
+    }
+    SignStatus status;
+    status.signId = signId;
+    rows.append(status);
+    index.insert(signId, rows.size() - 1);
+    return rows.size() - 1;
+}
+
+int FleetRegistry::observe(const QJsonObject &args, const QString &peer, qint64 bytesSent, qint64 nowMs) {
+    QString signId = args["sign_id"].toString();
+    if (signId.isEmpty()) {
+        signId = "ip:" + peer;
+    }
+
+    SignStatus &status = rows[rowFor(signId)];
+    if (args.contains("room")) status.room = args["room"].toString();
+    if (args.contains("app_version")) status.softwareVersion = args["app_version"].toString();
+    if (args.contains("data_version")) status.dataVersion = args["data_version"].toInteger();
+    if (args.contains("last_sync_ms")) status.lastSyncMs = args["last_sync_ms"].toInteger();
+    status.source = peer;
+    status.viaRelay = false;
+    status.lastSeenMs = nowMs;
+    status.bytesSent += bytesSent;
+    ++status.requests;
+    return index.value(signId);
+}
+
+int FleetRegistry::observeRelayed(const QJsonObject &entry, const QString &relayId) {
+    QString signId = entry["sign_id"].toString();
+    if (signId.isEmpty()) {
+        return -1;
+    }
+
+    int row = rowFor(signId);
+    SignStatus &status = rows[row];
+    status.room = entry["room"].toString(status.room);
+    status.softwareVersion = entry["app_version"].toString(status.softwareVersion);
+    status.dataVersion = entry.value("data_version").toInteger(status.dataVersion);
+    status.lastSyncMs = entry.value("last_sync_ms").toInteger(status.lastSyncMs);
+    status.lastSeenMs = qMax(status.lastSeenMs, entry.value("last_seen_ms").toInteger());
+    status.bytesSent = entry.value("bytes_sent").toInteger(status.bytesSent);
+    status.requests = entry["requests"].toInt(status.requests);
+    status.source = relayId;
+    status.viaRelay = true;
+    return row;
+}
+
+FleetRegistry::Health FleetRegistry::health(const SignStatus &status, qint64 currentChangeId,
+                                            qint64 currentChangeAtMs, qint64 nowMs) const {
+    if (nowMs - status.lastSeenMs > limits.offlineAfterMs) {
+        return Health::Offline;
+    }
+    if (status.dataVersion < currentChangeId && nowMs - currentChangeAtMs > limits.lagGraceMs) {
+        return Health::Lagging;
+    }
+    if (status.lastSyncMs > limits.slowSyncMs) {
+        return Health::Slow;
+    }
+    return Health::Ok;
+}
+
+FleetRegistry::Summary FleetRegistry::summarize(qint64 currentChangeId, qint64 currentChangeAtMs, qint64 nowMs) const {
+    Summary summary;
+    summary.total = rows.size();
+    for (const SignStatus &status : rows) {
+        switch (health(status, currentChangeId, currentChangeAtMs, nowMs)) {
+        case Health::Ok: ++summary.ok; break;
+        case Health::Lagging: ++summary.lagging; break;
+        case Health::Slow: ++summary.slow; break;
+        case Health::Offline: ++summary.offline; break;
+        }
+    }
+    return summary;
+}
+
+QString FleetRegistry::healthName(Health health) {
+    switch (health) {
+    case Health::Ok: return "ok";
+    case Health::Lagging: return "lagging";
+    case Health::Slow: return "slow";
+    case Health::Offline: return "offline";
+    }
+    return QString();
+}
+
+QJsonObject FleetRegistry::toJson(const SignStatus &status) {
+    QJsonObject obj;
+    obj["sign_id"] = status.signId;
+    obj["room"] = status.room;
+    obj["app_version"] = status.softwareVersion;
+    obj["source"] = status.source;
+    obj["via_relay"] = status.viaRelay;
+    obj["data_version"] = status.dataVersion;
+    obj["last_seen_ms"] = status.lastSeenMs;
+    obj["last_sync_ms"] = status.lastSyncMs;
+    obj["bytes_sent"] = status.bytesSent;
+    obj["requests"] = status.requests;
+    return obj;
+}
+
+QJsonObject FleetRegistry::query(const QJsonObject &args, qint64 currentChangeId, qint64 currentChangeAtMs,
+                                 qint64 nowMs) const {
+    QString filter = args["filter"].toString("all");
+    int limit = args["limit"].toInt(500);
+
+    QJsonArray signs;
+    for (const SignStatus &status : rows) {
+        Health state = health(status, currentChangeId, currentChangeAtMs, nowMs);
+        QString name = healthName(state);
+        bool wanted = filter == "all" || filter == name || (filter == "abnormal" && state != Health::Ok);
+        if (!wanted) continue;
+        if (signs.size() >= limit) break;
+
+        QJsonObject obj = toJson(status);
+        obj["version_lag"] = qMax<qint64>(0, currentChangeId - status.dataVersion);
+        obj["health"] = name;
+        signs.append(obj);
+    }
+
+    Summary summary = summarize(currentChangeId, currentChangeAtMs, nowMs);
+    QJsonObject summaryObj;
+    summaryObj["total"] = summary.total;
+    summaryObj["ok"] = summary.ok;
+    summaryObj["lagging"] = summary.lagging;
+    summaryObj["slow"] = summary.slow;
+    summaryObj["offline"] = summary.offline;
+
+    QJsonObject rootObj;
+    rootObj["change_id"] = currentChangeId;
+    rootObj["summary"] = summaryObj;
+    rootObj["signs"] = signs;
+    return rootObj;
+}
@@ -0,0 +1,75 @@
+#ifndef FLEETREGISTRY_H
+#define FLEETREGISTRY_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+
+// 单个班牌的同步状态
+struct SignStatus {
+    QString signId;
+    QString room;
+    QString softwareVersion;
+    QString source;            // 直连班牌的地址，或转发它的中继编号
+    qint64 dataVersion = 0;    // 班牌已应用的变更编号
+    qint64 lastSeenMs = 0;     // 最近一次请求的时间
+    qint64 lastSyncMs = -1;    // 班牌上报的上一次同步耗时（请求到写库完成），-1 表示未知
+    qint64 bytesSent = 0;      // 累计下发字节数
+    int requests = 0;
+    bool viaRelay = false;
+};
+
+// 全部班牌的状态表。行按首次出现的顺序追加且不删除，行号稳定，界面模型可按行号增量刷新；
+// 班牌编号到行号的哈希索引保证每次请求的更新为 O(1)。
+class FleetRegistry
+{
+public:
+    enum class Health { Ok, Lagging, Slow, Offline };
+
+    struct Thresholds {
+        qint64 offlineAfterMs = 600000; // 超过该时间没有请求视为离线
+        qint64 lagGraceMs = 120000;     // 最新变更提交超过该时间仍未应用视为滞后
+        qint64 slowSyncMs = 2000;       // 同步耗时超过该值视为较慢
+    };
+
+    struct Summary {
+        int total = 0;
+        int ok = 0;
+        int lagging = 0;
+        int slow = 0;
+        int offline = 0;
+    };
+
+    void setThresholds(const Thresholds &value) { limits = value; }
+    const Thresholds &thresholds() const { return limits; }
+
+    // 直连班牌的一次请求；没有 sign_id 的旧版班牌以地址标识。返回行号
+    int observe(const QJsonObject &args, const QString &peer, qint64 bytesSent, qint64 nowMs);
+    // 中继汇总转发的班牌状态，字节数和最后在线时间以中继的统计为准
+    int observeRelayed(const QJsonObject &entry, const QString &relayId);
+
+    int size() const { return rows.size(); }
+    const SignStatus &at(int row) const { return rows[row]; }
+    int indexOf(const QString &signId) const { return index.value(signId, -1); }
+
+    Health health(const SignStatus &status, qint64 currentChangeId, qint64 currentChangeAtMs, qint64 nowMs) const;
+    Summary summarize(qint64 currentChangeId, qint64 currentChangeAtMs, qint64 nowMs) const;
+
+    // FLEET 命令：{"filter": "all|abnormal|offline|lagging|slow", "limit": N}
+    QJsonObject query(const QJsonObject &args, qint64 currentChangeId, qint64 currentChangeAtMs, qint64 nowMs) const;
+
+    static QString healthName(Health health);
+    // 一行状态的 JSON 形式，FLEET 命令的结果和中继转发给上游的条目共用
+    static QJsonObject toJson(const SignStatus &status);
+
+private:
+    int rowFor(const QString &signId);
+
+    QVector<SignStatus> rows;
+    QHash<QString, int> index;
+    Thresholds limits;
+};
+
+#endif // FLEETREGISTRY_H
@@ -0,0 +1,93 @@
+#include "intervaltree.h"
+
+// 由 id 散列出优先级，同样的数据总是得到同样形状的树
+static quint32 priorityFor(int id) {
+    quint32 x = quint32(id) * 0x9E3779B9u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    return x;
+}
+
+void IntervalTree::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+    count = 0;
+}
+
+void IntervalTree::pull(int node) {
+    Node &n = nodes[node];
+    n.maxEnd = n.end;
+    if (n.left >= 0) n.maxEnd = qMax(n.maxEnd, nodes[n.left].maxEnd);
+    if (n.right >= 0) n.maxEnd = qMax(n.maxEnd, nodes[n.right].maxEnd);
+}
+
+void IntervalTree::split(int node, int start, int id, int &left, int &right) {
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    Node &n = nodes[node];
+    if (keyLess(n.start, n.id, start, id)) {
+        int rightLeft = -1;
+        split(n.right, start, id, rightLeft, right);
+        nodes[node].right = rightLeft;
+        left = node;
+    } else {
+        int leftRight = -1;
+        split(n.left, start, id, left, leftRight);
+        nodes[node].left = leftRight;
+        right = node;
+    }
+    pull(node);
+}
+
+int IntervalTree::merge(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        int merged = merge(nodes[left].right, right);
+        nodes[left].right = merged;
+        pull(left);
+        return left;
+    }
+    int merged = merge(left, nodes[right].left);
+    nodes[right].left = merged;
+    pull(right);
+    return right;
+}
+
+void IntervalTree::insert(int start, int end, int id) {
+    int node;
+    if (!freeNodes.isEmpty()) {
+        node = freeNodes.takeLast();
+    } else {
+        node = nodes.size();
+        nodes.append(Node());
+    }
+    nodes[node] = Node{start, end, end, id, priorityFor(id), -1, -1};
+
+    int left = -1;
+    int right = -1;
+    split(root, start, id, left, right);
+    root = merge(merge(left, node), right);
+    ++count;
+}
+
+bool IntervalTree::remove(int start, int id) {
+    // 拆出键恰为 (start, id) 的单个节点
+    int left = -1;
+    int rest = -1;
+    int middle = -1;
+    int right = -1;
+    split(root, start, id, left, rest);
+    split(rest, start, id + 1, middle, right);
+    root = merge(left, right);
+    if (middle < 0) {
+        return false;
+    }
+    freeNodes.append(middle);
+    --count;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef INTERVALTREE_H
+#define INTERVALTREE_H
+
+#include <QVector>
+
+// 半开区间 [start, end) 的区间树：按 (start, id) 排序的树堆（treap），每个节点记录子树内最大的 end。
+// 插入、删除期望 O(log n)；查找与某区间重叠的全部区间为 O(log n + k)。
+// 节点存放在数组中，删除的节点进入空闲表复用，不逐个分配内存。
+class IntervalTree
+{
+public:
+    void insert(int start, int end, int id);
+    bool remove(int start, int id);
+    void clear();
+    int size() const { return count; }
+
+    // 对每个与 [start, end) 重叠的区间调用 visit(id, start, end)
+    template <typename Visit>
+    void forEachOverlap(int start, int end, Visit visit) const {
+        visitOverlaps(root, start, end, visit);
+    }
+
+private:
+    struct Node {
+        int start;
+        int end;
+        int maxEnd;     // 子树内最大的 end，用于剪枝
+        int id;
+        quint32 priority;
+        int left;
+        int right;
+    };
+
+    static bool keyLess(int startA, int idA, int startB, int idB) {
+        return startA != startB ? startA < startB : idA < idB;
+    }
+
+    void pull(int node);
+    // 拆成键小于 (start, id) 与不小于 (start, id) 的两棵树
+    void split(int node, int start, int id, int &left, int &right);
+    int merge(int left, int right);
+
+    template <typename Visit>
+    void visitOverlaps(int node, int start, int end, Visit &visit) const {
+        while (node >= 0) {
+            const Node &n = nodes[node];
+            if (n.maxEnd <= start) {
+                return; // 整棵子树都在 start 之前结束
+            }
+            visitOverlaps(n.left, start, end, visit);
+            if (n.start >= end) {
+                return; // 右子树的起点更晚，不会重叠
+            }
+            if (n.end > start) {
+                visit(n.id, n.start, n.end);
+            }
+            node = n.right;
+        }
+    }
+
+    QVector<Node> nodes;
+    QVector<int> freeNodes;
+    int root = -1;
+    int count = 0;
+};
+
+#endif // INTERVALTREE_H
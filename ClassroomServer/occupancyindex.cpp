@@ -0,0 +1,312 @@
+#include "occupancyindex.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <algorithm>
+
+static const int kDefaultQueryLimit = 100;
+
+OccupancyIndex::OccupancyIndex() {
+}
+
+void OccupancyIndex::clear() {
+    names.clear();
+    capacities.clear();
+    floors.clear();
+    buildingIds.clear();
+    listed.clear();
+    roomIndex.clear();
+    buildingNames.clear();
+    buildingIndex.clear();
+    for (QVector<quint64> &column : columns) {
+        column.clear();
+    }
+    courses.clear();
+    roomCourses.clear();
+}
+
+bool OccupancyIndex::rebuild(QSqlDatabase db, QString *error) {
+    clear();
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT room_name, capacity, building, floor FROM classrooms")) {
+        if (error) *error = "读取教室失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        setRoom(query.value(0).toString(), query.value(1).toInt(), query.value(2).toString(), query.value(3).toInt());
+    }
+
+    if (!query.exec("SELECT id, room, weekday, start_time, end_time FROM master_schedules")) {
+        if (error) *error = "读取课程表失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        setCourse(query.value(0).toInt(), query.value(1).toString(), query.value(2).toInt(),
+                  query.value(3).toString(), query.value(4).toString());
+    }
+    return true;
+}
+
+int OccupancyIndex::roomRow(const QString &name) {
+    auto it = roomIndex.constFind(name);
+    if (it != roomIndex.constEnd()) {
+        return it.value();
+    }
+    int row = names.size();
+    names.append(name);
+    capacities.append(0);
+    floors.append(0);
+    buildingIds.append(-1);
+    listed.append(0);
+    for (QVector<quint64> &column : columns) {
+        column.append(0);
+    }
+    roomIndex.insert(name, row);
+    return row;
+}
+
+void OccupancyIndex::setRoom(const QString &name, int capacity, const QString &building, int floor) {
+    int row = roomRow(name);
+    int buildingId = buildingIndex.value(building, -1);
+    if (buildingId < 0) {
+        buildingId = buildingNames.size();
+        buildingNames.append(building);
+        buildingIndex.insert(building, buildingId);
+    }
+    capacities[row] = capacity;
+    floors[row] = floor;
+    buildingIds[row] = buildingId;
+    listed[row] = 1;
+}
+
+void OccupancyIndex::removeRoom(const QString &name) {
+    int row = roomIndex.value(name, -1);
+    if (row >= 0) {
+        listed[row] = 0;
+    }
+}
+
+int OccupancyIndex::parseMinutes(const QString &text) {
+    int colon = text.indexOf(':');
+    if (colon <= 0) {
+        return -1;
+    }
+    bool hourOk = false;
+    bool minuteOk = false;
+    int hour = text.left(colon).trimmed().toInt(&hourOk);
+    int minute = text.mid(colon + 1, 2).toInt(&minuteOk);
+    if (!hourOk || !minuteOk || hour < 0 || hour > 24 || minute < 0 || minute >= 60) {
+        return -1;
+    }
+    return qMin(hour * 60 + minute, 24 * 60);
+}
+
+bool OccupancyIndex::toSlots(const Interval &interval, int &firstSlot, int &endSlot) {
+    if (interval.weekday < 1 || interval.weekday > 7 || interval.startMinute < 0
+        || interval.endMinute <= interval.startMinute) {
+        return false;
+    }
+    // 开始时间向下、结束时间向上取整到时间片，部分占用的时间片按占用计
+    int dayBase = (interval.weekday - 1) * kSlotsPerDay;
+    firstSlot = dayBase + interval.startMinute / kSlotMinutes;
+    endSlot = dayBase + qMin(kSlotsPerDay, (interval.endMinute + kSlotMinutes - 1) / kSlotMinutes);
+    return firstSlot < endSlot;
+}
+
+void OccupancyIndex::paint(int row, int firstSlot, int endSlot) {
+    for (int slot = firstSlot; slot < endSlot;) {
+        int word = slot / 64;
+        int bit = slot % 64;
+        int count = qMin(64 - bit, endSlot - slot);
+        quint64 bits = (count == 64 ? ~quint64(0) : ((quint64(1) << count) - 1)) << bit;
+        columns[word][row] |= bits;
+        slot += count;
+    }
+}
+
+void OccupancyIndex::repaintRoom(int row) {
+    for (QVector<quint64> &column : columns) {
+        column[row] = 0;
+    }
+    for (auto it = roomCourses.constFind(row); it != roomCourses.constEnd() && it.key() == row; ++it) {
+        const Course &course = courses[it.value()];
+        paint(row, course.firstSlot, course.endSlot);
+    }
+}
+
+void OccupancyIndex::setCourse(int courseId, const QString &room, int weekday, const QString &startTime,
+                               const QString &endTime) {
+    removeCourse(courseId);
+
+    Interval interval;
+    interval.weekday = weekday;
+    interval.startMinute = parseMinutes(startTime);
+    interval.endMinute = parseMinutes(endTime);
+    Course course;
+    if (room.isEmpty() || !toSlots(interval, course.firstSlot, course.endSlot)) {
+        return; // 时间不完整的课程不占用教室
+    }
+
+    course.room = roomRow(room);
+    courses.insert(courseId, course);
+    roomCourses.insert(course.room, courseId);
+    paint(course.room, course.firstSlot, course.endSlot);
+}
+
+void OccupancyIndex::removeCourse(int courseId) {
+    auto it = courses.find(courseId);
+    if (it == courses.end()) {
+        return;
+    }
+    int row = it->room;
+    courses.erase(it);
+    roomCourses.remove(row, courseId);
+    // 同一教室的课程可能重叠，不能直接清位，按剩余课程重画这一间
+    repaintRoom(row);
+}
+
+QVector<OccupancyIndex::Room> OccupancyIndex::findFree(const Query &query) const {
+    QVector<Room> result;
+
+    quint64 mask[kWords] = {};
+    for (const Interval &interval : query.intervals) {
+        int firstSlot = 0;
+        int endSlot = 0;
+        if (!toSlots(interval, firstSlot, endSlot)) continue;
+        for (int slot = firstSlot; slot < endSlot; ++slot) {
+            mask[slot / 64] |= quint64(1) << (slot % 64);
+        }
+    }
+
+    int buildingId = -1;
+    if (!query.building.isEmpty()) {
+        buildingId = buildingIndex.value(query.building, -1);
+        if (buildingId < 0) {
+            return result;
+        }
+    }
+
+    // 各区间的时间片先并成一份掩码，再逐字整列求冲突：busy[r] |= columns[w][r] & mask[w]
+    const int n = names.size();
+    busyScratch.fill(0, n);
+    quint64 *busy = busyScratch.data();
+    for (int w = 0; w < kWords; ++w) {
+        const quint64 m = mask[w];
+        if (!m) continue;
+        const quint64 *column = columns[w].constData();
+        for (int r = 0; r < n; ++r) {
+            busy[r] |= column[r] & m;
+        }
+    }
+
+    QVector<int> rows;
+    for (int r = 0; r < n; ++r) {
+        if (busy[r] == 0 && listed[r] && capacities[r] >= query.minCapacity
+            && (buildingId < 0 || buildingIds[r] == buildingId) && (query.floor < 0 || floors[r] == query.floor)) {
+            rows.append(r);
+        }
+    }
+
+    // 容量刚好够用的教室排在前面
+    auto byCapacity = [this](int a, int b) {
+        return capacities[a] != capacities[b] ? capacities[a] < capacities[b] : a < b;
+    };
+    if (query.limit >= 0 && query.limit < rows.size()) {
+        std::partial_sort(rows.begin(), rows.begin() + query.limit, rows.end(), byCapacity);
+        rows.resize(query.limit);
+    } else {
+        std::sort(rows.begin(), rows.end(), byCapacity);
+    }
+
+    result.reserve(rows.size());
+    for (int r : std::as_const(rows)) {
+        Room room;
+        room.name = names[r];
+        room.capacity = capacities[r];
+        room.building = buildingNames[buildingIds[r]];
+        room.floor = floors[r];
+        result.append(room);
+    }
+    return result;
+}
+
+bool OccupancyIndex::isFree(const QString &room, const Interval &interval) const {
+    int row = roomIndex.value(room, -1);
+    int firstSlot = 0;
+    int endSlot = 0;
+    if (row < 0 || !toSlots(interval, firstSlot, endSlot)) {
+        return true; // 没有任何课程的教室，或空区间
+    }
+    for (int slot = firstSlot; slot < endSlot; ++slot) {
+        if (columns[slot / 64][row] & (quint64(1) << (slot % 64))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int OccupancyIndex::roomCount() const {
+    return int(std::count(listed.cbegin(), listed.cend(), quint8(1)));
+}
+
+QStringList OccupancyIndex::buildings() const {
+    QStringList result;
+    for (int r = 0; r < names.size(); ++r) {
+        if (listed[r] && !buildingNames[buildingIds[r]].isEmpty()) {
+            result.append(buildingNames[buildingIds[r]]);
+        }
+    }
+    result.removeDuplicates();
+    result.sort();
+    return result;
+}
+
+QJsonObject OccupancyIndex::query(const QJsonObject &args) const {
+    Query request;
+    QJsonArray slotArray = args["slots"].toArray();
+    if (slotArray.isEmpty()) {
+        slotArray.append(args);
+    }
+    for (const QJsonValue &value : std::as_const(slotArray)) {
+        QJsonObject slot = value.toObject();
+        Interval interval;
+        interval.weekday = slot["weekday"].toInt();
+        interval.startMinute = parseMinutes(slot["start"].toString());
+        interval.endMinute = parseMinutes(slot["end"].toString());
+        int firstSlot = 0;
+        int endSlot = 0;
+        if (!toSlots(interval, firstSlot, endSlot)) {
+            QJsonObject errorObj;
+            errorObj["error"] = "时间段无效，需要 weekday(1-7)、start、end(HH:mm)";
+            return errorObj;
+        }
+        request.intervals.append(interval);
+    }
+    request.minCapacity = args["min_capacity"].toInt(0);
+    request.building = args["building"].toString();
+    request.floor = args["floor"].toInt(-1);
+    request.limit = args["limit"].toInt(kDefaultQueryLimit);
+
+    QElapsedTimer clock;
+    clock.start();
+    QVector<Room> rooms = findFree(request);
+    qint64 elapsedNs = clock.nsecsElapsed();
+
+    QJsonArray roomArray;
+    for (const Room &room : std::as_const(rooms)) {
+        QJsonObject obj;
+        obj["room_name"] = room.name;
+        obj["capacity"] = room.capacity;
+        obj["building"] = room.building;
+        obj["floor"] = room.floor;
+        roomArray.append(obj);
+    }
+
+    QJsonObject rootObj;
+    rootObj["rooms"] = roomArray;
+    rootObj["count"] = roomArray.size();
+    rootObj["elapsed_us"] = elapsedNs / 1000;
+    return rootObj;
+}
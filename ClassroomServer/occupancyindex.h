@@ -0,0 +1,105 @@
+#ifndef OCCUPANCYINDEX_H
+#define OCCUPANCYINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMultiHash>
+#include <QJsonObject>
+#include <QSqlDatabase>
+
+// 教室占用位图：一周按 5 分钟切成 2016 个时间片，每个教室一份位图，由 master_schedules 生成，
+// 课程增删改时只重画受影响的教室。
+//
+// 位图按"字"分列存放：第 w 个 64 位字的全部教室连续排列。查询某个时段只涉及少数几个字，
+// 对每个字整列做一次按位与/或，循环体没有分支，编译器可以向量化；再按容量、楼栋、楼层筛选。
+class OccupancyIndex
+{
+public:
+    static constexpr int kSlotMinutes = 5;
+    static constexpr int kSlotsPerDay = 24 * 60 / kSlotMinutes;
+    static constexpr int kSlotsPerWeek = 7 * kSlotsPerDay;
+    static constexpr int kWords = (kSlotsPerWeek + 63) / 64;
+
+    // 星期 weekday（1-7）的 [startMinute, endMinute) 分钟区间
+    struct Interval {
+        int weekday = 1;
+        int startMinute = 0;
+        int endMinute = 0;
+    };
+
+    // 所有区间都空闲的教室；building 为空、floor 为 -1 表示不限
+    struct Query {
+        QVector<Interval> intervals;
+        int minCapacity = 0;
+        QString building;
+        int floor = -1;
+        int limit = -1;
+    };
+
+    struct Room {
+        QString name;
+        int capacity = 0;
+        QString building;
+        int floor = 0;
+    };
+
+    OccupancyIndex();
+
+    // 从数据库重建全部教室和课程
+    bool rebuild(QSqlDatabase db, QString *error = nullptr);
+
+    // 教室增改删，对应 classrooms 表；删除后保留其课程，重新添加时占用随之恢复
+    void setRoom(const QString &name, int capacity, const QString &building, int floor);
+    void removeRoom(const QString &name);
+
+    // 课程增改删，对应 master_schedules 表的一行
+    void setCourse(int courseId, const QString &room, int weekday, const QString &startTime, const QString &endTime);
+    void removeCourse(int courseId);
+
+    // 按容量从小到大返回，容量相同时按教室添加顺序
+    QVector<Room> findFree(const Query &query) const;
+    bool isFree(const QString &room, const Interval &interval) const;
+
+    int roomCount() const;
+    QStringList buildings() const;
+
+    // FREE_ROOMS 命令：{"weekday":1,"start":"08:00","end":"09:40"} 或 {"slots":[...]}，
+    // 可选 min_capacity、building、floor、limit
+    QJsonObject query(const QJsonObject &args) const;
+
+    // "HH:mm" 转为当天分钟数，格式不符返回 -1
+    static int parseMinutes(const QString &text);
+
+private:
+    struct Course {
+        int room = -1;
+        int firstSlot = 0;   // 周内时间片 [firstSlot, endSlot)
+        int endSlot = 0;
+    };
+
+    void clear();
+    int roomRow(const QString &name);
+    void paint(int row, int firstSlot, int endSlot);
+    void repaintRoom(int row);
+    static bool toSlots(const Interval &interval, int &firstSlot, int &endSlot);
+
+    // 教室按首次出现的顺序编号，行号不变
+    QVector<QString> names;
+    QVector<int> capacities;
+    QVector<int> floors;
+    QVector<int> buildingIds;
+    QVector<quint8> listed;                // 在 classrooms 表中；只有课程引用的教室不参与查询
+    QHash<QString, int> roomIndex;
+    QVector<QString> buildingNames;
+    QHash<QString, int> buildingIndex;
+
+    QVector<quint64> columns[kWords];      // columns[w][row]：教室 row 的第 w 个字
+    QHash<int, Course> courses;            // 课程编号 -> 所在教室与时间片
+    QMultiHash<int, int> roomCourses;      // 教室行号 -> 课程编号
+
+    mutable QVector<quint64> busyScratch;  // 查询时各教室的冲突位，只在界面线程使用
+};
+
+#endif // OCCUPANCYINDEX_H
@@ -0,0 +1,53 @@
+#include "pollpolicy.h"
+
+PollAdvisor::PollAdvisor(const PollPolicy &policy)
+{
+    setPolicy(policy);
+}
+
+void PollAdvisor::setPolicy(const PollPolicy &policy) {
+    pollPolicy = policy;
+    int window = qMax(1, pollPolicy.rateWindowSecs);
+    buckets.fill(0, window);
+    bucketSecs.fill(-1, window);
+}
+
+void PollAdvisor::recordRequest(qint64 nowMs) {
+    qint64 sec = nowMs / 1000;
+    int slot = int(sec % buckets.size());
+    if (bucketSecs[slot] != sec) {
+        // 桶中是上一轮的旧计数，直接覆盖
+        bucketSecs[slot] = sec;
+        buckets[slot] = 0;
+    }
+    ++buckets[slot];
+}
+
+double PollAdvisor::requestRate(qint64 nowMs) const {
+    qint64 sec = nowMs / 1000;
+    qint64 oldest = sec - buckets.size() + 1;
+    int total = 0;
+    for (int i = 0; i < buckets.size(); ++i) {
+        if (bucketSecs[i] >= oldest && bucketSecs[i] <= sec) {
+            total += buckets[i];
+        }
+    }
+    return double(total) / buckets.size();
+}
+
+int PollAdvisor::advise(qint64 nowMs, qint64 msToNextBoundary) const {
+    qint64 interval = pollPolicy.baseIntervalMs;
+
+    // 临近上下课时刻时，让班牌在该时刻之后不久拉取一次最新数据
+    if (msToNextBoundary >= 0 && msToNextBoundary + pollPolicy.boundaryGraceMs < interval) {
+        interval = msToNextBoundary + pollPolicy.boundaryGraceMs;
+    }
+
+    // 负载超过目标速率时按比例拉长间隔，让总请求速率回落到目标附近
+    double load = requestRate(nowMs) / pollPolicy.targetRequestsPerSec;
+    if (load > 1.0) {
+        interval = qint64(interval * load);
+    }
+
+    return int(qBound<qint64>(pollPolicy.minIntervalMs, interval, pollPolicy.maxIntervalMs));
+}
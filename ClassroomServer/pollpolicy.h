@@ -0,0 +1,38 @@
+#ifndef POLLPOLICY_H
+#define POLLPOLICY_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// 班牌轮询间隔的全部可调参数，集中在这里修改
+struct PollPolicy {
+    int baseIntervalMs = 30000;       // 空闲时建议的轮询间隔
+    int minIntervalMs = 5000;         // 建议间隔下限
+    int maxIntervalMs = 300000;       // 建议间隔上限
+    int boundaryGraceMs = 15000;      // 上下课时刻之后多久拉取新数据
+    double targetRequestsPerSec = 20; // 超过该请求速率时按比例拉长间隔
+    int rateWindowSecs = 10;          // 统计请求速率的时间窗口
+};
+
+// 根据当前负载和距下一个上下课时刻的时间，计算下发给班牌的轮询间隔
+class PollAdvisor
+{
+public:
+    explicit PollAdvisor(const PollPolicy &policy = PollPolicy());
+
+    const PollPolicy &policy() const { return pollPolicy; }
+    void setPolicy(const PollPolicy &policy);
+
+    void recordRequest(qint64 nowMs);          // 记录一次同步请求
+    double requestRate(qint64 nowMs) const;    // 最近窗口内的平均请求速率（次/秒）
+
+    // msToNextBoundary < 0 表示今天已没有上下课时刻
+    int advise(qint64 nowMs, qint64 msToNextBoundary) const;
+
+private:
+    PollPolicy pollPolicy;
+    QVector<int> buckets;       // 每秒一个计数桶，环形使用
+    QVector<qint64> bucketSecs; // 每个桶对应的秒
+};
+
+#endif // POLLPOLICY_H
@@ -0,0 +1,71 @@
+#include "propagationstats.h"
+#include <algorithm>
+
+static const int kFleetWindow = 4096;
+static const int kSignWindow = 64;
+
+void PropagationStats::Window::add(qint64 value, int capacity) {
+    if (values.size() < capacity) {
+        values.append(value);
+    } else {
+        values[next] = value;
+        next = (next + 1) % capacity;
+    }
+}
+
+bool PropagationStats::record(const QString &signId, const QJsonObject &report, Sample *accepted) {
+    Sample sample;
+    sample.changeId = report["change_id"].toInteger();
+    qint64 committedAtMs = report["committed_at_ms"].toInteger();
+    qint64 requestAtMs = report["request_at_ms"].toInteger();
+    sample.waitMs = requestAtMs - committedAtMs;
+    sample.fetchMs = report["fetch_ms"].toInteger(-1);
+    sample.applyMs = report["apply_ms"].toInteger(-1);
+    sample.displayMs = report["display_ms"].toInteger(-1);
+
+    if (signId.isEmpty() || sample.changeId <= 0 || committedAtMs <= 0 || sample.waitMs < 0
+        || sample.fetchMs < 0 || sample.applyMs < 0 || sample.displayMs < 0) {
+        return false;
+    }
+    if (lastChangeBySign.value(signId, 0) >= sample.changeId) {
+        return false;
+    }
+    lastChangeBySign.insert(signId, sample.changeId);
+
+    qint64 total = sample.totalMs();
+    fleet.add(total, kFleetWindow);
+    perSign[signId].add(total, kSignWindow);
+
+    if (accepted) {
+        *accepted = sample;
+    }
+    return true;
+}
+
+PropagationStats::Summary PropagationStats::summarize(const Window &window) {
+    Summary summary;
+    summary.samples = window.values.size();
+    if (window.values.isEmpty()) {
+        return summary;
+    }
+
+    QVector<qint64> sorted = window.values;
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](double p) {
+        int index = qMin(int(p * sorted.size()), int(sorted.size()) - 1);
+        return sorted[index];
+    };
+    summary.p50 = at(0.50);
+    summary.p95 = at(0.95);
+    summary.p99 = at(0.99);
+    summary.max = sorted.last();
+    return summary;
+}
+
+PropagationStats::Summary PropagationStats::fleetSummary() const {
+    return summarize(fleet);
+}
+
+PropagationStats::Summary PropagationStats::signSummary(const QString &signId) const {
+    return summarize(perSign.value(signId));
+}
@@ -0,0 +1,56 @@
+#ifndef PROPAGATIONSTATS_H
+#define PROPAGATIONSTATS_H
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QJsonObject>
+
+// 变更传播耗时统计：从管理端保存到班牌显示出来。
+// 班牌在下一次请求中上报上一次变更各阶段的耗时，这里按班牌和全网分别保留最近的样本。
+//
+// 总耗时 = (服务器收到请求 - 变更提交)  [服务器时钟]
+//        + fetch_ms + apply_ms + display_ms [班牌时钟]
+// 两段分别在各自的时钟上求差，不受两端时钟偏差影响。
+class PropagationStats
+{
+public:
+    struct Sample {
+        qint64 changeId = 0;
+        qint64 waitMs = 0;      // 变更提交到班牌下一次请求到达服务器
+        qint64 fetchMs = 0;     // 班牌发出请求到收完响应
+        qint64 applyMs = 0;     // 收完响应到写入本地库
+        qint64 displayMs = 0;   // 写入本地库到界面刷新
+        qint64 totalMs() const { return waitMs + fetchMs + applyMs + displayMs; }
+    };
+
+    struct Summary {
+        int samples = 0;
+        qint64 p50 = 0;
+        qint64 p95 = 0;
+        qint64 p99 = 0;
+        qint64 max = 0;
+    };
+
+    // 解析班牌上报；格式不对或时间不合理时返回 false
+    bool record(const QString &signId, const QJsonObject &report, Sample *accepted = nullptr);
+
+    Summary fleetSummary() const;
+    Summary signSummary(const QString &signId) const;
+    QStringList signIds() const { return perSign.keys(); }
+
+private:
+    // 固定容量的环形样本窗口，只保存总耗时
+    struct Window {
+        QVector<qint64> values;
+        int next = 0;
+        void add(qint64 value, int capacity);
+    };
+    static Summary summarize(const Window &window);
+
+    Window fleet;
+    QHash<QString, Window> perSign;
+    QHash<QString, qint64> lastChangeBySign;  // 同一变更重复上报时只计一次
+};
+
+#endif // PROPAGATIONSTATS_H
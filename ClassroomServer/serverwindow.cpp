@@ -1,4 +1,8 @@
 #include "serverwindow.h"
+#include "snapshotbuilder.h"
+#include "schema.h"
+#include "columnar.h"
+#include "propagationstats.h"
 #include <QVBoxLayout>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -13,6 +17,10 @@
 #include <QHeaderView>
 #include <QTableWidgetItem>
 #include <QTimer>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QSignalBlocker>
 #include <QFormLayout>
 #include <QSpinBox>
 #include <QLineEdit>
@@ -21,11 +29,49 @@
 #include <QList>
 #include <QMap>
 #include <QVector>
+#include <functional>
+#include <algorithm>
+
+// 优先级不低于该值的公告走紧急通道，立即推送
+static const int kUrgentPriority = 8;
+// 版本页最多显示的课程行数
+static const int kVersionPreviewRows = 2000;
+// 发布后课程数不超过该值时自动刷新各表格；更大的课表由管理员手动刷新，避免界面线程长时间占用影响同步服务
+static const int kAutoRefreshRows = 5000;
+// 签到队列已满或写入失败时，建议班牌重发前等待的时间
+static const int kCheckinRetryMs = 2000;
+
+// 公告在 now 时刻是否有效：发布时间为空或已到，过期时间为空或未到；时间按字符串比较
+static bool announcementActive(const QString &publishTime, const QString &expireTime, const QDateTime &now) {
+    const QString at = now.toString(SnapshotBuilder::kAnnouncementTimeFormat);
+    return publishTime <= at && (expireTime.isEmpty() || expireTime > at);
+}
+
+// 后台线程使用的数据库连接：与主连接打开同一个文件，用完即移除
+static bool withWorkerConnection(const QString &name, QString *error,
+                                 const std::function<bool(QSqlDatabase)> &work) {
+    bool ok = false;
+    {
+        QSqlDatabase worker = QSqlDatabase::cloneDatabase("ServerConnection", name);
+        if (worker.open()) {
+            QSqlQuery(worker).exec("PRAGMA busy_timeout = 5000");
+            ok = work(worker);
+            worker.close();
+        } else if (error) {
+            *error = "后台数据库连接打开失败: " + worker.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(name);
+    return ok;
+}
 
 ServerWindow::ServerWindow(QWidget *parent) : QWidget(parent)
 {
     setWindowTitle("校园服务器 (Port: 12345)");
     resize(1200, 800);
+
+    // 时间轮从现在开始计时，之后初始化数据库时登记公告和上下课事件
+    timerWheel.reset(QDateTime::currentMSecsSinceEpoch());
     
     setupUi();
     
@@ -34,24 +80,62 @@ ServerWindow::ServerWindow(QWidget *parent) : QWidget(parent)
     
     // 2. 刷新数据显示
     refreshData();
+    rebuildAttendance();
     
-    // 3. 设置定时器更新当前上课班级信息（每分钟更新一次）
-    classUpdateTimer = new QTimer(this);
-    connect(classUpdateTimer, &QTimer::timeout, this, &ServerWindow::updateCurrentClasses);
-    classUpdateTimer->start(60000); // 每分钟更新一次
+    // 3. 当前上课班级在上下课时刻由时间轮触发更新，启动时先按当前时间更新一次
+    updateCurrentClasses();
+    wheelTimer = new QTimer(this);
+    wheelTimer->setSingleShot(true);
+    wheelTimer->setTimerType(Qt::PreciseTimer);
+    connect(wheelTimer, &QTimer::timeout, this, &ServerWindow::onWheelTick);
+    wheelTimer->start(int(timerWheel.tickMs() - QDateTime::currentMSecsSinceEpoch() % timerWheel.tickMs()));
     
     // 4. 启动 TCP 监听
-    tcpServer = new QTcpServer(this);
-    connect(tcpServer, &QTcpServer::newConnection, this, &ServerWindow::onNewConnection);
+    syncService = new SyncService(this);
+    connect(syncService, &SyncService::logMessage, logViewer, &QTextEdit::append);
+    connect(syncService, &SyncService::syncRequested, this, &ServerWindow::onSyncRequested);
+    connect(syncService, &SyncService::syncServed, this, &ServerWindow::onSyncServed);
+    syncService->setPayloadProvider([this](const QJsonObject &args, qint64 requestAtMs) {
+        // 班牌声明支持列式编码时按列下发，旧版班牌仍收到 JSON
+        bool columnar = args["accept"].toString() == "columnar";
+        SnapshotBuilder::Horizon horizon = calendarHorizon(args);
+        return columnar ? getScheduleColumnar(args, requestAtMs, horizon) : getScheduleJson(args, requestAtMs, horizon);
+    });
+    // 运维查询班牌状态：FLEET {"filter":"abnormal","limit":100}
+    syncService->addCommand("FLEET", [this](const QJsonObject &args) {
+        QJsonObject result = fleet.query(args, currentChangeId, currentChangeAtMs, QDateTime::currentMSecsSinceEpoch());
+        return QJsonDocument(result).toJson(QJsonDocument::Compact);
+    });
+    // 空闲教室：FREE_ROOMS {"weekday":1,"start":"08:00","end":"09:40","min_capacity":40,"building":"A栋"}
+    syncService->addCommand("FREE_ROOMS", [this](const QJsonObject &args) {
+        return QJsonDocument(occupancy.query(args)).toJson(QJsonDocument::Compact);
+    });
+    // 班牌签到批次：CHECKIN {"sign_id":"A-301","batch":12,"events":[{"card":"...","at_ms":...}]}，写入后以 CheckinAck 帧确认
+    syncService->addAsyncCommand("CHECKIN", [this](quint64 connection, const QJsonObject &args) {
+        onCheckinRequest(connection, args);
+    });
 
-    if (tcpServer->listen(QHostAddress::Any, 12345)) {
+    if (syncService->listen(QHostAddress::Any, 12345)) {
         logViewer->append("服务已启动，监听端口: 12345");
     } else {
-        logViewer->append("服务启动失败: " + tcpServer->errorString());
+        logViewer->append("服务启动失败: " + syncService->errorString());
     }
 }
 
 ServerWindow::~ServerWindow() {
+    // 先写完已接收的签到，之后不再有确认投递到界面线程
+    checkinIngest.stop();
+    if (timetableThread) {
+        timetableCancel = true;
+        timetableThread->wait();
+        delete timetableThread;
+    }
+    for (QThread *thread : {publishThread, servingThread}) {
+        if (thread) {
+            thread->wait();
+            delete thread;
+        }
+    }
     if(db.isOpen()) db.close();
 }
 
@@ -64,12 +148,13 @@ void ServerWindow::initDb() {
         return;
     }
 
-    // 创建表（如果不存在）
+    // WAL：发布新版本和重建下发数据在后台连接上进行，界面线程的读取不被写锁阻塞
     QSqlQuery query(db);
-    query.exec("CREATE TABLE IF NOT EXISTS master_schedules ("
-               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "room TEXT, course TEXT, teacher TEXT, time_slot TEXT, "
-               "start_time TEXT, end_time TEXT, weekday INTEGER, is_next INTEGER)");
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA busy_timeout = 5000");
+
+    // 创建表（如果不存在）
+    query.exec(Schema::sql<Schema::Schedules, Schema::Side::Server, Schema::Statement::Create>());
 
     // 检查并更新 classrooms 表结构
     query.exec("PRAGMA table_info(classrooms)");
@@ -93,9 +178,7 @@ void ServerWindow::initDb() {
             query.exec("ALTER TABLE classrooms RENAME TO classrooms_old");
             
             // 创建新表结构
-            query.exec("CREATE TABLE classrooms ("
-                       "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                       "room_name TEXT, class_name TEXT, capacity INTEGER, building TEXT, floor INTEGER, current_class TEXT)");
+            query.exec(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::Create>());
             
             // 从旧表复制数据到新表（跳过可能存在的 id 列）
             query.exec("INSERT INTO classrooms (room_name, class_name, capacity, building, floor, current_class) "
@@ -108,9 +191,7 @@ void ServerWindow::initDb() {
         }
     } else {
         // 如果表不存在，创建新表
-        query.exec("CREATE TABLE IF NOT EXISTS classrooms ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "room_name TEXT, class_name TEXT, capacity INTEGER, building TEXT, floor INTEGER, current_class TEXT)");
+        query.exec(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::Create>());
     }
 
     // 检查并更新 announcements 表结构
@@ -135,7 +216,7 @@ void ServerWindow::initDb() {
             query.exec("ALTER TABLE announcements RENAME TO announcements_old");
             
             // 创建新表结构
-            query.exec("CREATE TABLE announcements (id INTEGER PRIMARY KEY AUTOINCREMENT, title TEXT, content TEXT, priority INTEGER, publish_time TEXT, expire_time TEXT)");
+            query.exec(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::Create>());
             
             // 从旧表复制数据到新表（跳过可能存在的 id 列）
             query.exec("INSERT INTO announcements (title, content, priority, publish_time, expire_time) SELECT title, content, priority, publish_time, expire_time FROM announcements_old");
@@ -147,9 +228,19 @@ void ServerWindow::initDb() {
         }
     } else {
         // 如果表不存在，创建新表
-        query.exec("CREATE TABLE IF NOT EXISTS announcements (id INTEGER PRIMARY KEY AUTOINCREMENT, title TEXT, content TEXT, priority INTEGER, publish_time TEXT, expire_time TEXT)");
+        query.exec(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::Create>());
+    }
+
+    // 公告的投放范围（见 audienceindex.h）只在服务端使用，不是同步表结构的一部分
+    if (!query.exec("SELECT target FROM announcements LIMIT 0")) {
+        query.exec("ALTER TABLE announcements ADD COLUMN target TEXT DEFAULT ''");
     }
 
+    // 变更记录：每次管理端修改数据生成一个递增的变更编号，用于追踪传播到班牌的耗时
+    query.exec("CREATE TABLE IF NOT EXISTS change_log ("
+               "id INTEGER PRIMARY KEY AUTOINCREMENT, entity TEXT, committed_at_ms INTEGER)");
+    loadLatestChange();
+
     // 检查是否有数据，如果没有则自动初始化
     query.exec("SELECT COUNT(*) FROM master_schedules");
     int scheduleCount = 0;
@@ -183,6 +274,71 @@ void ServerWindow::initDb() {
         logViewer->append("服务端数据库已连接，课程表记录数: " + QString::number(scheduleCount) + ", 教室记录数: " + QString::number(classroomCount));
     }
     
+    // 空闲教室查询使用的占用位图，之后随课程和教室的增删改增量更新
+    QString occupancyError;
+    if (occupancy.rebuild(db, &occupancyError)) {
+        logViewer->append(QString("教室占用位图已建立: %1 间教室").arg(occupancy.roomCount()));
+        refreshFreeRoomBuildings();
+    } else {
+        logViewer->append(occupancyError);
+    }
+
+    // 公告受众索引：各班牌和中继的公告集合按教室查表得到，之后随公告和教室的增删改更新
+    QString audienceError;
+    if (audienceIndex.rebuild(db, &audienceError)) {
+        logViewer->append(QString("公告受众索引已建立: %1 条公告, %2 间教室")
+                              .arg(audienceIndex.announcementCount()).arg(audienceIndex.roomCount()));
+    } else {
+        logViewer->append(audienceError);
+    }
+
+    // 校历规则读入内存，课程按日期展开；之后只重算变化的课程或日期
+    QString calendarError;
+    if (CalendarEngine::ensureSchema(db, &calendarError) && calendar.rebuild(db, QDate::currentDate(), &calendarError)) {
+        if (calendar.isActive()) {
+            logViewer->append(QString("校历已展开: %1 至 %2")
+                                  .arg(calendar.materializedFrom().toString(Qt::ISODate),
+                                       calendar.materializedTo().toString(Qt::ISODate)));
+        }
+        refreshCalendarPage();
+    } else {
+        logViewer->append(calendarError);
+    }
+    // 冲突检测要读取校历的上课周设置，在校历建表之后进行
+    revalidateConflicts();
+
+    // 课程表版本：草稿单独编辑，发布时整体替换线上课程
+    QString versionError;
+    if (!TimetableVersions::ensureSchema(db, &versionError)) {
+        logViewer->append(versionError);
+    }
+    refreshVersionPage();
+
+    // 签到写入管道：独立的写线程和数据库连接，提交完成后回到界面线程确认各批次
+    QString checkinError;
+    auto onCommitted = [this](const QVector<CheckinIngest::Receipt> &receipts) {
+        QMetaObject::invokeMethod(this, [this, receipts]() { onCheckinsCommitted(receipts); }, Qt::QueuedConnection);
+    };
+    if (CheckinIngest::ensureSchema(db, &checkinError)
+        && checkinIngest.start(db.databaseName(), onCommitted, CheckinIngest::Options(), &checkinError)) {
+        logViewer->append("签到写入管道已启动");
+    } else {
+        logViewer->append(checkinError);
+    }
+
+    // 尚未生效或过期的公告登记到时间轮，到时推送新的有效公告集合
+    loadAnnouncementTimers();
+
+    // 首份下发数据在开始监听前同步生成，之后每次变更在后台重建
+    auto snapshot = std::make_shared<SnapshotBuilder::Prebuilt>();
+    QString snapshotError;
+    if (SnapshotBuilder::prebuild(db, *snapshot, &snapshotError)) {
+        serving = snapshot;
+        audienceSlices.clear();
+    } else {
+        logViewer->append(snapshotError);
+    }
+
     // 确保界面刷新显示最新数据
     if(classroomCount > 0) {
         populateClassroomsTable();
@@ -237,6 +393,15 @@ void ServerWindow::setupUi() {
     setupManagementUi();
     managementLayout->addWidget(managementTabs);
     dataTabWidget->addTab(managementPage, "数据管理");
+
+    // 空闲教室查询页
+    dataTabWidget->addTab(setupFreeRoomPage(), "空闲教室");
+
+    // 班牌状态页
+    dataTabWidget->addTab(setupFleetPage(), "班牌状态");
+
+    // 实时出勤页
+    dataTabWidget->addTab(setupAttendancePage(), "实时出勤");
     
     // 刷新按钮
     refreshButton = new QPushButton("刷新数据");
@@ -252,6 +417,7 @@ void ServerWindow::setupUi() {
     weekDayFilterCombo->addItem("星期日", 7);
     
     statusLabel = new QLabel("就绪");
+    propagationLabel = new QLabel("变更传播: 暂无数据");
     
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     buttonLayout->addWidget(new QLabel("筛选:"));
@@ -260,6 +426,7 @@ void ServerWindow::setupUi() {
     buttonLayout->addWidget(clearFilterButton);
     buttonLayout->addWidget(statusLabel);
     buttonLayout->addStretch();
+    buttonLayout->addWidget(propagationLabel);
     
     connect(refreshButton, &QPushButton::clicked, this, &ServerWindow::refreshData);
     connect(clearFilterButton, &QPushButton::clicked, this, [=]() {
@@ -274,6 +441,257 @@ void ServerWindow::setupUi() {
     mainLayout->addWidget(logViewer);
 }
 
+QWidget *ServerWindow::setupFreeRoomPage() {
+    QWidget *freeRoomPage = new QWidget();
+    QVBoxLayout *freeRoomLayout = new QVBoxLayout(freeRoomPage);
+
+    freeWeekdayCombo = new QComboBox();
+    const char *weekdayNames[] = {"星期一", "星期二", "星期三", "星期四", "星期五", "星期六", "星期日"};
+    for (int i = 0; i < 7; ++i) {
+        freeWeekdayCombo->addItem(weekdayNames[i], i + 1);
+    }
+    freeWeekdayCombo->setCurrentIndex(QDate::currentDate().dayOfWeek() - 1);
+
+    freeStartEdit = new QTimeEdit(QTime(8, 0));
+    freeEndEdit = new QTimeEdit(QTime(9, 40));
+    freeStartEdit->setDisplayFormat("HH:mm");
+    freeEndEdit->setDisplayFormat("HH:mm");
+
+    freeCapacitySpinBox = new QSpinBox();
+    freeCapacitySpinBox->setRange(0, 10000);
+
+    freeBuildingCombo = new QComboBox();
+    freeBuildingCombo->addItem("全部");
+
+    freeFloorSpinBox = new QSpinBox();
+    freeFloorSpinBox->setRange(-1, 200);
+    freeFloorSpinBox->setValue(-1);
+    freeFloorSpinBox->setSpecialValueText("不限");
+
+    QPushButton *findButton = new QPushButton("查询");
+    freeRoomStatusLabel = new QLabel();
+
+    QHBoxLayout *conditionLayout = new QHBoxLayout();
+    conditionLayout->addWidget(freeWeekdayCombo);
+    conditionLayout->addWidget(freeStartEdit);
+    conditionLayout->addWidget(new QLabel("至"));
+    conditionLayout->addWidget(freeEndEdit);
+    conditionLayout->addWidget(new QLabel("容量不少于:"));
+    conditionLayout->addWidget(freeCapacitySpinBox);
+    conditionLayout->addWidget(new QLabel("楼栋:"));
+    conditionLayout->addWidget(freeBuildingCombo);
+    conditionLayout->addWidget(new QLabel("楼层:"));
+    conditionLayout->addWidget(freeFloorSpinBox);
+    conditionLayout->addWidget(findButton);
+    conditionLayout->addStretch();
+    conditionLayout->addWidget(freeRoomStatusLabel);
+
+    freeRoomTable = new QTableWidget(0, 4);
+    freeRoomTable->setHorizontalHeaderLabels({"教室", "容量", "楼栋", "楼层"});
+    freeRoomTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    freeRoomTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    freeRoomTable->horizontalHeader()->setStretchLastSection(true);
+
+    freeRoomLayout->addLayout(conditionLayout);
+    freeRoomLayout->addWidget(freeRoomTable);
+
+    connect(findButton, &QPushButton::clicked, this, &ServerWindow::findFreeRooms);
+    return freeRoomPage;
+}
+
+void ServerWindow::refreshFreeRoomBuildings() {
+    QString building = freeBuildingCombo->currentIndex() > 0 ? freeBuildingCombo->currentText() : QString();
+    freeBuildingCombo->blockSignals(true);
+    freeBuildingCombo->clear();
+    freeBuildingCombo->addItem("全部");
+    freeBuildingCombo->addItems(occupancy.buildings());
+    freeBuildingCombo->setCurrentIndex(qMax(0, freeBuildingCombo->findText(building)));
+    freeBuildingCombo->blockSignals(false);
+}
+
+void ServerWindow::findFreeRooms() {
+
+    OccupancyIndex::Interval interval;
+    interval.weekday = freeWeekdayCombo->currentData().toInt();
+    interval.startMinute = freeStartEdit->time().msecsSinceStartOfDay() / 60000;
+    interval.endMinute = freeEndEdit->time().msecsSinceStartOfDay() / 60000;
+    if (interval.endMinute <= interval.startMinute) {
+        freeRoomStatusLabel->setText("结束时间需晚于开始时间");
+        return;
+    }
+
+    OccupancyIndex::Query request;
+    request.intervals.append(interval);
+    request.minCapacity = freeCapacitySpinBox->value();
+    request.building = freeBuildingCombo->currentIndex() > 0 ? freeBuildingCombo->currentText() : QString();
+    request.floor = freeFloorSpinBox->value();
+
+    QElapsedTimer clock;
+    clock.start();
+    QVector<OccupancyIndex::Room> rooms = occupancy.findFree(request);
+    qint64 elapsedUs = clock.nsecsElapsed() / 1000;
+
+    freeRoomTable->setRowCount(rooms.size());
+    for (int i = 0; i < rooms.size(); ++i) {
+        const OccupancyIndex::Room &room = rooms[i];
+        freeRoomTable->setItem(i, 0, new QTableWidgetItem(room.name));
+        freeRoomTable->setItem(i, 1, new QTableWidgetItem(QString::number(room.capacity)));
+        freeRoomTable->setItem(i, 2, new QTableWidgetItem(room.building));
+        freeRoomTable->setItem(i, 3, new QTableWidgetItem(QString::number(room.floor)));
+    }
+    freeRoomStatusLabel->setText(QString("空闲 %1 间 / 共 %2 间，用时 %3 μs")
+                                 .arg(rooms.size()).arg(occupancy.roomCount()).arg(elapsedUs));
+}
+
+QWidget *ServerWindow::setupFleetPage() {
+    // 超过两个最长轮询间隔没有请求才算离线，避免负载高时被拉长间隔的班牌误报
+    FleetRegistry::Thresholds thresholds;
+    thresholds.offlineAfterMs = 2LL * pollAdvisor.policy().maxIntervalMs;
+    fleet.setThresholds(thresholds);
+
+    QWidget *fleetPage = new QWidget();
+    QVBoxLayout *fleetLayout = new QVBoxLayout(fleetPage);
+
+    fleetFilterCombo = new QComboBox();
+    fleetFilterCombo->addItem("全部", int(FleetFilterProxyModel::AllSigns));
+    fleetFilterCombo->addItem("异常", int(FleetFilterProxyModel::AbnormalSigns));
+    fleetFilterCombo->addItem("离线", int(FleetRegistry::Health::Offline));
+    fleetFilterCombo->addItem("数据滞后", int(FleetRegistry::Health::Lagging));
+    fleetFilterCombo->addItem("同步缓慢", int(FleetRegistry::Health::Slow));
+    fleetSummaryLabel = new QLabel("暂无班牌连接");
+
+    QHBoxLayout *fleetBar = new QHBoxLayout();
+    fleetBar->addWidget(new QLabel("显示:"));
+    fleetBar->addWidget(fleetFilterCombo);
+    fleetBar->addStretch();
+    fleetBar->addWidget(fleetSummaryLabel);
+
+    fleetModel = new FleetModel(&fleet, this);
+    fleetProxy = new FleetFilterProxyModel(this);
+    fleetProxy->setSourceModel(fleetModel);
+
+    fleetView = new QTableView();
+    fleetView->setModel(fleetProxy);
+    fleetView->setSortingEnabled(true);
+    fleetView->sortByColumn(FleetModel::HealthColumn, Qt::DescendingOrder);
+    fleetView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    fleetView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    fleetView->verticalHeader()->setVisible(false);
+    // 固定行高，视图无需逐行测量，只绘制可见行
+    fleetView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    fleetView->verticalHeader()->setDefaultSectionSize(22);
+    fleetView->horizontalHeader()->setStretchLastSection(true);
+
+    fleetLayout->addLayout(fleetBar);
+    fleetLayout->addWidget(fleetView);
+
+    connect(fleetFilterCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+        fleetProxy->setHealthFilter(fleetFilterCombo->currentData().toInt());
+    });
+
+    fleetRefreshTimer = new QTimer(this);
+    connect(fleetRefreshTimer, &QTimer::timeout, this, &ServerWindow::refreshFleetView);
+    fleetRefreshTimer->start(1000);
+
+    return fleetPage;
+}
+
+void ServerWindow::refreshFleetView() {
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    fleetModel->setCurrentChange(currentChangeId, currentChangeAtMs);
+    fleetModel->refreshTimes();
+
+    if (fleet.size() == 0) {
+        return;
+    }
+    FleetRegistry::Summary summary = fleet.summarize(currentChangeId, currentChangeAtMs, nowMs);
+    fleetSummaryLabel->setText(QString("班牌 %1 台: 正常 %2  滞后 %3  缓慢 %4  离线 %5")
+                               .arg(summary.total).arg(summary.ok).arg(summary.lagging)
+                               .arg(summary.slow).arg(summary.offline));
+}
+
+QWidget *ServerWindow::setupAttendancePage() {
+    QWidget *attendancePage = new QWidget();
+    QVBoxLayout *attendanceLayout = new QVBoxLayout(attendancePage);
+
+    attendanceSummaryLabel = new QLabel("暂无签到");
+
+    attendanceBuildingTable = new QTableWidget(0, 5);
+    attendanceBuildingTable->setHorizontalHeaderLabels({"楼栋", "上课教室", "已签到", "容量", "出勤率"});
+    attendanceBuildingTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    attendanceBuildingTable->verticalHeader()->setVisible(false);
+    attendanceBuildingTable->horizontalHeader()->setStretchLastSection(true);
+    attendanceBuildingTable->setMaximumHeight(180);
+
+    // 行按教室固定，每秒只改写有变化的教室
+    attendanceRoomTable = new QTableWidget(0, 7);
+    attendanceRoomTable->setHorizontalHeaderLabels({"教室", "楼栋", "当前课程", "时间", "已签到", "容量", "出勤率"});
+    attendanceRoomTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    attendanceRoomTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    attendanceRoomTable->verticalHeader()->setVisible(false);
+    attendanceRoomTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    attendanceRoomTable->verticalHeader()->setDefaultSectionSize(22);
+    attendanceRoomTable->horizontalHeader()->setStretchLastSection(true);
+
+    attendanceLayout->addWidget(attendanceSummaryLabel);
+    attendanceLayout->addWidget(attendanceBuildingTable);
+    attendanceLayout->addWidget(attendanceRoomTable);
+    return attendancePage;
+}
+
+// 出勤率按当前节次的教室容量计算，容量未填写时不显示
+static QString attendanceRate(int present, int capacity) {
+    return capacity > 0 ? QString::number(100.0 * present / capacity, 'f', 1) + "%" : QString("--");
+}
+
+void ServerWindow::showAttendanceRoom(const AttendanceTracker::RoomView &view) {
+    auto it = attendanceRows.find(view.room);
+    if (it == attendanceRows.end()) {
+        int row = attendanceRoomTable->rowCount();
+        attendanceRoomTable->insertRow(row);
+        for (int column = 0; column < attendanceRoomTable->columnCount(); ++column) {
+            attendanceRoomTable->setItem(row, column, new QTableWidgetItem());
+        }
+        it = attendanceRows.insert(view.room, row);
+    }
+
+    const int row = it.value();
+    const bool inSession = !view.course.isEmpty();
+    QString time;
+    if (inSession) {
+        time = QDateTime::fromMSecsSinceEpoch(view.startMs).toString("HH:mm") + " - "
+            + QDateTime::fromMSecsSinceEpoch(view.endMs).toString("HH:mm");
+    }
+    attendanceRoomTable->item(row, 0)->setText(view.room);
+    attendanceRoomTable->item(row, 1)->setText(view.building);
+    attendanceRoomTable->item(row, 2)->setText(inSession ? view.course : QString("--"));
+    attendanceRoomTable->item(row, 3)->setText(time);
+    attendanceRoomTable->item(row, 4)->setText(inSession ? QString::number(view.present) : QString());
+    attendanceRoomTable->item(row, 5)->setText(QString::number(view.capacity));
+    attendanceRoomTable->item(row, 6)->setText(inSession ? attendanceRate(view.present, view.capacity) : QString());
+}
+
+void ServerWindow::refreshAttendanceBuildings() {
+    const QVector<AttendanceTracker::BuildingView> buildings = attendance.buildingViews();
+    attendanceBuildingTable->setRowCount(buildings.size());
+    int present = 0;
+    int activeRooms = 0;
+    int activeCapacity = 0;
+    for (int i = 0; i < buildings.size(); ++i) {
+        const AttendanceTracker::BuildingView &building = buildings[i];
+        attendanceBuildingTable->setItem(i, 0, new QTableWidgetItem(building.building.isEmpty() ? "(未填写)" : building.building));
+        attendanceBuildingTable->setItem(i, 1, new QTableWidgetItem(QString("%1 / %2").arg(building.activeRooms).arg(building.rooms)));
+        attendanceBuildingTable->setItem(i, 2, new QTableWidgetItem(QString::number(building.present)));
+        attendanceBuildingTable->setItem(i, 3, new QTableWidgetItem(QString::number(building.activeCapacity)));
+        attendanceBuildingTable->setItem(i, 4, new QTableWidgetItem(attendanceRate(building.present, building.activeCapacity)));
+        present += building.present;
+        activeRooms += building.activeRooms;
+        activeCapacity += building.activeCapacity;
+    }
+    attendanceSummaryLabel->setText(QString("全校 %1 间教室上课，已签到 %2 人，出勤率 %3")
+                                    .arg(activeRooms).arg(present).arg(attendanceRate(present, activeCapacity)));
+}
+
 void ServerWindow::initSampleData() {
     QSqlQuery query(db);
     
@@ -522,6 +940,13 @@ void ServerWindow::updateCurrentClasses() {
     QTime currentTime = QTime::currentTime();
     QDate currentDate = QDate::currentDate();
     int currentWeekday = currentDate.dayOfWeek(); // 1=Monday, 7=Sunday
+
+    // 日期向前推进时补上新进入范围的日期
+    QString calendarError;
+    if (!calendar.ensureRange(db, currentDate.addDays(-CalendarEngine::kKeepPastDays),
+                              currentDate.addDays(CalendarEngine::kMaxHorizonDays), &calendarError)) {
+        logViewer->append(calendarError);
+    }
     
     QSqlQuery query(db);
     QString sql = QString(
@@ -529,6 +954,14 @@ void ServerWindow::updateCurrentClasses() {
         "time(start_time) <= time('%2') AND time(end_time) >= time('%2')")
         .arg(currentWeekday)
         .arg(currentTime.toString("hh:mm:ss"));
+    if (calendar.isActive()) {
+        // 校历启用后以当天展开的课程为准（放假没有课，调课日按替换的课表）
+        sql = QString(
+            "SELECT room, course, teacher FROM occurrence_view WHERE date = '%1' AND "
+            "time(start_time) <= time('%2') AND time(end_time) >= time('%2')")
+            .arg(currentDate.toString(Qt::ISODate))
+            .arg(currentTime.toString("hh:mm:ss"));
+    }
     
     if (query.exec(sql)) {
         while (query.next()) {
@@ -547,6 +980,8 @@ void ServerWindow::updateCurrentClasses() {
             logViewer->append(QString("教室 %1 正在上课: %2").arg(roomName, courseName));
         }
     }
+    // 当前班级不经过变更记录，下发数据仍需随之更新
+    rebuildServingSnapshot();
 }
 
 void ServerWindow::refreshData() {
@@ -562,10 +997,74 @@ void ServerWindow::refreshData() {
     populateSchedulesTable();
     populateClassroomsTable();
     populateAnnouncementsTable();
+    rebuildBoundaryCache();
     
     statusLabel->setText("数据刷新完成");
 }
 
+void ServerWindow::rebuildBoundaryCache() {
+    todayBoundaries.clear();
+    boundaryWeekday = QDate::currentDate().dayOfWeek();
+
+    for (TimerWheel::TimerId id : boundaryTimers) {
+        timerWheel.cancel(id);
+    }
+    boundaryTimers.clear();
+    const QDate today = QDate::currentDate();
+    boundaryTimers.append(timerWheel.schedule(today.addDays(1).startOfDay().toMSecsSinceEpoch(), DayRollover, 0));
+
+    QSqlQuery query(db);
+    if (calendar.isActive()) {
+        query.prepare("SELECT start_time, end_time FROM occurrence_view WHERE date = ?");
+        query.addBindValue(QDate::currentDate().toString(Qt::ISODate));
+    } else {
+        query.prepare("SELECT start_time, end_time FROM master_schedules WHERE weekday = ?");
+        query.addBindValue(boundaryWeekday);
+    }
+    if (!query.exec()) {
+        logViewer->append("查询上下课时刻失败: " + query.lastError().text());
+        return;
+    }
+
+    while (query.next()) {
+        for (int column = 0; column < 2; ++column) {
+            QString text = query.value(column).toString();
+            QTime time = QTime::fromString(text, "HH:mm");
+            if (!time.isValid()) {
+                time = QTime::fromString(text, "HH:mm:ss");
+            }
+            if (time.isValid()) {
+                todayBoundaries.append(time.msecsSinceStartOfDay());
+            }
+        }
+    }
+
+    std::sort(todayBoundaries.begin(), todayBoundaries.end());
+    todayBoundaries.erase(std::unique(todayBoundaries.begin(), todayBoundaries.end()), todayBoundaries.end());
+
+    // 下课时刻当秒仍算在上课（end_time >= 当前时间），因此各时刻都在下一秒触发
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    for (int boundary : todayBoundaries) {
+        qint64 atMs = QDateTime(today, QTime::fromMSecsSinceStartOfDay(boundary)).toMSecsSinceEpoch() + 1000;
+        if (atMs > nowMs) {
+            boundaryTimers.append(timerWheel.schedule(atMs, ClassBoundary, boundary));
+        }
+    }
+}
+
+qint64 ServerWindow::msToNextBoundary() {
+    if (boundaryWeekday != QDate::currentDate().dayOfWeek()) {
+        rebuildBoundaryCache();
+    }
+
+    int nowMsecs = QTime::currentTime().msecsSinceStartOfDay();
+    auto it = std::upper_bound(todayBoundaries.cbegin(), todayBoundaries.cend(), nowMsecs);
+    if (it == todayBoundaries.cend()) {
+        return -1;
+    }
+    return *it - nowMsecs;
+}
+
 void ServerWindow::populateSchedulesTable() {
     // 默认显示全部数据
     weekDayFilterCombo->setCurrentIndex(0); // 选择“全部”
@@ -574,7 +1073,7 @@ void ServerWindow::populateSchedulesTable() {
 
 void ServerWindow::populateClassroomsTable() {
     QSqlQuery query(db);
-    if (!query.exec("SELECT room_name, class_name, capacity, building, floor, current_class FROM classrooms ORDER BY room_name")) {
+    if (!query.exec(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::Select>() + " ORDER BY room_name")) {
         logViewer->append("查询教室信息失败: " + query.lastError().text());
         return;
     }
@@ -609,7 +1108,7 @@ void ServerWindow::populateClassroomsTable() {
 
 void ServerWindow::populateAnnouncementsTable() {
     QSqlQuery query(db);
-    if (!query.exec("SELECT title, content, priority, publish_time, expire_time FROM announcements ORDER BY priority DESC, publish_time DESC")) {
+    if (!query.exec(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::Select>() + " ORDER BY priority DESC, publish_time DESC")) {
         logViewer->append("查询公告失败: " + query.lastError().text());
         return;
     }
@@ -717,142 +1216,89 @@ void ServerWindow::filterSchedulesByWeekday() {
     }
 }
 
-void ServerWindow::onNewConnection() {
-    QTcpSocket *clientSocket = tcpServer->nextPendingConnection();
-    connect(clientSocket, &QTcpSocket::readyRead, this, &ServerWindow::onReadClientData);
-    connect(clientSocket, &QTcpSocket::disconnected, this, &ServerWindow::onClientDisconnected);
-    connect(clientSocket, &QTcpSocket::disconnected, clientSocket, &QTcpSocket::deleteLater);
+void ServerWindow::onSyncRequested(const QJsonObject &args, qint64 requestAtMs) {
+    // 班牌在请求中附带上一次变更的各阶段耗时
+    if (args.contains("report")) {
+        recordPropagation(args["sign_id"].toString(), args["report"].toObject());
+    }
+    // 楼宇中继把所辖班牌的上报汇总后一起转发
+    const QJsonArray reports = args["reports"].toArray();
+    for (const QJsonValue &value : reports) {
+        QJsonObject entry = value.toObject();
+        recordPropagation(entry["sign_id"].toString(), entry["report"].toObject());
+    }
+    if (args.contains("relay")) {
+        logViewer->append(QString("中继 %1 (%2) 拉取数据，转发上报 %3 条")
+                          .arg(args["sign_id"].toString(), args["relay"].toString()).arg(reports.size()));
+    }
 
-    // 将socket存储起来，便于后续管理和清理
-    clientSockets.insert(clientSocket);
-    
-    logViewer->append("客户端已连接: " + clientSocket->peerAddress().toString());
+    pollAdvisor.recordRequest(requestAtMs);
 }
 
-void ServerWindow::onReadClientData() {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) return;
+void ServerWindow::onSyncServed(const QJsonObject &args, const QString &peer, qint64 bytes) {
+    fleetModel->rowUpdated(fleet.observe(args, peer, bytes, QDateTime::currentMSecsSinceEpoch()));
 
-    // 检查是否有数据可读
-    if (socket->bytesAvailable() == 0) {
-        return; // 如果没有数据可读，则直接返回
+    // 中继下的班牌不直接连接服务器，状态由中继随请求汇总转发
+    const QJsonArray signs = args["signs"].toArray();
+    QString relayId = args["sign_id"].toString();
+    for (const QJsonValue &value : signs) {
+        fleetModel->rowUpdated(fleet.observeRelayed(value.toObject(), relayId));
     }
-    
-    // 读取数据
-    QByteArray requestData = socket->readAll();
-    QString requestStr = QString::fromUtf8(requestData);
-    logViewer->append("收到请求: " + requestStr);
-    
-    // 验证请求内容，只有特定请求才返回数据
-    if (requestStr.trimmed().isEmpty() || requestStr.contains("GET_SCHEDULE", Qt::CaseInsensitive) || requestStr.contains("SYNC", Qt::CaseInsensitive)) {
-        logViewer->append("正在准备发送数据...");
-
-        QByteArray responseData = getScheduleJson();
-
-        logViewer->append("数据大小: " + QString::number(responseData.size()) + " 字节");
-
-        // 先发送数据大小（4字节，大端序），再发送实际数据
-        QByteArray sizeData;
-        QDataStream ds(&sizeData, QIODevice::WriteOnly);
-        ds.setByteOrder(QDataStream::BigEndian);
-        ds << static_cast<quint32>(responseData.size());
-
-        // 发送数据大小信息
-        qint64 sizeBytesWritten = socket->write(sizeData);
-        if (sizeBytesWritten != 4) {
-            logViewer->append("发送数据大小信息失败");
-            return;
-        }
-
-        // 发送实际数据
-        qint64 dataBytesWritten = socket->write(responseData);
-        if (dataBytesWritten != responseData.size()) {
-            logViewer->append("发送数据失败，期望发送" + QString::number(responseData.size()) + "字节，实际发送" + QString::number(dataBytesWritten) + "字节");
-            return;
-        }
-        
-        socket->flush();
 
-        qint64 totalBytesWritten = sizeBytesWritten + dataBytesWritten;
-        logViewer->append("已写入 " + QString::number(totalBytesWritten) + " 字节");
-
-        if (socket->waitForBytesWritten(5000)) {
-            logViewer->append("数据已完全发送，等待客户端断开连接...");
-        } else {
-            logViewer->append("数据发送超时");
+    // 新订阅的分道连接在下一次整秒收到当前的出勤人数，不必等到有人签到
+    if (args["lanes"].toBool()) {
+        AudienceIndex::Audience audience = AudienceIndex::Audience::fromArgs(args);
+        switch (audience.kind) {
+        case AudienceIndex::Audience::Room:
+            attendance.markDirty(audience.name);
+            break;
+        case AudienceIndex::Audience::Building:
+            attendance.markBuildingDirty(audience.name);
+            break;
+        case AudienceIndex::Audience::Everyone:
+            attendance.markAllDirty();
+            break;
         }
-    } else {
-        logViewer->append("无效请求: " + requestStr + ", 拒绝发送数据");
-        // 对无效请求立即断开连接以防止滥用
-        socket->disconnectFromHost();
     }
 }
 
-QByteArray ServerWindow::getScheduleJson() {
-    if(!db.isOpen()) {
-        logViewer->append("数据库未打开，无法获取数据");
+SnapshotBuilder::Horizon ServerWindow::calendarHorizon(const QJsonObject &args) {
+    SnapshotBuilder::Horizon horizon;
+    if (!args.contains("horizon_days")) {
+        return horizon;
+    }
+    // 校历未启用时下发空表，班牌按星期显示
+    horizon.from = QDate::currentDate();
+    horizon.days = calendar.isActive() ? qBound(1, args["horizon_days"].toInt(), CalendarEngine::kMaxHorizonDays) : 0;
+    return horizon;
+}
+
+QByteArray ServerWindow::getScheduleJson(const QJsonObject &args, qint64 requestAtMs,
+                                         const SnapshotBuilder::Horizon &horizon) {
+    // 持有当前数据的引用：发布新版本只替换指针，不影响正在生成的响应
+    std::shared_ptr<const SnapshotBuilder::Prebuilt> snapshot = servingSnapshot();
+    if (!snapshot) {
+        logViewer->append("下发数据尚未生成，无法响应");
         return QJsonDocument(QJsonObject()).toJson();
     }
-    
-    QJsonObject rootObj;
 
-    QJsonArray schedulesArray;
-    QSqlQuery schedulesQuery(db);
-    if (!schedulesQuery.exec("SELECT room, course, teacher, time_slot, start_time, end_time, weekday, is_next FROM master_schedules")) {
-        logViewer->append("查询课程表失败: " + schedulesQuery.lastError().text());
-        return QJsonDocument(QJsonObject()).toJson(); // 返回空JSON
-    }
-    while (schedulesQuery.next()) {
-        QJsonObject obj;
-        obj["room_name"] = schedulesQuery.value(0).toString();
-        obj["course_name"] = schedulesQuery.value(1).toString();
-        obj["teacher"] = schedulesQuery.value(2).toString();
-        obj["time_slot"] = schedulesQuery.value(3).toString();
-        obj["start_time"] = schedulesQuery.value(4).toString();
-        obj["end_time"] = schedulesQuery.value(5).toString();
-        obj["weekday"] = schedulesQuery.value(6).toInt();
-        obj["is_next"] = schedulesQuery.value(7).toInt();
-        schedulesArray.append(obj);
-    }
-    logViewer->append("课程表记录数: " + QString::number(schedulesArray.size()));
-    rootObj["schedules"] = schedulesArray;
-
-    QJsonArray classroomsArray;
-    QSqlQuery classroomsQuery(db);
-    if (!classroomsQuery.exec("SELECT room_name, class_name, capacity, building, floor, current_class FROM classrooms")) {
-        logViewer->append("查询教室信息失败: " + classroomsQuery.lastError().text());
-        return QJsonDocument(QJsonObject()).toJson(); // 返回空JSON
-    }
-    while (classroomsQuery.next()) {
-        QJsonObject obj;
-        obj["room_name"] = classroomsQuery.value(0).toString();
-        obj["class_name"] = classroomsQuery.value(1).toString();
-        obj["capacity"] = classroomsQuery.value(2).toInt();
-        obj["building"] = classroomsQuery.value(3).toString();
-        obj["floor"] = classroomsQuery.value(4).toInt();
-        obj["current_class"] = classroomsQuery.value(5).toString();
-        classroomsArray.append(obj);
-    }
-    logViewer->append("教室信息记录数: " + QString::number(classroomsArray.size()));
-    rootObj["classrooms"] = classroomsArray;
-
-    QJsonArray announcementsArray;
-    QSqlQuery announcementsQuery(db);
-    if (!announcementsQuery.exec("SELECT title, content, priority, publish_time, expire_time FROM announcements")) {
-        logViewer->append("查询公告失败: " + announcementsQuery.lastError().text());
+    // 三张基础表与快照隐式共享，不逐行复制；公告换成该班牌或中继适用的部分，校历按请求的范围读取
+    QJsonObject rootObj = snapshot->tables;
+    const AudienceSlice &slice = audienceSlice(*snapshot, AudienceIndex::Audience::fromArgs(args));
+    rootObj["announcements"] = slice.announcements;
+    QString error;
+    if (!SnapshotBuilder::buildCalendar(db, horizon, rootObj, &error)) {
+        logViewer->append(error);
         return QJsonDocument(QJsonObject()).toJson(); // 返回空JSON
     }
-    while (announcementsQuery.next()) {
-        QJsonObject obj;
-        obj["title"] = announcementsQuery.value(0).toString();
-        obj["content"] = announcementsQuery.value(1).toString();
-        obj["priority"] = announcementsQuery.value(2).toInt();
-        obj["publish_time"] = announcementsQuery.value(3).toString();
-        obj["expire_time"] = announcementsQuery.value(4).toString();
-        announcementsArray.append(obj);
+    logViewer->append("课程表记录数: " + QString::number(snapshot->schedules));
+    logViewer->append("教室信息记录数: " + QString::number(snapshot->classrooms));
+    logViewer->append(QString("公告记录数: %1（有效 %2）").arg(slice.announcements.size()).arg(snapshot->announcements));
+
+    QJsonObject meta = syncMeta(requestAtMs, *snapshot);
+    for (auto it = meta.constBegin(); it != meta.constEnd(); ++it) {
+        rootObj.insert(it.key(), it.value());
     }
-    logViewer->append("公告记录数: " + QString::number(announcementsArray.size()));
-    rootObj["announcements"] = announcementsArray;
 
     QJsonDocument doc(rootObj);
     QByteArray jsonData = doc.toJson();
@@ -861,110 +1307,621 @@ QByteArray ServerWindow::getScheduleJson() {
     return jsonData;
 }
 
-void ServerWindow::onClientDisconnected() {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (socket && clientSockets.contains(socket)) {
-        clientSockets.remove(socket);
-        logViewer->append("客户端已断开连接: " + socket->peerAddress().toString());
+QByteArray ServerWindow::getScheduleColumnar(const QJsonObject &args, qint64 requestAtMs,
+                                             const SnapshotBuilder::Horizon &horizon) {
+    std::shared_ptr<const SnapshotBuilder::Prebuilt> snapshot = servingSnapshot();
+    if (!snapshot) {
+        logViewer->append("下发数据尚未生成，无法响应");
+        return QJsonDocument(QJsonObject()).toJson();
     }
+
+    QByteArray calendarTables;
+    QString error;
+    if (!SnapshotBuilder::buildCalendarColumnar(db, horizon, calendarTables, &error)) {
+        logViewer->append(error);
+        return QJsonDocument(QJsonObject()).toJson(); // 返回空JSON，班牌按旧格式处理
+    }
+    // 已编码的表直接拼接在头部之后，公告取该受众已编码的部分
+    const AudienceSlice &slice = audienceSlice(*snapshot, AudienceIndex::Audience::fromArgs(args));
+    int tableCount = horizon.days >= 0 ? Columnar::TableCount : Columnar::kBaseTableCount;
+    return Columnar::beginPayload(syncMeta(requestAtMs, *snapshot), tableCount) + snapshot->columnarTables
+        + slice.columnar + calendarTables;
 }
 
-// CRUD 操作实现
-bool ServerWindow::addCourse(const QString& room, const QString& course, const QString& teacher,
-                             const QString& timeSlot, const QString& startTime, const QString& endTime,
-                             int weekday, int isNext) {
+QJsonObject ServerWindow::syncMeta(qint64 requestAtMs, const SnapshotBuilder::Prebuilt &snapshot) {
+    QJsonObject meta;
+
+    // 数据版本取自下发数据本身：后台重建尚未完成时，班牌拿到的仍是上一个编号，之后会再次拉取
+    QJsonObject versionObj;
+    versionObj["change_id"] = snapshot.changeId;
+    versionObj["committed_at_ms"] = snapshot.committedAtMs;
+    versionObj["request_at_ms"] = requestAtMs;
+    meta["version"] = versionObj;
+
+    // 建议班牌下次轮询的间隔，班牌在此基础上加随机抖动
+    meta["next_poll_ms"] = pollAdvisor.advise(QDateTime::currentMSecsSinceEpoch(), msToNextBoundary());
+    return meta;
+}
+
+void ServerWindow::rebuildServingSnapshot() {
     if (!db.isOpen()) {
-        logViewer->append("数据库未打开，无法添加课程");
-        return false;
+        return;
     }
-    
-    // 验证必要字段不为空
-    if (room.isEmpty() || course.isEmpty() || teacher.isEmpty()) {
-        logViewer->append("教室、课程和教师不能为空");
-        return false;
+    if (servingThread) {
+        servingDirty = true;
+        return;
     }
-    
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO master_schedules (room, course, teacher, time_slot, start_time, end_time, weekday, is_next) "
-               "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
-    query.addBindValue(room);
-    query.addBindValue(course);
-    query.addBindValue(teacher);
-    query.addBindValue(timeSlot);
-    query.addBindValue(startTime);
-    query.addBindValue(endTime);
-    query.addBindValue(weekday);
-    query.addBindValue(isNext);
-    
-    if (!query.exec()) {
-        logViewer->append("添加课程失败: " + query.lastError().text());
-        return false;
+    servingDirty = false;
+
+    auto snapshot = std::make_shared<SnapshotBuilder::Prebuilt>();
+    auto error = std::make_shared<QString>();
+    servingThread = QThread::create([snapshot, error]() {
+        withWorkerConnection("ServingBuilder", error.get(), [&](QSqlDatabase worker) {
+            return SnapshotBuilder::prebuild(worker, *snapshot, error.get());
+        });
+    });
+    connect(servingThread, &QThread::finished, this, [this, snapshot, error]() {
+        servingThread->deleteLater();
+        servingThread = nullptr;
+        if (error->isEmpty()) {
+            adoptServingSnapshot(snapshot);
+        } else {
+            logViewer->append(*error);
+        }
+        if (servingDirty) {
+            rebuildServingSnapshot();
+        }
+    });
+    servingThread->start();
+}
+
+void ServerWindow::adoptServingSnapshot(std::shared_ptr<const SnapshotBuilder::Prebuilt> snapshot) {
+    // 发布线程和重建线程可能先后完成，变更编号更旧的结果丢弃
+    if (serving && snapshot->changeId < serving->changeId) {
+        return;
     }
-    
-    logViewer->append(QString("课程添加成功: %1 - %2 (%3)").arg(room, course, teacher));
-    refreshData(); // 刷新界面显示
-    return true;
+    serving = std::move(snapshot);
+    audienceSlices.clear();
 }
 
-bool ServerWindow::updateCourse(int id, const QString& room, const QString& course, const QString& teacher,
-                               const QString& timeSlot, const QString& startTime, const QString& endTime,
-                               int weekday, int isNext) {
-    if (!db.isOpen()) {
-        logViewer->append("数据库未打开，无法更新课程");
+std::shared_ptr<const SnapshotBuilder::Prebuilt> ServerWindow::servingSnapshot() {
+    // 时间轮每秒才推进一次，后台重建的结果也可能是稍早读取的；
+    // 已经过了下一个公告生效或过期时刻时先重读公告，过期的公告因此不会下发
+    if (serving && serving->announcementsUntilMs > 0
+        && QDateTime::currentMSecsSinceEpoch() >= serving->announcementsUntilMs) {
+        refreshServingAnnouncements();
+    }
+    return serving;
+}
+
+bool ServerWindow::refreshServingAnnouncements() {
+    if (!serving) {
         return false;
     }
-    
-    // 验证必要字段不为空
-    if (room.isEmpty() || course.isEmpty() || teacher.isEmpty()) {
-        logViewer->append("教室、课程和教师不能为空");
+    // 课程表和教室与当前数据隐式共享，只有公告重新读取和编码
+    auto snapshot = std::make_shared<SnapshotBuilder::Prebuilt>(*serving);
+    QString error;
+    if (!SnapshotBuilder::refreshAnnouncements(db, *snapshot, QDateTime::currentDateTime(), &error)) {
+        logViewer->append(error);
         return false;
     }
-    
-    QSqlQuery query(db);
-    query.prepare("UPDATE master_schedules SET room=?, course=?, teacher=?, time_slot=?, start_time=?, "
-               "end_time=?, weekday=?, is_next=? WHERE id=?");
-    query.addBindValue(room);
-    query.addBindValue(course);
-    query.addBindValue(teacher);
-    query.addBindValue(timeSlot);
-    query.addBindValue(startTime);
-    query.addBindValue(endTime);
-    query.addBindValue(weekday);
-    query.addBindValue(isNext);
-    query.addBindValue(id);
-    
-    if (!query.exec()) {
-        logViewer->append("更新课程失败: " + query.lastError().text());
-        return false;
+    serving = std::move(snapshot);
+    audienceSlices.clear();
+    return true;
+}
+
+const ServerWindow::AudienceSlice &ServerWindow::audienceSlice(const SnapshotBuilder::Prebuilt &snapshot,
+                                                               const AudienceIndex::Audience &audience) {
+    // 同一份下发数据中每个教室（或楼宇）只筛选、编码一次，下发数据或受众索引变化时清空
+    auto it = audienceSlices.find(audience.key());
+    if (it != audienceSlices.end()) {
+        return it.value();
     }
-    
-    if (query.numRowsAffected() > 0) {
-        logViewer->append(QString("课程更新成功: ID=%1").arg(id));
-        refreshData(); // 刷新界面显示
-        return true;
-    } else {
-        logViewer->append(QString("未找到要更新的课程: ID=%1").arg(id));
-        return false;
+
+    // 中继还要按所辖班牌再筛选一次，发给中继的公告带上投放范围
+    const bool withTargets = audience.kind != AudienceIndex::Audience::Room;
+    const QJsonArray all = snapshot.tables["announcements"].toArray();
+    AudienceSlice slice;
+    Columnar::TableEncoder<Schema::Announcements> encoder;
+    for (int row : SnapshotBuilder::announcementRows(snapshot, audienceIndex.lookup(audience))) {
+        QJsonObject obj = all.at(row).toObject();
+        if (withTargets) {
+            obj["target"] = audienceIndex.target(snapshot.announcementIds[row]).toString();
+        }
+        encoder.appendJson(obj);
+        slice.announcements.append(obj);
     }
+    encoder.writeTo(slice.columnar, Columnar::AnnouncementTable);
+    return audienceSlices.insert(audience.key(), slice).value();
 }
 
-bool ServerWindow::deleteCourse(int id) {
-    if (!db.isOpen()) {
-        logViewer->append("数据库未打开，无法删除课程");
-        return false;
+void ServerWindow::loadLatestChange() {
+    QSqlQuery query(db);
+    if (query.exec("SELECT id, committed_at_ms FROM change_log ORDER BY id DESC LIMIT 1") && query.next()) {
+        currentChangeId = query.value(0).toLongLong();
+        currentChangeAtMs = query.value(1).toLongLong();
     }
-    
+}
+
+void ServerWindow::recordChange(const QString &entity) {
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+
     QSqlQuery query(db);
-    query.prepare("DELETE FROM master_schedules WHERE id = ?");
-    query.addBindValue(id);
-    
+    query.prepare("INSERT INTO change_log (entity, committed_at_ms) VALUES (?, ?)");
+    query.addBindValue(entity);
+    query.addBindValue(nowMs);
     if (!query.exec()) {
-        logViewer->append("删除课程失败: " + query.lastError().text());
-        return false;
+        logViewer->append("记录变更失败: " + query.lastError().text());
+        return;
+    }
+
+    currentChangeId = query.lastInsertId().toLongLong();
+    currentChangeAtMs = nowMs;
+    logViewer->append(QString("变更 #%1 (%2) 已提交").arg(currentChangeId).arg(entity));
+    rebuildServingSnapshot();
+}
+
+void ServerWindow::pushUrgentAnnouncement(const QString &title, const QString &content, int priority,
+                                          const QString &publishTime, const QString &expireTime,
+                                          const AnnouncementTarget &target) {
+    if (priority < kUrgentPriority) {
+        return;
+    }
+
+    // 紧急公告不等下一次轮询，立即推送给投放范围内保持连接的班牌和中继；完整数据仍随后续同步下发
+    QJsonObject ann;
+    ann["title"] = title;
+    ann["content"] = content;
+    ann["priority"] = priority;
+    ann["publish_time"] = publishTime;
+    ann["expire_time"] = expireTime;
+    ann["target"] = target.toString();
+    ann["change_id"] = currentChangeId;
+    ann["sent_at_ms"] = QDateTime::currentMSecsSinceEpoch();
+    const QByteArray payload = QJsonDocument(ann).toJson(QJsonDocument::Compact);
+    int sent = syncService->pushUrgent([this, &target, &payload](const QJsonObject &args) {
+        return audienceIndex.reaches(target, AudienceIndex::Audience::fromArgs(args)) ? payload : QByteArray();
+    });
+    logViewer->append(QString("紧急公告已推送给 %1 个连接: %2").arg(sent).arg(title));
+}
+
+void ServerWindow::pushEffectiveAnnouncements() {
+    if (!serving) {
+        return;
+    }
+    // 每个连接只收到适用于它的公告；同一受众的推送内容只序列化一次
+    std::shared_ptr<const SnapshotBuilder::Prebuilt> snapshot = serving;
+    const qint64 sentAtMs = QDateTime::currentMSecsSinceEpoch();
+    QHash<QString, QByteArray> payloads;
+    int sent = syncService->pushAnnouncements([&](const QJsonObject &args) {
+        AudienceIndex::Audience audience = AudienceIndex::Audience::fromArgs(args);
+        auto it = payloads.find(audience.key());
+        if (it == payloads.end()) {
+            QJsonObject update;
+            update["announcements"] = audienceSlice(*snapshot, audience).announcements;
+            update["change_id"] = snapshot->changeId;
+            update["sent_at_ms"] = sentAtMs;
+            it = payloads.insert(audience.key(), QJsonDocument(update).toJson(QJsonDocument::Compact));
+        }
+        return it.value();
+    });
+    logViewer->append(QString("公告生效或过期，当前有效 %1 条，已推送给 %2 个连接").arg(serving->announcements).arg(sent));
+}
+
+void ServerWindow::onCheckinRequest(quint64 connection, const QJsonObject &args) {
+    CheckinIngest::Batch batch;
+    QString error;
+    quint64 ticket = 0;
+    if (CheckinIngest::parseBatch(args, batch, &error)) {
+        ticket = checkinIngest.submit(std::move(batch));
+        if (ticket == 0) {
+            error = checkinIngest.isRunning() ? "签到队列已满" : "签到写入管道未启动";
+        }
+    }
+
+    if (ticket != 0) {
+        pendingCheckins.insert(ticket, PendingCheckin{connection, args["batch"], args["tag"]});
+        return;
+    }
+
+    // 未接收的批次立即回复，班牌保留本地记录稍后重发
+    QJsonObject ack;
+    ack["batch"] = args["batch"];
+    if (args.contains("tag")) {
+        ack["tag"] = args["tag"];
+    }
+    ack["ok"] = false;
+    ack["error"] = error;
+    ack["retry_ms"] = kCheckinRetryMs;
+    syncService->reply(connection, Lane::CheckinAck, QJsonDocument(ack).toJson(QJsonDocument::Compact));
+}
+
+void ServerWindow::onCheckinsCommitted(const QVector<CheckinIngest::Receipt> &receipts) {
+    QString loggedError;
+    for (const CheckinIngest::Receipt &receipt : receipts) {
+        // 一次提交中的各批次共用同一个失败原因，只记一条
+        if (!receipt.ok && receipt.error != loggedError) {
+            loggedError = receipt.error;
+            logViewer->append("签到写入失败，已通知班牌重发: " + loggedError);
+        }
+        // 只累加新写入的签到，重发的批次不会重复计数；推送留到下一次整秒
+        for (const CheckinIngest::Event &event : receipt.written) {
+            attendance.record(event.room, event.cardId, event.checkedAtMs);
+        }
+        auto it = pendingCheckins.find(receipt.ticket);
+        if (it == pendingCheckins.end()) {
+            continue;
+        }
+        QJsonObject ack;
+        ack["batch"] = it->batch;
+        if (!it->tag.isUndefined()) {
+            ack["tag"] = it->tag;
+        }
+        ack["ok"] = receipt.ok;
+        ack["accepted"] = receipt.accepted;
+        ack["duplicates"] = receipt.duplicates;
+        if (!receipt.ok) {
+            ack["retry_ms"] = kCheckinRetryMs;
+        }
+        // 连接已断开时班牌会在重连后重发，重复的签到由唯一约束忽略
+        syncService->reply(it->connection, Lane::CheckinAck, QJsonDocument(ack).toJson(QJsonDocument::Compact));
+        pendingCheckins.erase(it);
+    }
+}
+
+void ServerWindow::rebuildAttendance() {
+    QString error;
+    if (!attendance.rebuild(db, QDate::currentDate(), calendar.isActive(), QDateTime::currentMSecsSinceEpoch(), &error)) {
+        logViewer->append(error);
+    }
+
+    attendanceRows.clear();
+    attendanceRoomTable->setRowCount(0);
+    QStringList rooms = attendance.takeDirty();
+    std::sort(rooms.begin(), rooms.end());
+    for (const QString &room : rooms) {
+        showAttendanceRoom(attendance.roomView(room));
+    }
+    refreshAttendanceBuildings();
+    // 重建后各教室的人数都推送一次
+    attendance.markAllDirty();
+}
+
+void ServerWindow::updateAttendanceSession(int id, const QString &room, const QString &course, const QString &teacher,
+                                           int weekday, const QString &startTime, const QString &endTime) {
+    const QDate day = attendance.date();
+    if (!day.isValid()) {
+        return;
+    }
+    // 只登记当天上的课；启用校历时以展开结果为准（须在 calendar.upsertCourse 之后调用）
+    bool today = calendar.isActive() ? calendar.occursOn(id, calendar.resolve(day)) : weekday == day.dayOfWeek();
+    if (today) {
+        attendance.setSession(id, room, course, teacher, startTime, endTime);
+    } else {
+        attendance.removeSession(id);
+    }
+}
+
+void ServerWindow::dropAttendanceRoom(const QString &room) {
+    attendance.removeRoom(room);
+    auto it = attendanceRows.find(room);
+    if (it == attendanceRows.end()) {
+        return;
+    }
+    const int row = it.value();
+    attendanceRows.erase(it);
+    attendanceRoomTable->removeRow(row);
+    for (auto other = attendanceRows.begin(); other != attendanceRows.end(); ++other) {
+        if (other.value() > row) {
+            --other.value();
+        }
+    }
+    refreshAttendanceBuildings();
+}
+
+void ServerWindow::flushAttendance() {
+    attendance.advance(QDateTime::currentMSecsSinceEpoch());
+    const QStringList changed = attendance.takeDirty();
+    if (changed.isEmpty()) {
+        return;
+    }
+
+    // 一秒内同一教室的多次签到合并为一次推送；班牌只收到所在教室，中继收到所辖楼宇有变化的教室
+    QHash<QString, QJsonObject> byRoom;
+    QHash<QString, QJsonArray> byBuilding;
+    QJsonArray all;
+    for (const QString &room : changed) {
+        AttendanceTracker::RoomView view = attendance.roomView(room);
+        showAttendanceRoom(view);
+        QJsonObject obj = AttendanceTracker::toJson(view);
+        byRoom.insert(room, obj);
+        byBuilding[view.building].append(obj);
+        all.append(obj);
+    }
+    refreshAttendanceBuildings();
+
+    const qint64 sentAtMs = QDateTime::currentMSecsSinceEpoch();
+    QHash<QString, QByteArray> payloads;
+    syncService->pushAttendance([&](const QJsonObject &args) {
+        AudienceIndex::Audience audience = AudienceIndex::Audience::fromArgs(args);
+        auto it = payloads.find(audience.key());
+        if (it == payloads.end()) {
+            QJsonArray rooms;
+            switch (audience.kind) {
+            case AudienceIndex::Audience::Room:
+                if (byRoom.contains(audience.name)) {
+                    rooms.append(byRoom.value(audience.name));
+                }
+                break;
+            case AudienceIndex::Audience::Building:
+                rooms = byBuilding.value(audience.name);
+                break;
+            case AudienceIndex::Audience::Everyone:
+                rooms = all;
+                break;
+            }
+            QByteArray payload;
+            if (!rooms.isEmpty()) {
+                QJsonObject update;
+                update["rooms"] = rooms;
+                update["sent_at_ms"] = sentAtMs;
+                payload = QJsonDocument(update).toJson(QJsonDocument::Compact);
+            }
+            it = payloads.insert(audience.key(), payload);
+        }
+        return it.value();
+    });
+}
+
+void ServerWindow::onWheelTick() {
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    bool announcementsDue = false;
+    bool boundaryDue = false;
+    bool dayRolled = false;
+    QVector<int> activated;
+    timerWheel.advance(nowMs, [&](const TimerWheel::Event &event) {
+        switch (event.kind) {
+        case AnnouncementStart:
+            activated.append(int(event.key));
+            announcementsDue = true;
+            break;
+        case AnnouncementEnd:
+            announcementTimers.remove(int(event.key));
+            announcementsDue = true;
+            break;
+        case ClassBoundary:
+            boundaryDue = true;
+            break;
+        case DayRollover:
+            dayRolled = true;
+            break;
+        }
+    });
+
+    if (announcementsDue && refreshServingAnnouncements()) {
+        pushEffectiveAnnouncements();
+        // 定时发布的紧急公告在生效时走紧急通道，不认识公告集合推送的旧班牌也能立即显示
+        QSqlQuery query(db);
+        query.prepare("SELECT title, content, priority, publish_time, expire_time FROM announcements WHERE id = ?");
+        for (int id : activated) {
+            query.bindValue(0, id);
+            if (query.exec() && query.next()) {
+                pushUrgentAnnouncement(query.value(0).toString(), query.value(1).toString(), query.value(2).toInt(),
+                                       query.value(3).toString(), query.value(4).toString(), audienceIndex.target(id));
+            }
+        }
+    }
+    if (dayRolled) {
+        rebuildBoundaryCache();
+        rebuildAttendance();
+    }
+    if (boundaryDue || dayRolled) {
+        updateCurrentClasses();
+    }
+    flushAttendance();
+
+    // 下一次在整秒时推进，公告和上下课事件都以秒为单位
+    nowMs = QDateTime::currentMSecsSinceEpoch();
+    wheelTimer->start(int(timerWheel.tickMs() - nowMs % timerWheel.tickMs()));
+}
+
+void ServerWindow::loadAnnouncementTimers() {
+    QSqlQuery query(db);
+    if (!query.exec("SELECT id, publish_time, expire_time FROM announcements")) {
+        logViewer->append("读取公告时间失败: " + query.lastError().text());
+        return;
+    }
+    while (query.next()) {
+        scheduleAnnouncementTimers(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString());
+    }
+    logViewer->append(QString("时间轮已登记 %1 个公告事件").arg(timerWheel.size()));
+}
+
+void ServerWindow::scheduleAnnouncementTimers(int id, const QString &publishTime, const QString &expireTime) {
+    cancelAnnouncementTimers(id);
+
+    // 只登记将来的时刻；已经过去的时刻在下发数据中已按时间过滤
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    QPair<TimerWheel::TimerId, TimerWheel::TimerId> timers(0, 0);
+    QDateTime publishAt = QDateTime::fromString(publishTime, SnapshotBuilder::kAnnouncementTimeFormat);
+    QDateTime expireAt = QDateTime::fromString(expireTime, SnapshotBuilder::kAnnouncementTimeFormat);
+    if (publishAt.isValid() && publishAt.toMSecsSinceEpoch() > nowMs) {
+        timers.first = timerWheel.schedule(publishAt.toMSecsSinceEpoch(), AnnouncementStart, id);
+    }
+    if (expireAt.isValid() && expireAt.toMSecsSinceEpoch() > nowMs) {
+        timers.second = timerWheel.schedule(expireAt.toMSecsSinceEpoch(), AnnouncementEnd, id);
+    }
+    if (timers.first || timers.second) {
+        announcementTimers.insert(id, timers);
+    }
+}
+
+void ServerWindow::cancelAnnouncementTimers(int id) {
+    auto it = announcementTimers.find(id);
+    if (it == announcementTimers.end()) {
+        return;
+    }
+    timerWheel.cancel(it->first);
+    timerWheel.cancel(it->second);
+    announcementTimers.erase(it);
+}
+
+void ServerWindow::recordPropagation(const QString &signId, const QJsonObject &report) {
+    PropagationStats::Sample sample;
+    if (!propagationStats.record(signId, report, &sample)) {
+        return;
+    }
+
+    logViewer->append(QString("变更 #%1 已在班牌 %2 显示，总耗时 %3 ms（等待 %4 / 下载 %5 / 写库 %6 / 刷新 %7）")
+                      .arg(sample.changeId).arg(signId).arg(sample.totalMs())
+                      .arg(sample.waitMs).arg(sample.fetchMs).arg(sample.applyMs).arg(sample.displayMs));
+
+    PropagationStats::Summary fleet = propagationStats.fleetSummary();
+    propagationLabel->setText(QString("变更传播(%1 次): p50 %2 ms  p95 %3 ms  p99 %4 ms")
+                              .arg(fleet.samples).arg(fleet.p50).arg(fleet.p95).arg(fleet.p99));
+}
+
+// CRUD 操作实现
+bool ServerWindow::addCourse(const QString& room, const QString& course, const QString& teacher,
+                             const QString& timeSlot, const QString& startTime, const QString& endTime,
+                             int weekday, int isNext) {
+    if (!db.isOpen()) {
+        logViewer->append("数据库未打开，无法添加课程");
+        return false;
+    }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
+    
+    // 验证必要字段不为空
+    if (room.isEmpty() || course.isEmpty() || teacher.isEmpty()) {
+        logViewer->append("教室、课程和教师不能为空");
+        return false;
+    }
+    
+    if (!acceptCourseConflicts(ConflictEngine::makeEntry(0, room, course, teacher, weekday, startTime, endTime))) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(Schema::sql<Schema::Schedules, Schema::Side::Server, Schema::Statement::Insert>());
+    query.addBindValue(room);
+    query.addBindValue(course);
+    query.addBindValue(teacher);
+    query.addBindValue(timeSlot);
+    query.addBindValue(startTime);
+    query.addBindValue(endTime);
+    query.addBindValue(weekday);
+    query.addBindValue(isNext);
+    
+    if (!query.exec()) {
+        logViewer->append("添加课程失败: " + query.lastError().text());
+        return false;
+    }
+    
+    logViewer->append(QString("课程添加成功: %1 - %2 (%3)").arg(room, course, teacher));
+    int courseId = query.lastInsertId().toInt();
+    occupancy.setCourse(courseId, room, weekday, startTime, endTime);
+    conflictEngine.upsert(ConflictEngine::makeEntry(courseId, room, course, teacher, weekday, startTime, endTime));
+    updateConflictReport(courseId);
+    QString calendarError;
+    if (!calendar.upsertCourse(db, courseId, weekday, &calendarError)) {
+        logViewer->append(calendarError);
+    }
+    updateAttendanceSession(courseId, room, course, teacher, weekday, startTime, endTime);
+    recordChange("course");
+    refreshData(); // 刷新界面显示
+    return true;
+}
+
+bool ServerWindow::updateCourse(int id, const QString& room, const QString& course, const QString& teacher,
+                               const QString& timeSlot, const QString& startTime, const QString& endTime,
+                               int weekday, int isNext) {
+    if (!db.isOpen()) {
+        logViewer->append("数据库未打开，无法更新课程");
+        return false;
+    }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
+    
+    // 验证必要字段不为空
+    if (room.isEmpty() || course.isEmpty() || teacher.isEmpty()) {
+        logViewer->append("教室、课程和教师不能为空");
+        return false;
+    }
+    
+    ConflictEngine::Entry entry = ConflictEngine::makeEntry(id, room, course, teacher, weekday, startTime, endTime);
+    entry.weeks = calendar.weekRule(id);
+    if (!acceptCourseConflicts(entry)) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(Schema::sql<Schema::Schedules, Schema::Side::Server, Schema::Statement::UpdateById>());
+    query.addBindValue(room);
+    query.addBindValue(course);
+    query.addBindValue(teacher);
+    query.addBindValue(timeSlot);
+    query.addBindValue(startTime);
+    query.addBindValue(endTime);
+    query.addBindValue(weekday);
+    query.addBindValue(isNext);
+    query.addBindValue(id);
+    
+    if (!query.exec()) {
+        logViewer->append("更新课程失败: " + query.lastError().text());
+        return false;
+    }
+    
+    if (query.numRowsAffected() > 0) {
+        logViewer->append(QString("课程更新成功: ID=%1").arg(id));
+        occupancy.setCourse(id, room, weekday, startTime, endTime);
+        conflictEngine.upsert(entry);
+        updateConflictReport(id);
+        QString calendarError;
+        if (!calendar.upsertCourse(db, id, weekday, &calendarError)) {
+            logViewer->append(calendarError);
+        }
+        updateAttendanceSession(id, room, course, teacher, weekday, startTime, endTime);
+        recordChange("course");
+        refreshData(); // 刷新界面显示
+        return true;
+    } else {
+        logViewer->append(QString("未找到要更新的课程: ID=%1").arg(id));
+        return false;
+    }
+}
+
+bool ServerWindow::deleteCourse(int id) {
+    if (!db.isOpen()) {
+        logViewer->append("数据库未打开，无法删除课程");
+        return false;
+    }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
+    
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM master_schedules WHERE id = ?");
+    query.addBindValue(id);
+    
+    if (!query.exec()) {
+        logViewer->append("删除课程失败: " + query.lastError().text());
+        return false;
     }
     
     if (query.numRowsAffected() > 0) {
         logViewer->append(QString("课程删除成功: ID=%1").arg(id));
+        occupancy.removeCourse(id);
+        conflictEngine.remove(id);
+        updateConflictReport(id);
+        QString calendarError;
+        if (!calendar.removeCourse(db, id, &calendarError)) {
+            logViewer->append(calendarError);
+        }
+        attendance.removeSession(id);
+        recordChange("course");
         refreshData(); // 刷新界面显示
         return true;
     } else {
@@ -979,6 +1936,9 @@ bool ServerWindow::addClassroom(const QString& roomName, const QString& classNam
         logViewer->append("数据库未打开，无法添加教室");
         return false;
     }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
     
     // 验证必要字段不为空
     if (roomName.isEmpty() || className.isEmpty()) {
@@ -998,8 +1958,7 @@ bool ServerWindow::addClassroom(const QString& roomName, const QString& classNam
     }
     
     QSqlQuery query(db);
-    query.prepare("INSERT INTO classrooms (room_name, class_name, capacity, building, floor, current_class) "
-               "VALUES (?, ?, ?, ?, ?, ?)");
+    query.prepare(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::Insert>());
     query.addBindValue(roomName);
     query.addBindValue(className);
     query.addBindValue(capacity);
@@ -1013,6 +1972,12 @@ bool ServerWindow::addClassroom(const QString& roomName, const QString& classNam
     }
     
     logViewer->append(QString("教室添加成功: %1 - %2").arg(roomName, className));
+    occupancy.setRoom(roomName, capacity, building, floor);
+    audienceIndex.setRoom(roomName, building, floor);
+    attendance.setRoom(roomName, building, capacity);
+    audienceSlices.clear();
+    refreshFreeRoomBuildings();
+    recordChange("classroom");
     refreshData(); // 刷新界面显示
     return true;
 }
@@ -1023,6 +1988,9 @@ bool ServerWindow::updateClassroom(const QString& roomName, const QString& class
         logViewer->append("数据库未打开，无法更新教室");
         return false;
     }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
     
     // 验证必要字段不为空
     if (roomName.isEmpty() || className.isEmpty()) {
@@ -1031,7 +1999,7 @@ bool ServerWindow::updateClassroom(const QString& roomName, const QString& class
     }
     
     QSqlQuery query(db);
-    query.prepare("UPDATE classrooms SET class_name=?, capacity=?, building=?, floor=?, current_class=? WHERE room_name=?");
+    query.prepare(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::UpdateByKey>());
     query.addBindValue(className);
     query.addBindValue(capacity);
     query.addBindValue(building);
@@ -1046,6 +2014,12 @@ bool ServerWindow::updateClassroom(const QString& roomName, const QString& class
     
     if (query.numRowsAffected() > 0) {
         logViewer->append(QString("教室更新成功: %1").arg(roomName));
+        occupancy.setRoom(roomName, capacity, building, floor);
+        audienceIndex.setRoom(roomName, building, floor);
+        attendance.setRoom(roomName, building, capacity);
+        audienceSlices.clear();
+        refreshFreeRoomBuildings();
+        recordChange("classroom");
         refreshData(); // 刷新界面显示
         return true;
     } else {
@@ -1059,6 +2033,9 @@ bool ServerWindow::deleteClassroom(const QString& roomName) {
         logViewer->append("数据库未打开，无法删除教室");
         return false;
     }
+    if (rejectWhilePublishing()) {
+        return false;
+    }
     
     // 验证教室名称不为空
     if (roomName.isEmpty()) {
@@ -1077,6 +2054,12 @@ bool ServerWindow::deleteClassroom(const QString& roomName) {
     
     if (query.numRowsAffected() > 0) {
         logViewer->append(QString("教室删除成功: %1").arg(roomName));
+        occupancy.removeRoom(roomName);
+        audienceIndex.removeRoom(roomName);
+        dropAttendanceRoom(roomName);
+        audienceSlices.clear();
+        refreshFreeRoomBuildings();
+        recordChange("classroom");
         refreshData(); // 刷新界面显示
         return true;
     } else {
@@ -1086,7 +2069,7 @@ bool ServerWindow::deleteClassroom(const QString& roomName) {
 }
 
 bool ServerWindow::addAnnouncement(const QString& title, const QString& content, int priority,
-                                 const QString& publishTime, const QString& expireTime) {
+                                 const QString& publishTime, const QString& expireTime, const QString& target) {
     if (!db.isOpen()) {
         logViewer->append("数据库未打开，无法添加公告");
         return false;
@@ -1097,10 +2080,24 @@ bool ServerWindow::addAnnouncement(const QString& title, const QString& content,
         logViewer->append("公告标题和内容不能为空");
         return false;
     }
+
+    // 生效和过期按字符串比较，时间必须是统一的格式
+    for (const QString &time : {publishTime, expireTime}) {
+        if (!time.isEmpty() && !QDateTime::fromString(time, SnapshotBuilder::kAnnouncementTimeFormat).isValid()) {
+            logViewer->append(QString("公告时间格式应为 yyyy-MM-dd hh:mm:ss: %1").arg(time));
+            return false;
+        }
+    }
+    AnnouncementTarget audience;
+    if (!AnnouncementTarget::parse(target, audience)) {
+        logViewer->append(QString("无法识别的投放范围: %1（应为 all、building:楼栋、floor:楼栋/楼层或 rooms:教室,教室）").arg(target));
+        return false;
+    }
     
+    // 公告和它的投放范围在同一个事务中写入
+    db.transaction();
     QSqlQuery query(db);
-    query.prepare("INSERT INTO announcements (title, content, priority, publish_time, expire_time) "
-               "VALUES (?, ?, ?, ?, ?)");
+    query.prepare(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::Insert>());
     query.addBindValue(title);
     query.addBindValue(content);
     query.addBindValue(priority);
@@ -1109,16 +2106,31 @@ bool ServerWindow::addAnnouncement(const QString& title, const QString& content,
     
     if (!query.exec()) {
         logViewer->append("添加公告失败: " + query.lastError().text());
+        db.rollback();
         return false;
     }
+    int id = query.lastInsertId().toInt();
+    if (!saveAnnouncementTarget(id, audience)) {
+        db.rollback();
+        return false;
+    }
+    db.commit();
     
     logViewer->append(QString("公告添加成功: %1").arg(title));
+    audienceIndex.setAnnouncement(id, audience);
+    audienceSlices.clear();
+    scheduleAnnouncementTimers(id, publishTime, expireTime);
+    recordChange("announcement");
+    // 尚未生效的紧急公告在生效时由时间轮推送
+    if (announcementActive(publishTime, expireTime, QDateTime::currentDateTime())) {
+        pushUrgentAnnouncement(title, content, priority, publishTime, expireTime, audience);
+    }
     refreshData(); // 刷新界面显示
     return true;
 }
 
 bool ServerWindow::updateAnnouncement(int id, const QString& title, const QString& content, int priority,
-                                    const QString& publishTime, const QString& expireTime) {
+                                    const QString& publishTime, const QString& expireTime, const QString& target) {
     if (!db.isOpen()) {
         logViewer->append("数据库未打开，无法更新公告");
         return false;
@@ -1129,9 +2141,24 @@ bool ServerWindow::updateAnnouncement(int id, const QString& title, const QStrin
         logViewer->append("公告标题和内容不能为空");
         return false;
     }
+
+    // 生效和过期按字符串比较，时间必须是统一的格式
+    for (const QString &time : {publishTime, expireTime}) {
+        if (!time.isEmpty() && !QDateTime::fromString(time, SnapshotBuilder::kAnnouncementTimeFormat).isValid()) {
+            logViewer->append(QString("公告时间格式应为 yyyy-MM-dd hh:mm:ss: %1").arg(time));
+            return false;
+        }
+    }
+    AnnouncementTarget audience;
+    if (!AnnouncementTarget::parse(target, audience)) {
+        logViewer->append(QString("无法识别的投放范围: %1（应为 all、building:楼栋、floor:楼栋/楼层或 rooms:教室,教室）").arg(target));
+        return false;
+    }
     
+    // 公告和它的投放范围在同一个事务中写入
+    db.transaction();
     QSqlQuery query(db);
-    query.prepare("UPDATE announcements SET title=?, content=?, priority=?, publish_time=?, expire_time=? WHERE id=?");
+    query.prepare(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::UpdateById>());
     query.addBindValue(title);
     query.addBindValue(content);
     query.addBindValue(priority);
@@ -1141,19 +2168,45 @@ bool ServerWindow::updateAnnouncement(int id, const QString& title, const QStrin
     
     if (!query.exec()) {
         logViewer->append("更新公告失败: " + query.lastError().text());
+        db.rollback();
         return false;
     }
     
     if (query.numRowsAffected() > 0) {
+        if (!saveAnnouncementTarget(id, audience)) {
+            db.rollback();
+            return false;
+        }
+        db.commit();
         logViewer->append(QString("公告更新成功: ID=%1").arg(id));
+        audienceIndex.setAnnouncement(id, audience);
+        audienceSlices.clear();
+        scheduleAnnouncementTimers(id, publishTime, expireTime);
+        recordChange("announcement");
+        if (announcementActive(publishTime, expireTime, QDateTime::currentDateTime())) {
+            pushUrgentAnnouncement(title, content, priority, publishTime, expireTime, audience);
+        }
         refreshData(); // 刷新界面显示
         return true;
     } else {
+        db.rollback();
         logViewer->append(QString("未找到要更新的公告: ID=%1").arg(id));
         return false;
     }
 }
 
+bool ServerWindow::saveAnnouncementTarget(int id, const AnnouncementTarget &target) {
+    QSqlQuery query(db);
+    query.prepare("UPDATE announcements SET target = ? WHERE id = ?");
+    query.addBindValue(target.toString());
+    query.addBindValue(id);
+    if (!query.exec()) {
+        logViewer->append("保存公告投放范围失败: " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
 bool ServerWindow::deleteAnnouncement(int id) {
     if (!db.isOpen()) {
         logViewer->append("数据库未打开，无法删除公告");
@@ -1171,6 +2224,10 @@ bool ServerWindow::deleteAnnouncement(int id) {
     
     if (query.numRowsAffected() > 0) {
         logViewer->append(QString("公告删除成功: ID=%1").arg(id));
+        audienceIndex.removeAnnouncement(id);
+        audienceSlices.clear();
+        cancelAnnouncementTimers(id);
+        recordChange("announcement");
         refreshData(); // 刷新界面显示
         return true;
     } else {
@@ -1192,6 +2249,874 @@ void ServerWindow::setupManagementUi() {
     
     // 创建公告管理页面
     setupAnnouncementManagementPage();
+
+    // 创建冲突报告页面
+    setupConflictReportPage();
+
+    // 创建自动排课页面
+    setupTimetablePage();
+
+    // 创建校历页面
+    setupCalendarPage();
+
+    // 创建版本页面
+    setupVersionPage();
+}
+
+void ServerWindow::setupConflictReportPage() {
+    QWidget *conflictPage = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(conflictPage);
+
+    QPushButton *revalidateBtn = new QPushButton("重新校验全部课程");
+    conflictStatusLabel = new QLabel("尚未校验");
+    QHBoxLayout *barLayout = new QHBoxLayout();
+    barLayout->addWidget(revalidateBtn);
+    barLayout->addStretch();
+    barLayout->addWidget(conflictStatusLabel);
+
+    conflictTable = new QTableWidget(0, 7);
+    conflictTable->setHorizontalHeaderLabels({"类型", "教室/教师", "星期", "重叠时间", "课程", "冲突课程", "课程ID"});
+    conflictTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    conflictTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    conflictTable->horizontalHeader()->setStretchLastSection(true);
+
+    layout->addLayout(barLayout);
+    layout->addWidget(conflictTable);
+
+    connect(revalidateBtn, &QPushButton::clicked, this, &ServerWindow::revalidateConflicts);
+    managementTabs->addTab(conflictPage, "冲突报告");
+}
+
+bool ServerWindow::acceptCourseConflicts(const ConflictEngine::Entry &entry) {
+    QVector<ConflictEngine::Conflict> found = conflictEngine.check(entry);
+    if (found.isEmpty()) {
+        return true;
+    }
+    for (const ConflictEngine::Conflict &conflict : std::as_const(found)) {
+        logViewer->append("排课冲突: " + ConflictEngine::describe(conflict));
+    }
+    if (allowConflictCheckBox->isChecked()) {
+        logViewer->append(QString("存在 %1 处冲突，已按设置保存并记入冲突报告").arg(found.size()));
+        return true;
+    }
+    logViewer->append(QString("存在 %1 处冲突，未保存").arg(found.size()));
+    return false;
+}
+
+void ServerWindow::revalidateConflicts() {
+    if (!db.isOpen()) {
+        return;
+    }
+    QElapsedTimer clock;
+    clock.start();
+    QString error;
+    if (!conflictEngine.rebuild(db, &error)) {
+        logViewer->append(error);
+        return;
+    }
+    refreshConflictReport();
+    logViewer->append(QString("已校验 %1 门课程，用时 %2 ms").arg(conflictEngine.size()).arg(clock.elapsed()));
+}
+
+void ServerWindow::refreshConflictReport() {
+    conflictReport = conflictEngine.conflicts();
+    showConflictReport();
+}
+
+// 其他课程之间的冲突不受这门课影响，只需去掉涉及它的旧记录，再补上它现在的 check() 结果
+void ServerWindow::updateConflictReport(int courseId) {
+    conflictReport.erase(std::remove_if(conflictReport.begin(), conflictReport.end(),
+                                        [courseId](const ConflictEngine::Conflict &conflict) {
+        return conflict.courseId == courseId || conflict.otherId == courseId;
+    }), conflictReport.end());
+    if (conflictEngine.contains(courseId)) {
+        conflictReport += conflictEngine.check(conflictEngine.entry(courseId));
+    }
+    showConflictReport();
+}
+
+void ServerWindow::showConflictReport() {
+    static const char *weekdayNames[] = {"星期一", "星期二", "星期三", "星期四", "星期五", "星期六", "星期日"};
+    auto clock = [](int minutes) {
+        return QString("%1:%2").arg(minutes / 60, 2, 10, QChar('0')).arg(minutes % 60, 2, 10, QChar('0'));
+    };
+
+    const QVector<ConflictEngine::Conflict> &found = conflictReport;
+    conflictTable->setRowCount(found.size());
+    for (int i = 0; i < found.size(); ++i) {
+        const ConflictEngine::Conflict &conflict = found[i];
+        bool room = conflict.resource == ConflictEngine::Resource::Room;
+        conflictTable->setItem(i, 0, new QTableWidgetItem(room ? "教室" : "教师"));
+        conflictTable->setItem(i, 1, new QTableWidgetItem(conflict.name));
+        conflictTable->setItem(i, 2, new QTableWidgetItem(weekdayNames[qBound(1, conflict.weekday, 7) - 1]));
+        conflictTable->setItem(i, 3, new QTableWidgetItem(clock(conflict.startMinute) + "-" + clock(conflict.endMinute)));
+        conflictTable->setItem(i, 4, new QTableWidgetItem(conflict.course));
+        conflictTable->setItem(i, 5, new QTableWidgetItem(conflict.otherCourse));
+        conflictTable->setItem(i, 6, new QTableWidgetItem(QString("%1 / %2").arg(conflict.courseId).arg(conflict.otherId)));
+    }
+    conflictStatusLabel->setText(found.isEmpty() ? QString("%1 门课程，无冲突").arg(conflictEngine.size())
+                                                 : QString("%1 门课程，%2 处冲突").arg(conflictEngine.size()).arg(found.size()));
+}
+
+void ServerWindow::setupTimetablePage() {
+    QWidget *timetablePage = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(timetablePage);
+    QFormLayout *formLayout = new QFormLayout();
+
+    timetableSeedSpinBox = new QSpinBox();
+    timetableSeedSpinBox->setRange(0, 999999);
+    timetableSeedSpinBox->setValue(1);
+    timetableChainsSpinBox = new QSpinBox();
+    timetableChainsSpinBox->setRange(1, 256);
+    timetableChainsSpinBox->setValue(16);
+    timetableThreadsSpinBox = new QSpinBox();
+    timetableThreadsSpinBox->setRange(0, 256);
+    timetableThreadsSpinBox->setSpecialValueText("全部核心");
+    timetableRoundsSpinBox = new QSpinBox();
+    timetableRoundsSpinBox->setRange(1, 10000);
+    timetableRoundsSpinBox->setValue(200);
+    timetableDaysSpinBox = new QSpinBox();
+    timetableDaysSpinBox->setRange(1, 7);
+    timetableDaysSpinBox->setValue(5);
+
+    formLayout->addRow("随机种子:", timetableSeedSpinBox);
+    formLayout->addRow("退火链数:", timetableChainsSpinBox);
+    formLayout->addRow("线程数:", timetableThreadsSpinBox);
+    formLayout->addRow("轮数:", timetableRoundsSpinBox);
+    formLayout->addRow("排课天数:", timetableDaysSpinBox);
+
+    generateTimetableBtn = new QPushButton("生成");
+    cancelTimetableBtn = new QPushButton("取消");
+    applyTimetableBtn = new QPushButton("保存为草稿");
+    cancelTimetableBtn->setEnabled(false);
+    applyTimetableBtn->setEnabled(false);
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addWidget(generateTimetableBtn);
+    buttonLayout->addWidget(cancelTimetableBtn);
+    buttonLayout->addWidget(applyTimetableBtn);
+    buttonLayout->addStretch();
+
+    timetableProgress = new QProgressBar();
+    timetableProgress->setValue(0);
+    timetableStatusLabel = new QLabel("以现有课程表中每门课的每周次数为需求，重新分配时间和教室");
+
+    layout->addLayout(formLayout);
+    layout->addLayout(buttonLayout);
+    layout->addWidget(timetableProgress);
+    layout->addWidget(timetableStatusLabel);
+    layout->addStretch();
+
+    connect(generateTimetableBtn, &QPushButton::clicked, this, &ServerWindow::startTimetableGeneration);
+    connect(cancelTimetableBtn, &QPushButton::clicked, this, [this]() { timetableCancel = true; });
+    connect(applyTimetableBtn, &QPushButton::clicked, this, &ServerWindow::applyGeneratedTimetable);
+    managementTabs->addTab(timetablePage, "自动排课");
+}
+
+void ServerWindow::startTimetableGeneration() {
+    if (timetableThread || !db.isOpen()) {
+        return;
+    }
+
+    QVector<TimetableGenerator::Demand> demands;
+    QVector<TimetableGenerator::Room> rooms;
+    TimetableGenerator::Constraints constraints;
+    QString error;
+    if (!TimetableGenerator::loadFromDb(db, demands, rooms, constraints, &error)) {
+        logViewer->append(error);
+        return;
+    }
+    constraints.days = timetableDaysSpinBox->value();
+    timetableGenerator = std::make_unique<TimetableGenerator>(demands, rooms, constraints);
+
+    TimetableGenerator::Options options;
+    options.seed = quint64(timetableSeedSpinBox->value());
+    options.chains = timetableChainsSpinBox->value();
+    options.threads = timetableThreadsSpinBox->value();
+    options.rounds = timetableRoundsSpinBox->value();
+
+    logViewer->append(QString("开始自动排课: %1 门课 %2 节次，%3 间教室，%4 条退火链")
+                          .arg(demands.size()).arg(timetableGenerator->sessionCount())
+                          .arg(rooms.size()).arg(options.chains));
+    timetableCancel = false;
+    timetableResult = TimetableGenerator::Result();
+    timetableProgress->setRange(0, options.rounds);
+    timetableProgress->setValue(0);
+    generateTimetableBtn->setEnabled(false);
+    cancelTimetableBtn->setEnabled(true);
+    applyTimetableBtn->setEnabled(false);
+
+    // 搜索在工作线程中进行，进度通过排队调用回到界面线程
+    const TimetableGenerator *generator = timetableGenerator.get();
+    auto result = std::make_shared<TimetableGenerator::Result>();
+    timetableThread = QThread::create([this, generator, options, result]() {
+        *result = generator->run(options, [this](int round, int totalRounds, int hard, int soft) {
+            QMetaObject::invokeMethod(this, [this, round, totalRounds, hard, soft]() {
+                timetableProgress->setValue(round);
+                timetableStatusLabel->setText(QString("第 %1/%2 轮，硬冲突 %3，软约束扣分 %4")
+                                                  .arg(round).arg(totalRounds).arg(hard).arg(soft));
+            }, Qt::QueuedConnection);
+        }, &timetableCancel);
+    });
+    connect(timetableThread, &QThread::finished, this, [this, result]() {
+        timetableThread->deleteLater();
+        timetableThread = nullptr;
+        onTimetableFinished(*result);
+    });
+    timetableThread->start();
+}
+
+void ServerWindow::onTimetableFinished(const TimetableGenerator::Result &result) {
+    timetableResult = result;
+    generateTimetableBtn->setEnabled(true);
+    cancelTimetableBtn->setEnabled(false);
+
+    QString summary = QString("%1 轮，硬冲突 %2，软约束扣分 %3，用时 %4 ms")
+                          .arg(result.rounds).arg(result.hardViolations).arg(result.softPenalty).arg(result.elapsedMs);
+    if (result.cancelled) {
+        summary = "已取消，当前最优: " + summary;
+    }
+    timetableStatusLabel->setText(summary);
+    logViewer->append("自动排课结束: " + summary);
+
+    // 只有无硬冲突的结果才允许写入
+    applyTimetableBtn->setEnabled(result.hardViolations == 0 && !result.placements.isEmpty());
+}
+
+void ServerWindow::applyGeneratedTimetable() {
+    if (!timetableGenerator || timetableResult.hardViolations != 0 || timetableResult.placements.isEmpty()) {
+        return;
+    }
+
+    // 写入前用冲突引擎独立核对一遍，避免排课器与冲突检查的规则不一致
+    const QVector<TimetableGenerator::Demand> &demands = timetableGenerator->demands();
+    const QVector<TimetableGenerator::Room> &rooms = timetableGenerator->rooms();
+    const QVector<TimetableGenerator::Period> &periods = timetableGenerator->constraints().periods;
+    QVector<ConflictEngine::Entry> batch;
+    batch.reserve(timetableResult.placements.size());
+    for (int i = 0; i < timetableResult.placements.size(); ++i) {
+        const TimetableGenerator::Placement &placement = timetableResult.placements[i];
+        const TimetableGenerator::Demand &demand = demands[placement.demand];
+        const TimetableGenerator::Period &period = periods[placement.period];
+        batch.append(ConflictEngine::makeEntry(i + 1, rooms[placement.room].name, demand.course, demand.teacher,
+                                               placement.weekday, period.start, period.end));
+    }
+    QVector<ConflictEngine::Conflict> found = ConflictEngine::validate(batch);
+    if (!found.isEmpty()) {
+        for (const ConflictEngine::Conflict &conflict : std::as_const(found)) {
+            logViewer->append("排课结果冲突: " + ConflictEngine::describe(conflict));
+        }
+        logViewer->append(QString("排课结果存在 %1 处冲突，未保存").arg(found.size()));
+        return;
+    }
+
+    // 结果写成草稿，不直接替换线上课程；在"版本"页检查后发布，发布时统一记变更、重建索引并推送班牌
+    QString name = QString("自动排课 %1").arg(QDateTime::currentDateTime().toString("MM-dd hh:mm"));
+    QString error;
+    int draftId = timetableGenerator->writeDraft(db, timetableResult, name, &error);
+    if (draftId <= 0) {
+        logViewer->append(error);
+        return;
+    }
+    logViewer->append(QString("自动排课结果已保存为草稿 %1: %2，%3 节课，请在版本页检查后发布")
+                          .arg(draftId).arg(name).arg(timetableResult.placements.size()));
+    applyTimetableBtn->setEnabled(false);
+    refreshVersionPage();
+}
+
+void ServerWindow::setupCalendarPage() {
+    QWidget *calendarPage = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(calendarPage);
+
+    // 学期
+    semesterTable = new QTableWidget(0, 3);
+    semesterTable->setHorizontalHeaderLabels({"学期", "开学日期", "结束日期"});
+    semesterTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    semesterTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    semesterTable->horizontalHeader()->setStretchLastSection(true);
+    semesterNameLineEdit = new QLineEdit();
+    semesterStartEdit = new QDateEdit(QDate::currentDate());
+    semesterEndEdit = new QDateEdit(QDate::currentDate().addDays(18 * 7 - 1));
+    semesterStartEdit->setCalendarPopup(true);
+    semesterEndEdit->setCalendarPopup(true);
+    QPushButton *addSemesterBtn = new QPushButton("添加学期");
+    QPushButton *deleteSemesterBtn = new QPushButton("删除学期");
+    QHBoxLayout *semesterForm = new QHBoxLayout();
+    semesterForm->addWidget(new QLabel("名称:"));
+    semesterForm->addWidget(semesterNameLineEdit);
+    semesterForm->addWidget(semesterStartEdit);
+    semesterForm->addWidget(new QLabel("至"));
+    semesterForm->addWidget(semesterEndEdit);
+    semesterForm->addWidget(addSemesterBtn);
+    semesterForm->addWidget(deleteSemesterBtn);
+
+    // 放假、考试周、调课
+    exceptionTable = new QTableWidget(0, 5);
+    exceptionTable->setHorizontalHeaderLabels({"类型", "开始日期", "结束日期", "按此日课表", "说明"});
+    exceptionTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    exceptionTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    exceptionTable->horizontalHeader()->setStretchLastSection(true);
+    exceptionKindCombo = new QComboBox();
+    exceptionKindCombo->addItem(CalendarEngine::kindLabel(CalendarEngine::DayKind::Holiday), int(CalendarEngine::DayKind::Holiday));
+    exceptionKindCombo->addItem(CalendarEngine::kindLabel(CalendarEngine::DayKind::Exam), int(CalendarEngine::DayKind::Exam));
+    exceptionKindCombo->addItem(CalendarEngine::kindLabel(CalendarEngine::DayKind::Makeup), int(CalendarEngine::DayKind::Makeup));
+    exceptionStartEdit = new QDateEdit(QDate::currentDate());
+    exceptionEndEdit = new QDateEdit(QDate::currentDate());
+    exceptionFollowEdit = new QDateEdit(QDate::currentDate());
+    exceptionStartEdit->setCalendarPopup(true);
+    exceptionEndEdit->setCalendarPopup(true);
+    exceptionFollowEdit->setCalendarPopup(true);
+    exceptionFollowEdit->setEnabled(false);
+    exceptionNoteLineEdit = new QLineEdit();
+    QPushButton *addExceptionBtn = new QPushButton("添加");
+    QPushButton *deleteExceptionBtn = new QPushButton("删除");
+    QHBoxLayout *exceptionForm = new QHBoxLayout();
+    exceptionForm->addWidget(exceptionKindCombo);
+    exceptionForm->addWidget(exceptionStartEdit);
+    exceptionForm->addWidget(new QLabel("至"));
+    exceptionForm->addWidget(exceptionEndEdit);
+    exceptionForm->addWidget(new QLabel("按此日课表:"));
+    exceptionForm->addWidget(exceptionFollowEdit);
+    exceptionForm->addWidget(new QLabel("说明:"));
+    exceptionForm->addWidget(exceptionNoteLineEdit);
+    exceptionForm->addWidget(addExceptionBtn);
+    exceptionForm->addWidget(deleteExceptionBtn);
+
+    // 单双周
+    weekRuleCourseSpinBox = new QSpinBox();
+    weekRuleCourseSpinBox->setRange(1, 99999999);
+    weekParityCombo = new QComboBox();
+    weekParityCombo->addItems({"每周", "单周", "双周"});
+    firstWeekSpinBox = new QSpinBox();
+    firstWeekSpinBox->setRange(1, 60);
+    lastWeekSpinBox = new QSpinBox();
+    lastWeekSpinBox->setRange(0, 60);
+    lastWeekSpinBox->setSpecialValueText("学期结束");
+    QPushButton *setWeekRuleBtn = new QPushButton("设置上课周");
+    QHBoxLayout *weekForm = new QHBoxLayout();
+    weekForm->addWidget(new QLabel("课程ID:"));
+    weekForm->addWidget(weekRuleCourseSpinBox);
+    weekForm->addWidget(weekParityCombo);
+    weekForm->addWidget(new QLabel("第"));
+    weekForm->addWidget(firstWeekSpinBox);
+    weekForm->addWidget(new QLabel("周至"));
+    weekForm->addWidget(lastWeekSpinBox);
+    weekForm->addWidget(setWeekRuleBtn);
+    weekForm->addStretch();
+
+    calendarStatusLabel = new QLabel();
+
+    layout->addWidget(new QLabel("学期（第一周从开学日期所在周的周一算起）"));
+    layout->addWidget(semesterTable);
+    layout->addLayout(semesterForm);
+    layout->addWidget(new QLabel("放假、考试周与调课"));
+    layout->addWidget(exceptionTable);
+    layout->addLayout(exceptionForm);
+    layout->addWidget(new QLabel("单双周课程"));
+    layout->addLayout(weekForm);
+    layout->addWidget(calendarStatusLabel);
+
+    connect(exceptionKindCombo, &QComboBox::currentIndexChanged, this, [this]() {
+        bool makeup = CalendarEngine::DayKind(exceptionKindCombo->currentData().toInt()) == CalendarEngine::DayKind::Makeup;
+        exceptionFollowEdit->setEnabled(makeup);
+        exceptionEndEdit->setEnabled(!makeup);
+    });
+    connect(addSemesterBtn, &QPushButton::clicked, this, [this]() {
+        if (rejectWhilePublishing()) {
+            return;
+        }
+        CalendarEngine::Semester semester;
+        semester.name = semesterNameLineEdit->text().trimmed();
+        semester.start = semesterStartEdit->date();
+        semester.end = semesterEndEdit->date();
+        QString error;
+        bool ok = calendar.addSemester(db, semester, &error);
+        afterCalendarChange(ok, error, "学期已添加: " + semester.name);
+    });
+    connect(deleteSemesterBtn, &QPushButton::clicked, this, [this]() {
+        if (rejectWhilePublishing()) {
+            return;
+        }
+        int row = semesterTable->currentRow();
+        if (row < 0) {
+            logViewer->append("请先选择要删除的学期");
+            return;
+        }
+        QString error;
+        bool ok = calendar.removeSemester(db, semesterTable->item(row, 0)->data(Qt::UserRole).toInt(), &error);
+        afterCalendarChange(ok, error, "学期已删除");
+    });
+    connect(addExceptionBtn, &QPushButton::clicked, this, [this]() {
+        if (rejectWhilePublishing()) {
+            return;
+        }
+        CalendarEngine::Exception exception;
+        exception.kind = CalendarEngine::DayKind(exceptionKindCombo->currentData().toInt());
+        exception.start = exceptionStartEdit->date();
+        exception.end = exceptionEndEdit->date();
+        if (exception.kind == CalendarEngine::DayKind::Makeup) {
+            exception.followDate = exceptionFollowEdit->date();
+        }
+        exception.note = exceptionNoteLineEdit->text().trimmed();
+        QString error;
+        bool ok = calendar.addException(db, exception, &error);
+        afterCalendarChange(ok, error, QString("%1已添加: %2").arg(CalendarEngine::kindLabel(exception.kind),
+                                                                 exception.start.toString(Qt::ISODate)));
+    });
+    connect(deleteExceptionBtn, &QPushButton::clicked, this, [this]() {
+        if (rejectWhilePublishing()) {
+            return;
+        }
+        int row = exceptionTable->currentRow();
+        if (row < 0) {
+            logViewer->append("请先选择要删除的日期");
+            return;
+        }
+        QString error;
+        bool ok = calendar.removeException(db, exceptionTable->item(row, 0)->data(Qt::UserRole).toInt(), &error);
+        afterCalendarChange(ok, error, "例外日期已删除");
+    });
+    connect(setWeekRuleBtn, &QPushButton::clicked, this, [this]() {
+        if (rejectWhilePublishing()) {
+            return;
+        }
+        CalendarEngine::WeekRule rule;
+        rule.parity = weekParityCombo->currentIndex();
+        rule.firstWeek = firstWeekSpinBox->value();
+        rule.lastWeek = lastWeekSpinBox->value();
+        int courseId = weekRuleCourseSpinBox->value();
+        QString error;
+        bool ok = calendar.setWeekRule(db, courseId, rule, &error);
+        if (ok) {
+            conflictEngine.setWeekRule(courseId, rule);
+            updateConflictReport(courseId);
+        }
+        afterCalendarChange(ok, error, QString("课程 %1 上课周已设置: %2").arg(courseId).arg(weekParityCombo->currentText()));
+    });
+
+    managementTabs->addTab(calendarPage, "校历");
+    refreshCalendarPage();
+}
+
+void ServerWindow::afterCalendarChange(bool ok, const QString &error, const QString &done) {
+    if (!ok) {
+        logViewer->append(error);
+        return;
+    }
+    logViewer->append(done);
+    rebuildBoundaryCache();
+    rebuildAttendance();
+    updateCurrentClasses();
+    recordChange("calendar");
+    refreshCalendarPage();
+}
+
+void ServerWindow::refreshCalendarPage() {
+    const QVector<CalendarEngine::Semester> &semesters = calendar.semesters();
+    semesterTable->setRowCount(semesters.size());
+    for (int i = 0; i < semesters.size(); ++i) {
+        QTableWidgetItem *nameItem = new QTableWidgetItem(semesters[i].name);
+        nameItem->setData(Qt::UserRole, semesters[i].id);
+        semesterTable->setItem(i, 0, nameItem);
+        semesterTable->setItem(i, 1, new QTableWidgetItem(semesters[i].start.toString(Qt::ISODate)));
+        semesterTable->setItem(i, 2, new QTableWidgetItem(semesters[i].end.toString(Qt::ISODate)));
+    }
+
+    const QVector<CalendarEngine::Exception> &exceptions = calendar.exceptions();
+    exceptionTable->setRowCount(exceptions.size());
+    for (int i = 0; i < exceptions.size(); ++i) {
+        const CalendarEngine::Exception &exception = exceptions[i];
+        QTableWidgetItem *kindItem = new QTableWidgetItem(CalendarEngine::kindLabel(exception.kind));
+        kindItem->setData(Qt::UserRole, exception.id);
+        exceptionTable->setItem(i, 0, kindItem);
+        exceptionTable->setItem(i, 1, new QTableWidgetItem(exception.start.toString(Qt::ISODate)));
+        exceptionTable->setItem(i, 2, new QTableWidgetItem(exception.end.toString(Qt::ISODate)));
+        exceptionTable->setItem(i, 3, new QTableWidgetItem(exception.followDate.toString(Qt::ISODate)));
+        exceptionTable->setItem(i, 4, new QTableWidgetItem(exception.note));
+    }
+
+    if (!calendar.isActive()) {
+        calendarStatusLabel->setText("未配置学期和例外日期，班牌按星期显示课程");
+        return;
+    }
+    CalendarEngine::Day today = calendar.resolve(QDate::currentDate());
+    QString todayText = CalendarEngine::kindLabel(today.kind);
+    if (today.week > 0) {
+        todayText += QString("，第 %1 周").arg(today.week);
+    }
+    if (today.kind == CalendarEngine::DayKind::Makeup) {
+        todayText += QString("，按星期%1课表").arg(today.weekday);
+    }
+    calendarStatusLabel->setText(QString("今天: %1；已展开 %2 至 %3")
+                                     .arg(todayText, calendar.materializedFrom().toString(Qt::ISODate),
+                                          calendar.materializedTo().toString(Qt::ISODate)));
+}
+
+void ServerWindow::setupVersionPage() {
+    QWidget *versionPage = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(versionPage);
+
+    versionTable = new QTableWidget(0, 6);
+    versionTable->setHorizontalHeaderLabels({"版本", "名称", "状态", "课程数", "创建时间", "发布时间"});
+    versionTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    versionTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    versionTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    versionTable->horizontalHeader()->setStretchLastSection(true);
+
+    versionNameLineEdit = new QLineEdit();
+    versionNameLineEdit->setPlaceholderText("新草稿名称，如 2025 秋季课表");
+    QPushButton *emptyDraftBtn = new QPushButton("新建空草稿");
+    QPushButton *copyDraftBtn = new QPushButton("复制所选版本为草稿");
+    QPushButton *importCsvBtn = new QPushButton("导入 CSV 到所选草稿");
+    QPushButton *deleteVersionBtn = new QPushButton("删除所选版本");
+    publishVersionBtn = new QPushButton("发布所选版本");
+    QHBoxLayout *versionButtons = new QHBoxLayout();
+    versionButtons->addWidget(versionNameLineEdit);
+    versionButtons->addWidget(emptyDraftBtn);
+    versionButtons->addWidget(copyDraftBtn);
+    versionButtons->addWidget(importCsvBtn);
+    versionButtons->addWidget(deleteVersionBtn);
+    versionButtons->addWidget(publishVersionBtn);
+
+    // 所选版本的课程；草稿可直接在表格中修改，改动立即写入草稿，班牌看不到
+    versionRowsTable = new QTableWidget(0, 8);
+    versionRowsTable->setHorizontalHeaderLabels({"教室", "课程", "教师", "节次", "开始", "结束", "星期", "下节"});
+    versionRowsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    versionRowsTable->horizontalHeader()->setStretchLastSection(true);
+    QPushButton *addRowBtn = new QPushButton("添加课程");
+    QPushButton *removeRowBtn = new QPushButton("删除课程");
+    versionStatusLabel = new QLabel();
+    QHBoxLayout *rowButtons = new QHBoxLayout();
+    rowButtons->addWidget(addRowBtn);
+    rowButtons->addWidget(removeRowBtn);
+    rowButtons->addStretch();
+    rowButtons->addWidget(versionStatusLabel);
+
+    layout->addWidget(versionTable);
+    layout->addLayout(versionButtons);
+    layout->addWidget(versionRowsTable, 1);
+    layout->addLayout(rowButtons);
+
+    auto createDraft = [this](int baseId) {
+        QString name = versionNameLineEdit->text().trimmed();
+        if (name.isEmpty()) {
+            name = QString("草稿 %1").arg(QDateTime::currentDateTime().toString("MM-dd hh:mm"));
+        }
+        QString error;
+        int draftId = TimetableVersions::createDraft(db, name, baseId, &error);
+        if (draftId <= 0) {
+            logViewer->append(error);
+            return;
+        }
+        logViewer->append(QString("已创建草稿 %1: %2").arg(draftId).arg(name));
+        versionNameLineEdit->clear();
+        refreshVersionPage();
+    };
+    connect(emptyDraftBtn, &QPushButton::clicked, this, [createDraft]() { createDraft(0); });
+    connect(copyDraftBtn, &QPushButton::clicked, this, [this, createDraft]() {
+        int baseId = selectedVersionId();
+        if (baseId > 0) {
+            createDraft(baseId);
+        }
+    });
+    connect(importCsvBtn, &QPushButton::clicked, this, [this]() {
+        TimetableVersions::Status status = TimetableVersions::Status::Published;
+        int draftId = selectedVersionId(&status);
+        if (draftId <= 0 || status != TimetableVersions::Status::Draft) {
+            logViewer->append("请先选择一个草稿");
+            return;
+        }
+        QString path = QFileDialog::getOpenFileName(this, "导入课程表", QString(), "CSV 文件 (*.csv *.txt)");
+        if (path.isEmpty()) {
+            return;
+        }
+        int skipped = 0;
+        QString error;
+        int imported = TimetableVersions::importCsv(db, draftId, path, &skipped, &error);
+        if (imported < 0) {
+            logViewer->append(error);
+            return;
+        }
+        logViewer->append(QString("草稿 %1 导入 %2 门课程，跳过 %3 行").arg(draftId).arg(imported).arg(skipped));
+        refreshVersionPage();
+    });
+    connect(deleteVersionBtn, &QPushButton::clicked, this, [this]() {
+        int versionId = selectedVersionId();
+        QString error;
+        if (versionId <= 0 || !TimetableVersions::remove(db, versionId, &error)) {
+            if (!error.isEmpty()) logViewer->append(error);
+            return;
+        }
+        logViewer->append(QString("已删除版本 %1").arg(versionId));
+        refreshVersionPage();
+    });
+    connect(publishVersionBtn, &QPushButton::clicked, this, &ServerWindow::publishSelectedVersion);
+    connect(versionTable, &QTableWidget::itemSelectionChanged, this, &ServerWindow::showVersionRows);
+    connect(versionRowsTable, &QTableWidget::itemChanged, this, &ServerWindow::onDraftItemChanged);
+    connect(addRowBtn, &QPushButton::clicked, this, [this]() {
+        TimetableVersions::Status status = TimetableVersions::Status::Published;
+        int draftId = selectedVersionId(&status);
+        if (draftId <= 0 || status != TimetableVersions::Status::Draft) {
+            return;
+        }
+        TimetableVersions::Row row;
+        row.room = "新教室";
+        row.course = "新课程";
+        row.teacher = "教师";
+        row.timeSlot = "第1-2节";
+        row.startTime = "08:00";
+        row.endTime = "09:40";
+        QString error;
+        if (TimetableVersions::addRow(db, draftId, row, &error) <= 0) {
+            logViewer->append(error);
+            return;
+        }
+        showVersionRows();
+        versionRowsTable->scrollToBottom();
+    });
+    connect(removeRowBtn, &QPushButton::clicked, this, [this]() {
+        TimetableVersions::Status status = TimetableVersions::Status::Published;
+        int draftId = selectedVersionId(&status);
+        int current = versionRowsTable->currentRow();
+        if (draftId <= 0 || status != TimetableVersions::Status::Draft || current < 0) {
+            return;
+        }
+        int rowId = versionRowsTable->item(current, 0)->data(Qt::UserRole).toInt();
+        QString error;
+        if (!TimetableVersions::removeRow(db, draftId, rowId, &error)) {
+            logViewer->append(error);
+            return;
+        }
+        versionRowsTable->removeRow(current);
+    });
+
+    managementTabs->addTab(versionPage, "版本");
+}
+
+int ServerWindow::selectedVersionId(TimetableVersions::Status *status) {
+    int row = versionTable->currentRow();
+    if (row < 0 || !versionTable->item(row, 0)) {
+        return 0;
+    }
+    if (status) {
+        *status = TimetableVersions::Status(versionTable->item(row, 2)->data(Qt::UserRole).toInt());
+    }
+    return versionTable->item(row, 0)->data(Qt::UserRole).toInt();
+}
+
+void ServerWindow::refreshVersionPage() {
+    if (!db.isOpen()) {
+        return;
+    }
+    int selected = selectedVersionId();
+    QString error;
+    const QVector<TimetableVersions::Version> versions = TimetableVersions::list(db, &error);
+    if (!error.isEmpty()) {
+        logViewer->append(error);
+    }
+
+    auto timeText = [](qint64 ms) {
+        return ms > 0 ? QDateTime::fromMSecsSinceEpoch(ms).toString("yyyy-MM-dd hh:mm:ss") : QString();
+    };
+    {
+        QSignalBlocker blocker(versionTable);
+        versionTable->setRowCount(versions.size());
+        for (int i = 0; i < versions.size(); ++i) {
+            const TimetableVersions::Version &version = versions[i];
+            QTableWidgetItem *idItem = new QTableWidgetItem(QString::number(version.id));
+            idItem->setData(Qt::UserRole, version.id);
+            QTableWidgetItem *statusItem = new QTableWidgetItem(TimetableVersions::statusLabel(version.status));
+            statusItem->setData(Qt::UserRole, int(version.status));
+            versionTable->setItem(i, 0, idItem);
+            versionTable->setItem(i, 1, new QTableWidgetItem(version.name));
+            versionTable->setItem(i, 2, statusItem);
+            versionTable->setItem(i, 3, new QTableWidgetItem(QString::number(version.rows)));
+            versionTable->setItem(i, 4, new QTableWidgetItem(timeText(version.createdAtMs)));
+            versionTable->setItem(i, 5, new QTableWidgetItem(timeText(version.publishedAtMs)));
+            if (version.id == selected) {
+                versionTable->selectRow(i);
+            }
+        }
+    }
+    showVersionRows();
+}
+
+void ServerWindow::showVersionRows() {
+    TimetableVersions::Status status = TimetableVersions::Status::Published;
+    int versionId = selectedVersionId(&status);
+    bool editable = status == TimetableVersions::Status::Draft;
+    publishVersionBtn->setEnabled(versionId > 0 && status != TimetableVersions::Status::Published && !publishThread);
+    publishVersionBtn->setText(status == TimetableVersions::Status::Archived ? "回滚到所选版本" : "发布所选版本");
+
+    QSignalBlocker blocker(versionRowsTable);
+    versionRowsTable->setRowCount(0);
+    versionRowsTable->setEditTriggers(editable ? QAbstractItemView::DoubleClicked | QAbstractItemView::EditKeyPressed
+                                               : QAbstractItemView::NoEditTriggers);
+    if (versionId <= 0) {
+        versionStatusLabel->setText("选择一个版本查看课程");
+        return;
+    }
+
+    QString error;
+    const QVector<TimetableVersions::Row> rows = TimetableVersions::rows(db, versionId, kVersionPreviewRows, &error);
+    if (!error.isEmpty()) {
+        logViewer->append(error);
+        return;
+    }
+    versionRowsTable->setRowCount(rows.size());
+    for (int i = 0; i < rows.size(); ++i) {
+        const TimetableVersions::Row &row = rows[i];
+        const QString values[] = {row.room, row.course, row.teacher, row.timeSlot, row.startTime, row.endTime,
+                                  QString::number(row.weekday), QString::number(row.isNext)};
+        for (int c = 0; c < 8; ++c) {
+            versionRowsTable->setItem(i, c, new QTableWidgetItem(values[c]));
+        }
+        versionRowsTable->item(i, 0)->setData(Qt::UserRole, row.id);
+    }
+
+    QString text = editable ? "草稿：双击单元格修改" : "只读";
+    if (rows.size() == kVersionPreviewRows) {
+        text += QString("，仅显示前 %1 门课程").arg(kVersionPreviewRows);
+    }
+    versionStatusLabel->setText(text);
+}
+
+void ServerWindow::onDraftItemChanged(QTableWidgetItem *item) {
+    TimetableVersions::Status status = TimetableVersions::Status::Published;
+    int draftId = selectedVersionId(&status);
+    if (draftId <= 0 || status != TimetableVersions::Status::Draft) {
+        return;
+    }
+    int r = item->row();
+    auto text = [this, r](int column) {
+        QTableWidgetItem *cell = versionRowsTable->item(r, column);
+        return cell ? cell->text().trimmed() : QString();
+    };
+    TimetableVersions::Row row;
+    row.id = versionRowsTable->item(r, 0)->data(Qt::UserRole).toInt();
+    row.room = text(0);
+    row.course = text(1);
+    row.teacher = text(2);
+    row.timeSlot = text(3);
+    row.startTime = text(4);
+    row.endTime = text(5);
+    row.weekday = qBound(1, text(6).toInt(), 7);
+    row.isNext = text(7).toInt();
+
+    QString error;
+    if (!TimetableVersions::updateRow(db, draftId, row, &error)) {
+        logViewer->append(error);
+    }
+}
+
+void ServerWindow::publishSelectedVersion() {
+    TimetableVersions::Status status = TimetableVersions::Status::Published;
+    int versionId = selectedVersionId(&status);
+    if (publishThread || versionId <= 0 || status == TimetableVersions::Status::Published || !db.isOpen()) {
+        return;
+    }
+
+    // 冲突检查、发布事务、校历展开、索引和下发数据都在工作线程的独立连接上完成；
+    // 期间班牌照常从当前的下发数据取数，完成后界面线程只交换指针
+    bool allowConflicts = allowConflictCheckBox->isChecked();
+    auto outcome = std::make_shared<PublishOutcome>();
+    outcome->versionId = versionId;
+    outcome->snapshot = std::make_shared<SnapshotBuilder::Prebuilt>();
+    publishThread = QThread::create([outcome, allowConflicts]() {
+        QElapsedTimer clock;
+        clock.start();
+        QString *error = &outcome->error;
+        withWorkerConnection("VersionPublisher", error, [&](QSqlDatabase worker) {
+            QVector<ConflictEngine::Entry> entries = TimetableVersions::entries(worker, outcome->versionId, error);
+            if (!error->isEmpty()) {
+                return false;
+            }
+            outcome->conflicts = ConflictEngine::validate(entries).size();
+            if (outcome->conflicts > 0 && !allowConflicts) {
+                *error = QString("版本 %1 有 %2 处冲突，未发布（勾选课程管理页的“冲突时仍保存”后可强制发布）")
+                             .arg(outcome->versionId).arg(outcome->conflicts);
+                return false;
+            }
+            outcome->changeId = TimetableVersions::publish(worker, outcome->versionId, error);
+            if (outcome->changeId < 0) {
+                return false;
+            }
+            return outcome->calendar.rebuild(worker, QDate::currentDate(), error)
+                && outcome->occupancy.rebuild(worker, error)
+                && outcome->conflictEngine.rebuild(worker, error)
+                && SnapshotBuilder::prebuild(worker, *outcome->snapshot, error);
+        });
+        outcome->elapsedMs = clock.elapsed();
+    });
+    connect(publishThread, &QThread::finished, this, [this, outcome]() {
+        publishThread->deleteLater();
+        publishThread = nullptr;
+        onVersionPublished(*outcome);
+    });
+    publishVersionBtn->setEnabled(false);
+    versionStatusLabel->setText(QString("正在发布版本 %1...").arg(versionId));
+    publishThread->start();
+}
+
+// 发布线程从它自己的连接重建校历、占用位图和冲突索引，完成后整体替换界面线程的这几份；
+// 期间在界面线程上做的修改会丢失，因此发布期间不接受修改
+bool ServerWindow::rejectWhilePublishing() {
+    if (!publishThread) {
+        return false;
+    }
+    logViewer->append("正在发布课程表版本，请在发布完成后再修改");
+    return true;
+}
+
+void ServerWindow::onVersionPublished(PublishOutcome &outcome) {
+    if (outcome.changeId < 0) {
+        logViewer->append(outcome.error);
+        refreshVersionPage();
+        return;
+    }
+    if (!outcome.error.isEmpty()) {
+        // 发布已提交，只是发布后的重建失败：在主连接上补做
+        logViewer->append(outcome.error);
+        QString error;
+        if (!occupancy.rebuild(db, &error) || !calendar.rebuild(db, QDate::currentDate(), &error)) {
+            logViewer->append(error);
+        }
+        revalidateConflicts();
+        loadLatestChange();
+        rebuildServingSnapshot();
+        refreshVersionPage();
+        rebuildBoundaryCache();
+        rebuildAttendance();
+        return;
+    }
+
+    adoptServingSnapshot(outcome.snapshot);
+    calendar = std::move(outcome.calendar);
+    occupancy = std::move(outcome.occupancy);
+    conflictEngine = std::move(outcome.conflictEngine);
+    loadLatestChange();
+
+    // 班牌收到通知后在几秒内随机拉取，不必等到下一次轮询
+    QJsonObject notice;
+    notice["change_id"] = outcome.changeId;
+    notice["version_id"] = outcome.versionId;
+    notice["sent_at_ms"] = QDateTime::currentMSecsSinceEpoch();
+    int sent = syncService->pushVersion(QJsonDocument(notice).toJson(QJsonDocument::Compact));
+    logViewer->append(QString("版本 %1 已发布（变更 #%2，%3 门课程，%4 处冲突，用时 %5 ms），已通知 %6 个连接")
+                          .arg(outcome.versionId).arg(outcome.changeId).arg(outcome.snapshot->schedules)
+                          .arg(outcome.conflicts).arg(outcome.elapsedMs).arg(sent));
+
+    refreshFreeRoomBuildings();
+    refreshConflictReport();
+    refreshCalendarPage();
+    refreshVersionPage();
+    rebuildBoundaryCache();
+    rebuildAttendance();
+    if (outcome.snapshot->schedules <= kAutoRefreshRows) {
+        refreshData();
+        refreshCourseManagementData();
+    } else {
+        logViewer->append("课程较多，课程表页面未自动刷新，请手动刷新");
+    }
 }
 
 void ServerWindow::setupCourseManagementPage() {
@@ -1239,6 +3164,8 @@ void ServerWindow::setupCourseManagementPage() {
     buttonLayout->addWidget(updateCourseBtn);
     buttonLayout->addWidget(deleteCourseBtn);
     buttonLayout->addStretch();
+    allowConflictCheckBox = new QCheckBox("冲突时仍保存（记入冲突报告）");
+    buttonLayout->addWidget(allowConflictCheckBox);
     
     layout->addLayout(buttonLayout);
     
@@ -1355,6 +3282,10 @@ void ServerWindow::setupAnnouncementManagementPage() {
     expireTimeLineEdit->setPlaceholderText("格式: yyyy-MM-dd hh:mm:ss");
     formLayout->addRow("过期时间:", expireTimeLineEdit);
     
+    targetLineEdit = new QLineEdit();
+    targetLineEdit->setPlaceholderText("留空为全部; building:A栋 / floor:A栋/3 / rooms:A-301,A-302");
+    formLayout->addRow("投放范围:", targetLineEdit);
+    
     layout->addLayout(formLayout);
     
     // 按钮
@@ -1375,7 +3306,7 @@ void ServerWindow::setupAnnouncementManagementPage() {
     announcementTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     announcementTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     
-    QStringList headers = {"ID", "标题", "内容", "优先级", "发布时间", "过期时间"};
+    QStringList headers = {"ID", "标题", "内容", "优先级", "发布时间", "过期时间", "投放范围"};
     announcementTable->setColumnCount(headers.size());
     announcementTable->setHorizontalHeaderLabels(headers);
     
@@ -1400,7 +3331,7 @@ void ServerWindow::refreshCourseManagementData() {
     }
     
     QSqlQuery query(db);
-    if (!query.exec("SELECT id, room, course, teacher, time_slot, start_time, end_time, weekday, is_next FROM master_schedules ORDER BY id")) {
+    if (!query.exec(Schema::sql<Schema::Schedules, Schema::Side::Server, Schema::Statement::SelectWithId>() + " ORDER BY id")) {
         logViewer->append("查询课程数据失败: " + query.lastError().text());
         return;
     }
@@ -1439,7 +3370,7 @@ void ServerWindow::refreshClassroomManagementData() {
     }
     
     QSqlQuery query(db);
-    if (!query.exec("SELECT id, room_name, class_name, capacity, building, floor, current_class FROM classrooms ORDER BY id")) {
+    if (!query.exec(Schema::sql<Schema::Classrooms, Schema::Side::Server, Schema::Statement::SelectWithId>() + " ORDER BY id")) {
         logViewer->append("查询教室数据失败: " + query.lastError().text());
         return;
     }
@@ -1476,7 +3407,7 @@ void ServerWindow::refreshAnnouncementManagementData() {
     }
     
     QSqlQuery query(db);
-    if (!query.exec("SELECT id, title, content, priority, publish_time, expire_time FROM announcements ORDER BY id")) {
+    if (!query.exec(Schema::sql<Schema::Announcements, Schema::Side::Server, Schema::Statement::SelectWithId>() + " ORDER BY id")) {
         logViewer->append("查询公告数据失败: " + query.lastError().text());
         return;
     }
@@ -1499,6 +3430,7 @@ void ServerWindow::refreshAnnouncementManagementData() {
         announcementTable->setItem(row, 3, new QTableWidgetItem(QString::number(query.value(3).toInt())));
         announcementTable->setItem(row, 4, new QTableWidgetItem(query.value(4).toString()));
         announcementTable->setItem(row, 5, new QTableWidgetItem(query.value(5).toString()));
+        announcementTable->setItem(row, 6, new QTableWidgetItem(audienceIndex.target(query.value(0).toInt()).toString()));
         row++;
     }
     
@@ -1729,6 +3661,7 @@ void ServerWindow::onAddAnnouncementClicked() {
     int priority = prioritySpinBox->value();
     QString publishTime = publishTimeLineEdit->text().trimmed();
     QString expireTime = expireTimeLineEdit->text().trimmed();
+    QString target = targetLineEdit->text().trimmed();
     
     if (title.isEmpty() || content.isEmpty()) {
         logViewer->append("标题和内容不能为空!");
@@ -1745,13 +3678,14 @@ void ServerWindow::onAddAnnouncementClicked() {
         expireTimeLineEdit->setText(expireTime);
     }
     
-    if (addAnnouncement(title, content, priority, publishTime, expireTime)) {
+    if (addAnnouncement(title, content, priority, publishTime, expireTime, target)) {
         // 清空输入框
         titleLineEdit->clear();
         contentTextEdit->clear();
         prioritySpinBox->setValue(0);
         publishTimeLineEdit->clear();
         expireTimeLineEdit->clear();
+        targetLineEdit->clear();
         
         // 刷新数据
         refreshAnnouncementManagementData();
@@ -1778,13 +3712,14 @@ void ServerWindow::onUpdateAnnouncementClicked() {
     int priority = prioritySpinBox->value();
     QString publishTime = publishTimeLineEdit->text().trimmed();
     QString expireTime = expireTimeLineEdit->text().trimmed();
+    QString target = targetLineEdit->text().trimmed();
     
     if (title.isEmpty() || content.isEmpty()) {
         logViewer->append("标题和内容不能为空!");
         return;
     }
     
-    if (updateAnnouncement(id, title, content, priority, publishTime, expireTime)) {
+    if (updateAnnouncement(id, title, content, priority, publishTime, expireTime, target)) {
         refreshAnnouncementManagementData();
     }
 }
@@ -1823,10 +3758,12 @@ void ServerWindow::onAnnouncementTableSelectionChanged() {
     QTableWidgetItem *item3 = announcementTable->item(row, 3);
     QTableWidgetItem *item4 = announcementTable->item(row, 4);
     QTableWidgetItem *item5 = announcementTable->item(row, 5);
+    QTableWidgetItem *item6 = announcementTable->item(row, 6);
     
     if(item1) titleLineEdit->setText(item1->text());
     if(item2) contentTextEdit->setText(item2->text());
     if(item3) prioritySpinBox->setValue(item3->text().toInt());
     if(item4) publishTimeLineEdit->setText(item4->text());
     if(item5) expireTimeLineEdit->setText(item5->text());
+    if(item6) targetLineEdit->setText(item6->text());
 }
@@ -2,8 +2,6 @@
 #define SERVERWINDOW_H
 
 #include <QSqlDatabase>
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QTextEdit>
 #include <QWidget>
 #include <QTabWidget>
@@ -11,6 +9,7 @@
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QTableWidget>
+#include <QTableView>
 #include <QLabel>
 #include <QComboBox>
 #include <QTime>
@@ -19,9 +18,34 @@
 #include <QSet>
 #include <QLineEdit>
 #include <QSpinBox>
+#include <QTimeEdit>
+#include <QDateEdit>
+#include <QCheckBox>
+#include <QProgressBar>
+#include <QThread>
 #include <QString>
 #include <QMap>
 #include <QVector>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "pollpolicy.h"
+#include "propagationstats.h"
+#include "syncservice.h"
+#include "fleetregistry.h"
+#include "fleetmodel.h"
+#include "occupancyindex.h"
+#include "conflictengine.h"
+#include "timetablegenerator.h"
+#include "calendarengine.h"
+#include "snapshotbuilder.h"
+#include "timetableversions.h"
+#include "timerwheel.h"
+#include "audienceindex.h"
+#include "checkiningest.h"
+#include "attendancetracker.h"
+#include <atomic>
+#include <memory>
 
 class ServerWindow : public QWidget
 {
@@ -32,15 +56,64 @@ public:
     ~ServerWindow();
 
 private slots:
-    void onNewConnection();
-    void onReadClientData();
-    void onClientDisconnected();
+    void onSyncRequested(const QJsonObject &args, qint64 requestAtMs);
+    void onSyncServed(const QJsonObject &args, const QString &peer, qint64 bytes);
 
 private:
     void initDb();                // 初始化服务端数据库
     void initSampleData();        // 初始化示例数据
-    QByteArray getScheduleJson(); // 从数据库获取数据并转为JSON
+    QByteArray getScheduleJson(const QJsonObject &args, qint64 requestAtMs,
+                               const SnapshotBuilder::Horizon &horizon); // 从数据库获取数据并转为JSON
+    QByteArray getScheduleColumnar(const QJsonObject &args, qint64 requestAtMs,
+                                   const SnapshotBuilder::Horizon &horizon); // 同样的数据按列式字典编码
+    SnapshotBuilder::Horizon calendarHorizon(const QJsonObject &args); // 班牌请求的校历天数
+    QJsonObject syncMeta(qint64 requestAtMs, const SnapshotBuilder::Prebuilt &snapshot); // 随数据下发的版本与轮询间隔
+    void rebuildServingSnapshot();     // 在后台线程中重新生成下发数据，完成后交换指针
+    std::shared_ptr<const SnapshotBuilder::Prebuilt> servingSnapshot(); // 当前下发数据，公告到期时先重读公告
+    bool refreshServingAnnouncements(); // 只重读公告表并交换下发数据
+    void adoptServingSnapshot(std::shared_ptr<const SnapshotBuilder::Prebuilt> snapshot);
+
+    // 某个受众（教室或楼宇）适用的公告，JSON 与列式编码各一份
+    struct AudienceSlice {
+        QJsonArray announcements;
+        QByteArray columnar;
+    };
+    const AudienceSlice &audienceSlice(const SnapshotBuilder::Prebuilt &snapshot, const AudienceIndex::Audience &audience);
+    void loadLatestChange();      // 读取最近一次变更的编号和提交时间
+    void recordChange(const QString &entity); // 管理端修改数据后记录一次变更
+    void recordPropagation(const QString &signId, const QJsonObject &report); // 处理班牌上报的传播耗时
+    void pushUrgentAnnouncement(const QString &title, const QString &content, int priority,
+                                const QString &publishTime, const QString &expireTime,
+                                const AnnouncementTarget &target); // 紧急公告立即推送给投放范围内的连接
+    void pushEffectiveAnnouncements(); // 公告生效或过期时推送当前有效的公告集合
+    void onCheckinRequest(quint64 connection, const QJsonObject &args); // 班牌上传的签到批次交给写入管道
+    void onCheckinsCommitted(const QVector<CheckinIngest::Receipt> &receipts); // 批次已写入，向班牌确认
+    void rebuildAttendance();          // 按当天的课程和已写入的签到重建出勤统计，只在启动、换日、发布和校历变化时调用
+    void updateAttendanceSession(int id, const QString &room, const QString &course, const QString &teacher,
+                                 int weekday, const QString &startTime, const QString &endTime); // 单门课程增改后更新出勤统计
+    void flushAttendance();            // 每秒一次：把出勤有变化的教室推送给班牌和中继，并更新出勤页
+
+    // 时间轮中的事件类型
+    enum TimedEvent {
+        AnnouncementStart,             // 公告到达发布时间，key 为公告 id
+        AnnouncementEnd,               // 公告到达过期时间
+        ClassBoundary,                 // 上下课时刻，key 为当天毫秒数
+        DayRollover,                   // 零点，重建当天的上下课时刻
+    };
+    void onWheelTick();                // 推进时间轮并处理到期的事件，然后对齐到下一秒
+    void loadAnnouncementTimers();     // 启动时为所有尚未生效或过期的公告登记事件
+    void scheduleAnnouncementTimers(int id, const QString &publishTime, const QString &expireTime);
+    void cancelAnnouncementTimers(int id);
     void setupUi();               // 设置用户界面
+    QWidget *setupFreeRoomPage(); // 空闲教室查询页
+    void findFreeRooms();         // 按查询页的条件查找空闲教室
+    void refreshFreeRoomBuildings(); // 教室增删改后刷新楼栋下拉框
+    QWidget *setupFleetPage();    // 班牌状态页
+    void refreshFleetView();      // 每秒刷新班牌状态页的时间列和汇总
+    QWidget *setupAttendancePage(); // 实时出勤页
+    void showAttendanceRoom(const AttendanceTracker::RoomView &view); // 更新出勤页中一间教室的行
+    void dropAttendanceRoom(const QString &room); // 教室删除后移出出勤统计和出勤页
+    void refreshAttendanceBuildings(); // 更新出勤页的楼栋汇总
     void refreshData();           // 刷新数据显示
     void populateSchedulesTable(); // 填充课程表数据
     void populateClassroomsTable(); // 填充教室表数据
@@ -49,12 +122,48 @@ private:
     void filterSchedulesByWeekday();   // 按星期筛选课程表
     void onWeekDayFilterChanged();     // 星期筛选变化槽函数
     void updateCurrentClasses();       // 更新当前上课班级信息
+    void rebuildBoundaryCache();       // 重建今天的上下课时刻列表，并把剩余的时刻登记到时间轮
+    qint64 msToNextBoundary();         // 距今天下一个上下课时刻的毫秒数，没有则返回 -1
     
     // 管理界面相关函数
     void setupManagementUi();
     void setupCourseManagementPage();
     void setupClassroomManagementPage();
     void setupAnnouncementManagementPage();
+    void setupConflictReportPage();
+    bool acceptCourseConflicts(const ConflictEngine::Entry &entry); // 保存课程前检查冲突，按设置拒绝或放行
+    void revalidateConflicts();        // 从数据库重建冲突索引并刷新报告
+    void refreshConflictReport();      // 全量：conflicts() 重新列出全部冲突
+    void updateConflictReport(int courseId); // 单门课程增改删后只替换涉及它的冲突
+    void showConflictReport();
+    void setupTimetablePage();
+    void startTimetableGeneration();   // 按现有课程表的需求在后台线程中自动排课
+    void onTimetableFinished(const TimetableGenerator::Result &result);
+    void applyGeneratedTimetable();    // 校验无冲突后把排课结果保存为草稿
+    void setupCalendarPage();
+    void refreshCalendarPage();
+    void afterCalendarChange(bool ok, const QString &error, const QString &done); // 校历规则修改后记录变更并刷新
+    void setupVersionPage();
+    void refreshVersionPage();
+    void showVersionRows();            // 显示所选版本的课程，草稿可直接编辑
+    int selectedVersionId(TimetableVersions::Status *status = nullptr);
+    void onDraftItemChanged(QTableWidgetItem *item);
+    void publishSelectedVersion();     // 在后台线程中发布所选版本（草稿或回滚到已归档版本）
+    bool rejectWhilePublishing();      // 发布进行中时拒绝修改课程、教室和校历，避免修改被发布结果覆盖
+
+    // 后台发布的结果：新的下发数据和各索引都在工作线程中建好，界面线程只交换
+    struct PublishOutcome {
+        QString error;
+        int versionId = 0;
+        int conflicts = 0;
+        qint64 changeId = -1;
+        qint64 elapsedMs = 0;
+        std::shared_ptr<SnapshotBuilder::Prebuilt> snapshot;
+        CalendarEngine calendar;
+        OccupancyIndex occupancy;
+        ConflictEngine conflictEngine;
+    };
+    void onVersionPublished(PublishOutcome &outcome);
     
     void refreshCourseManagementData();
     void refreshClassroomManagementData();
@@ -94,10 +203,11 @@ private:
     bool deleteClassroom(const QString& roomName);
     
     bool addAnnouncement(const QString& title, const QString& content, int priority, 
-                         const QString& publishTime, const QString& expireTime);
+                         const QString& publishTime, const QString& expireTime, const QString& target = QString());
     bool updateAnnouncement(int id, const QString& title, const QString& content, int priority, 
-                           const QString& publishTime, const QString& expireTime);
+                           const QString& publishTime, const QString& expireTime, const QString& target = QString());
     bool deleteAnnouncement(int id);
+    bool saveAnnouncementTarget(int id, const AnnouncementTarget &target); // 写入 announcements.target 列
     
     QTabWidget *dataTabWidget;    // 数据显示标签页
     QTableWidget *schedulesTable;  // 课程表显示
@@ -106,7 +216,32 @@ private:
     QPushButton *refreshButton;    // 刷新按钮
     QPushButton *clearFilterButton; // 清除筛选按钮
     QLabel *statusLabel;           // 状态标签
+    QLabel *propagationLabel;      // 变更传播耗时（全网分位数）
     QComboBox *weekDayFilterCombo;  // 星期筛选下拉框
+
+    // 空闲教室查询页
+    QComboBox *freeWeekdayCombo;
+    QTimeEdit *freeStartEdit;
+    QTimeEdit *freeEndEdit;
+    QSpinBox *freeCapacitySpinBox;
+    QComboBox *freeBuildingCombo;
+    QSpinBox *freeFloorSpinBox;
+    QTableWidget *freeRoomTable;
+    QLabel *freeRoomStatusLabel;
+
+    // 班牌状态页
+    FleetModel *fleetModel;
+    FleetFilterProxyModel *fleetProxy;
+    QTableView *fleetView;
+    QComboBox *fleetFilterCombo;
+    QLabel *fleetSummaryLabel;
+    QTimer *fleetRefreshTimer;
+
+    // 实时出勤页
+    QTableWidget *attendanceBuildingTable;
+    QTableWidget *attendanceRoomTable;
+    QLabel *attendanceSummaryLabel;
+    QHash<QString, int> attendanceRows; // 教室 -> 出勤页中的行
     
     // 管理界面组件
     QWidget *managementWidget;       // 管理界面主窗口
@@ -128,6 +263,48 @@ private:
     QPushButton *addCourseBtn;
     QPushButton *updateCourseBtn;
     QPushButton *deleteCourseBtn;
+    QCheckBox *allowConflictCheckBox;  // 勾选后冲突的课程仍保存，只记入冲突报告
+
+    // 冲突报告页面元素
+    QTableWidget *conflictTable;
+    QLabel *conflictStatusLabel;
+    QVector<ConflictEngine::Conflict> conflictReport; // 冲突报告页当前列出的冲突
+
+    // 校历页面元素
+    QTableWidget *semesterTable;
+    QLineEdit *semesterNameLineEdit;
+    QDateEdit *semesterStartEdit;
+    QDateEdit *semesterEndEdit;
+    QTableWidget *exceptionTable;
+    QComboBox *exceptionKindCombo;
+    QDateEdit *exceptionStartEdit;
+    QDateEdit *exceptionEndEdit;
+    QDateEdit *exceptionFollowEdit;
+    QLineEdit *exceptionNoteLineEdit;
+    QSpinBox *weekRuleCourseSpinBox;
+    QComboBox *weekParityCombo;
+    QSpinBox *firstWeekSpinBox;
+    QSpinBox *lastWeekSpinBox;
+    QLabel *calendarStatusLabel;
+
+    // 版本页面元素
+    QTableWidget *versionTable;
+    QLineEdit *versionNameLineEdit;
+    QTableWidget *versionRowsTable;
+    QPushButton *publishVersionBtn;
+    QLabel *versionStatusLabel;
+
+    // 自动排课页面元素
+    QSpinBox *timetableSeedSpinBox;
+    QSpinBox *timetableChainsSpinBox;
+    QSpinBox *timetableThreadsSpinBox;
+    QSpinBox *timetableRoundsSpinBox;
+    QSpinBox *timetableDaysSpinBox;
+    QPushButton *generateTimetableBtn;
+    QPushButton *cancelTimetableBtn;
+    QPushButton *applyTimetableBtn;
+    QProgressBar *timetableProgress;
+    QLabel *timetableStatusLabel;
     
     // 教室管理界面元素
     QLineEdit *roomNameLineEdit;
@@ -147,18 +324,55 @@ private:
     QSpinBox *prioritySpinBox;
     QLineEdit *publishTimeLineEdit;
     QLineEdit *expireTimeLineEdit;
+    QLineEdit *targetLineEdit;
     QTableWidget *announcementTable;
     QPushButton *addAnnouncementBtn;
     QPushButton *updateAnnouncementBtn;
     QPushButton *deleteAnnouncementBtn;
 
-    QTcpServer *tcpServer;
+    SyncService *syncService;          // 班牌同步协议的监听与收发
     QTextEdit *logViewer;
     QSqlDatabase db;
-    QTimer *classUpdateTimer;          // 班级信息更新定时器
-    
-    // 用于跟踪客户端连接
-    QSet<QTcpSocket*> clientSockets;
+    QTimer *wheelTimer;                // 每秒推进一次时间轮，对齐到整秒
+    TimerWheel timerWheel;             // 公告生效与过期、上下课等定时事件
+    QHash<int, QPair<TimerWheel::TimerId, TimerWheel::TimerId>> announcementTimers; // 公告 id -> 生效、过期事件
+    QVector<TimerWheel::TimerId> boundaryTimers; // 今天剩余的上下课时刻和零点
+
+    PollAdvisor pollAdvisor;           // 计算下发给班牌的轮询间隔
+    QVector<int> todayBoundaries;      // 今天的上下课时刻（当天毫秒数，升序）
+    int boundaryWeekday = 0;           // todayBoundaries 对应的星期
+
+    qint64 currentChangeId = 0;        // 最近一次变更编号，随同步响应下发
+    qint64 currentChangeAtMs = 0;      // 最近一次变更的提交时间
+    PropagationStats propagationStats;
+    FleetRegistry fleet;               // 各班牌的身份与同步状态，界面和 FLEET 命令共用
+    OccupancyIndex occupancy;          // 各教室一周的占用位图，空闲教室查询用
+    ConflictEngine conflictEngine;     // 教室与教师的区间树，增改课程前检查冲突
+    CalendarEngine calendar;           // 校历规则，课程按日期展开后下发给班牌
+    AudienceIndex audienceIndex;       // 教室 -> 适用公告的倒排索引，按受众筛选下发的公告
+
+    // 签到写入管道与等待确认的批次（管道编号 -> 来源连接及班牌的批次号）
+    struct PendingCheckin {
+        quint64 connection = 0;
+        QJsonValue batch;
+        QJsonValue tag;                // 经中继转发时中继附加的标记，确认时原样带回
+    };
+    CheckinIngest checkinIngest;
+    QHash<quint64, PendingCheckin> pendingCheckins;
+    AttendanceTracker attendance;      // 各教室、各节课、各楼栋的签到人数，随写入的签到累加
+
+    std::unique_ptr<TimetableGenerator> timetableGenerator; // 最近一次自动排课的问题与结果
+    TimetableGenerator::Result timetableResult;
+    QThread *timetableThread = nullptr;
+    std::atomic_bool timetableCancel{false};
+
+    // 下发给班牌的数据只在变更后重建一次：重建在后台线程，完成后在界面线程交换指针，
+    // 正在生成的响应持有旧数据的引用，旧数据在最后一个引用释放时回收
+    std::shared_ptr<const SnapshotBuilder::Prebuilt> serving;
+    QThread *servingThread = nullptr;
+    bool servingDirty = false;         // 重建期间又有变更，完成后再重建一次
+    QHash<QString, AudienceSlice> audienceSlices; // 受众 -> 当前下发数据中适用的公告，下发数据或索引变化时清空
+    QThread *publishThread = nullptr;
 };
 
 #endif // SERVERWINDOW_H
\ No newline at end of file
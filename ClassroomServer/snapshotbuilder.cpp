@@ -0,0 +1,235 @@
+#include "snapshotbuilder.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonArray>
+#include "schema.h"
+#include "columnar.h"
+
+// 校历两张表只取班牌请求的日期范围；日期为 ISO 格式，按字符串比较即按日期比较
+static QString horizonFilter(const SnapshotBuilder::Horizon &horizon) {
+    if (horizon.days <= 0) {
+        return " WHERE 0";
+    }
+    return QString(" WHERE date >= '%1' AND date <= '%2' ORDER BY date")
+        .arg(horizon.from.toString(Qt::ISODate), horizon.from.addDays(horizon.days - 1).toString(Qt::ISODate));
+}
+
+// 只取 now 时刻有效的公告：发布时间为空或已到，过期时间为空或未到
+static QString announcementFilter(const QDateTime &now) {
+    const QString at = now.toString(SnapshotBuilder::kAnnouncementTimeFormat);
+    return QString(" WHERE COALESCE(publish_time, '') <= '%1' AND (COALESCE(expire_time, '') = '' OR expire_time > '%1')")
+        .arg(at);
+}
+
+// now 之后最近的一个公告发布或过期时刻，没有则返回 0
+static qint64 nextAnnouncementChange(QSqlDatabase db, const QDateTime &now) {
+    const QString at = now.toString(SnapshotBuilder::kAnnouncementTimeFormat);
+    QSqlQuery query(db);
+    if (!query.exec(QString("SELECT MIN(t) FROM (SELECT publish_time AS t FROM announcements WHERE publish_time > '%1' "
+                            "UNION ALL SELECT expire_time FROM announcements WHERE expire_time > '%1')").arg(at))
+        || !query.next() || query.value(0).isNull()) {
+        return 0;
+    }
+    QDateTime next = QDateTime::fromString(query.value(0).toString(), SnapshotBuilder::kAnnouncementTimeFormat);
+    return next.isValid() ? next.toMSecsSinceEpoch() : 0;
+}
+
+// 按描述读出一张服务端表，每行按列下标编码为同步 JSON
+template <const Schema::Table &T>
+static bool readTable(QSqlDatabase db, QJsonArray &array, QString *error, const char *what,
+                      const QString &filter = QString()) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(Schema::sql<T, Schema::Side::Server, Schema::Statement::Select>() + filter)) {
+        if (error) *error = QString("查询%1失败: %2").arg(what, query.lastError().text());
+        return false;
+    }
+    while (query.next()) {
+        array.append(Schema::encodeRow<T>(query));
+    }
+    return true;
+}
+
+bool SnapshotBuilder::build(QSqlDatabase db, QJsonObject &rootObj, QString *error, const Horizon &horizon,
+                            const QDateTime &now) {
+    QJsonArray schedulesArray;
+    QJsonArray classroomsArray;
+    QJsonArray announcementsArray;
+
+    if (!readTable<Schema::Schedules>(db, schedulesArray, error, "课程表")
+        || !readTable<Schema::Classrooms>(db, classroomsArray, error, "教室信息")
+        || !readTable<Schema::Announcements>(db, announcementsArray, error, "公告", announcementFilter(now))) {
+        return false;
+    }
+
+    rootObj["schedules"] = schedulesArray;
+    rootObj["classrooms"] = classroomsArray;
+    rootObj["announcements"] = announcementsArray;
+
+    return buildCalendar(db, horizon, rootObj, error);
+}
+
+bool SnapshotBuilder::buildCalendar(QSqlDatabase db, const Horizon &horizon, QJsonObject &rootObj, QString *error) {
+    if (horizon.days < 0) {
+        return true;
+    }
+    QJsonArray daysArray;
+    QJsonArray occurrencesArray;
+    const QString filter = horizonFilter(horizon);
+    if (!readTable<Schema::CalendarDays>(db, daysArray, error, "校历", filter)
+        || !readTable<Schema::Occurrences>(db, occurrencesArray, error, "课程日程", filter)) {
+        return false;
+    }
+    rootObj["calendar_days"] = daysArray;
+    rootObj["occurrences"] = occurrencesArray;
+    return true;
+}
+
+template <const Schema::Table &T>
+static bool readColumns(QSqlDatabase db, Columnar::TableEncoder<T> &encoder, QString *error, const char *what,
+                        const QString &filter = QString()) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(Schema::sql<T, Schema::Side::Server, Schema::Statement::Select>() + filter)) {
+        if (error) *error = QString("查询%1失败: %2").arg(what, query.lastError().text());
+        return false;
+    }
+    while (query.next()) {
+        encoder.appendRow(query);
+    }
+    return true;
+}
+
+bool SnapshotBuilder::buildColumnar(QSqlDatabase db, const QJsonObject &meta, QByteArray &payload, QString *error,
+                                    const Horizon &horizon, const QDateTime &now) {
+    Columnar::TableEncoder<Schema::Schedules> schedules;
+    Columnar::TableEncoder<Schema::Classrooms> classrooms;
+    Columnar::TableEncoder<Schema::Announcements> announcements;
+
+    if (!readColumns<Schema::Schedules>(db, schedules, error, "课程表")
+        || !readColumns<Schema::Classrooms>(db, classrooms, error, "教室信息")
+        || !readColumns<Schema::Announcements>(db, announcements, error, "公告", announcementFilter(now))) {
+        return false;
+    }
+
+    QByteArray calendar;
+    if (!buildCalendarColumnar(db, horizon, calendar, error)) {
+        return false;
+    }
+
+    const bool withCalendar = horizon.days >= 0;
+    payload = Columnar::beginPayload(meta, withCalendar ? Columnar::TableCount : Columnar::kBaseTableCount);
+    schedules.writeTo(payload, Columnar::ScheduleTable);
+    classrooms.writeTo(payload, Columnar::ClassroomTable);
+    announcements.writeTo(payload, Columnar::AnnouncementTable);
+    payload += calendar;
+    return true;
+}
+
+bool SnapshotBuilder::buildCalendarColumnar(QSqlDatabase db, const Horizon &horizon, QByteArray &encoded,
+                                            QString *error) {
+    if (horizon.days < 0) {
+        return true;
+    }
+    Columnar::TableEncoder<Schema::CalendarDays> days;
+    Columnar::TableEncoder<Schema::Occurrences> occurrences;
+    const QString filter = horizonFilter(horizon);
+    if (!readColumns<Schema::CalendarDays>(db, days, error, "校历", filter)
+        || !readColumns<Schema::Occurrences>(db, occurrences, error, "课程日程", filter)) {
+        return false;
+    }
+    days.writeTo(encoded, Columnar::CalendarDayTable);
+    occurrences.writeTo(encoded, Columnar::OccurrenceTable);
+    return true;
+}
+
+// 同一次查询同时生成 JSON 行和列式编码；ids 不为空时一并读出各行的 id
+template <const Schema::Table &T>
+static bool readBoth(QSqlDatabase db, QJsonArray &array, Columnar::TableEncoder<T> &encoder, QString *error,
+                     const char *what, const QString &filter = QString(), QVector<int> *ids = nullptr) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    const QString select = ids ? Schema::sql<T, Schema::Side::Server, Schema::Statement::SelectWithId>()
+                               : Schema::sql<T, Schema::Side::Server, Schema::Statement::Select>();
+    if (!query.exec(select + filter)) {
+        if (error) *error = QString("查询%1失败: %2").arg(what, query.lastError().text());
+        return false;
+    }
+    const int first = ids ? 1 : 0;
+    while (query.next()) {
+        if (ids) {
+            ids->append(query.value(0).toInt());
+        }
+        array.append(Schema::encodeRow<T>(query, first));
+        encoder.appendRow(query, first);
+    }
+    return true;
+}
+
+bool SnapshotBuilder::prebuild(QSqlDatabase db, Prebuilt &out, QString *error) {
+    QJsonArray schedulesArray;
+    QJsonArray classroomsArray;
+    Columnar::TableEncoder<Schema::Schedules> schedules;
+    Columnar::TableEncoder<Schema::Classrooms> classrooms;
+
+    // 变更编号和各表在同一个读事务中读取，WAL 下看到的是同一次提交后的状态
+    db.transaction();
+    QSqlQuery query(db);
+    if (query.exec("SELECT id, committed_at_ms FROM change_log ORDER BY id DESC LIMIT 1") && query.next()) {
+        out.changeId = query.value(0).toLongLong();
+        out.committedAtMs = query.value(1).toLongLong();
+    }
+    bool ok = readBoth<Schema::Schedules>(db, schedulesArray, schedules, error, "课程表")
+        && readBoth<Schema::Classrooms>(db, classroomsArray, classrooms, error, "教室信息")
+        && refreshAnnouncements(db, out, QDateTime::currentDateTime(), error);
+    query.finish();
+    db.commit();
+    if (!ok) {
+        return false;
+    }
+
+    out.schedules = schedulesArray.size();
+    out.classrooms = classroomsArray.size();
+    out.tables["schedules"] = schedulesArray;
+    out.tables["classrooms"] = classroomsArray;
+    out.columnarTables.clear();
+    schedules.writeTo(out.columnarTables, Columnar::ScheduleTable);
+    classrooms.writeTo(out.columnarTables, Columnar::ClassroomTable);
+    return true;
+}
+
+QVector<int> SnapshotBuilder::announcementRows(const Prebuilt &snapshot, const QVector<int> &ids) {
+    // 两边都按 id 升序，一次归并
+    QVector<int> rows;
+    const QVector<int> &present = snapshot.announcementIds;
+    for (int i = 0, j = 0; i < present.size() && j < ids.size();) {
+        if (present[i] < ids[j]) {
+            ++i;
+        } else if (ids[j] < present[i]) {
+            ++j;
+        } else {
+            rows.append(i);
+            ++i;
+            ++j;
+        }
+    }
+    return rows;
+}
+
+bool SnapshotBuilder::refreshAnnouncements(QSqlDatabase db, Prebuilt &snapshot, const QDateTime &now, QString *error) {
+    QJsonArray announcementsArray;
+    Columnar::TableEncoder<Schema::Announcements> announcements;
+    QVector<int> ids;
+    if (!readBoth<Schema::Announcements>(db, announcementsArray, announcements, error, "公告",
+                                         announcementFilter(now) + " ORDER BY id", &ids)) {
+        return false;
+    }
+
+    snapshot.announcements = announcementsArray.size();
+    snapshot.announcementIds = ids;
+    snapshot.tables["announcements"] = announcementsArray;
+    snapshot.columnarAnnouncements.clear();
+    announcements.writeTo(snapshot.columnarAnnouncements, Columnar::AnnouncementTable);
+    snapshot.announcementsUntilMs = nextAnnouncementChange(db, now);
+    return true;
+}
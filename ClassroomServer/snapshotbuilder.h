@@ -0,0 +1,65 @@
+#ifndef SNAPSHOTBUILDER_H
+#define SNAPSHOTBUILDER_H
+
+#include <QSqlDatabase>
+#include <QJsonObject>
+#include <QByteArray>
+#include <QString>
+#include <QDate>
+#include <QDateTime>
+#include <QVector>
+
+// 从服务端数据库读出下发给班牌的全部数据（课程表、教室、公告）。
+// 与界面无关，便于在基准测试中单独测量。
+class SnapshotBuilder
+{
+public:
+    // 班牌请求的校历范围 [from, from + days)。days < 0 表示班牌没有请求，不下发校历；
+    // days == 0 表示校历未启用，下发空表让班牌清除旧数据
+    struct Horizon {
+        QDate from;
+        int days = -1;
+    };
+
+    // 成功时把 schedules/classrooms/announcements 三个数组写入 rootObj，请求了校历时再加 calendar_days/occurrences；
+    // 失败时返回 false 并给出错误信息。公告只包含在 now 时刻有效的（已到发布时间、未到过期时间）
+    static bool build(QSqlDatabase db, QJsonObject &rootObj, QString *error = nullptr,
+                      const Horizon &horizon = Horizon(), const QDateTime &now = QDateTime::currentDateTime());
+
+    // 同样的数据按列式字典编码（见 columnar.h），meta 随数据一起下发
+    static bool buildColumnar(QSqlDatabase db, const QJsonObject &meta, QByteArray &payload,
+                              QString *error = nullptr, const Horizon &horizon = Horizon(),
+                              const QDateTime &now = QDateTime::currentDateTime());
+
+    // 预先生成的三张基础表，两种格式各一份；数据变化时整体重建，响应时只补上 meta 和校历。
+    // 公告按生效时间过滤，到 announcementsUntilMs 时有效集合会变化，只需单独重读公告表
+    struct Prebuilt {
+        qint64 changeId = 0;         // 数据对应的变更编号，与各表在同一个读事务中读取
+        qint64 committedAtMs = 0;
+        QJsonObject tables;          // schedules/classrooms/announcements 三个数组
+        QByteArray columnarTables;   // 课程表和教室的列式编码，接在 Columnar::beginPayload 之后
+        QByteArray columnarAnnouncements; // 公告的列式编码，接在 columnarTables 之后
+        QVector<int> announcementIds;     // 与 tables["announcements"] 逐行对应的公告 id，升序
+        qint64 announcementsUntilMs = 0;  // 下一个公告生效或过期的时刻，没有则为 0
+        int schedules = 0;
+        int classrooms = 0;
+        int announcements = 0;
+    };
+    static bool prebuild(QSqlDatabase db, Prebuilt &out, QString *error = nullptr);
+    // 只重读公告表，按 now 重新过滤；课程表和教室保持不变
+    static bool refreshAnnouncements(QSqlDatabase db, Prebuilt &snapshot, const QDateTime &now,
+                                     QString *error = nullptr);
+
+    // 下发数据中属于 ids（升序）的公告在 tables["announcements"] 中的行号，按受众筛选公告时使用
+    static QVector<int> announcementRows(const Prebuilt &snapshot, const QVector<int> &ids);
+
+    // 公告时间的存储格式，按字符串比较即按时间比较
+    static constexpr const char *kAnnouncementTimeFormat = "yyyy-MM-dd hh:mm:ss";
+
+    // 校历两张表，按请求的范围单独读取；horizon.days < 0 时什么也不做
+    static bool buildCalendar(QSqlDatabase db, const Horizon &horizon, QJsonObject &rootObj, QString *error = nullptr);
+    static bool buildCalendarColumnar(QSqlDatabase db, const Horizon &horizon, QByteArray &encoded,
+                                      QString *error = nullptr);
+};
+
+#endif // SNAPSHOTBUILDER_H
@@ -0,0 +1,47 @@
+#include "syncframing.h"
+#include <QtEndian>
+#include <QJsonDocument>
+#include <cstring>
+
+bool SyncFraming::takeRequest(QByteArray &buffer, QByteArray &command, QJsonObject &args, bool allowBare) {
+    QByteArray line;
+    int newline = buffer.indexOf('\n');
+    if (newline >= 0) {
+        line = buffer.left(newline);
+        buffer.remove(0, newline + 1);
+    } else if (allowBare && !buffer.contains('{')) {
+        // 不带参数的旧格式请求，整段即为命令
+        line = buffer;
+        buffer.clear();
+    } else {
+        return false;
+    }
+
+    line = line.trimmed();
+    int space = line.indexOf(' ');
+    command = space < 0 ? line : line.left(space);
+    args = QJsonObject();
+    if (space >= 0) {
+        QJsonDocument doc = QJsonDocument::fromJson(line.mid(space + 1));
+        if (doc.isObject()) {
+            args = doc.object();
+        }
+    }
+    return true;
+}
+
+bool SyncFraming::isSyncRequest(const QByteArray &request) {
+    QByteArray trimmed = request.trimmed();
+    if (trimmed.isEmpty()) {
+        return true;
+    }
+    QByteArray upper = trimmed.toUpper();
+    return upper.contains("GET_SCHEDULE") || upper.contains("SYNC");
+}
+
+QByteArray SyncFraming::frame(const QByteArray &payload) {
+    QByteArray framed(4 + payload.size(), Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(payload.size()), framed.data());
+    std::memcpy(framed.data() + 4, payload.constData(), payload.size());
+    return framed;
+}
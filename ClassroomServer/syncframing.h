@@ -0,0 +1,21 @@
+#ifndef SYNCFRAMING_H
+#define SYNCFRAMING_H
+
+#include <QByteArray>
+#include <QJsonObject>
+
+// 班牌同步协议的请求识别与响应分帧：4 字节大端长度 + 数据。
+// 请求为一行 "命令 {JSON参数}\n"；旧版班牌只发送不带换行的 "GET_SCHEDULE"。
+class SyncFraming
+{
+public:
+    // 从缓冲区取出一条完整请求；数据尚不完整时返回 false 并保留缓冲区。
+    // allowBare 为 false 时只接受以换行结尾的请求：连接上发过带换行的请求后，没有换行的数据只是半行
+    static bool takeRequest(QByteArray &buffer, QByteArray &command, QJsonObject &args, bool allowBare = true);
+    // 空请求、GET_SCHEDULE 与 SYNC（不区分大小写）都视为同步请求
+    static bool isSyncRequest(const QByteArray &request);
+    // 长度头与数据拼成一块缓冲区，一次写入套接字
+    static QByteArray frame(const QByteArray &payload);
+};
+
+#endif // SYNCFRAMING_H
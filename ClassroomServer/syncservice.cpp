@@ -0,0 +1,288 @@
+#include "syncservice.h"
+#include "syncframing.h"
+#include "laneframes.h"
+#include <QDateTime>
+
+static const int kMaxRequestBytes = 64 * 1024;
+// 分道连接的发送水位线：套接字中待发数据低于此值时才写入下一块
+static const qint64 kBulkHighWaterBytes = 64 * 1024;
+
+SyncService::SyncService(QObject *parent)
+    : QObject(parent), tcpServer(new QTcpServer(this)) {
+    connect(tcpServer, &QTcpServer::newConnection, this, &SyncService::onNewConnection);
+}
+
+void SyncService::setPayloadProvider(PayloadProvider provider) {
+    payloadProvider = std::move(provider);
+}
+
+void SyncService::addCommand(const QByteArray &command, CommandHandler handler) {
+    commands.insert(command, std::move(handler));
+}
+
+void SyncService::addAsyncCommand(const QByteArray &command, AsyncCommandHandler handler) {
+    asyncCommands.insert(command, std::move(handler));
+}
+
+bool SyncService::reply(quint64 connection, Lane::FrameType type, const QByteArray &payload) {
+    QTcpSocket *socket = connections.value(connection);
+    if (!socket || socket->state() != QAbstractSocket::ConnectedState) {
+        return false;
+    }
+    auto it = clients.constFind(socket);
+    if (it == clients.constEnd()) {
+        return false;
+    }
+    socket->write(it->lanes ? Lane::frame(type, payload) : SyncFraming::frame(payload));
+    return true;
+}
+
+bool SyncService::listen(const QHostAddress &address, quint16 port) {
+    return tcpServer->listen(address, port);
+}
+
+quint16 SyncService::serverPort() const {
+    return tcpServer->serverPort();
+}
+
+QString SyncService::errorString() const {
+    return tcpServer->errorString();
+}
+
+void SyncService::onNewConnection() {
+    while (QTcpSocket *clientSocket = tcpServer->nextPendingConnection()) {
+        connect(clientSocket, &QTcpSocket::readyRead, this, &SyncService::onReadClientData);
+        connect(clientSocket, &QTcpSocket::bytesWritten, this, &SyncService::onBytesWritten);
+        connect(clientSocket, &QTcpSocket::disconnected, this, &SyncService::onClientDisconnected);
+        connect(clientSocket, &QTcpSocket::disconnected, clientSocket, &QTcpSocket::deleteLater);
+
+        // 将socket存储起来，便于后续管理和清理
+        ClientState state;
+        state.id = nextConnectionId++;
+        clients.insert(clientSocket, state);
+        connections.insert(state.id, clientSocket);
+
+        emit logMessage("客户端已连接: " + clientSocket->peerAddress().toString());
+    }
+}
+
+void SyncService::onReadClientData() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !clients.contains(socket)) return;
+
+    // 检查是否有数据可读
+    if (socket->bytesAvailable() == 0) {
+        return; // 如果没有数据可读，则直接返回
+    }
+
+    // 读取数据，凑成完整请求后再处理；分道连接上可能先后有多条请求
+    clients[socket].requestBuffer.append(socket->readAll());
+
+    QByteArray command;
+    QJsonObject args;
+    while (true) {
+        auto it = clients.find(socket);
+        if (it == clients.end()) {
+            return; // 处理上一条请求时连接已断开
+        }
+        QByteArray &pending = it->requestBuffer;
+        if (pending.isEmpty()) {
+            return;
+        }
+        // 只有从未发过换行的旧班牌才按不带换行的整段命令处理，保持打开的连接上读到半行时继续等待
+        const bool terminated = pending.indexOf('\n') >= 0;
+        if (!SyncFraming::takeRequest(pending, command, args, !it->lineFramed)) {
+            if (pending.size() > kMaxRequestBytes) {
+                emit logMessage("请求过长，断开连接: " + socket->peerAddress().toString());
+                pending.clear();
+                socket->disconnectFromHost();
+            }
+            return;
+        }
+        it->lineFramed = it->lineFramed || terminated;
+        handleRequest(socket, command, args);
+    }
+}
+
+void SyncService::handleRequest(QTcpSocket *socket, const QByteArray &command, const QJsonObject &args) {
+    // 异步命令（签到等）到达频繁，不逐条写日志
+    const QByteArray name = command.trimmed().toUpper();
+    auto asyncHandler = asyncCommands.constFind(name);
+    if (asyncHandler != asyncCommands.constEnd()) {
+        asyncHandler.value()(clients.value(socket).id, args);
+        return;
+    }
+
+    qint64 requestAtMs = QDateTime::currentMSecsSinceEpoch();
+    QString requestStr = QString::fromUtf8(command);
+    emit logMessage("收到请求: " + requestStr);
+
+    // 查询命令：不计入同步请求，也不改变连接的帧格式
+    auto handler = commands.constFind(name);
+    if (handler != commands.constEnd()) {
+        sendResponse(socket, handler.value()(args));
+        return;
+    }
+
+    // 验证请求内容，只有特定请求才返回数据
+    if (!SyncFraming::isSyncRequest(command) || !payloadProvider) {
+        emit logMessage("无效请求: " + requestStr + ", 拒绝发送数据");
+        // 对无效请求立即断开连接以防止滥用
+        socket->disconnectFromHost();
+        return;
+    }
+
+    if (args["lanes"].toBool()) {
+        ClientState &state = clients[socket];
+        if (state.bulkOffset < state.bulk.size()) {
+            // 班牌只在上一份数据收完后才会再次请求，这里直接忽略
+            emit logMessage("上一份数据尚未发完，忽略重复请求");
+            return;
+        }
+        state.lanes = true;
+        state.args = args;
+    }
+
+    emit syncRequested(args, requestAtMs);
+
+    emit logMessage("正在准备发送数据...");
+    QByteArray responseData = payloadProvider(args, requestAtMs);
+    emit logMessage("数据大小: " + QString::number(responseData.size()) + " 字节");
+
+    if (!clients.contains(socket)) {
+        return;
+    }
+    // 先取地址：旧协议的发送会等待写完，期间连接可能已断开
+    QString peer = socket->peerAddress().toString();
+    sendResponse(socket, responseData);
+    emit syncServed(args, peer, responseData.size());
+}
+
+void SyncService::sendResponse(QTcpSocket *socket, const QByteArray &responseData) {
+    auto it = clients.find(socket);
+    if (it == clients.end()) {
+        return;
+    }
+    if (it->lanes) {
+        if (responseData.isEmpty()) {
+            socket->write(Lane::frame(Lane::BulkEnd, QByteArray()));
+            return;
+        }
+        it->bulk = responseData;
+        it->bulkOffset = 0;
+        pumpBulk(socket);
+        return;
+    }
+
+    // 长度头（4字节，大端序）与数据合并为一次写入
+    QByteArray framed = SyncFraming::frame(responseData);
+    qint64 totalBytesWritten = socket->write(framed);
+    if (totalBytesWritten != framed.size()) {
+        emit logMessage("发送数据失败，期望发送" + QString::number(framed.size()) + "字节，实际发送"
+                        + QString::number(totalBytesWritten) + "字节");
+        return;
+    }
+
+    socket->flush();
+    emit logMessage("已写入 " + QString::number(totalBytesWritten) + " 字节");
+
+    if (socket->waitForBytesWritten(5000)) {
+        emit logMessage("数据已完全发送，等待客户端断开连接...");
+    } else {
+        emit logMessage("数据发送超时");
+    }
+}
+
+void SyncService::onBytesWritten() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket) {
+        pumpBulk(socket);
+    }
+}
+
+void SyncService::pumpBulk(QTcpSocket *socket) {
+    auto it = clients.find(socket);
+    if (it == clients.end() || it->bulk.isEmpty()) {
+        return;
+    }
+
+    ClientState &state = it.value();
+    while (state.bulkOffset < state.bulk.size() && socket->bytesToWrite() < kBulkHighWaterBytes) {
+        int length = qMin(Lane::kChunkBytes, int(state.bulk.size()) - state.bulkOffset);
+        bool last = state.bulkOffset + length == state.bulk.size();
+        socket->write(Lane::frame(last ? Lane::BulkEnd : Lane::BulkChunk, state.bulk.mid(state.bulkOffset, length)));
+        state.bulkOffset += length;
+    }
+
+    if (state.bulkOffset >= state.bulk.size()) {
+        emit logMessage("数据已分块写入 " + QString::number(state.bulk.size()) + " 字节，连接保持打开");
+        state.bulk.clear();
+        state.bulkOffset = 0;
+    }
+}
+
+int SyncService::pushUrgent(const QByteArray &payload) {
+    return pushFrame(Lane::Urgent, payload);
+}
+
+int SyncService::pushUrgent(const PushProvider &provider) {
+    return pushFrame(Lane::Urgent, provider);
+}
+
+int SyncService::pushVersion(const QByteArray &payload) {
+    return pushFrame(Lane::Version, payload);
+}
+
+int SyncService::pushAnnouncements(const QByteArray &payload) {
+    return pushFrame(Lane::Announcements, payload);
+}
+
+int SyncService::pushAnnouncements(const PushProvider &provider) {
+    return pushFrame(Lane::Announcements, provider);
+}
+
+int SyncService::pushAttendance(const PushProvider &provider) {
+    return pushFrame(Lane::Attendance, provider);
+}
+
+int SyncService::pushFrame(Lane::FrameType type, const QByteArray &payload) {
+    // 直接写入套接字，排在已写入的数据块之后、尚未写入的数据块之前
+    QByteArray framed = Lane::frame(type, payload);
+    int sent = 0;
+    for (auto it = clients.constBegin(); it != clients.constEnd(); ++it) {
+        QTcpSocket *socket = it.key();
+        if (it->lanes && socket->state() == QAbstractSocket::ConnectedState) {
+            socket->write(framed);
+            ++sent;
+        }
+    }
+    return sent;
+}
+
+int SyncService::pushFrame(Lane::FrameType type, const PushProvider &provider) {
+    int sent = 0;
+    for (auto it = clients.constBegin(); it != clients.constEnd(); ++it) {
+        QTcpSocket *socket = it.key();
+        if (!it->lanes || socket->state() != QAbstractSocket::ConnectedState) {
+            continue;
+        }
+        QByteArray payload = provider(it->args);
+        if (!payload.isEmpty()) {
+            socket->write(Lane::frame(type, payload));
+            ++sent;
+        }
+    }
+    return sent;
+}
+
+void SyncService::onClientDisconnected() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    auto it = clients.find(socket);
+    if (it != clients.end()) {
+        connections.remove(it->id);
+        clients.erase(it);
+        emit logMessage("客户端已断开连接: " + socket->peerAddress().toString());
+    }
+}
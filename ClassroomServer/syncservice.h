@@ -0,0 +1,94 @@
+#ifndef SYNCSERVICE_H
+#define SYNCSERVICE_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QHash>
+#include <QJsonObject>
+#include <functional>
+#include "laneframes.h"
+
+// 班牌同步协议的服务端：接受连接、拼出完整请求、按请求生成响应并分帧发送。
+// 中心服务器和楼宇中继共用，数据来源由 PayloadProvider 决定。
+//
+// 请求带 "lanes":true 的连接使用分道帧（见 laneframes.h）并保持打开：完整数据按小块发送，
+// 套接字待发数据低于水位线时才继续写下一块，紧急公告因此最多排在一个水位线的数据之后。
+class SyncService : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 根据请求参数生成响应数据（不含长度头）
+    using PayloadProvider = std::function<QByteArray(const QJsonObject &args, qint64 requestAtMs)>;
+    // 同步以外的查询命令（如 FLEET，命令名用大写注册），返回的数据按连接当前的帧格式发送
+    using CommandHandler = std::function<QByteArray(const QJsonObject &args)>;
+    // 按连接生成推送内容：参数为该连接最近一次同步请求的参数，返回空数据时不向该连接推送
+    using PushProvider = std::function<QByteArray(const QJsonObject &args)>;
+    // 结果稍后才能给出的命令（如 CHECKIN 要等写入数据库）：处理函数记下连接编号，就绪后调用 reply
+    using AsyncCommandHandler = std::function<void(quint64 connection, const QJsonObject &args)>;
+
+    explicit SyncService(QObject *parent = nullptr);
+
+    void setPayloadProvider(PayloadProvider provider);
+    void addCommand(const QByteArray &command, CommandHandler handler);
+    void addAsyncCommand(const QByteArray &command, AsyncCommandHandler handler);
+    // 向 connection 发送异步命令的结果：分道连接上用 type 帧，可插在数据块之间；连接已断开时返回 false
+    bool reply(quint64 connection, Lane::FrameType type, const QByteArray &payload);
+    bool listen(const QHostAddress &address, quint16 port);
+    quint16 serverPort() const;
+    QString errorString() const;
+    int clientCount() const { return clients.size(); }
+
+    // 向所有分道连接发送紧急公告，返回发送的连接数
+    int pushUrgent(const QByteArray &payload);
+    int pushUrgent(const PushProvider &provider);
+    // 向所有分道连接发送新版本通知，返回发送的连接数
+    int pushVersion(const QByteArray &payload);
+    // 向所有分道连接发送当前有效的公告集合，返回发送的连接数
+    int pushAnnouncements(const QByteArray &payload);
+    int pushAnnouncements(const PushProvider &provider);
+    // 向分道连接发送出勤人数，内容按连接生成，返回发送的连接数
+    int pushAttendance(const PushProvider &provider);
+
+signals:
+    void logMessage(const QString &message);
+    // 收到同步请求，在生成响应之前发出；直连时处理完才会调用 PayloadProvider
+    void syncRequested(const QJsonObject &args, qint64 requestAtMs);
+    // 同步响应已交给套接字；peer 为对端地址，bytes 为响应数据大小
+    void syncServed(const QJsonObject &args, const QString &peer, qint64 bytes);
+
+private slots:
+    void onNewConnection();
+    void onReadClientData();
+    void onClientDisconnected();
+    void onBytesWritten();
+
+private:
+    struct ClientState {
+        quint64 id = 0;             // 连接编号，异步命令据此找回连接
+        QByteArray requestBuffer;   // 尚未凑成完整请求的数据
+        bool lanes = false;         // 使用分道帧
+        bool lineFramed = false;    // 已收到过以换行结尾的请求，之后的请求都等到换行再处理
+        QJsonObject args;           // 最近一次同步请求的参数，按受众推送时使用
+        QByteArray bulk;            // 正在分块发送的完整数据
+        int bulkOffset = 0;         // 已写入套接字的字节数
+    };
+
+    void handleRequest(QTcpSocket *socket, const QByteArray &command, const QJsonObject &args);
+    void sendResponse(QTcpSocket *socket, const QByteArray &responseData);
+    void pumpBulk(QTcpSocket *socket);
+    int pushFrame(Lane::FrameType type, const QByteArray &payload);
+    int pushFrame(Lane::FrameType type, const PushProvider &provider);
+
+    QTcpServer *tcpServer;
+    PayloadProvider payloadProvider;
+    QHash<QByteArray, CommandHandler> commands;
+    QHash<QByteArray, AsyncCommandHandler> asyncCommands;
+    QHash<QTcpSocket*, ClientState> clients;        // 当前连接及其收发状态
+    QHash<quint64, QTcpSocket*> connections;        // 连接编号 -> 连接
+    quint64 nextConnectionId = 1;
+};
+
+#endif // SYNCSERVICE_H
@@ -0,0 +1,137 @@
+#include "timerwheel.h"
+#include <algorithm>
+#include <iterator>
+
+TimerWheel::TimerWheel(qint64 tickMs) : tick(qMax<qint64>(1, tickMs)) {
+    reset(0);
+}
+
+void TimerWheel::reset(qint64 nowMs) {
+    nodes.clear();
+    freeHead = -1;
+    std::fill(std::begin(buckets), std::end(buckets), -1);
+    nextTick = qMax<qint64>(0, nowMs) / tick;
+    count = 0;
+    due.clear();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(qint64 atMs, int kind, qint64 key) {
+    int node = freeHead;
+    if (node >= 0) {
+        freeHead = nodes[node].next;
+    } else {
+        node = nodes.size();
+        nodes.append(Node{0, 0, 0, 1, -1, -1, -1});
+    }
+    Node &n = nodes[node];
+    n.atMs = atMs;
+    n.key = key;
+    n.kind = kind;
+    place(node);
+    ++count;
+    return (TimerId(n.generation) << 32) | quint32(node);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    int node = int(quint32(id));
+    if (node >= nodes.size() || nodes[node].generation != quint32(id >> 32) || nodes[node].bucket < 0) {
+        return false;
+    }
+    unlink(node);
+    release(node);
+    return true;
+}
+
+void TimerWheel::place(int node) {
+    Node &n = nodes[node];
+    // 在 atMs 当格或之后的第一格触发；已过去的时刻放到下一个待处理的格
+    qint64 expires = qMax(nextTick, (qMax<qint64>(0, n.atMs) + tick - 1) / tick);
+    qint64 delta = expires - nextTick;
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (qint64(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    if (level == kLevels - 1) {
+        // 超出最高层范围的时刻先放在最远处，转到时按真实时刻重新放置
+        expires = nextTick + qMin(delta, (qint64(1) << (kSlotBits * kLevels)) - 1);
+    }
+    int bucket = level * kSlots + int((expires >> (kSlotBits * level)) & kSlotMask);
+
+    n.bucket = bucket;
+    n.prev = -1;
+    n.next = buckets[bucket];
+    if (n.next >= 0) {
+        nodes[n.next].prev = node;
+    }
+    buckets[bucket] = node;
+}
+
+void TimerWheel::unlink(int node) {
+    Node &n = nodes[node];
+    if (n.prev >= 0) {
+        nodes[n.prev].next = n.next;
+    } else {
+        buckets[n.bucket] = n.next;
+    }
+    if (n.next >= 0) {
+        nodes[n.next].prev = n.prev;
+    }
+    n.bucket = -1;
+}
+
+void TimerWheel::release(int node) {
+    Node &n = nodes[node];
+    n.generation = n.generation + 1 ? n.generation + 1 : 1;  // 代数不为 0，id 因此不为 0
+    n.bucket = -1;
+    n.next = freeHead;
+    freeHead = node;
+    --count;
+}
+
+void TimerWheel::cascade(int level, int slot) {
+    int bucket = level * kSlots + slot;
+    int node = buckets[bucket];
+    buckets[bucket] = -1;
+    while (node >= 0) {
+        int next = nodes[node].next;
+        place(node);
+        node = next;
+    }
+}
+
+void TimerWheel::collect(qint64 nowMs) {
+    due.clear();
+    qint64 target = qMax<qint64>(0, nowMs) / tick;
+    if (count == 0) {
+        nextTick = qMax(nextTick, target + 1);
+        return;
+    }
+
+    while (nextTick <= target) {
+        // 低层转满一圈时，上一层当前槽的事件都落在接下来的一圈内，重新分配到下层
+        for (int level = 1; level < kLevels; ++level) {
+            if ((nextTick >> (kSlotBits * (level - 1))) & kSlotMask) {
+                break;
+            }
+            cascade(level, int((nextTick >> (kSlotBits * level)) & kSlotMask));
+        }
+
+        int bucket = int(nextTick & kSlotMask);
+        int node = buckets[bucket];
+        buckets[bucket] = -1;
+        while (node >= 0) {
+            Node &n = nodes[node];
+            int next = n.next;
+            due.append(Event{(TimerId(n.generation) << 32) | quint32(node), n.atMs, n.kind, n.key});
+            release(node);
+            node = next;
+        }
+        ++nextTick;
+
+        if (count == 0) {
+            nextTick = qMax(nextTick, target + 1);
+            break;
+        }
+    }
+}
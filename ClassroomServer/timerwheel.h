@@ -0,0 +1,74 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QVector>
+
+// 分层时间轮：4 层、每层 256 个槽，一格为 tickMs。第 0 层覆盖最近 256 格，往上每层扩大 256 倍，
+// 1 秒一格时共可表示约 136 年；更远的时刻放在最高层，转到时重新放置。
+// 插入和取消都是 O(1)：节点存放在数组中，按槽串成双向链表，取消时直接摘下，删除的节点进入空闲表复用。
+// 推进时逐格处理，第 0 层转满一圈时把上一层对应槽的事件重新分配到下层（级联）。
+class TimerWheel
+{
+public:
+    using TimerId = quint64;         // 低 32 位为节点下标，高 32 位为节点的代数，节点复用后旧的 id 失效
+
+    struct Event {
+        TimerId id;
+        qint64 atMs;
+        int kind;
+        qint64 key;
+    };
+
+    explicit TimerWheel(qint64 tickMs = 1000);
+
+    void reset(qint64 nowMs);        // 清空全部事件，从 nowMs 开始计时
+    // 在 atMs 或之后的第一格触发；已经过去的时刻在下一次推进时触发。返回值用于取消，不会为 0
+    TimerId schedule(qint64 atMs, int kind, qint64 key);
+    bool cancel(TimerId id);         // 事件不存在或已触发时返回 false
+    int size() const { return count; }
+    qint64 tickMs() const { return tick; }
+
+    // 推进到 nowMs，对每个到期的事件调用 fire(event)，返回触发的个数。
+    // 到期事件先全部从时间轮取出再依次回调，回调中可以安全地插入和取消；
+    // 同一次推进中已取出的事件不能再被取消
+    template <typename Fire>
+    int advance(qint64 nowMs, Fire fire) {
+        collect(nowMs);
+        for (const Event &event : due) {
+            fire(event);
+        }
+        return due.size();
+    }
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr int kSlots = 1 << kSlotBits;
+    static constexpr int kSlotMask = kSlots - 1;
+
+    struct Node {
+        qint64 atMs;
+        qint64 key;
+        int kind;
+        quint32 generation;
+        int prev;
+        int next;
+        int bucket;       // 所在的槽（层 * kSlots + 槽号），空闲节点为 -1
+    };
+
+    void place(int node);            // 按到期格放入对应的层和槽
+    void unlink(int node);
+    void release(int node);
+    void cascade(int level, int slot);
+    void collect(qint64 nowMs);      // 逐格推进，到期事件移入 due
+
+    QVector<Node> nodes;
+    int freeHead = -1;
+    int buckets[kLevels * kSlots];
+    qint64 tick;
+    qint64 nextTick = 0;             // 下一个待处理的格，更早的格都已处理
+    int count = 0;
+    QVector<Event> due;              // 复用，推进时不重新分配
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,416 @@
+#include "timetablegenerator.h"
+#include "timetableversions.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QRandomGenerator>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+// 一处硬约束违反折合的代价；比任何单步的软约束变化都大
+static const int kHardWeight = 50;
+// 没有容量足够的教室时，在最大的几间中选
+static const int kFallbackRooms = 4;
+// 各链的起始温度依次为基准的 1-4 倍，高温链负责跳出局部最优，低温链负责收敛
+static const double kBaseTemperature = 6.0;
+static const double kFinalTemperature = 0.05;
+
+struct TimetableGenerator::Chain {
+    const TimetableGenerator *problem;
+    QRandomGenerator rng;
+    double startTemperature;
+
+    QVector<int> cell;          // 每次课所在时间格
+    QVector<int> room;          // 每次课所在教室
+    QVector<quint16> roomUse;   // [时间格][教室] 的课数
+    QVector<quint16> teacherUse;
+    QVector<quint16> groupUse;
+    QVector<quint16> courseDay; // [需求][天] 的课数
+    QVector<quint16> teacherDay;
+    int hard = 0;
+    int soft = 0;
+
+    Chain(const TimetableGenerator *problem, quint64 seed, int index)
+        : problem(problem), startTemperature(kBaseTemperature * (1 + index % 4)) {
+        const quint32 seedWords[3] = {quint32(seed), quint32(seed >> 32), quint32(index)};
+        rng.seed(seedWords, 3);
+
+        roomUse.fill(0, problem->cellCount * problem->roomList.size());
+        teacherUse.fill(0, problem->cellCount * problem->teacherCount);
+        groupUse.fill(0, problem->cellCount * problem->groupCount);
+        courseDay.fill(0, problem->demandList.size() * problem->rules.days);
+        teacherDay.fill(0, problem->teacherCount * problem->rules.days);
+        cell.fill(0, problem->sessionDemand.size());
+        room.fill(0, problem->sessionDemand.size());
+    }
+
+    int cost() const { return hard * kHardWeight + soft; }
+
+    double temperatureAt(double progress) const {
+        return startTemperature * std::pow(kFinalTemperature / startTemperature, progress);
+    }
+
+    // 重叠代价为 max(0, n - 1)
+    void clash(quint16 &count, int sign) {
+        if (sign > 0) {
+            if (count >= 1) ++hard;
+            ++count;
+        } else {
+            --count;
+            if (count >= 1) --hard;
+        }
+    }
+
+    // sign 为 +1 时把第 s 次课放到 (c, r)，为 -1 时从那里移走，同时增量更新代价
+    void place(int s, int c, int r, int sign) {
+        const TimetableGenerator &p = *problem;
+        const int d = p.sessionDemand[s];
+        const int t = p.demandTeacher[d];
+        const int g = p.demandGroup[d];
+        const int day = c / p.rules.periods.size();
+
+        clash(roomUse[c * p.roomList.size() + r], sign);
+        if (t >= 0) {
+            clash(teacherUse[c * p.teacherCount + t], sign);
+            if (!p.teacherBlocked[t].isEmpty() && p.teacherBlocked[t][c]) hard += sign;
+
+            quint16 &perDay = teacherDay[t * p.rules.days + day];
+            if (sign > 0) {
+                if (perDay >= p.rules.maxTeacherPeriodsPerDay) ++soft;
+                ++perDay;
+            } else {
+                --perDay;
+                if (perDay >= p.rules.maxTeacherPeriodsPerDay) --soft;
+            }
+        }
+        if (g >= 0) {
+            clash(groupUse[c * p.groupCount + g], sign);
+        }
+        if (p.roomList[r].capacity < p.demandList[d].students) hard += sign;
+
+        quint16 &sameDay = courseDay[d * p.rules.days + day];
+        if (sign > 0) {
+            if (sameDay >= 1) ++soft;
+            ++sameDay;
+        } else {
+            --sameDay;
+            if (sameDay >= 1) --soft;
+        }
+    }
+
+    void randomize() {
+        for (int s = 0; s < cell.size(); ++s) {
+            const QVector<int> &rooms = problem->eligibleRooms[problem->sessionDemand[s]];
+            cell[s] = rng.bounded(problem->cellCount);
+            room[s] = rooms[rng.bounded(rooms.size())];
+            place(s, cell[s], room[s], +1);
+        }
+    }
+
+    bool accept(int delta, double temperature) {
+        return delta <= 0 || rng.generateDouble() < std::exp(-delta / temperature);
+    }
+
+    void anneal(int steps, double temperature, const std::atomic_bool *cancel) {
+        const int sessions = cell.size();
+        for (int i = 0; i < steps && hard + soft > 0; ++i) {
+            if (cancel && (i & 1023) == 0 && cancel->load()) {
+                return;
+            }
+
+            const int s = rng.bounded(sessions);
+            const int before = cost();
+
+            if (rng.bounded(4) == 0) {
+                // 交换两次课的时间格，教室不变；时间格已满时单独移动很难找到空位
+                const int other = rng.bounded(sessions);
+                if (other == s || cell[other] == cell[s]) continue;
+                const int cellA = cell[s];
+                const int cellB = cell[other];
+                place(s, cellA, room[s], -1);
+                place(other, cellB, room[other], -1);
+                place(s, cellB, room[s], +1);
+                place(other, cellA, room[other], +1);
+                if (accept(cost() - before, temperature)) {
+                    cell[s] = cellB;
+                    cell[other] = cellA;
+                } else {
+                    place(s, cellB, room[s], -1);
+                    place(other, cellA, room[other], -1);
+                    place(s, cellA, room[s], +1);
+                    place(other, cellB, room[other], +1);
+                }
+                continue;
+            }
+
+            const QVector<int> &rooms = problem->eligibleRooms[problem->sessionDemand[s]];
+            const int newCell = rng.bounded(problem->cellCount);
+            const int newRoom = rooms[rng.bounded(rooms.size())];
+            if (newCell == cell[s] && newRoom == room[s]) continue;
+
+            place(s, cell[s], room[s], -1);
+            place(s, newCell, newRoom, +1);
+            if (accept(cost() - before, temperature)) {
+                cell[s] = newCell;
+                room[s] = newRoom;
+            } else {
+                place(s, newCell, newRoom, -1);
+                place(s, cell[s], room[s], +1);
+            }
+        }
+    }
+
+    // 复制解和计数，保留自己的随机数与温度
+    void copyStateFrom(const Chain &other) {
+        cell = other.cell;
+        room = other.room;
+        roomUse = other.roomUse;
+        teacherUse = other.teacherUse;
+        groupUse = other.groupUse;
+        courseDay = other.courseDay;
+        teacherDay = other.teacherDay;
+        hard = other.hard;
+        soft = other.soft;
+    }
+};
+
+TimetableGenerator::TimetableGenerator(const QVector<Demand> &demands, const QVector<Room> &rooms,
+                                       const Constraints &constraints)
+    : demandList(demands), roomList(rooms), rules(constraints) {
+    rules.days = qBound(1, rules.days, 7);
+    cellCount = rules.days * rules.periods.size();
+
+    QHash<QString, int> teacherIds;
+    QHash<QString, int> groupIds;
+    for (const Demand &demand : std::as_const(demandList)) {
+        int teacher = -1;
+        if (!demand.teacher.isEmpty()) {
+            teacher = teacherIds.value(demand.teacher, -1);
+            if (teacher < 0) {
+                teacher = teacherIds.size();
+                teacherIds.insert(demand.teacher, teacher);
+            }
+        }
+        int group = -1;
+        if (!demand.group.isEmpty()) {
+            group = groupIds.value(demand.group, -1);
+            if (group < 0) {
+                group = groupIds.size();
+                groupIds.insert(demand.group, group);
+            }
+        }
+        demandTeacher.append(teacher);
+        demandGroup.append(group);
+    }
+    teacherCount = teacherIds.size();
+    groupCount = groupIds.size();
+
+    teacherBlocked.resize(teacherCount);
+    for (auto it = rules.teacherUnavailable.constBegin(); it != rules.teacherUnavailable.constEnd(); ++it) {
+        int teacher = teacherIds.value(it.key(), -1);
+        if (teacher < 0) continue;
+        teacherBlocked[teacher].fill(0, cellCount);
+        for (int c : it.value()) {
+            if (c >= 0 && c < cellCount) teacherBlocked[teacher][c] = 1;
+        }
+    }
+
+    // 按容量从大到小，便于取最大的几间作后备
+    QVector<int> bySize(roomList.size());
+    std::iota(bySize.begin(), bySize.end(), 0);
+    std::stable_sort(bySize.begin(), bySize.end(), [this](int a, int b) {
+        return roomList[a].capacity > roomList[b].capacity;
+    });
+
+    for (int d = 0; d < demandList.size(); ++d) {
+        QVector<int> rooms;
+        for (int r = 0; r < roomList.size(); ++r) {
+            if (roomList[r].capacity >= demandList[d].students) rooms.append(r);
+        }
+        if (rooms.isEmpty()) {
+            rooms = bySize.mid(0, kFallbackRooms);
+        }
+        eligibleRooms.append(rooms);
+        for (int i = 0; i < demandList[d].sessions; ++i) {
+            sessionDemand.append(d);
+        }
+    }
+}
+
+bool TimetableGenerator::loadFromDb(QSqlDatabase db, QVector<Demand> &demands, QVector<Room> &rooms,
+                                    Constraints &constraints, QString *error) {
+    QSqlQuery query(db);
+    QHash<QString, int> capacities;
+    if (!query.exec("SELECT room_name, capacity FROM classrooms ORDER BY room_name")) {
+        if (error) *error = "读取教室失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        Room room;
+        room.name = query.value(0).toString();
+        room.capacity = query.value(1).toInt();
+        capacities.insert(room.name, room.capacity);
+        rooms.append(room);
+    }
+
+    // 节次沿用现有课程表中出现过的起止时间
+    if (!query.exec("SELECT DISTINCT start_time, end_time FROM master_schedules "
+                    "WHERE start_time <> '' AND end_time <> '' ORDER BY start_time, end_time")) {
+        if (error) *error = "读取节次失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        constraints.periods.append(Period{query.value(0).toString(), query.value(1).toString()});
+    }
+    if (constraints.periods.isEmpty()) {
+        constraints.periods = {{"08:00", "09:40"}, {"10:00", "11:40"}, {"13:30", "15:10"},
+                               {"15:30", "17:10"}, {"19:00", "20:40"}};
+    }
+
+    if (!query.exec("SELECT room, course, teacher, COUNT(*) FROM master_schedules "
+                    "GROUP BY room, course, teacher ORDER BY room, course, teacher")) {
+        if (error) *error = "读取课程需求失败: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        Demand demand;
+        demand.group = query.value(0).toString();
+        demand.course = query.value(1).toString();
+        demand.teacher = query.value(2).toString();
+        demand.sessions = query.value(3).toInt();
+        demand.students = capacities.value(demand.group, 0);
+        demands.append(demand);
+    }
+    return true;
+}
+
+TimetableGenerator::Result TimetableGenerator::run(const Options &options, const ProgressCallback &progress,
+                                                   const std::atomic_bool *cancel) const {
+    QElapsedTimer clock;
+    clock.start();
+
+    Result result;
+    if (sessionDemand.isEmpty()) {
+        result.hardViolations = 0;
+        return result;
+    }
+    if (roomList.isEmpty() || cellCount == 0) {
+        result.hardViolations = sessionDemand.size();
+        return result;
+    }
+
+    const int chainCount = qMax(1, options.chains);
+    const int rounds = qMax(1, options.rounds);
+    std::vector<Chain> chains;
+    chains.reserve(chainCount);
+    for (int i = 0; i < chainCount; ++i) {
+        chains.emplace_back(this, options.seed, i);
+        chains.back().randomize();
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(options.threads > 0 ? options.threads : QThread::idealThreadCount());
+
+    int bestCost = -1;
+    QVector<int> bestCell;
+    QVector<int> bestRoom;
+    QVector<int> order(chainCount);
+
+    for (int round = 0; round < rounds; ++round) {
+        const double ratio = rounds > 1 ? double(round) / (rounds - 1) : 1.0;
+        for (int i = 0; i < chainCount; ++i) {
+            Chain *chain = &chains[i];
+            pool.start(QRunnable::create([chain, ratio, &options, cancel]() {
+                chain->anneal(options.stepsPerRound, chain->temperatureAt(ratio), cancel);
+            }));
+        }
+        pool.waitForDone();
+        result.rounds = round + 1;
+
+        // 按代价排序，代价相同时按链编号，保证结果可复现
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&chains](int a, int b) {
+            int costA = chains[a].cost();
+            int costB = chains[b].cost();
+            return costA != costB ? costA < costB : a < b;
+        });
+        const Chain &leader = chains[order[0]];
+        if (bestCost < 0 || leader.cost() < bestCost) {
+            bestCost = leader.cost();
+            bestCell = leader.cell;
+            bestRoom = leader.room;
+            result.hardViolations = leader.hard;
+            result.softPenalty = leader.soft;
+        }
+
+        if (progress) {
+            progress(result.rounds, rounds, result.hardViolations, result.softPenalty);
+        }
+        if (cancel && cancel->load()) {
+            result.cancelled = true;
+            break;
+        }
+        if (bestCost == 0) {
+            break;
+        }
+
+        // 较差的一半链从当前最优解继续搜索
+        for (int k = (chainCount + 1) / 2; k < chainCount; ++k) {
+            chains[order[k]].copyStateFrom(leader);
+        }
+    }
+
+    const int periods = rules.periods.size();
+    result.placements.reserve(sessionDemand.size());
+    for (int s = 0; s < sessionDemand.size(); ++s) {
+        Placement placement;
+        placement.demand = sessionDemand[s];
+        placement.weekday = bestCell[s] / periods + 1;
+        placement.period = bestCell[s] % periods;
+        placement.room = bestRoom[s];
+        result.placements.append(placement);
+    }
+    result.elapsedMs = clock.elapsed();
+    return result;
+}
+
+int TimetableGenerator::writeDraft(QSqlDatabase db, const Result &result, const QString &name, QString *error) const {
+    QVector<Placement> placements = result.placements;
+    std::sort(placements.begin(), placements.end(), [this](const Placement &a, const Placement &b) {
+        if (a.room != b.room) return roomList[a.room].name < roomList[b.room].name;
+        if (a.weekday != b.weekday) return a.weekday < b.weekday;
+        return a.period < b.period;
+    });
+
+    QVector<TimetableVersions::Row> rows;
+    rows.reserve(placements.size());
+    for (const Placement &placement : std::as_const(placements)) {
+        const Demand &demand = demandList[placement.demand];
+        const Period &period = rules.periods[placement.period];
+        TimetableVersions::Row row;
+        row.room = roomList[placement.room].name;
+        row.course = demand.course;
+        row.teacher = demand.teacher;
+        row.timeSlot = period.start + " - " + period.end;
+        row.startTime = period.start;
+        row.endTime = period.end;
+        row.weekday = placement.weekday;
+        rows.append(row);
+    }
+
+    int draftId = TimetableVersions::createDraft(db, name, 0, error);
+    if (draftId <= 0) {
+        return 0;
+    }
+    if (!TimetableVersions::addRows(db, draftId, rows, error)) {
+        // 写了一半的草稿没有用处，删掉
+        TimetableVersions::remove(db, draftId);
+        return 0;
+    }
+    return draftId;
+}
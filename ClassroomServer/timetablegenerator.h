@@ -0,0 +1,109 @@
+#ifndef TIMETABLEGENERATOR_H
+#define TIMETABLEGENERATOR_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSqlDatabase>
+#include <atomic>
+#include <functional>
+
+// 自动排课：把每门课每周的若干次课分配到（星期, 节次, 教室），
+// 硬约束为教室、教师、班级不重叠，教室容量足够，教师不可用的时间不排课；
+// 软约束为同一班级的同一门课不在同一天重复，教师每天不超过指定节数。
+//
+// 搜索使用多条模拟退火链。每一轮每条链是线程池中的一个任务，各跑固定步数；链数多于线程数时，
+// 空闲线程从线程池队列中取下一条链，核心之间自动均衡。轮与轮之间用当前最优解替换较差的一半链。
+// 每条链的随机数由种子和链编号决定，步数固定，因此同样的种子和链数得到同样的结果，与线程数和调度无关。
+class TimetableGenerator
+{
+public:
+    struct Period {
+        QString start;
+        QString end;
+    };
+
+    struct Demand {
+        QString course;
+        QString teacher;
+        QString group;         // 上课的班级，同一班级不能同时上两门课
+        int students = 0;
+        int sessions = 1;      // 每周次数
+    };
+
+    struct Room {
+        QString name;
+        int capacity = 0;
+    };
+
+    struct Constraints {
+        int days = 5;                       // 从星期一起连续排课的天数
+        QVector<Period> periods;            // 每天的节次
+        int maxTeacherPeriodsPerDay = 3;
+        QHash<QString, QVector<int>> teacherUnavailable; // 教师 -> 不可排的时间格（day * 节数 + period）
+    };
+
+    struct Options {
+        quint64 seed = 1;
+        int chains = 16;          // 退火链数，决定结果；与线程数无关
+        int threads = 0;          // 0 表示使用全部核心
+        int rounds = 200;
+        int stepsPerRound = 20000;
+    };
+
+    struct Placement {
+        int demand = 0;
+        int weekday = 1;
+        int period = 0;
+        int room = 0;
+    };
+
+    struct Result {
+        int hardViolations = -1;  // 0 表示无冲突
+        int softPenalty = 0;
+        int rounds = 0;
+        qint64 elapsedMs = 0;
+        bool cancelled = false;
+        QVector<Placement> placements;
+    };
+
+    // 每轮结束后在工作线程中调用
+    using ProgressCallback = std::function<void(int round, int totalRounds, int hardViolations, int softPenalty)>;
+
+    TimetableGenerator(const QVector<Demand> &demands, const QVector<Room> &rooms, const Constraints &constraints);
+
+    // 以现有课程表为需求：按（教室, 课程, 教师）统计每周次数，教室即班级，容量取自 classrooms
+    static bool loadFromDb(QSqlDatabase db, QVector<Demand> &demands, QVector<Room> &rooms,
+                           Constraints &constraints, QString *error = nullptr);
+
+    Result run(const Options &options, const ProgressCallback &progress = ProgressCallback(),
+               const std::atomic_bool *cancel = nullptr) const;
+
+    // 把结果写成一个新的空白草稿（TimetableVersions），由管理员检查后发布；返回草稿 id，失败返回 0
+    int writeDraft(QSqlDatabase db, const Result &result, const QString &name, QString *error = nullptr) const;
+
+    const QVector<Demand> &demands() const { return demandList; }
+    const QVector<Room> &rooms() const { return roomList; }
+    const Constraints &constraints() const { return rules; }
+    int sessionCount() const { return sessionDemand.size(); }
+
+private:
+    struct Chain;
+    friend struct Chain;
+
+    QVector<Demand> demandList;
+    QVector<Room> roomList;
+    Constraints rules;
+
+    // 预处理后的只读数据，各链共享
+    int cellCount = 0;                  // days * 节数
+    QVector<int> sessionDemand;         // 每次课对应的需求
+    QVector<int> demandTeacher;         // 需求 -> 教师编号
+    QVector<int> demandGroup;           // 需求 -> 班级编号
+    QVector<QVector<int>> eligibleRooms; // 需求 -> 容量足够的教室；都不够时为最大的几间
+    QVector<QVector<quint8>> teacherBlocked; // 教师 -> 每个时间格是否不可用
+    int teacherCount = 0;
+    int groupCount = 0;
+};
+
+#endif // TIMETABLEGENERATOR_H
@@ -0,0 +1,453 @@
+#include "timetableversions.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+
+// master_schedules 与 version_schedules 共有的课程列，顺序与 Schema::Schedules 一致
+static const char *kScheduleColumns = "room, course, teacher, time_slot, start_time, end_time, weekday, is_next";
+
+static void setError(QString *error, const QString &what, const QSqlQuery &query) {
+    if (error) *error = what + ": " + query.lastError().text();
+}
+
+static TimetableVersions::Status statusFromName(const QString &name) {
+    if (name == "published") return TimetableVersions::Status::Published;
+    if (name == "archived") return TimetableVersions::Status::Archived;
+    return TimetableVersions::Status::Draft;
+}
+
+static void bindRow(QSqlQuery &query, const TimetableVersions::Row &row) {
+    query.addBindValue(row.room);
+    query.addBindValue(row.course);
+    query.addBindValue(row.teacher);
+    query.addBindValue(row.timeSlot);
+    query.addBindValue(row.startTime);
+    query.addBindValue(row.endTime);
+    query.addBindValue(row.weekday);
+    query.addBindValue(row.isNext);
+}
+
+QString TimetableVersions::statusLabel(Status status) {
+    switch (status) {
+    case Status::Draft: return "草稿";
+    case Status::Published: return "线上";
+    case Status::Archived: return "已归档";
+    }
+    return "草稿";
+}
+
+bool TimetableVersions::ensureSchema(QSqlDatabase db, QString *error) {
+    const QString ddl[] = {
+        "CREATE TABLE IF NOT EXISTS timetable_versions (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, "
+        "status TEXT, base_id INTEGER DEFAULT 0, created_at_ms INTEGER, published_at_ms INTEGER DEFAULT 0)",
+        "CREATE TABLE IF NOT EXISTS version_schedules (row_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "version_id INTEGER NOT NULL, schedule_id INTEGER, room TEXT, course TEXT, teacher TEXT, "
+        "time_slot TEXT, start_time TEXT, end_time TEXT, weekday INTEGER, is_next INTEGER DEFAULT 0)",
+        "CREATE INDEX IF NOT EXISTS idx_version_schedules_version ON version_schedules(version_id)",
+    };
+
+    QSqlQuery query(db);
+    for (const QString &statement : ddl) {
+        if (!query.exec(statement)) {
+            setError(error, "创建版本表失败", query);
+            return false;
+        }
+    }
+
+    if (!query.exec("SELECT COUNT(*) FROM timetable_versions") || !query.next()) {
+        setError(error, "读取版本失败", query);
+        return false;
+    }
+    if (query.value(0).toInt() > 0) {
+        return true;
+    }
+    query.prepare("INSERT INTO timetable_versions (name, status, created_at_ms, published_at_ms) "
+                  "VALUES ('初始版本', 'published', ?, ?)");
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    query.addBindValue(nowMs);
+    query.addBindValue(nowMs);
+    if (!query.exec()) {
+        setError(error, "登记初始版本失败", query);
+        return false;
+    }
+    return true;
+}
+
+QVector<TimetableVersions::Version> TimetableVersions::list(QSqlDatabase db, QString *error) {
+    QVector<Version> versions;
+    QSqlQuery query(db);
+    // 线上版本的行数在 master_schedules 中，其余版本按 version_id 计数
+    if (!query.exec("SELECT v.id, v.name, v.status, v.base_id, v.created_at_ms, v.published_at_ms, "
+                    "CASE WHEN v.status = 'published' THEN (SELECT COUNT(*) FROM master_schedules) "
+                    "ELSE (SELECT COUNT(*) FROM version_schedules s WHERE s.version_id = v.id) END "
+                    "FROM timetable_versions v ORDER BY v.id DESC")) {
+        setError(error, "读取版本失败", query);
+        return versions;
+    }
+    while (query.next()) {
+        Version version;
+        version.id = query.value(0).toInt();
+        version.name = query.value(1).toString();
+        version.status = statusFromName(query.value(2).toString());
+        version.baseId = query.value(3).toInt();
+        version.createdAtMs = query.value(4).toLongLong();
+        version.publishedAtMs = query.value(5).toLongLong();
+        version.rows = query.value(6).toInt();
+        versions.append(version);
+    }
+    return versions;
+}
+
+int TimetableVersions::publishedId(QSqlDatabase db) {
+    QSqlQuery query(db);
+    if (query.exec("SELECT id FROM timetable_versions WHERE status = 'published' LIMIT 1") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+TimetableVersions::Status TimetableVersions::statusOf(QSqlDatabase db, int versionId, bool *found) {
+    QSqlQuery query(db);
+    query.prepare("SELECT status FROM timetable_versions WHERE id = ?");
+    query.addBindValue(versionId);
+    *found = query.exec() && query.next();
+    return *found ? statusFromName(query.value(0).toString()) : Status::Draft;
+}
+
+int TimetableVersions::createDraft(QSqlDatabase db, const QString &name, int baseId, QString *error) {
+    bool found = false;
+    Status baseStatus = baseId > 0 ? statusOf(db, baseId, &found) : Status::Draft;
+    if (baseId > 0 && !found) {
+        if (error) *error = QString("版本 %1 不存在").arg(baseId);
+        return 0;
+    }
+
+    if (!db.transaction()) {
+        if (error) *error = "开始事务失败: " + db.lastError().text();
+        return 0;
+    }
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO timetable_versions (name, status, base_id, created_at_ms) VALUES (?, 'draft', ?, ?)");
+    query.addBindValue(name);
+    query.addBindValue(baseId);
+    query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    if (!query.exec()) {
+        setError(error, "创建草稿失败", query);
+        db.rollback();
+        return 0;
+    }
+    int draftId = query.lastInsertId().toInt();
+
+    if (baseId > 0) {
+        // 整表复制在 SQLite 内完成，不经过 Qt 逐行绑定
+        QString copy = baseStatus == Status::Published
+            ? QString("INSERT INTO version_schedules (version_id, schedule_id, %1) SELECT %2, id, %1 "
+                      "FROM master_schedules ORDER BY id").arg(kScheduleColumns).arg(draftId)
+            : QString("INSERT INTO version_schedules (version_id, schedule_id, %1) SELECT %2, schedule_id, %1 "
+                      "FROM version_schedules WHERE version_id = %3 ORDER BY row_id")
+                  .arg(kScheduleColumns).arg(draftId).arg(baseId);
+        if (!query.exec(copy)) {
+            setError(error, "复制版本失败", query);
+            db.rollback();
+            return 0;
+        }
+    }
+
+    if (!db.commit()) {
+        if (error) *error = "提交草稿失败: " + db.lastError().text();
+        return 0;
+    }
+    return draftId;
+}
+
+bool TimetableVersions::remove(QSqlDatabase db, int versionId, QString *error) {
+    bool found = false;
+    if (statusOf(db, versionId, &found) == Status::Published || !found) {
+        if (error) *error = found ? "线上版本不能删除" : QString("版本 %1 不存在").arg(versionId);
+        return false;
+    }
+
+    if (!db.transaction()) {
+        if (error) *error = "开始事务失败: " + db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM version_schedules WHERE version_id = ?");
+    query.addBindValue(versionId);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM timetable_versions WHERE id = ?");
+        query.addBindValue(versionId);
+        ok = query.exec();
+    }
+    if (!ok) {
+        setError(error, "删除版本失败", query);
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QVector<TimetableVersions::Row> TimetableVersions::rows(QSqlDatabase db, int versionId, int limit, QString *error) {
+    QVector<Row> result;
+    bool found = false;
+    Status status = statusOf(db, versionId, &found);
+    if (!found) {
+        if (error) *error = QString("版本 %1 不存在").arg(versionId);
+        return result;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (status == Status::Published) {
+        query.prepare(QString("SELECT id, %1 FROM master_schedules ORDER BY id LIMIT ?").arg(kScheduleColumns));
+    } else {
+        query.prepare(QString("SELECT row_id, %1 FROM version_schedules WHERE version_id = ? ORDER BY row_id LIMIT ?")
+                          .arg(kScheduleColumns));
+        query.addBindValue(versionId);
+    }
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        setError(error, "读取版本课程失败", query);
+        return result;
+    }
+    while (query.next()) {
+        Row row;
+        row.id = query.value(0).toInt();
+        row.room = query.value(1).toString();
+        row.course = query.value(2).toString();
+        row.teacher = query.value(3).toString();
+        row.timeSlot = query.value(4).toString();
+        row.startTime = query.value(5).toString();
+        row.endTime = query.value(6).toString();
+        row.weekday = query.value(7).toInt();
+        row.isNext = query.value(8).toInt();
+        result.append(row);
+    }
+    return result;
+}
+
+int TimetableVersions::addRow(QSqlDatabase db, int draftId, const Row &row, QString *error) {
+    bool found = false;
+    if (statusOf(db, draftId, &found) != Status::Draft || !found) {
+        if (error) *error = "只能修改草稿";
+        return 0;
+    }
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO version_schedules (version_id, %1) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                      .arg(kScheduleColumns));
+    query.addBindValue(draftId);
+    bindRow(query, row);
+    if (!query.exec()) {
+        setError(error, "添加草稿课程失败", query);
+        return 0;
+    }
+    return query.lastInsertId().toInt();
+}
+
+bool TimetableVersions::updateRow(QSqlDatabase db, int draftId, const Row &row, QString *error) {
+    bool found = false;
+    if (statusOf(db, draftId, &found) != Status::Draft || !found) {
+        if (error) *error = "只能修改草稿";
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare("UPDATE version_schedules SET room=?, course=?, teacher=?, time_slot=?, start_time=?, end_time=?, "
+                  "weekday=?, is_next=? WHERE row_id=? AND version_id=?");
+    bindRow(query, row);
+    query.addBindValue(row.id);
+    query.addBindValue(draftId);
+    if (!query.exec()) {
+        setError(error, "修改草稿课程失败", query);
+        return false;
+    }
+    return true;
+}
+
+bool TimetableVersions::removeRow(QSqlDatabase db, int draftId, int rowId, QString *error) {
+    bool found = false;
+    if (statusOf(db, draftId, &found) != Status::Draft || !found) {
+        if (error) *error = "只能修改草稿";
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM version_schedules WHERE row_id = ? AND version_id = ?");
+    query.addBindValue(rowId);
+    query.addBindValue(draftId);
+    if (!query.exec()) {
+        setError(error, "删除草稿课程失败", query);
+        return false;
+    }
+    return true;
+}
+
+bool TimetableVersions::addRows(QSqlDatabase db, int draftId, const QVector<Row> &rows, QString *error) {
+    bool found = false;
+    if (statusOf(db, draftId, &found) != Status::Draft || !found) {
+        if (error) *error = "只能修改草稿";
+        return false;
+    }
+    if (!db.transaction()) {
+        if (error) *error = "开始事务失败: " + db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO version_schedules (version_id, %1) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                      .arg(kScheduleColumns));
+    for (const Row &row : rows) {
+        query.addBindValue(draftId);
+        bindRow(query, row);
+        if (!query.exec()) {
+            setError(error, "添加草稿课程失败", query);
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        if (error) *error = "提交草稿课程失败: " + db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int TimetableVersions::importCsv(QSqlDatabase db, int draftId, const QString &path, int *skipped, QString *error) {
+    bool found = false;
+    if (statusOf(db, draftId, &found) != Status::Draft || !found) {
+        if (error) *error = "只能向草稿导入";
+        return -1;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (error) *error = "无法打开文件: " + path;
+        return -1;
+    }
+
+    if (!db.transaction()) {
+        if (error) *error = "开始事务失败: " + db.lastError().text();
+        return -1;
+    }
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO version_schedules (version_id, %1) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                      .arg(kScheduleColumns));
+
+    int imported = 0;
+    int bad = 0;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QStringList fields = line.split(',');
+        bool weekdayOk = false;
+        int weekday = fields.size() >= 7 ? fields[6].trimmed().toInt(&weekdayOk) : 0;
+        if (fields.size() < 7 || !weekdayOk || weekday < 1 || weekday > 7) {
+            // 表头和格式不对的行跳过，只计数
+            ++bad;
+            continue;
+        }
+        Row row;
+        row.room = fields[0].trimmed();
+        row.course = fields[1].trimmed();
+        row.teacher = fields[2].trimmed();
+        row.timeSlot = fields[3].trimmed();
+        row.startTime = fields[4].trimmed();
+        row.endTime = fields[5].trimmed();
+        row.weekday = weekday;
+        row.isNext = fields.size() > 7 ? fields[7].trimmed().toInt() : 0;
+        query.addBindValue(draftId);
+        bindRow(query, row);
+        if (!query.exec()) {
+            setError(error, "导入草稿课程失败", query);
+            db.rollback();
+            return -1;
+        }
+        ++imported;
+    }
+
+    if (!db.commit()) {
+        if (error) *error = "提交导入失败: " + db.lastError().text();
+        return -1;
+    }
+    if (skipped) *skipped = bad;
+    return imported;
+}
+
+QVector<ConflictEngine::Entry> TimetableVersions::entries(QSqlDatabase db, int versionId, QString *error) {
+    QVector<ConflictEngine::Entry> result;
+    const QVector<Row> all = rows(db, versionId, -1, error);
+    result.reserve(all.size());
+    for (const Row &row : all) {
+        result.append(ConflictEngine::makeEntry(row.id, row.room, row.course, row.teacher, row.weekday,
+                                                row.startTime, row.endTime));
+    }
+    return result;
+}
+
+qint64 TimetableVersions::publish(QSqlDatabase db, int versionId, QString *error) {
+    bool found = false;
+    Status status = statusOf(db, versionId, &found);
+    if (!found || status == Status::Published) {
+        if (error) *error = found ? "该版本已经在线上" : QString("版本 %1 不存在").arg(versionId);
+        return -1;
+    }
+    // 版本的发布由调用方串行进行，线上版本在事务开始前读取即可；
+    // 事务中第一条语句就是写入，WAL 下不会因为读事务升级失败
+    int liveId = publishedId(db);
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+
+    if (!db.transaction()) {
+        if (error) *error = "开始事务失败: " + db.lastError().text();
+        return -1;
+    }
+    QSqlQuery query(db);
+    auto run = [&](const QString &sql, const char *what) {
+        if (query.exec(sql)) {
+            return true;
+        }
+        setError(error, what, query);
+        db.rollback();
+        return false;
+    };
+
+    // 1. 线上内容归档到原来的版本号下；该版本以前的归档内容被覆盖（期间可能有直接修改）
+    if (liveId > 0
+        && (!run(QString("DELETE FROM version_schedules WHERE version_id = %1").arg(liveId), "归档线上版本失败")
+            || !run(QString("INSERT INTO version_schedules (version_id, schedule_id, %1) SELECT %2, id, %1 "
+                            "FROM master_schedules ORDER BY id").arg(kScheduleColumns).arg(liveId),
+                    "归档线上版本失败")
+            || !run(QString("UPDATE timetable_versions SET status = 'archived' WHERE id = %1").arg(liveId),
+                    "归档线上版本失败"))) {
+        return -1;
+    }
+
+    // 2. 换上新版本；新增的行 schedule_id 为 NULL，由 AUTOINCREMENT 分配不与历史重复的 id
+    if (!run("DELETE FROM master_schedules", "清空线上课程失败")
+        || !run(QString("INSERT INTO master_schedules (id, %1) SELECT schedule_id, %1 FROM version_schedules "
+                        "WHERE version_id = %2 ORDER BY row_id").arg(kScheduleColumns).arg(versionId),
+                "写入新版本失败")
+        || !run(QString("UPDATE timetable_versions SET status = 'published', published_at_ms = %1 WHERE id = %2")
+                    .arg(nowMs).arg(versionId), "更新版本状态失败")) {
+        return -1;
+    }
+
+    // 3. 变更编号与数据在同一个事务中提交，班牌看到这个编号时一定能拿到完整的新版本
+    query.prepare("INSERT INTO change_log (entity, committed_at_ms) VALUES ('version', ?)");
+    query.addBindValue(nowMs);
+    if (!query.exec()) {
+        setError(error, "记录变更失败", query);
+        db.rollback();
+        return -1;
+    }
+    qint64 changeId = query.lastInsertId().toLongLong();
+
+    if (!db.commit()) {
+        if (error) *error = "提交发布失败: " + db.lastError().text();
+        return -1;
+    }
+    return changeId;
+}
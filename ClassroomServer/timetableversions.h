@@ -0,0 +1,77 @@
+#ifndef TIMETABLEVERSIONS_H
+#define TIMETABLEVERSIONS_H
+
+#include <QString>
+#include <QVector>
+#include <QSqlDatabase>
+#include "conflictengine.h"
+
+// 课程表的多个版本：草稿在 version_schedules 中单独编辑，班牌看不到；
+// 发布时在一个事务中把线上的 master_schedules 归档为旧版本、换成草稿的内容，并记一次变更。
+// 线上版本的课程始终在 master_schedules 中，其他版本（草稿和已归档）的课程在 version_schedules 中，
+// 已归档的版本可以再次发布，用于回滚。
+//
+// 每行记住它在 master_schedules 中的 id（schedule_id），发布时沿用，单双周规则和校历展开因此在回滚后仍然对应；
+// 草稿中新增的行没有 id，发布时分配新的 id。
+class TimetableVersions
+{
+public:
+    enum class Status { Draft, Published, Archived };
+
+    struct Version {
+        int id = 0;
+        QString name;
+        Status status = Status::Draft;
+        int baseId = 0;              // 草稿复制自哪个版本，空草稿为 0
+        qint64 createdAtMs = 0;
+        qint64 publishedAtMs = 0;    // 最近一次发布的时间，未发布过为 0
+        int rows = 0;
+    };
+
+    struct Row {
+        int id = 0;                  // 草稿和归档版本中为行号，线上版本中为课程 id
+        QString room;
+        QString course;
+        QString teacher;
+        QString timeSlot;
+        QString startTime;
+        QString endTime;
+        int weekday = 1;
+        int isNext = 0;
+    };
+
+    // 建表；还没有任何版本时，把现有的 master_schedules 登记为第一个已发布版本
+    static bool ensureSchema(QSqlDatabase db, QString *error = nullptr);
+    static QVector<Version> list(QSqlDatabase db, QString *error = nullptr);
+    static int publishedId(QSqlDatabase db);
+
+    // 复制一个版本的全部课程作为新草稿，baseId 为 0 时为空草稿；返回草稿 id，失败返回 0
+    static int createDraft(QSqlDatabase db, const QString &name, int baseId, QString *error = nullptr);
+    // 删除草稿或已归档的版本，线上版本不能删除
+    static bool remove(QSqlDatabase db, int versionId, QString *error = nullptr);
+
+    // 读取一个版本的课程，limit < 0 时读取全部
+    static QVector<Row> rows(QSqlDatabase db, int versionId, int limit = -1, QString *error = nullptr);
+    // 草稿的增删改，只对状态为草稿的版本生效；addRow 返回新行号，失败返回 0
+    static int addRow(QSqlDatabase db, int draftId, const Row &row, QString *error = nullptr);
+    static bool updateRow(QSqlDatabase db, int draftId, const Row &row, QString *error = nullptr);
+    static bool removeRow(QSqlDatabase db, int draftId, int rowId, QString *error = nullptr);
+    // 一次写入多行（如自动排课的结果），单个事务
+    static bool addRows(QSqlDatabase db, int draftId, const QVector<Row> &rows, QString *error = nullptr);
+    // 批量导入 CSV（教室,课程,教师,节次,开始,结束,星期[,是否下节]），单个事务；返回导入行数，失败返回 -1
+    static int importCsv(QSqlDatabase db, int draftId, const QString &path, int *skipped = nullptr,
+                         QString *error = nullptr);
+
+    // 发布前交给 ConflictEngine::validate 检查
+    static QVector<ConflictEngine::Entry> entries(QSqlDatabase db, int versionId, QString *error = nullptr);
+
+    // 发布草稿或已归档的版本，返回这次发布的变更编号，失败返回 -1
+    static qint64 publish(QSqlDatabase db, int versionId, QString *error = nullptr);
+
+    static QString statusLabel(Status status);
+
+private:
+    static Status statusOf(QSqlDatabase db, int versionId, bool *found);
+};
+
+#endif // TIMETABLEVERSIONS_H
@@ -8,6 +8,8 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QDateTime>
+#include "localstore.h"
+#include "schema.h"
 
 class DatabaseManager {
 public:
@@ -27,58 +29,11 @@ public:
 
         qDebug() << "数据库打开成功";
 
-        QSqlQuery query;
-
-        qDebug() << "开始创建表...";
-
-        if (!query.exec("CREATE TABLE IF NOT EXISTS schedules ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "room_name TEXT, "
-                   "course_name TEXT, "
-                   "teacher TEXT, "
-                   "time_slot TEXT, "
-                   "start_time TEXT, "
-                   "end_time TEXT, "
-                   "weekday INTEGER, "
-                   "is_next INTEGER DEFAULT 0)")) {
-            qDebug() << "创建schedules表失败:" << query.lastError();
-        } else {
-            qDebug() << "schedules表创建成功";
-        }
-
-        if (!query.exec("CREATE TABLE IF NOT EXISTS classrooms ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "room_name TEXT UNIQUE, "
-                   "class_name TEXT, "
-                   "capacity INTEGER, "
-                   "building TEXT, "
-                   "floor INTEGER, "
-                   "current_class TEXT)")) {
-            qDebug() << "创建classrooms表失败:" << query.lastError();
-        } else {
-            qDebug() << "classrooms表创建成功";
-        }
-
-        if (!query.exec("CREATE TABLE IF NOT EXISTS announcements ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "title TEXT, "
-                   "content TEXT, "
-                   "priority INTEGER DEFAULT 0, "
-                   "publish_time TEXT, "
-                   "expire_time TEXT)")) {
-            qDebug() << "创建announcements表失败:" << query.lastError();
-        } else {
-            qDebug() << "announcements表创建成功";
-        }
+        // 界面线程的读连接同样使用 WAL，与 NetworkWorker 的写入互不阻塞
+        LocalStore::configure(db);
 
-        if (!query.exec("CREATE TABLE IF NOT EXISTS sync_log ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "sync_time TEXT, "
-                   "status TEXT, "
-                   "items_count INTEGER)")) {
-            qDebug() << "创建sync_log表失败:" << query.lastError();
-        } else {
-            qDebug() << "sync_log表创建成功";
+        if (!LocalStore::ensureSchema(db)) {
+            qDebug() << "创建表失败";
         }
 
         qDebug() << "数据库初始化完成";
@@ -130,8 +85,7 @@ public:
 
     static bool insertAnnouncement(const QString &title, const QString &content, int priority = 0) {
         QSqlQuery query;
-        query.prepare("INSERT INTO announcements (title, content, priority, publish_time, expire_time) "
-                     "VALUES (?, ?, ?, ?, ?)");
+        query.prepare(Schema::sql<Schema::Announcements, Schema::Side::Client, Schema::Statement::Insert>());
         query.addBindValue(title);
         query.addBindValue(content);
         query.addBindValue(priority);
@@ -142,8 +96,7 @@ public:
 
     static bool insertClassroom(const QString &roomName, const QString &className, int capacity, const QString &building, int floor, const QString &currentClass = "") {
         QSqlQuery query;
-        query.prepare("INSERT OR REPLACE INTO classrooms (room_name, class_name, capacity, building, floor, current_class) "
-                     "VALUES (?, ?, ?, ?, ?, ?)");
+        query.prepare(Schema::sql<Schema::Classrooms, Schema::Side::Client, Schema::Statement::Upsert>());
         query.addBindValue(roomName);
         query.addBindValue(className);
         query.addBindValue(capacity);
@@ -155,7 +108,7 @@ public:
 
     static bool logSync(const QString &status, int itemsCount) {
         QSqlQuery query;
-        query.prepare("INSERT INTO sync_log (sync_time, status, items_count) VALUES (?, ?, ?)");
+        query.prepare(Schema::sql<Schema::SyncLog, Schema::Side::Client, Schema::Statement::Insert>());
         query.addBindValue(QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss"));
         query.addBindValue(status);
         query.addBindValue(itemsCount);
@@ -0,0 +1,159 @@
+#include "announcementqueue.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// 优先级不低于该值的公告为紧急公告，与服务器的紧急通道一致
+static const int kUrgentPriority = 8;
+
+// 标准库堆默认是大顶堆，按时刻倒序比较得到小顶堆
+static bool laterFirst(const QPair<qint64, int> &a, const QPair<qint64, int> &b) {
+    return a.first > b.first;
+}
+
+void AnnouncementQueue::reset(AnnouncementTablePtr newTable, qint64 nowMs) {
+    const QString shown = bannerText();
+
+    table = std::move(newTable);
+    order.clear();
+    banners.clear();
+    states.clear();
+    pendingHeap.clear();
+    expiryHeap.clear();
+    activeTotal = 0;
+    activeUrgent = 0;
+    cursor = -1;
+    if (!table) {
+        ticker.clear();
+        return;
+    }
+
+    const QVector<AnnouncementRow> &rows = table->rows;
+    order.resize(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&rows](int a, int b) {
+        if (rows[a].priority != rows[b].priority) {
+            return rows[a].priority > rows[b].priority;
+        }
+        // 同一优先级中先过期的排在前面，不过期的排在最后
+        qint64 expireA = rows[a].expireAtMs > 0 ? rows[a].expireAtMs : std::numeric_limits<qint64>::max();
+        qint64 expireB = rows[b].expireAtMs > 0 ? rows[b].expireAtMs : std::numeric_limits<qint64>::max();
+        return expireA < expireB;
+    });
+
+    banners.reserve(order.size());
+    states.resize(order.size());
+    for (int pos = 0; pos < order.size(); ++pos) {
+        const AnnouncementRow &row = rows[order[pos]];
+        banners.append(row.priority >= kUrgentPriority ? "【紧急·" + row.title + "】" + row.content
+                                                       : "【" + row.title + "】" + row.content);
+        if (row.expireAtMs > 0 && row.expireAtMs <= nowMs) {
+            states[pos] = Gone;
+            continue;
+        }
+        if (row.publishAtMs > nowMs) {
+            states[pos] = Pending;
+            pendingHeap.append(Timed(row.publishAtMs, pos));
+        } else {
+            states[pos] = Active;
+            ++activeTotal;
+            activeUrgent += row.priority >= kUrgentPriority ? 1 : 0;
+        }
+        if (row.expireAtMs > 0) {
+            expiryHeap.append(Timed(row.expireAtMs, pos));
+        }
+    }
+    std::make_heap(pendingHeap.begin(), pendingHeap.end(), laterFirst);
+    std::make_heap(expiryHeap.begin(), expiryHeap.end(), laterFirst);
+
+    // 同步不打断正在显示的公告
+    for (int pos = 0; pos < order.size() && !shown.isEmpty(); ++pos) {
+        if (states[pos] == Active && banners[pos] == shown && shownAllowed(pos)) {
+            cursor = pos;
+            break;
+        }
+    }
+    if (cursor < 0) {
+        cursor = nextShown(-1);
+        shownSinceMs = nowMs;
+    }
+    rebuildTicker();
+}
+
+bool AnnouncementQueue::advance(qint64 nowMs) {
+    bool setChanged = false;
+    while (!expiryHeap.isEmpty() && expiryHeap.constFirst().first <= nowMs) {
+        int pos = expiryHeap.constFirst().second;
+        std::pop_heap(expiryHeap.begin(), expiryHeap.end(), laterFirst);
+        expiryHeap.removeLast();
+        if (states[pos] == Active) {
+            --activeTotal;
+            activeUrgent -= table->rows[order[pos]].priority >= kUrgentPriority ? 1 : 0;
+            setChanged = true;
+        }
+        states[pos] = Gone;
+    }
+    while (!pendingHeap.isEmpty() && pendingHeap.constFirst().first <= nowMs) {
+        int pos = pendingHeap.constFirst().second;
+        std::pop_heap(pendingHeap.begin(), pendingHeap.end(), laterFirst);
+        pendingHeap.removeLast();
+        if (states[pos] == Pending) {
+            states[pos] = Active;
+            ++activeTotal;
+            activeUrgent += table->rows[order[pos]].priority >= kUrgentPriority ? 1 : 0;
+            setChanged = true;
+        }
+    }
+
+    const int previous = cursor;
+    if (setChanged) {
+        rebuildTicker();
+        // 正在显示的公告过期，或有紧急公告生效时立即切换
+        if (cursor < 0 || states[cursor] != Active || !shownAllowed(cursor)) {
+            cursor = nextShown(cursor);
+            shownSinceMs = nowMs;
+        }
+    } else if (activeTotal > 1 && nowMs - shownSinceMs >= dwellMs) {
+        int next = nextShown(cursor);
+        if (next >= 0) {
+            cursor = next;
+        }
+        shownSinceMs = nowMs;
+    }
+    return setChanged || cursor != previous;
+}
+
+const QString &AnnouncementQueue::bannerText() const {
+    static const QString empty;
+    return cursor >= 0 ? banners[cursor] : empty;
+}
+
+bool AnnouncementQueue::shownAllowed(int pos) const {
+    return activeUrgent == 0 || table->rows[order[pos]].priority >= kUrgentPriority;
+}
+
+int AnnouncementQueue::nextShown(int from) const {
+    const int count = order.size();
+    for (int step = 1; step <= count; ++step) {
+        int pos = (from + step) % count;
+        if (states[pos] == Active && shownAllowed(pos)) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+void AnnouncementQueue::rebuildTicker() {
+    ticker.clear();
+    for (int pos = 0; pos < order.size(); ++pos) {
+        if (states[pos] != Active) {
+            continue;
+        }
+        const AnnouncementRow &row = table->rows[order[pos]];
+        ticker += ticker.isEmpty() ? QStringLiteral("📢 ") : QStringLiteral("  ★  ");
+        ticker += row.title;
+        if (!row.content.isEmpty()) {
+            ticker += QStringLiteral("：") + row.content;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef ANNOUNCEMENTQUEUE_H
+#define ANNOUNCEMENTQUEUE_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+#include "localtables.h"
+
+// 班牌的公告轮播：同步来的公告按 (优先级降序, 过期时间升序) 排好，到发布时间加入、到过期时间移出，
+// 顶部横幅按停留时间在有效公告间轮换，底部滚动条显示全部有效公告。
+// 有紧急公告（优先级不低于 8，与服务器一致）生效时横幅只在紧急公告之间轮换。
+//
+// 发布和过期时刻各放在一个小顶堆中，推进时只弹出到期的堆顶，不查询数据库；
+// 横幅文本在换表时一次排好，推进过程中只移动下标，没有内存分配。滚动条文本只在有效集合变化时重新拼接。
+class AnnouncementQueue
+{
+public:
+    void setDwellMs(int ms) { dwellMs = qMax(1000, ms); }
+
+    // 换成新同步的公告表；正在显示的公告如果仍在表中且有效，继续显示并保留已停留的时间
+    void reset(AnnouncementTablePtr table, qint64 nowMs);
+    // 推进到 nowMs，返回横幅或滚动条文本是否变化
+    bool advance(qint64 nowMs);
+    // 横幅被紧急通道推送临时占用时调用，从 nowMs 起停留满一轮再轮换
+    void holdBanner(qint64 nowMs) { shownSinceMs = nowMs; }
+
+    const QString &bannerText() const;   // 当前轮到的公告，没有有效公告时为空
+    const QString &tickerText() const { return ticker; }
+    int activeCount() const { return activeTotal; }
+
+private:
+    enum State : quint8 { Pending, Active, Gone };
+    using Timed = QPair<qint64, int>;    // (时刻, order 中的位置)
+
+    void rebuildTicker();
+    int nextShown(int from) const;       // from 之后（循环）下一个应显示的位置，没有则返回 -1
+    bool shownAllowed(int pos) const;
+
+    AnnouncementTablePtr table;
+    QVector<int> order;                  // table->rows 下标，按 (优先级降序, 过期时间升序)
+    QVector<QString> banners;            // 与 order 对应的横幅文本
+    QVector<State> states;
+    QVector<Timed> pendingHeap;          // 尚未到发布时间的公告，按发布时间
+    QVector<Timed> expiryHeap;           // 有过期时间的公告，按过期时间
+    int activeTotal = 0;
+    int activeUrgent = 0;
+    int cursor = -1;                     // 横幅正在显示的位置
+    qint64 shownSinceMs = 0;
+    int dwellMs = 8000;
+    QString ticker;
+};
+
+#endif // ANNOUNCEMENTQUEUE_H
@@ -0,0 +1,90 @@
+#include "cardreader.h"
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QDebug>
+
+// 读卡器相邻两次按键的最大间隔，人工输入远慢于此
+static const qint64 kMaxKeyGapMs = 50;
+static const int kMinCardLength = 6;
+static const int kMaxCardLength = 32;
+// 模拟读卡器的卡号范围：一所学校的学生数量级
+static const int kSimulatedCards = 20000;
+
+CardReader *CardReader::create(const SignConfig &config, QObject *parent) {
+    if (config.checkinReader == "none") {
+        return nullptr;
+    }
+    if (config.checkinReader == "simulated") {
+        return new SimulatedCardReader(config.simulatedCheckinsPerMinute, parent);
+    }
+    if (config.checkinReader != "keyboard") {
+        qDebug() << "未知的读卡器类型" << config.checkinReader << "，使用键盘读卡器";
+    }
+    return new KeyboardCardReader(parent);
+}
+
+void KeyboardCardReader::start() {
+    QCoreApplication::instance()->installEventFilter(this);
+}
+
+bool KeyboardCardReader::eventFilter(QObject *watched, QEvent *event) {
+    if (event->type() != QEvent::KeyPress) {
+        return CardReader::eventFilter(watched, event);
+    }
+    // 同一次按键先经过顶层窗口再发往焦点控件，未被接受时还会逐级发给父控件，只处理第一次发往控件的那一次
+    auto *keyEvent = static_cast<QKeyEvent *>(event);
+    if (keyEvent->isAutoRepeat() || !watched->isWidgetType()
+        || (event == lastEvent && keyEvent->timestamp() == lastTimestamp)) {
+        return CardReader::eventFilter(watched, event);
+    }
+    lastEvent = event;
+    lastTimestamp = keyEvent->timestamp();
+
+    const bool burst = lastKey.isValid() && lastKey.elapsed() <= kMaxKeyGapMs;
+    lastKey.start();
+
+    if (keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter) {
+        QString cardId = pending;
+        pending.clear();
+        if (burst && cardId.size() >= kMinCardLength) {
+            emit cardRead(cardId);
+            return true;
+        }
+        return CardReader::eventFilter(watched, event);
+    }
+
+    const QString text = keyEvent->text();
+    if (text.size() == 1 && text.at(0).isLetterOrNumber()) {
+        // 间隔过长说明是新的一串（或人工输入），从这个字符重新开始
+        if (!burst || pending.size() >= kMaxCardLength) {
+            pending.clear();
+        }
+        pending += text;
+    } else {
+        pending.clear();
+    }
+    return CardReader::eventFilter(watched, event);
+}
+
+SimulatedCardReader::SimulatedCardReader(int perMinute, QObject *parent)
+    : CardReader(parent), timer(new QTimer(this)), perMinute(qMax(1, perMinute)) {
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &SimulatedCardReader::emitRandomCard);
+}
+
+void SimulatedCardReader::start() {
+    scheduleNext();
+}
+
+void SimulatedCardReader::scheduleNext() {
+    // 平均间隔按速率计算，在 0.5 到 1.5 倍之间随机，刷卡不会整齐地落在同一节拍上
+    int meanMs = 60000 / perMinute;
+    timer->start(qMax(1, int(meanMs * (0.5 + QRandomGenerator::global()->generateDouble()))));
+}
+
+void SimulatedCardReader::emitRandomCard() {
+    emit cardRead(QString("SIM%1").arg(QRandomGenerator::global()->bounded(kSimulatedCards), 6, 10, QChar('0')));
+    scheduleNext();
+}
@@ -0,0 +1,67 @@
+#ifndef CARDREADER_H
+#define CARDREADER_H
+
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include "signconfig.h"
+
+class QTimer;
+
+// 签到刷卡输入。不同的读卡器各自实现，读到卡号时发出 cardRead；界面只依赖这个接口。
+class CardReader : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+    ~CardReader() override = default;
+
+    // 按配置创建读卡器（checkin/reader），配置为 none 时返回 nullptr
+    static CardReader *create(const SignConfig &config, QObject *parent = nullptr);
+
+    virtual void start() = 0;
+
+signals:
+    void cardRead(const QString &cardId);
+};
+
+// USB 读卡器通常模拟键盘：刷卡时在极短时间内输入卡号并回车。
+// 在应用程序上安装事件过滤器收集连续按键，相邻按键间隔都很短、长度足够时按回车才算一次刷卡；
+// 人工输入的速度达不到，不会被误认为刷卡。卡号字符仍会送达当前焦点控件，回车在识别为刷卡时被拦下。
+class KeyboardCardReader : public CardReader
+{
+    Q_OBJECT
+
+public:
+    using CardReader::CardReader;
+    void start() override;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    QString pending;                 // 当前这一串连续按键
+    QElapsedTimer lastKey;
+    const QEvent *lastEvent = nullptr; // 最近处理的按键，识别同一事件的重复派发
+    quint64 lastTimestamp = 0;
+};
+
+// 测试用：按配置的速率产生刷卡，卡号从固定的号段中随机抽取，重复刷卡也会出现
+class SimulatedCardReader : public CardReader
+{
+    Q_OBJECT
+
+public:
+    SimulatedCardReader(int perMinute, QObject *parent = nullptr);
+    void start() override;
+
+private:
+    void scheduleNext();
+    void emitRandomCard();
+
+    QTimer *timer;
+    int perMinute;
+};
+
+#endif // CARDREADER_H
@@ -0,0 +1,229 @@
+#include "dayplan.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QTime>
+#include <QPair>
+#include <QDebug>
+#include "schema.h"
+#include <algorithm>
+
+int DayPlan::parseClock(const QString &text) {
+    QTime time = QTime::fromString(text, "HH:mm:ss");
+    if (!time.isValid()) {
+        time = QTime::fromString(text, "HH:mm");
+    }
+    if (!time.isValid()) {
+        time = QTime::fromString(text, "H:mm");
+    }
+    return time.isValid() ? time.msecsSinceStartOfDay() / 1000 : -1;
+}
+
+std::shared_ptr<const DayPlan> DayPlan::build(QSqlDatabase db, const QString &roomName) {
+    QSqlQuery query(db);
+    query.prepare(Schema::sql<Schema::Schedules, Schema::Side::Client, Schema::Statement::Select>() + " WHERE room_name = ?");
+    query.addBindValue(roomName);
+    if (!query.exec()) {
+        qDebug() << "构建课程计划失败:" << query.lastError().text();
+    }
+
+    QVector<PlanSlot> planSlots;
+    while (query.next()) {
+        PlanSlot slot;
+        slot.courseName = query.value(Schema::ScheduleCol::CourseName).toString();
+        slot.teacher = query.value(Schema::ScheduleCol::Teacher).toString();
+        slot.timeSlot = query.value(Schema::ScheduleCol::TimeSlot).toString();
+        slot.startSecs = parseClock(query.value(Schema::ScheduleCol::StartTime).toString());
+        slot.endSecs = parseClock(query.value(Schema::ScheduleCol::EndTime).toString());
+        slot.weekday = query.value(Schema::ScheduleCol::Weekday).toInt();
+        planSlots.append(slot);
+    }
+
+    // 校历：覆盖的日期和本教室在这些日期的课程
+    QVector<qint64> coveredDays;
+    if (query.exec(Schema::sql<Schema::CalendarDays, Schema::Side::Client, Schema::Statement::Select>())) {
+        while (query.next()) {
+            QDate date = QDate::fromString(query.value(Schema::CalendarDayCol::Date).toString(), Qt::ISODate);
+            if (date.isValid()) {
+                coveredDays.append(date.toJulianDay());
+            }
+        }
+    }
+
+    QVector<PlanSlot> datedSlots;
+    if (!coveredDays.isEmpty()) {
+        query.prepare(Schema::sql<Schema::Occurrences, Schema::Side::Client, Schema::Statement::Select>() + " WHERE room_name = ?");
+        query.addBindValue(roomName);
+        if (!query.exec()) {
+            qDebug() << "读取校历日程失败:" << query.lastError().text();
+        }
+        while (query.next()) {
+            QDate date = QDate::fromString(query.value(Schema::OccurrenceCol::Date).toString(), Qt::ISODate);
+            PlanSlot slot;
+            slot.courseName = query.value(Schema::OccurrenceCol::CourseName).toString();
+            slot.teacher = query.value(Schema::OccurrenceCol::Teacher).toString();
+            slot.timeSlot = query.value(Schema::OccurrenceCol::TimeSlot).toString();
+            slot.startSecs = parseClock(query.value(Schema::OccurrenceCol::StartTime).toString());
+            slot.endSecs = parseClock(query.value(Schema::OccurrenceCol::EndTime).toString());
+            slot.weekday = date.dayOfWeek();
+            slot.day = date.isValid() ? date.toJulianDay() : 0;
+            datedSlots.append(slot);
+        }
+    }
+
+    return fromSlots(roomName, std::move(planSlots), std::move(datedSlots), coveredDays);
+}
+
+// 缺少星期或时间的记录无法参与时刻判断
+static bool invalidSlot(const PlanSlot &slot) {
+    return slot.weekday < 1 || slot.weekday > 7 || slot.startSecs < 0 || slot.endSecs <= slot.startSecs;
+}
+
+std::shared_ptr<const DayPlan> DayPlan::fromSlots(const QString &roomName, QVector<PlanSlot> planSlots,
+                                                  QVector<PlanSlot> datedSlots, const QVector<qint64> &coveredDays) {
+    auto plan = std::make_shared<DayPlan>();
+    plan->room = roomName;
+
+    planSlots.erase(std::remove_if(planSlots.begin(), planSlots.end(), invalidSlot), planSlots.end());
+    plan->slotList = std::move(planSlots);
+
+    std::sort(plan->slotList.begin(), plan->slotList.end(), [](const PlanSlot &a, const PlanSlot &b) {
+        if (a.weekday != b.weekday) return a.weekday < b.weekday;
+        if (a.startSecs != b.startSecs) return a.startSecs < b.startSecs;
+        return a.endSecs < b.endSecs;
+    });
+
+    int index = 0;
+    for (int day = 1; day <= 8; ++day) {
+        while (index < plan->slotList.size() && plan->slotList[index].weekday < day) {
+            ++index;
+        }
+        plan->dayBegin[day] = index;
+    }
+
+    if (!coveredDays.isEmpty()) {
+        auto [low, high] = std::minmax_element(coveredDays.cbegin(), coveredDays.cend());
+        plan->firstDay = *low;
+        const int span = int(*high - *low + 1);
+        plan->coveredDay.fill(false, span);
+        for (qint64 day : coveredDays) {
+            plan->coveredDay[int(day - plan->firstDay)] = true;
+        }
+
+        // 只保留落在校历覆盖日期内的课程
+        datedSlots.erase(std::remove_if(datedSlots.begin(), datedSlots.end(), [&plan, span](const PlanSlot &slot) {
+            return invalidSlot(slot) || slot.day < plan->firstDay || slot.day >= plan->firstDay + span
+                   || !plan->coveredDay[int(slot.day - plan->firstDay)];
+        }), datedSlots.end());
+        std::sort(datedSlots.begin(), datedSlots.end(), [](const PlanSlot &a, const PlanSlot &b) {
+            if (a.day != b.day) return a.day < b.day;
+            if (a.startSecs != b.startSecs) return a.startSecs < b.startSecs;
+            return a.endSecs < b.endSecs;
+        });
+        plan->datedList = std::move(datedSlots);
+
+        plan->datedBegin.resize(span + 1);
+        int dated = 0;
+        for (int k = 0; k <= span; ++k) {
+            while (dated < plan->datedList.size() && plan->datedList[dated].day < plan->firstDay + k) {
+                ++dated;
+            }
+            plan->datedBegin[k] = dated;
+        }
+    }
+
+    return plan;
+}
+
+const PlanSlot *DayPlan::currentSlot(int weekday, int secs) const {
+    if (weekday < 1 || weekday > 7) return nullptr;
+    for (int i = dayBegin[weekday]; i < dayBegin[weekday + 1]; ++i) {
+        const PlanSlot &slot = slotList[i];
+        if (slot.startSecs > secs) break;
+        if (secs < slot.endSecs) return &slot;
+    }
+    return nullptr;
+}
+
+const PlanSlot *DayPlan::nextSlot(int weekday, int fromSecs) const {
+    auto it = std::lower_bound(slotList.cbegin(), slotList.cend(), qMakePair(weekday, fromSecs),
+                               [](const PlanSlot &slot, const QPair<int, int> &key) {
+        if (slot.weekday != key.first) return slot.weekday < key.first;
+        return slot.startSecs < key.second;
+    });
+    return it == slotList.cend() ? nullptr : &*it;
+}
+
+int DayPlan::nextBoundary(int weekday, int secs) const {
+    int boundary = 24 * 3600;
+    if (weekday < 1 || weekday > 7) return boundary;
+    for (int i = dayBegin[weekday]; i < dayBegin[weekday + 1]; ++i) {
+        const PlanSlot &slot = slotList[i];
+        if (slot.startSecs > secs) boundary = qMin(boundary, slot.startSecs);
+        if (slot.endSecs > secs) boundary = qMin(boundary, slot.endSecs);
+    }
+    return boundary;
+}
+
+bool DayPlan::datedRange(const QDate &date, int &begin, int &end) const {
+    qint64 k = date.toJulianDay() - firstDay;
+    if (k < 0 || k >= coveredDay.size() || !coveredDay[int(k)]) {
+        return false;
+    }
+    begin = datedBegin[int(k)];
+    end = datedBegin[int(k) + 1];
+    return true;
+}
+
+bool DayPlan::covers(const QDate &date) const {
+    int begin = 0;
+    int end = 0;
+    return datedRange(date, begin, end);
+}
+
+const PlanSlot *DayPlan::currentSlot(const QDate &date, int secs) const {
+    int begin = 0;
+    int end = 0;
+    if (!datedRange(date, begin, end)) {
+        return currentSlot(date.dayOfWeek(), secs);
+    }
+    for (int i = begin; i < end; ++i) {
+        const PlanSlot &slot = datedList[i];
+        if (slot.startSecs > secs) break;
+        if (secs < slot.endSecs) return &slot;
+    }
+    return nullptr;
+}
+
+const PlanSlot *DayPlan::nextSlot(const QDate &date, int fromSecs) const {
+    // 逐日查到本周日为止，每天按是否有校历分别查询
+    for (int weekday = date.dayOfWeek(); weekday <= 7; ++weekday) {
+        QDate day = date.addDays(weekday - date.dayOfWeek());
+        int secs = day == date ? fromSecs : 0;
+        int begin = 0;
+        int end = 0;
+        if (datedRange(day, begin, end)) {
+            for (int i = begin; i < end; ++i) {
+                if (datedList[i].startSecs >= secs) return &datedList[i];
+            }
+        } else {
+            const PlanSlot *slot = nextSlot(weekday, secs);
+            if (slot && slot->weekday == weekday) return slot;
+        }
+    }
+    return nullptr;
+}
+
+int DayPlan::nextBoundary(const QDate &date, int secs) const {
+    int begin = 0;
+    int end = 0;
+    if (!datedRange(date, begin, end)) {
+        return nextBoundary(date.dayOfWeek(), secs);
+    }
+    int boundary = 24 * 3600;
+    for (int i = begin; i < end; ++i) {
+        const PlanSlot &slot = datedList[i];
+        if (slot.startSecs > secs) boundary = qMin(boundary, slot.startSecs);
+        if (slot.endSecs > secs) boundary = qMin(boundary, slot.endSecs);
+    }
+    return boundary;
+}
@@ -0,0 +1,73 @@
+#ifndef DAYPLAN_H
+#define DAYPLAN_H
+
+#include <QString>
+#include <QVector>
+#include <QDate>
+#include <QSqlDatabase>
+#include <memory>
+
+// 单节课在内存中的表示，时间统一换算为当天的秒数
+struct PlanSlot {
+    int weekday = 0;     // 1=周一 ... 7=周日
+    int startSecs = 0;   // 开始时间（当天秒数）
+    int endSecs = 0;     // 结束时间（当天秒数），上课区间为 [startSecs, endSecs)
+    QString courseName;
+    QString teacher;
+    QString timeSlot;
+    qint64 day = 0;      // 校历日程所在日期（儒略日），按星期重复的课程为 0
+};
+
+// 某个教室一周课程的不可变快照。
+// 由 NetworkWorker 在工作线程中构建，构建完成后不再修改，界面线程只读。
+// 服务器启用校历时还带有近期按日期展开的课程：校历覆盖的日期以展开结果为准（放假当天没有课，
+// 调课日为替换后的课程），其余日期仍按星期查询。
+class DayPlan {
+public:
+    static std::shared_ptr<const DayPlan> build(QSqlDatabase db, const QString &roomName);
+    // 由已有的课程列表构建（例如来自快照文件），无效记录会被跳过
+    static std::shared_ptr<const DayPlan> fromSlots(const QString &roomName, QVector<PlanSlot> planSlots,
+                                                    QVector<PlanSlot> datedSlots = {},
+                                                    const QVector<qint64> &coveredDays = {});
+    static int parseClock(const QString &text); // "HH:mm[:ss]" -> 当天秒数，失败返回 -1
+
+    QString roomName() const { return room; }
+    const QVector<PlanSlot> &weekSlots() const { return slotList; }
+
+    // 指定时刻正在进行的课程，没有则返回 nullptr
+    const PlanSlot *currentSlot(int weekday, int secs) const;
+    // 当天 fromSecs 及之后开始、或之后日子里的第一节课（不跨周），没有则返回 nullptr
+    const PlanSlot *nextSlot(int weekday, int fromSecs) const;
+    // 当天 secs 之后最近的开始/结束时刻（当天秒数），没有则返回 86400（午夜）
+    int nextBoundary(int weekday, int secs) const;
+
+    // 按日期查询，语义同上；校历未覆盖的日期退回按星期查询
+    bool covers(const QDate &date) const;
+    const PlanSlot *currentSlot(const QDate &date, int secs) const;
+    const PlanSlot *nextSlot(const QDate &date, int fromSecs) const;
+    int nextBoundary(const QDate &date, int secs) const;
+
+private:
+    bool datedRange(const QDate &date, int &begin, int &end) const;
+
+    QString room;
+    QVector<PlanSlot> slotList;  // 按 (weekday, startSecs) 排序
+    int dayBegin[9] = {0};       // 星期 d 的课程下标区间为 [dayBegin[d], dayBegin[d + 1])
+
+    QVector<PlanSlot> datedList; // 按 (day, startSecs) 排序
+    qint64 firstDay = 0;         // 校历覆盖的第一天（儒略日）
+    QVector<bool> coveredDay;    // firstDay + k 是否有校历
+    QVector<int> datedBegin;     // firstDay + k 的课程下标区间为 [datedBegin[k], datedBegin[k + 1])
+};
+
+// 工作线程与界面线程之间共享的发布点，通过 shared_ptr 原子替换实现无锁读取
+class DayPlanStore {
+public:
+    std::shared_ptr<const DayPlan> current() const { return std::atomic_load(&plan); }
+    void publish(std::shared_ptr<const DayPlan> newPlan) { std::atomic_store(&plan, std::move(newPlan)); }
+
+private:
+    std::shared_ptr<const DayPlan> plan;
+};
+
+#endif // DAYPLAN_H
@@ -0,0 +1,60 @@
+#include "endpointpool.h"
+
+static const double kLatencySmoothing = 0.3;
+static const qint64 kCooldownBaseMs = 5000;
+static const qint64 kCooldownMaxMs = 120000;
+
+void EndpointPool::setEndpoints(const QVector<ServerEndpoint> &endpoints) {
+    states.clear();
+    for (const ServerEndpoint &endpoint : endpoints) {
+        State state;
+        state.endpoint = endpoint;
+        states.append(state);
+    }
+}
+
+int EndpointPool::pick(qint64 nowMs, const QVector<bool> &excluded) const {
+    int best = -1;
+    int earliest = -1;
+    for (int i = 0; i < states.size(); ++i) {
+        if (i < excluded.size() && excluded[i]) continue;
+        const State &state = states[i];
+
+        if (state.downUntilMs > nowMs) {
+            if (earliest < 0 || state.downUntilMs < states[earliest].downUntilMs) {
+                earliest = i;
+            }
+            continue;
+        }
+
+        // 未测量的服务器视为延迟 0，保证每个服务器都会被探测到；相同延迟按配置顺序
+        if (best < 0) {
+            best = i;
+        } else {
+            double candidate = qMax(0.0, state.latencyMs);
+            double current = qMax(0.0, states[best].latencyMs);
+            if (candidate < current) {
+                best = i;
+            }
+        }
+    }
+    return best >= 0 ? best : earliest;
+}
+
+void EndpointPool::reportSuccess(int index, qint64 latencyMs) {
+    State &state = states[index];
+    state.failures = 0;
+    state.downUntilMs = 0;
+    if (state.latencyMs < 0) {
+        state.latencyMs = latencyMs;
+    } else {
+        state.latencyMs = kLatencySmoothing * latencyMs + (1.0 - kLatencySmoothing) * state.latencyMs;
+    }
+}
+
+void EndpointPool::reportFailure(int index, qint64 nowMs) {
+    State &state = states[index];
+    state.failures = qMin(state.failures + 1, 16);
+    qint64 cooldown = qMin(kCooldownBaseMs << (state.failures - 1), kCooldownMaxMs);
+    state.downUntilMs = nowMs + cooldown;
+}
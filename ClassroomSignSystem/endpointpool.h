@@ -0,0 +1,34 @@
+#ifndef ENDPOINTPOOL_H
+#define ENDPOINTPOOL_H
+
+#include <QVector>
+#include "signconfig.h"
+
+// 记录每个服务器的健康状态和实测延迟，选出当前最合适的服务器
+class EndpointPool
+{
+public:
+    void setEndpoints(const QVector<ServerEndpoint> &endpoints);
+
+    int size() const { return states.size(); }
+    const ServerEndpoint &endpoint(int index) const { return states[index].endpoint; }
+    double latencyMs(int index) const { return states[index].latencyMs; }
+
+    // 选出未被排除的服务器：优先健康的，其中未测过延迟的先试，其余取延迟最低；
+    // 全部处于冷却期时选最早恢复的。没有可选项时返回 -1
+    int pick(qint64 nowMs, const QVector<bool> &excluded) const;
+
+    void reportSuccess(int index, qint64 latencyMs); // 延迟取首字节时间，按指数滑动平均
+    void reportFailure(int index, qint64 nowMs);     // 进入冷却期，连续失败时冷却时间翻倍
+
+private:
+    struct State {
+        ServerEndpoint endpoint;
+        double latencyMs = -1;   // -1 表示尚未测量
+        int failures = 0;
+        qint64 downUntilMs = 0;
+    };
+    QVector<State> states;
+};
+
+#endif // ENDPOINTPOOL_H
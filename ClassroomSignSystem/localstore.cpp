@@ -0,0 +1,221 @@
+#include "localstore.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonArray>
+#include <QDebug>
+#include "schema.h"
+
+static const int kBusyTimeoutMs = 5000;
+
+bool LocalStore::configure(QSqlDatabase db) {
+    QSqlQuery query(db);
+
+    if (!query.exec("PRAGMA journal_mode=WAL") || !query.next()
+        || query.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) {
+        qDebug() << "无法切换到 WAL 模式:" << query.lastError().text();
+        return false;
+    }
+    // WAL 下 NORMAL 仍能保证数据库一致，只是断电时可能丢失最后一次提交
+    query.exec("PRAGMA synchronous=NORMAL");
+    query.exec(QString("PRAGMA busy_timeout=%1").arg(kBusyTimeoutMs));
+    return true;
+}
+
+bool LocalStore::ensureSchema(QSqlDatabase db) {
+    using namespace Schema;
+    const QString ddl[] = {
+        sql<Schedules, Side::Client, Statement::Create>(),
+        sql<Classrooms, Side::Client, Statement::Create>(),
+        sql<Announcements, Side::Client, Statement::Create>(),
+        sql<SyncLog, Side::Client, Statement::Create>(),
+        sql<CalendarDays, Side::Client, Statement::Create>(),
+        sql<Occurrences, Side::Client, Statement::Create>(),
+        sql<PendingCheckins, Side::Client, Statement::Create>(),
+        // DayPlan 按教室取日程
+        QStringLiteral("CREATE INDEX IF NOT EXISTS idx_occurrences_room_date ON occurrences(room_name, date)"),
+    };
+
+    QSqlQuery query(db);
+    for (const QString &statement : ddl) {
+        if (!query.exec(statement)) {
+            qDebug() << "创建表失败:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+// 整表替换：先清空，再按列顺序逐行绑定插入
+template <const Schema::Table &T, Schema::Statement K = Schema::Statement::Insert>
+static bool replaceTable(QSqlQuery &query, const QJsonArray &array) {
+    if (!query.exec(QStringLiteral("DELETE FROM ") + QLatin1String(T.name))) return false;
+    if (!query.prepare(Schema::sql<T, Schema::Side::Client, K>())) return false;
+    for (const QJsonValue &value : array) {
+        Schema::bindJson<T>(query, value.toObject());
+        if (!query.exec()) return false;
+    }
+    return true;
+}
+
+template <const Schema::Table &T, Schema::Statement K = Schema::Statement::Insert>
+static bool replaceTable(QSqlQuery &query, const Columnar::TableData &table) {
+    if (!query.exec(QStringLiteral("DELETE FROM ") + QLatin1String(T.name))) return false;
+    if (!query.prepare(Schema::sql<T, Schema::Side::Client, K>())) return false;
+    for (int row = 0; row < table.rowCount; ++row) {
+        for (int i = 0; i < T.columnCount; ++i) {
+            if (T.columns[i].type == Schema::ColumnType::Integer) {
+                query.bindValue(i, int(table.integer(i, row)));
+            } else {
+                query.bindValue(i, table.text(i, row));
+            }
+        }
+        if (!query.exec()) return false;
+    }
+    return true;
+}
+
+// 在一个事务中执行写入，失败时回滚并记录错误
+template <typename Apply>
+static LocalStore::ApplyResult applyInTransaction(QSqlDatabase db, Apply apply) {
+    LocalStore::ApplyResult result;
+
+    if (!db.transaction()) {
+        result.error = db.lastError().text();
+        return result;
+    }
+
+    QSqlQuery query(db);
+    if (!apply(query, result)) {
+        result.error = query.lastError().text();
+        db.rollback();
+        return result;
+    }
+
+    if (!db.commit()) {
+        result.error = db.lastError().text();
+        db.rollback();
+        return result;
+    }
+
+    result.ok = true;
+    return result;
+}
+
+LocalStore::ApplyResult LocalStore::applySync(QSqlDatabase db, const QJsonObject &rootObj) {
+    return applyInTransaction(db, [&rootObj](QSqlQuery &query, ApplyResult &result) {
+        if (rootObj.contains("schedules")) {
+            QJsonArray array = rootObj["schedules"].toArray();
+            if (!replaceTable<Schema::Schedules>(query, array)) return false;
+            result.schedules = array.size();
+        }
+        if (rootObj.contains("classrooms")) {
+            QJsonArray array = rootObj["classrooms"].toArray();
+            // room_name 带 UNIQUE 约束，服务器数据若有重复以后一条为准
+            if (!replaceTable<Schema::Classrooms, Schema::Statement::Upsert>(query, array)) return false;
+            result.classrooms = array.size();
+        }
+        if (rootObj.contains("announcements")) {
+            QJsonArray array = rootObj["announcements"].toArray();
+            if (!replaceTable<Schema::Announcements>(query, array)) return false;
+            result.announcements = array.size();
+        }
+        if (rootObj.contains("calendar_days")) {
+            QJsonArray days = rootObj["calendar_days"].toArray();
+            QJsonArray occurrences = rootObj["occurrences"].toArray();
+            if (!replaceTable<Schema::CalendarDays, Schema::Statement::Upsert>(query, days)) return false;
+            if (!replaceTable<Schema::Occurrences>(query, occurrences)) return false;
+            result.occurrences = occurrences.size();
+        }
+        return true;
+    });
+}
+
+LocalStore::ApplyResult LocalStore::applyColumnar(QSqlDatabase db, const Columnar::Snapshot &snapshot) {
+    return applyInTransaction(db, [&snapshot](QSqlQuery &query, ApplyResult &result) {
+        const Columnar::TableData &schedules = snapshot.tables[Columnar::ScheduleTable];
+        const Columnar::TableData &classrooms = snapshot.tables[Columnar::ClassroomTable];
+        const Columnar::TableData &announcements = snapshot.tables[Columnar::AnnouncementTable];
+        const Columnar::TableData &days = snapshot.tables[Columnar::CalendarDayTable];
+        const Columnar::TableData &occurrences = snapshot.tables[Columnar::OccurrenceTable];
+
+        if (schedules.present) {
+            if (!replaceTable<Schema::Schedules>(query, schedules)) return false;
+            result.schedules = schedules.rowCount;
+        }
+        if (classrooms.present) {
+            if (!replaceTable<Schema::Classrooms, Schema::Statement::Upsert>(query, classrooms)) return false;
+            result.classrooms = classrooms.rowCount;
+        }
+        if (announcements.present) {
+            if (!replaceTable<Schema::Announcements>(query, announcements)) return false;
+            result.announcements = announcements.rowCount;
+        }
+        if (days.present) {
+            if (!replaceTable<Schema::CalendarDays, Schema::Statement::Upsert>(query, days)) return false;
+            if (!replaceTable<Schema::Occurrences>(query, occurrences)) return false;
+            result.occurrences = occurrences.rowCount;
+        }
+        return true;
+    });
+}
+
+bool LocalStore::enqueueCheckin(QSqlDatabase db, const QString &cardId, const QString &room, qint64 checkedAtMs) {
+    using namespace Schema;
+    QSqlQuery query(db);
+    if (!query.prepare(sql<PendingCheckins, Side::Client, Statement::Insert>())) {
+        qDebug() << "签到写入失败:" << query.lastError().text();
+        return false;
+    }
+    query.bindValue(PendingCheckinCol::CardId, cardId);
+    query.bindValue(PendingCheckinCol::RoomName, room);
+    query.bindValue(PendingCheckinCol::CheckedAtMs, checkedAtMs);
+    if (!query.exec()) {
+        qDebug() << "签到写入失败:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QVector<LocalStore::Checkin> LocalStore::pendingCheckins(QSqlDatabase db, int limit) {
+    using namespace Schema;
+    QVector<Checkin> checkins;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql<PendingCheckins, Side::Client, Statement::SelectWithId>() + " ORDER BY id LIMIT ?")) {
+        qDebug() << "读取签到队列失败:" << query.lastError().text();
+        return checkins;
+    }
+    query.bindValue(0, limit);
+    if (!query.exec()) {
+        qDebug() << "读取签到队列失败:" << query.lastError().text();
+        return checkins;
+    }
+    while (query.next()) {
+        Checkin checkin;
+        checkin.id = query.value(0).toLongLong();
+        checkin.cardId = query.value(1 + PendingCheckinCol::CardId).toString();
+        checkin.room = query.value(1 + PendingCheckinCol::RoomName).toString();
+        checkin.checkedAtMs = query.value(1 + PendingCheckinCol::CheckedAtMs).toLongLong();
+        checkins.append(checkin);
+    }
+    return checkins;
+}
+
+bool LocalStore::removeCheckins(QSqlDatabase db, qint64 upToId) {
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM pending_checkins WHERE id <= ?");
+    query.bindValue(0, upToId);
+    if (!query.exec()) {
+        qDebug() << "删除已确认的签到失败:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int LocalStore::pendingCheckinCount(QSqlDatabase db) {
+    QSqlQuery query(db);
+    if (!query.exec("SELECT COUNT(*) FROM pending_checkins") || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toInt();
+}
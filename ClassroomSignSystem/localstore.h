@@ -0,0 +1,49 @@
+#ifndef LOCALSTORE_H
+#define LOCALSTORE_H
+
+#include <QSqlDatabase>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include "columnar.h"
+
+// 班牌本地数据库的表结构与写入。
+// 数据库使用 WAL 模式：同步写入期间，界面线程的读连接仍能看到上一次提交的完整数据，
+// 不会被写锁阻塞；一次同步的全部表在同一个事务中替换，读者要么看到旧数据要么看到新数据。
+// 刷卡签到先写入本地队列，服务器确认后才删除，断网或重启期间的签到不会丢失；同步只替换下发的表，不影响队列。
+class LocalStore
+{
+public:
+    struct ApplyResult {
+        bool ok = false;
+        int schedules = -1;       // 本次写入的行数，-1 表示响应中没有该表
+        int classrooms = -1;
+        int announcements = -1;
+        int occurrences = -1;     // 校历展开的课程，服务器未启用校历时为 0
+        QString error;
+    };
+
+    struct Checkin {
+        qint64 id = 0;            // 本地队列中的编号，递增，上传批次以最后一条的编号标识
+        QString cardId;
+        QString room;
+        qint64 checkedAtMs = 0;
+    };
+
+    // 每个连接打开后调用：WAL、较宽松的同步级别和忙等待超时
+    static bool configure(QSqlDatabase db);
+    static bool ensureSchema(QSqlDatabase db);
+
+    // 把服务器响应中出现的表整体替换为新内容（DELETE + INSERT，单个事务）
+    static ApplyResult applySync(QSqlDatabase db, const QJsonObject &rootObj);
+    // 同上，数据来自列式编码的响应，直接从各列字典绑定，不经过 JSON
+    static ApplyResult applyColumnar(QSqlDatabase db, const Columnar::Snapshot &snapshot);
+
+    // 签到队列：写入一条、按编号取出最早的至多 limit 条、删除服务器已确认的（编号不大于 upToId）
+    static bool enqueueCheckin(QSqlDatabase db, const QString &cardId, const QString &room, qint64 checkedAtMs);
+    static QVector<Checkin> pendingCheckins(QSqlDatabase db, int limit);
+    static bool removeCheckins(QSqlDatabase db, qint64 upToId);
+    static int pendingCheckinCount(QSqlDatabase db);
+};
+
+#endif // LOCALSTORE_H
@@ -0,0 +1,100 @@
+#include "localtables.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <QDateTime>
+#include "schema.h"
+#include <algorithm>
+
+std::shared_ptr<const ScheduleTable> ScheduleTable::load(QSqlDatabase db) {
+    auto table = std::make_shared<ScheduleTable>();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(Schema::sql<Schema::Schedules, Schema::Side::Client, Schema::Statement::Select>() + " ORDER BY id")) {
+        qDebug() << "读取课程表失败:" << query.lastError().text();
+        return table;
+    }
+
+    while (query.next()) {
+        ScheduleRow row;
+        row.roomName = query.value(Schema::ScheduleCol::RoomName).toString();
+        row.courseName = query.value(Schema::ScheduleCol::CourseName).toString();
+        row.teacher = query.value(Schema::ScheduleCol::Teacher).toString();
+        row.timeSlot = query.value(Schema::ScheduleCol::TimeSlot).toString();
+        row.startTime = query.value(Schema::ScheduleCol::StartTime).toString();
+        row.endTime = query.value(Schema::ScheduleCol::EndTime).toString();
+        row.weekday = query.value(Schema::ScheduleCol::Weekday).toInt();
+        row.isNext = query.value(Schema::ScheduleCol::IsNext).toInt();
+
+        table->rowsByRoom[row.roomName].append(table->rows.size());
+        table->rows.append(row);
+    }
+
+    table->searchIndex.build(table->rows);
+    return table;
+}
+
+std::shared_ptr<const ClassroomTable> ClassroomTable::load(QSqlDatabase db) {
+    auto table = std::make_shared<ClassroomTable>();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(Schema::sql<Schema::Classrooms, Schema::Side::Client, Schema::Statement::Select>() + " ORDER BY id")) {
+        qDebug() << "读取教室表失败:" << query.lastError().text();
+        return table;
+    }
+
+    while (query.next()) {
+        ClassroomRow row;
+        row.roomName = query.value(Schema::ClassroomCol::RoomName).toString();
+        row.className = query.value(Schema::ClassroomCol::ClassName).toString();
+        row.capacity = query.value(Schema::ClassroomCol::Capacity).toInt();
+        row.building = query.value(Schema::ClassroomCol::Building).toString();
+        row.floor = query.value(Schema::ClassroomCol::Floor).toInt();
+        row.currentClass = query.value(Schema::ClassroomCol::CurrentClass).toString();
+        table->rows.append(row);
+    }
+
+    table->byRoomName.resize(table->rows.size());
+    for (int i = 0; i < table->byRoomName.size(); ++i) {
+        table->byRoomName[i] = i;
+    }
+    const QVector<ClassroomRow> &rows = table->rows;
+    std::sort(table->byRoomName.begin(), table->byRoomName.end(), [&rows](int a, int b) {
+        return rows[a].roomName < rows[b].roomName;
+    });
+
+    return table;
+}
+
+// 公告时间为 "yyyy-MM-dd hh:mm:ss"，空值或无法解析时返回 0
+static qint64 announcementTimeMs(const QString &text) {
+    if (text.isEmpty()) {
+        return 0;
+    }
+    QDateTime time = QDateTime::fromString(text, "yyyy-MM-dd hh:mm:ss");
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+std::shared_ptr<const AnnouncementTable> AnnouncementTable::load(QSqlDatabase db) {
+    auto table = std::make_shared<AnnouncementTable>();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(Schema::sql<Schema::Announcements, Schema::Side::Client, Schema::Statement::Select>())) {
+        qDebug() << "读取公告表失败:" << query.lastError().text();
+        return table;
+    }
+
+    while (query.next()) {
+        AnnouncementRow row;
+        row.title = query.value(Schema::AnnouncementCol::Title).toString();
+        row.content = query.value(Schema::AnnouncementCol::Content).toString();
+        row.priority = query.value(Schema::AnnouncementCol::Priority).toInt();
+        row.publishAtMs = announcementTimeMs(query.value(Schema::AnnouncementCol::PublishTime).toString());
+        row.expireAtMs = announcementTimeMs(query.value(Schema::AnnouncementCol::ExpireTime).toString());
+        table->rows.append(row);
+    }
+    return table;
+}
@@ -0,0 +1,88 @@
+#ifndef LOCALTABLES_H
+#define LOCALTABLES_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QMetaType>
+#include <QSqlDatabase>
+#include <memory>
+#include "schedulesearch.h"
+
+// 本地 schedules 表的一行
+struct ScheduleRow {
+    QString roomName;
+    QString courseName;
+    QString teacher;
+    QString timeSlot;
+    QString startTime;
+    QString endTime;
+    int weekday = 0;
+    int isNext = 0;
+
+    bool operator==(const ScheduleRow &other) const {
+        return roomName == other.roomName && courseName == other.courseName && teacher == other.teacher
+            && timeSlot == other.timeSlot && startTime == other.startTime && endTime == other.endTime
+            && weekday == other.weekday && isNext == other.isNext;
+    }
+    bool operator!=(const ScheduleRow &other) const { return !(*this == other); }
+};
+
+// 本地 classrooms 表的一行
+struct ClassroomRow {
+    QString roomName;
+    QString className;
+    int capacity = 0;
+    QString building;
+    int floor = 0;
+    QString currentClass;
+
+    bool operator==(const ClassroomRow &other) const {
+        return roomName == other.roomName && className == other.className && capacity == other.capacity
+            && building == other.building && floor == other.floor && currentClass == other.currentClass;
+    }
+    bool operator!=(const ClassroomRow &other) const { return !(*this == other); }
+};
+
+// 本地 announcements 表的一行，时间在读出时换算为毫秒，显示时不再解析
+struct AnnouncementRow {
+    QString title;
+    QString content;
+    int priority = 0;
+    qint64 publishAtMs = 0;   // 0 表示立即生效
+    qint64 expireAtMs = 0;    // 0 表示不过期
+};
+
+// 课程表的不可变行集合，由工作线程从本地数据库读出并建好索引后交给界面线程
+struct ScheduleTable {
+    QVector<ScheduleRow> rows;                  // 按 id 顺序
+    QHash<QString, QVector<int>> rowsByRoom;    // 教室 -> rows 下标（升序）
+    ScheduleSearchIndex searchIndex;            // 教室/教师/课程的 n-gram 索引
+
+    static std::shared_ptr<const ScheduleTable> load(QSqlDatabase db);
+};
+
+// 教室表的不可变行集合
+struct ClassroomTable {
+    QVector<ClassroomRow> rows;                 // 按 id 顺序
+    QVector<int> byRoomName;                    // rows 下标按教室名称排序，用于下拉框
+
+    static std::shared_ptr<const ClassroomTable> load(QSqlDatabase db);
+};
+
+// 公告表的不可变行集合，交给界面线程的 AnnouncementQueue 轮播
+struct AnnouncementTable {
+    QVector<AnnouncementRow> rows;
+
+    static std::shared_ptr<const AnnouncementTable> load(QSqlDatabase db);
+};
+
+using ScheduleTablePtr = std::shared_ptr<const ScheduleTable>;
+using ClassroomTablePtr = std::shared_ptr<const ClassroomTable>;
+using AnnouncementTablePtr = std::shared_ptr<const AnnouncementTable>;
+
+Q_DECLARE_METATYPE(ScheduleTablePtr)
+Q_DECLARE_METATYPE(ClassroomTablePtr)
+Q_DECLARE_METATYPE(AnnouncementTablePtr)
+
+#endif // LOCALTABLES_H
@@ -1,14 +1,18 @@
 #include "mainwindow.h"
-#include "DatabaseManager.h"
 #include <QApplication>
 #include <QDebug>
 #include <QSqlDatabase>
+#include <QElapsedTimer>
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupClock;
+    startupClock.start();
+
     qDebug() << "程序启动...";
 
     QApplication a(argc, argv);
+    a.setApplicationVersion("1.4.0"); // 随同步请求上报，服务器的班牌状态表按此区分版本
 
     qDebug() << "QApplication创建成功";
 
@@ -27,8 +31,7 @@ int main(int argc, char *argv[])
     MainWindow w;
     qDebug() << "MainWindow创建成功";
 
-    DatabaseManager::initSampleData();
-
+    w.setStartupClock(startupClock);
     w.setWindowTitle("智慧教室班牌系统");
     w.show();
 
@@ -7,45 +7,50 @@
 #include <QTabWidget>
 #include <QSplitter>
 #include <QComboBox>
+#include "plansnapshot.h"
+#include "signconfig.h"
 
 MainWindow::MainWindow(QWidget *parent)
-    : QWidget(parent), scrollPosition(0)
+    : QWidget(parent)
 {
     qDebug() << "MainWindow构造函数开始";
 
-    if (!DatabaseManager::initDb()) {
-        qDebug() << "数据库初始化失败";
-    } else {
-        qDebug() << "数据库初始化成功";
-    }
-
     qDebug() << "开始设置UI";
     setupUi();
 
+    SignConfig config = SignConfig::load();
+    savedRoom = config.room;
+
+    // 先用上次同步留下的快照显示上次所选教室的课程，数据库在首帧之后再初始化
+    loadStartupSnapshot();
+
     qDebug() << "开始设置Model";
     setupModel();
 
     qDebug() << "开始启动Worker";
+    announcementQueue.setDwellMs(config.announcementDwellMs);
     startWorker();
 
+    // 刷卡签到：读到的卡号交给工作线程写入本地队列
+    cardReader = CardReader::create(config, this);
+    if (cardReader) {
+        connect(cardReader, &CardReader::cardRead, this, &MainWindow::onCardRead);
+        cardReader->start();
+    }
+
     timeTimer = new QTimer(this);
     connect(timeTimer, &QTimer::timeout, this, &MainWindow::updateCurrentTime);
     timeTimer->start(1000);
 
-    scrollTimer = new QTimer(this);
-    connect(scrollTimer, &QTimer::timeout, this, &MainWindow::scrollAnnouncement);
-    scrollTimer->start(200);
-
-    bottomScrollTimer = new QTimer(this);
-    connect(bottomScrollTimer, &QTimer::timeout, this, &MainWindow::scrollBottomNotification);
-    bottomScrollTimer->start(100);
+    boundaryTimer = new QTimer(this);
+    boundaryTimer->setSingleShot(true);
+    boundaryTimer->setTimerType(Qt::PreciseTimer);
+    connect(boundaryTimer, &QTimer::timeout, this, &MainWindow::updateDisplay);
 
     qDebug() << "开始更新显示";
     updateCurrentTime();
-    loadClassrooms();
     updateDisplay();
-    loadAnnouncement();
-    loadNotifications();
+    emit roomSelected(selectedRoom()); // 教室列表为空时也要构建默认教室的计划
 
     qDebug() << "MainWindow构造函数完成";
 }
@@ -147,6 +152,10 @@ void MainWindow::setupUi() {
     lblTime->setStyleSheet("font-size: 16px; color: #7f8c8d; padding: 5px;");
     lblTime->setAlignment(Qt::AlignCenter);
 
+    lblAttendance = new QLabel("出勤: --");
+    lblAttendance->setStyleSheet("font-size: 16px; color: #2980b9; padding: 5px;");
+    lblAttendance->setAlignment(Qt::AlignCenter);
+
     QFrame *line = new QFrame();
     line->setFrameShape(QFrame::HLine);
     line->setStyleSheet("background-color: #bdc3c7;");
@@ -160,16 +169,17 @@ void MainWindow::setupUi() {
     infoLayout->addWidget(lblCourseName);
     infoLayout->addWidget(lblTeacher);
     infoLayout->addWidget(lblTime);
+    infoLayout->addWidget(lblAttendance);
     infoLayout->addWidget(line);
     infoLayout->addWidget(lblNextCourse);
     infoLayout->addStretch();
     infoGroup->setLayout(infoLayout);
 
-    lblAnnouncement = new QLabel();
-    lblAnnouncement->setStyleSheet("background-color: #f39c12; color: white; padding: 10px; font-size: 14px; border-radius: 5px;");
-    lblAnnouncement->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    lblAnnouncement = new MarqueeLabel();
+    lblAnnouncement->setStyleSheet("background-color: #f39c12; color: white; font-size: 14px; border-radius: 5px;");
+    lblAnnouncement->setContentsMargins(10, 10, 10, 10);
     lblAnnouncement->setMinimumHeight(40);
-    lblAnnouncement->setWordWrap(false);
+    lblAnnouncement->setSpeed(40);
     lblAnnouncement->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
 
     QTabWidget *tabWidget = new QTabWidget();
@@ -183,6 +193,11 @@ void MainWindow::setupUi() {
     searchBox->setPlaceholderText("输入关键词筛选...");
     filterLayout->addWidget(searchBox);
 
+    // 输入停顿后再检索，连续输入时只执行最后一次
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(150);
+    connect(searchTimer, &QTimer::timeout, this, &MainWindow::applyScheduleFilter);
     connect(searchBox, &QLineEdit::textChanged, this, &MainWindow::filterData);
 
     tableView = new QTableView();
@@ -225,11 +240,11 @@ void MainWindow::setupUi() {
 
     overallLayout->addLayout(contentLayout);
 
-    lblBottomNotification = new QLabel();
-    lblBottomNotification->setStyleSheet("background-color: #2c3e50; color: #ecf0f1; padding: 15px; font-size: 16px; font-weight: bold;");
-    lblBottomNotification->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    lblBottomNotification = new MarqueeLabel();
+    lblBottomNotification->setStyleSheet("background-color: #2c3e50; color: #ecf0f1; font-size: 16px; font-weight: bold;");
+    lblBottomNotification->setContentsMargins(15, 15, 15, 15);
     lblBottomNotification->setMinimumHeight(50);
-    lblBottomNotification->setWordWrap(false);
+    lblBottomNotification->setSpeed(80);
     lblBottomNotification->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
 
     overallLayout->addWidget(lblBottomNotification);
@@ -238,43 +253,33 @@ void MainWindow::setupUi() {
 }
 
 void MainWindow::setupModel() {
-    model = new QSqlTableModel(this);
-    model->setTable("schedules");
-    model->setHeaderData(1, Qt::Horizontal, "教室");
-    model->setHeaderData(2, Qt::Horizontal, "课程");
-    model->setHeaderData(3, Qt::Horizontal, "教师");
-    model->setHeaderData(4, Qt::Horizontal, "时间段");
-    model->select();
-
-    tableView->setModel(model);
-    tableView->hideColumn(0);  // id
-    tableView->hideColumn(5);  // start_time
-    tableView->hideColumn(6);  // end_time
-    tableView->hideColumn(7);  // weekday
-    tableView->hideColumn(8);  // is_next
-
-    classroomModel = new QSqlTableModel(this);
-    classroomModel->setTable("classrooms");
-    classroomModel->setHeaderData(1, Qt::Horizontal, "教室名称");
-    classroomModel->setHeaderData(2, Qt::Horizontal, "班级");
-    classroomModel->setHeaderData(3, Qt::Horizontal, "容量");
-    classroomModel->setHeaderData(4, Qt::Horizontal, "教学楼");
-    classroomModel->setHeaderData(5, Qt::Horizontal, "楼层");
-    classroomModel->select();
+    // 模型数据由工作线程准备好后整体替换，界面线程不再直接查询数据库
+    scheduleModel = new ScheduleTableModel(this);
+    scheduleProxy = new RowSubsetProxyModel(this);
+    scheduleProxy->setSourceModel(scheduleModel);
+    tableView->setModel(scheduleProxy);
 
+    classroomModel = new ClassroomTableModel(this);
     classroomView->setModel(classroomModel);
-    classroomView->hideColumn(0);
 }
 
 void MainWindow::startWorker() {
     workerThread = new QThread;
-    NetworkWorker *worker = new NetworkWorker;
+    NetworkWorker *worker = new NetworkWorker(&planStore);
 
     worker->moveToThread(workerThread);
 
     connect(workerThread, &QThread::started, worker, &NetworkWorker::startSync);
     connect(worker, &NetworkWorker::dataUpdated, this, &MainWindow::onDataSynced);
-    connect(worker, &NetworkWorker::announcementUpdated, this, &MainWindow::onAnnouncementUpdated);
+    connect(worker, &NetworkWorker::announcementsUpdated, this, &MainWindow::onAnnouncementsUpdated);
+    connect(worker, &NetworkWorker::urgentAnnouncement, this, &MainWindow::onUrgentAnnouncement);
+    connect(worker, &NetworkWorker::planUpdated, this, &MainWindow::onPlanUpdated);
+    connect(worker, &NetworkWorker::tablesUpdated, this, &MainWindow::onTablesUpdated);
+    connect(this, &MainWindow::roomSelected, worker, &NetworkWorker::setPlanRoom);
+    connect(this, &MainWindow::syncDisplayed, worker, &NetworkWorker::onSyncDisplayed);
+    connect(this, &MainWindow::checkinRequested, worker, &NetworkWorker::recordCheckin);
+    connect(worker, &NetworkWorker::checkinRecorded, this, &MainWindow::onCheckinRecorded);
+    connect(worker, &NetworkWorker::attendanceUpdated, this, &MainWindow::onAttendanceUpdated);
 
     connect(workerThread, &QThread::finished, worker, &QObject::deleteLater);
     connect(workerThread, &QThread::finished, workerThread, &QObject::deleteLater);
@@ -282,277 +287,305 @@ void MainWindow::startWorker() {
     workerThread->start();
 }
 
-void MainWindow::onDataSynced(const QString &msg) {
+void MainWindow::onDataSynced(const QString &msg, qint64 changeId) {
     lblStatus->setText(msg);
+    emit syncDisplayed(changeId, QDateTime::currentMSecsSinceEpoch());
+}
 
-    // 清除过滤条件，避免之前的过滤影响新数据
-    model->setFilter("");
-    model->select();
-    
-    classroomModel->setFilter("");
-    classroomModel->select();
+void MainWindow::onTablesUpdated(ScheduleTablePtr schedules, ClassroomTablePtr classrooms) {
+    // 行集合已在工作线程中读出并建好索引，这里只做指针替换和少量差异更新
+    scheduleModel->setTable(schedules);
+    classroomModel->setTable(classrooms);
 
-    loadClassrooms();
-    updateDisplay();
-    
-    // 同步后自动过滤到当前选中的教室
-    if (classroomComboBox->count() > 0) {
-        QString currentRoom = classroomComboBox->currentData().toString();
-        if (!currentRoom.isEmpty()) {
-            QString filterStr = QString("room_name = '%1'").arg(currentRoom);
-            model->setFilter(filterStr);
-            model->select();
-        }
+    if (classrooms) {
+        updateClassroomCombo(*classrooms);
     }
+    applyScheduleFilter();
 }
 
-void MainWindow::onAnnouncementUpdated(const QString &title, const QString &content) {
-    announcementText = "【" + title + "】" + content;
-    scrollPosition = 0;
-    lblAnnouncement->setText(announcementText);
+void MainWindow::onAnnouncementsUpdated(AnnouncementTablePtr announcements) {
+    // 空表或全部过期时公告栏和滚动条都会清空
+    announcementQueue.reset(std::move(announcements), QDateTime::currentMSecsSinceEpoch());
+    showAnnouncements();
 }
 
-void MainWindow::updateDisplay(const QString &roomName) {
-    QString currentRoomName = roomName;
-    if (currentRoomName.isEmpty() && classroomComboBox->count() > 0) {
-        currentRoomName = classroomComboBox->currentData().toString();
+void MainWindow::onCardRead(const QString &cardId) {
+    // 键盘式读卡器的字符也会进入获得焦点的搜索框，识别为刷卡后去掉
+    QString search = searchBox->text();
+    if (search.endsWith(cardId)) {
+        searchBox->setText(search.chopped(cardId.size()));
     }
-    
-    if (currentRoomName.isEmpty()) {
-        currentRoomName = "Class 101";
+    emit checkinRequested(cardId, QDateTime::currentMSecsSinceEpoch());
+}
+
+void MainWindow::onCheckinRecorded(const QString &cardId, int pending) {
+    // 已写入本地队列才提示成功；离线时显示积压的条数
+    QString text = QString("签到成功: 尾号 %1  %2").arg(cardId.right(4), QTime::currentTime().toString("HH:mm:ss"));
+    if (pending > 1) {
+        text += QString("（%1 条待上传）").arg(pending);
     }
+    lblStatus->setText(text);
+}
 
-    QSqlQuery query;
-    QDateTime now = QDateTime::currentDateTime();
-    QString currentTime = now.toString("HH:mm");
-    int currentWeekday = now.date().dayOfWeek();
-    
-    // 查询当前时间段的课程（当前时间在 start_time 和 end_time 之间）
-    query.prepare(
-        "SELECT course_name, teacher, time_slot, start_time, end_time "
-        "FROM schedules "
-        "WHERE room_name = ? AND weekday = ? AND start_time <= ? AND end_time >= ? "
-        "ORDER BY start_time LIMIT 1"
-    );
-    query.addBindValue(currentRoomName);
-    query.addBindValue(currentWeekday);
-    query.addBindValue(currentTime);
-    query.addBindValue(currentTime);
-    
-    if(query.exec() && query.next()) {
-        // 找到了当前正在进行的课程
-        lblCourseName->setText(query.value(0).toString());
-        lblTeacher->setText("教师: " + query.value(1).toString());
-        lblTime->setText("时间: " + query.value(2).toString());
-        
-        QString currentEndTime = query.value(4).toString();
-        
-        // 查询下一节课（start_time > 当前课程的 end_time）
-        QSqlQuery nextQuery;
-        nextQuery.prepare(
-            "SELECT course_name, time_slot, weekday "
-            "FROM schedules "
-            "WHERE room_name = ? AND (weekday > ? OR (weekday = ? AND start_time > ?)) "
-            "ORDER BY weekday ASC, start_time ASC LIMIT 1"
-        );
-        nextQuery.addBindValue(currentRoomName);
-        nextQuery.addBindValue(currentWeekday);
-        nextQuery.addBindValue(currentWeekday);
-        nextQuery.addBindValue(currentEndTime);
-        
-        if(nextQuery.exec() && nextQuery.next()) {
-            QString nextCourseName = nextQuery.value(0).toString();
-            QString nextTimeSlot = nextQuery.value(1).toString();
-            int nextWeekday = nextQuery.value(2).toInt();
-            
-            QString dayName;
-            switch(nextWeekday) {
-                case 1: dayName = "周一"; break;
-                case 2: dayName = "周二"; break;
-                case 3: dayName = "周三"; break;
-                case 4: dayName = "周四"; break;
-                case 5: dayName = "周五"; break;
-                case 6: dayName = "周六"; break;
-                case 7: dayName = "周日"; break;
-                default: dayName = "未知"; break;
-            }
-            
-            lblNextCourse->setText("下节预告: " + nextCourseName + " (" + dayName + " " + nextTimeSlot + ")");
-        } else {
-            lblNextCourse->setText("下节预告: 无");
-        }
+void MainWindow::onAttendanceUpdated(const QString &room, int present, int capacity, const QString &course) {
+    if (room != selectedRoom()) {
+        return;
+    }
+    // 没有课时服务器推送的课程为空
+    if (course.isEmpty()) {
+        lblAttendance->setText("出勤: --");
+    } else if (capacity > 0) {
+        lblAttendance->setText(QString("出勤: %1 / %2 人").arg(present).arg(capacity));
     } else {
-        // 当前时间没有课，查找下一节课（start_time > 当前时间）
-        query.prepare(
-            "SELECT course_name, teacher, time_slot, start_time, weekday "
-            "FROM schedules "
-            "WHERE room_name = ? AND (weekday > ? OR (weekday = ? AND start_time > ?)) "
-            "ORDER BY weekday ASC, start_time ASC LIMIT 1"
-        );
-        query.addBindValue(currentRoomName);
-        query.addBindValue(currentWeekday);
-        query.addBindValue(currentWeekday);
-        query.addBindValue(currentTime);
-        
-        if(query.exec() && query.next()) {
-            // 显示下一节课
-            QString nextCourseName = query.value(0).toString();
-            QString nextTimeSlot = query.value(2).toString();
-            int nextWeekday = query.value(4).toInt();
-            
-            QString dayName;
-            switch(nextWeekday) {
-                case 1: dayName = "周一"; break;
-                case 2: dayName = "周二"; break;
-                case 3: dayName = "周三"; break;
-                case 4: dayName = "周四"; break;
-                case 5: dayName = "周五"; break;
-                case 6: dayName = "周六"; break;
-                case 7: dayName = "周日"; break;
-                default: dayName = "未知"; break;
-            }
-            
-            lblCourseName->setText("当前无课");
-            lblTeacher->setText("");
-            lblTime->setText("");
-            lblNextCourse->setText("下节预告: " + nextCourseName + " (" + dayName + " " + nextTimeSlot + ")");
-        } else {
-            // 今天没有更多课程了
-            lblCourseName->setText("当前无课");
-            lblTeacher->setText("");
-            lblTime->setText("");
-            lblNextCourse->setText("下节预告: 无");
-        }
+        lblAttendance->setText(QString("出勤: %1 人").arg(present));
     }
 }
 
-void MainWindow::filterData(const QString &text) {
-    // 如果搜索框有内容，优先使用搜索过滤
-    if (!text.isEmpty()) {
-        // 正确的 SQL LIKE 语法：使用 % 作为通配符
-        QString filterStr = QString("room_name LIKE '%%1%' OR teacher LIKE '%%1%' OR course_name LIKE '%%1%'").arg(text);
-        model->setFilter(filterStr);
-    } else {
-        // 搜索框为空，恢复到当前选中的教室过滤
-        if (classroomComboBox->count() > 0) {
-            QString currentRoom = classroomComboBox->currentData().toString();
-            if (!currentRoom.isEmpty()) {
-                QString filterStr = QString("room_name = '%1'").arg(currentRoom);
-                model->setFilter(filterStr);
-            } else {
-                model->setFilter("");
-            }
-        } else {
-            model->setFilter("");
-        }
+void MainWindow::onUrgentAnnouncement(const QString &title, const QString &content) {
+    // 紧急公告先直接显示，写入本地库后随下一次公告表进入轮播
+    lblAnnouncement->setText("【紧急·" + title + "】" + content);
+    announcementQueue.holdBanner(QDateTime::currentMSecsSinceEpoch());
+}
+
+void MainWindow::showAnnouncements() {
+    lblAnnouncement->setText(announcementQueue.bannerText());
+    lblBottomNotification->setText(announcementQueue.tickerText());
+}
+
+QString MainWindow::selectedRoom() const {
+    QString roomName;
+    if (classroomComboBox->count() > 0) {
+        roomName = classroomComboBox->currentData().toString();
+    }
+    if (roomName.isEmpty()) {
+        roomName = savedRoom.isEmpty() ? QString("Class 101") : savedRoom;
     }
-    model->select();
+    return roomName;
 }
 
-void MainWindow::updateCurrentTime() {
-    QDateTime now = QDateTime::currentDateTime();
-    lblCurrentTime->setText(now.toString("yyyy年MM月dd日 HH:mm:ss dddd"));
+static QString weekdayName(int weekday) {
+    switch(weekday) {
+        case 1: return "周一";
+        case 2: return "周二";
+        case 3: return "周三";
+        case 4: return "周四";
+        case 5: return "周五";
+        case 6: return "周六";
+        case 7: return "周日";
+        default: return "未知";
+    }
 }
 
-void MainWindow::scrollAnnouncement() {
-    if (announcementText.isEmpty()) {
+void MainWindow::onPlanUpdated() {
+    planFromSnapshot = false;
+    updateDisplay();
+}
+
+void MainWindow::updateDisplay() {
+    // 只读取工作线程发布的内存计划，不在界面线程访问数据库
+    std::shared_ptr<const DayPlan> plan = planStore.current();
+    if (!plan || plan->roomName() != selectedRoom()) {
+        // 新教室的计划尚未发布，等待 planUpdated 后再刷新
         return;
     }
 
-    QFontMetrics fm(lblAnnouncement->font());
-    int textWidth = fm.horizontalAdvance(announcementText);
-    int labelWidth = lblAnnouncement->width();
+    QDateTime now = QDateTime::currentDateTime();
+    QDate today = now.date();  // 按日期查询，放假、调课以服务器下发的校历为准
+    int currentMsecs = now.time().msecsSinceStartOfDay();
+    int currentSecs = currentMsecs / 1000;
+
+    const PlanSlot *current = plan->currentSlot(today, currentSecs);
+    const PlanSlot *next = nullptr;
 
-    if (textWidth > labelWidth) {
-        scrollPosition += 2;
-        if (scrollPosition > textWidth) {
-            scrollPosition = -labelWidth;
-        }
-        lblAnnouncement->setText(announcementText.right(textWidth - scrollPosition) + "    " + announcementText);
+    if (current) {
+        // 找到了当前正在进行的课程
+        lblCourseName->setText(current->courseName);
+        lblTeacher->setText("教师: " + current->teacher);
+        lblTime->setText("时间: " + current->timeSlot);
+
+        // 下一节课：当前课程结束之后开始的课程
+        next = plan->nextSlot(today, current->endSecs);
+    } else {
+        // 当前时间没有课，查找当前时间之后的下一节课
+        lblCourseName->setText("当前无课");
+        lblTeacher->setText("");
+        lblTime->setText("");
+
+        next = plan->nextSlot(today, currentSecs);
+    }
+
+    if (next) {
+        lblNextCourse->setText("下节预告: " + next->courseName + " (" + weekdayName(next->weekday) + " " + next->timeSlot + ")");
+    } else {
+        lblNextCourse->setText("下节预告: 无");
     }
+
+    // 在下一个上课/下课时刻（或午夜）精确刷新，期间不做任何轮询
+    int boundarySecs = plan->nextBoundary(today, currentSecs);
+    int delayMsecs = qMax(0, boundarySecs * 1000 - currentMsecs);
+    nextBoundaryAt = now.addMSecs(delayMsecs);
+    boundaryTimer->start(delayMsecs);
 }
 
-void MainWindow::loadAnnouncement() {
-    QSqlQuery query;
-    query.prepare("SELECT title, content FROM announcements ORDER BY priority DESC, publish_time DESC LIMIT 1");
-    if (query.exec() && query.next()) {
-        QString title = query.value(0).toString();
-        QString content = query.value(1).toString();
-        announcementText = "【" + title + "】" + content;
-        scrollPosition = 0;
-        lblAnnouncement->setText(announcementText);
+void MainWindow::filterData(const QString &text) {
+    if (text.trimmed().isEmpty()) {
+        // 清空搜索框时立即恢复教室筛选
+        searchTimer->stop();
+        applyScheduleFilter();
+    } else {
+        searchTimer->start();
     }
 }
 
-void MainWindow::scrollBottomNotification() {
-    if (notificationText.isEmpty()) {
+void MainWindow::applyScheduleFilter() {
+    ScheduleTablePtr table = scheduleModel->table();
+    if (!table) {
+        scheduleProxy->showAllRows();
+        return;
+    }
+
+    QString text = searchBox->text().trimmed();
+    if (!text.isEmpty()) {
+        // 如果搜索框有内容，优先按教室/教师/课程检索（索引在工作线程同步后建好）
+        scheduleProxy->setRows(table->searchIndex.search(text));
         return;
     }
 
-    bottomScrollPosition++;
-    if (bottomScrollPosition >= notificationText.length()) {
-        bottomScrollPosition = 0;
+    // 搜索框为空，恢复到当前选中的教室
+    QString currentRoom = classroomComboBox->count() > 0 ? classroomComboBox->currentData().toString() : QString();
+    if (currentRoom.isEmpty()) {
+        scheduleProxy->showAllRows();
+    } else {
+        scheduleProxy->setRows(table->rowsByRoom.value(currentRoom));
     }
+}
 
-    QString displayText = notificationText.mid(bottomScrollPosition) + notificationText.left(bottomScrollPosition);
-    lblBottomNotification->setText(displayText);
+void MainWindow::setStartupClock(const QElapsedTimer &clock) {
+    startupClock = clock;
 }
 
-void MainWindow::loadNotifications() {
-    notificationText = "📢 期末考试1月15日开始  ★  图书馆8:00-22:00  ★  周六凌晨网络维护  ★  寒假1月20日-2月20日  ★  选课1月10日开放  ★  请同学们注意考试时间  ★  祝大家考试顺利  ★  考试期间请保持安静  ★  提前30分钟到达考场  ★  携带好准考证和身份证  ★  ";
-    bottomScrollPosition = 0;
-    lblBottomNotification->setText(notificationText);
+void MainWindow::loadStartupSnapshot() {
+    QElapsedTimer loadClock;
+    loadClock.start();
+
+    PlanSnapshot snapshot;
+    if (!snapshot.open(PlanSnapshot::defaultPath())) {
+        qDebug() << "没有可用的课程表快照，等待数据库加载";
+        return;
+    }
+
+    planStore.publish(snapshot.planFor(selectedRoom()));
+    planFromSnapshot = true;
+    qDebug() << "已从快照加载课程计划，记录数:" << snapshot.recordCount()
+             << "快照时间:" << QDateTime::fromMSecsSinceEpoch(snapshot.generatedAtMs()).toString("yyyy-MM-dd HH:mm:ss")
+             << "耗时:" << loadClock.nsecsElapsed() / 1000 << "微秒";
 }
 
-void MainWindow::loadClassrooms() {
-    // 保存当前选中的值
-    QString currentSelectedRoom = "";
-    if (classroomComboBox->currentIndex() >= 0) {
-        currentSelectedRoom = classroomComboBox->currentData().toString();
+void MainWindow::initLocalDatabase() {
+    if (!DatabaseManager::initDb()) {
+        qDebug() << "数据库初始化失败";
+        return;
     }
-    
-    QSqlQuery query;
-    query.prepare("SELECT room_name, class_name FROM classrooms ORDER BY room_name");
-    if (query.exec()) {
-        classroomComboBox->clear();
-        while (query.next()) {
-            QString roomName = query.value(0).toString();
-            QString className = query.value(1).toString();
-            classroomComboBox->addItem(roomName + " - " + className, roomName);
+    qDebug() << "数据库初始化成功";
+
+    DatabaseManager::initSampleData();
+}
+
+void MainWindow::paintEvent(QPaintEvent *event) {
+    QWidget::paintEvent(event);
+
+    if (!databaseInitScheduled) {
+        // 首帧已经画出，再初始化界面线程的数据库连接
+        databaseInitScheduled = true;
+        QTimer::singleShot(0, this, &MainWindow::initLocalDatabase);
+    }
+
+    if (!firstFrameReported && startupClock.isValid()) {
+        std::shared_ptr<const DayPlan> plan = planStore.current();
+        if (plan && plan->roomName() == selectedRoom()) {
+            firstFrameReported = true;
+            qDebug() << "冷启动到首个正确画面:" << startupClock.elapsed() << "毫秒，课程计划来源:"
+                     << (planFromSnapshot ? "快照文件" : "数据库");
         }
-        
-        // 尝试恢复之前选中的值
-        if (!currentSelectedRoom.isEmpty()) {
-            int index = classroomComboBox->findData(currentSelectedRoom);
-            if (index >= 0) {
-                classroomComboBox->setCurrentIndex(index);
-            } else {
-                // 如果找不到之前选中的值，则选择第一个
-                if (classroomComboBox->count() > 0) {
-                    classroomComboBox->setCurrentIndex(0);
-                }
+    }
+}
+
+void MainWindow::updateCurrentTime() {
+    QDateTime now = QDateTime::currentDateTime();
+    lblCurrentTime->setText(now.toString("yyyy年MM月dd日 HH:mm:ss dddd"));
+
+    // 系统休眠或时钟被调整时单次定时器可能错过边界，这里顺带校正
+    if (nextBoundaryAt.isValid() && now >= nextBoundaryAt) {
+        updateDisplay();
+    }
+
+    // 公告的生效、过期和轮换都在这里推进，没有变化时不更新标签
+    if (announcementQueue.advance(now.toMSecsSinceEpoch())) {
+        showAnnouncements();
+    }
+}
+
+void MainWindow::updateClassroomCombo(const ClassroomTable &table) {
+    QString previousRoom = classroomComboBox->currentData().toString();
+
+    {
+        // 下拉框与 table.byRoomName 都按教室名称排序，逐项合并差异，不清空重建
+        QSignalBlocker blocker(classroomComboBox);
+        int comboIndex = 0;
+        for (int rowIndex : table.byRoomName) {
+            const ClassroomRow &row = table.rows[rowIndex];
+            QString label = row.roomName + " - " + row.className;
+
+            // 删除排在该教室之前、已经不存在的旧项
+            while (comboIndex < classroomComboBox->count()
+                   && classroomComboBox->itemData(comboIndex).toString() < row.roomName) {
+                classroomComboBox->removeItem(comboIndex);
             }
-        } else {
-            // 如果之前没有选择任何值，且列表不为空，则选择第一个
-            if (classroomComboBox->count() > 0) {
-                classroomComboBox->setCurrentIndex(0);
+
+            if (comboIndex < classroomComboBox->count()
+                && classroomComboBox->itemData(comboIndex).toString() == row.roomName) {
+                if (classroomComboBox->itemText(comboIndex) != label) {
+                    classroomComboBox->setItemText(comboIndex, label);
+                }
+            } else {
+                classroomComboBox->insertItem(comboIndex, label, row.roomName);
             }
+            ++comboIndex;
+        }
+        while (classroomComboBox->count() > comboIndex) {
+            classroomComboBox->removeItem(classroomComboBox->count() - 1);
+        }
+
+        // 尝试恢复之前选中的教室（首次填充时为上次运行所选的教室），找不到则选择第一个
+        int index = classroomComboBox->findData(previousRoom.isEmpty() ? savedRoom : previousRoom);
+        if (index < 0 && classroomComboBox->count() > 0) {
+            index = 0;
         }
+        classroomComboBox->setCurrentIndex(index);
+    }
+
+    if (classroomComboBox->currentData().toString() != previousRoom) {
+        onClassroomChanged(classroomComboBox->currentIndex());
     }
 }
 
 void MainWindow::onClassroomChanged(int index) {
     if (index >= 0) {
         QString roomName = classroomComboBox->currentData().toString();
+        if (!roomName.isEmpty() && roomName != savedRoom) {
+            // 记住所选教室，下次启动时快照直接显示它
+            savedRoom = roomName;
+            SignConfig::saveRoom(roomName);
+        }
         
-        // 更新左侧当前课程显示
-        updateDisplay(roomName);
+        // 通知工作线程构建该教室的课程计划，发布后更新左侧当前课程显示；出勤等新教室的推送
+        lblAttendance->setText("出勤: --");
+        emit roomSelected(selectedRoom());
+        updateDisplay();
         
         // 同时过滤右侧课程表，只显示当前教室的课程
         if (!roomName.isEmpty()) {
-            QString filterStr = QString("room_name = '%1'").arg(roomName);
-            model->setFilter(filterStr);
-            model->select();
+            applyScheduleFilter();
         }
     }
 }
@@ -4,7 +4,6 @@
 #include <QWidget>
 #include <QLabel>
 #include <QTableView>
-#include <QSqlTableModel>
 #include <QLineEdit>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -13,6 +12,13 @@
 #include <QThread>
 #include <QTimer>
 #include <QComboBox>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include "dayplan.h"
+#include "marqueelabel.h"
+#include "tablemodels.h"
+#include "announcementqueue.h"
+#include "cardreader.h"
 
 class MainWindow : public QWidget
 {
@@ -22,50 +28,75 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    void setStartupClock(const QElapsedTimer &clock); // 进程启动时开始计时，用于统计冷启动耗时
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+signals:
+    void roomSelected(const QString &roomName);
+    void syncDisplayed(qint64 changeId, qint64 displayedAtMs); // 同步结果已显示，用于统计变更传播耗时
+    void checkinRequested(const QString &cardId, qint64 checkedAtMs); // 刷卡签到，交给工作线程排队上传
+
 private slots:
-    void updateDisplay(const QString &roomName = QString());
-    void onDataSynced(const QString &msg);
-    void onAnnouncementUpdated(const QString &title, const QString &content);
+    void updateDisplay();
+    void onPlanUpdated();
+    void onDataSynced(const QString &msg, qint64 changeId);
+    void onTablesUpdated(ScheduleTablePtr schedules, ClassroomTablePtr classrooms);
+    void onAnnouncementsUpdated(AnnouncementTablePtr announcements);
+    void onUrgentAnnouncement(const QString &title, const QString &content);
+    void onCardRead(const QString &cardId);
+    void onCheckinRecorded(const QString &cardId, int pending);
+    void onAttendanceUpdated(const QString &room, int present, int capacity, const QString &course);
     void filterData(const QString &text);
     void updateCurrentTime();
-    void scrollAnnouncement();
-    void scrollBottomNotification();
-    void loadAnnouncement();
-    void loadNotifications();
     void onClassroomChanged(int index);
+    void initLocalDatabase();
 
 private:
     void setupUi();
     void setupModel();
     void startWorker();
-    void loadClassrooms();
+    void loadStartupSnapshot();
+    void updateClassroomCombo(const ClassroomTable &table);
+    void applyScheduleFilter();
+    QString selectedRoom() const;
+    void showAnnouncements();    // 把公告轮播的当前内容显示到公告栏和底部滚动条
 
     QLabel *lblCourseName;
     QLabel *lblTeacher;
     QLabel *lblTime;
     QLabel *lblNextCourse;
+    QLabel *lblAttendance;       // 当前节次的签到人数 / 教室容量
     QLabel *lblStatus;
-    QLabel *lblAnnouncement;
+    MarqueeLabel *lblAnnouncement;
     QLabel *lblCurrentTime;
-    QLabel *lblBottomNotification;
+    MarqueeLabel *lblBottomNotification;
 
     QLineEdit *searchBox;
     QComboBox *classroomComboBox;
     QTableView *tableView;
     QTableView *classroomView;
 
-    QSqlTableModel *model;
-    QSqlTableModel *classroomModel;
+    ScheduleTableModel *scheduleModel;
+    RowSubsetProxyModel *scheduleProxy;  // 按教室或搜索结果筛选课程表
+    ClassroomTableModel *classroomModel;
 
     QThread *workerThread;
-    QTimer *scrollTimer;
     QTimer *timeTimer;
-    QTimer *bottomScrollTimer;
+    QTimer *searchTimer;         // 搜索输入防抖
+    QTimer *boundaryTimer;       // 下一个上课/下课时刻触发的单次定时器
+
+    DayPlanStore planStore;      // 当前教室的课程计划，由工作线程发布
+    AnnouncementQueue announcementQueue; // 由 timeTimer 每秒推进
+    CardReader *cardReader = nullptr;    // 签到读卡器，配置为 none 时为空
+    QDateTime nextBoundaryAt;    // boundaryTimer 对应的绝对时刻，用于校正时钟跳变
 
-    QString announcementText;
-    int scrollPosition;
-    QString notificationText;
-    int bottomScrollPosition;
+    QElapsedTimer startupClock;
+    bool planFromSnapshot = false;       // 当前显示的课程计划来自启动快照
+    QString savedRoom;                   // 上次选择的教室（sign_config.ini），下拉框为空时使用
+    bool databaseInitScheduled = false;
+    bool firstFrameReported = false;
 };
 
 #endif // MAINWINDOW_H
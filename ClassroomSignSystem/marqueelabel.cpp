@@ -0,0 +1,267 @@
+#include "marqueelabel.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPointer>
+#include <QStyle>
+#include <QStyleOption>
+#include <QTimer>
+#include <QVector>
+#include <QtMath>
+#include <cmath>
+#include <utility>
+
+// 位图缓存的最大宽度（设备像素），超过后改用 QStaticText 绘制
+static const int kMaxPixmapWidth = 8192;
+// 动画时钟间隔，约 25 帧/秒，对低功耗班牌足够平滑
+static const int kClockIntervalMsecs = 40;
+
+// 全部跑马灯共用的动画时钟，只在存在需要滚动的控件时运行
+class MarqueeClock
+{
+public:
+    static MarqueeClock &instance() {
+        static MarqueeClock clock;
+        return clock;
+    }
+
+    void attach(MarqueeLabel *label) {
+        if (labels.contains(label)) return;
+        labels.append(label);
+        if (!timer) {
+            // 定时器挂在 qApp 上，随应用一起销毁
+            timer = new QTimer(QCoreApplication::instance());
+            timer->setInterval(kClockIntervalMsecs);
+            QObject::connect(timer, &QTimer::timeout, timer, [this]() { tick(); });
+        }
+        resume();
+    }
+
+    // 时钟因控件都不在屏幕上而停止后，控件重新显示时调用
+    void resume() {
+        if (labels.isEmpty() || !timer || timer->isActive()) return;
+        elapsed.start();
+        lastTick = 0;
+        timer->start();
+    }
+
+    void detach(MarqueeLabel *label) {
+        labels.removeAll(label);
+        if (labels.isEmpty() && timer) {
+            timer->stop();
+        }
+    }
+
+private:
+    void tick() {
+        qint64 now = elapsed.elapsed();
+        qint64 delta = now - lastTick;
+        lastTick = now;
+        bool anyOnScreen = false;
+        for (MarqueeLabel *label : std::as_const(labels)) {
+            if (label->isOnScreen()) {
+                label->advance(delta);
+                anyOnScreen = true;
+            }
+        }
+        // 最小化的窗口不会收到隐藏事件，控件仍登记在这里；都不在屏幕上时停止计时，窗口恢复时 resume
+        if (!anyOnScreen) {
+            timer->stop();
+        }
+    }
+
+    QPointer<QTimer> timer;
+    QElapsedTimer elapsed;
+    qint64 lastTick = 0;
+    QVector<MarqueeLabel *> labels;
+};
+
+MarqueeLabel::MarqueeLabel(QWidget *parent)
+    : QWidget(parent), textWidth(0), textHeight(0), gapWidth(0), speed(60), offset(0), scrolling(false)
+{
+    staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+}
+
+MarqueeLabel::~MarqueeLabel()
+{
+    MarqueeClock::instance().detach(this);
+}
+
+void MarqueeLabel::setText(const QString &text) {
+    if (text == labelText) {
+        return;
+    }
+    labelText = text;
+    offset = 0;
+    rebuildCache();
+}
+
+void MarqueeLabel::setSpeed(int pixelsPerSecond) {
+    speed = qMax(1, pixelsPerSecond);
+}
+
+QSize MarqueeLabel::sizeHint() const {
+    QMargins margins = contentsMargins();
+    return QSize(qMin(textWidth, 400) + margins.left() + margins.right(),
+                 fontMetrics().height() + margins.top() + margins.bottom());
+}
+
+QSize MarqueeLabel::minimumSizeHint() const {
+    QMargins margins = contentsMargins();
+    return QSize(margins.left() + margins.right(), fontMetrics().height() + margins.top() + margins.bottom());
+}
+
+void MarqueeLabel::rebuildCache() {
+    QFontMetrics fm(font());
+    textWidth = fm.horizontalAdvance(labelText);
+    textHeight = fm.height();
+    gapWidth = fm.horizontalAdvance(QLatin1Char(' ')) * 8;
+
+    textPixmap = QPixmap();
+    staticText = QStaticText();
+    staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+
+    if (!labelText.isEmpty()) {
+        const qreal dpr = devicePixelRatioF();
+        if (textWidth * dpr <= kMaxPixmapWidth) {
+            QPixmap pixmap(qCeil(textWidth * dpr), qCeil(textHeight * dpr));
+            pixmap.setDevicePixelRatio(dpr);
+            pixmap.fill(Qt::transparent);
+
+            QPainter painter(&pixmap);
+            painter.setFont(font());
+            painter.setPen(palette().color(foregroundRole()));
+            painter.drawText(QRect(0, 0, textWidth, textHeight), Qt::AlignLeft | Qt::AlignVCenter, labelText);
+            painter.end();
+
+            textPixmap = pixmap;
+        } else {
+            staticText.setText(labelText);
+            staticText.prepare(QTransform(), font());
+        }
+    }
+
+    updateGeometry();
+    updateScrolling();
+    update();
+}
+
+void MarqueeLabel::updateScrolling() {
+    bool shouldScroll = !labelText.isEmpty() && isVisible() && textWidth > contentsRect().width();
+    if (shouldScroll == scrolling) {
+        return;
+    }
+
+    scrolling = shouldScroll;
+    if (scrolling) {
+        MarqueeClock::instance().attach(this);
+    } else {
+        MarqueeClock::instance().detach(this);
+        offset = 0;
+        update();
+    }
+}
+
+void MarqueeLabel::advance(qint64 elapsedMsecs) {
+    const int period = textWidth + gapWidth;
+    if (period <= 0) {
+        return;
+    }
+
+    offset += speed * elapsedMsecs / 1000.0;
+    if (offset >= period) {
+        offset = std::fmod(offset, qreal(period));
+    }
+    update(contentsRect());
+}
+
+bool MarqueeLabel::isOnScreen() const {
+    return isVisible() && !window()->isMinimized();
+}
+
+void MarqueeLabel::drawTextAt(QPainter &painter, int x, int y) {
+    if (!textPixmap.isNull()) {
+        painter.drawPixmap(x, y, textPixmap);
+    } else {
+        painter.setPen(palette().color(foregroundRole()));
+        painter.drawStaticText(x, y, staticText);
+    }
+}
+
+void MarqueeLabel::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+
+    // 绘制样式表中的背景和圆角
+    QStyleOption option;
+    option.initFrom(this);
+    style()->drawPrimitive(QStyle::PE_Widget, &option, &painter, this);
+
+    if (labelText.isEmpty()) {
+        return;
+    }
+
+    QRect area = contentsRect();
+    painter.setClipRect(area);
+    int y = area.top() + (area.height() - textHeight) / 2;
+
+    if (!scrolling) {
+        drawTextAt(painter, area.left(), y);
+        return;
+    }
+
+    // 滚动时绘制两份文本首尾相接，形成循环
+    int x = area.left() - qFloor(offset);
+    drawTextAt(painter, x, y);
+    drawTextAt(painter, x + textWidth + gapWidth, y);
+}
+
+void MarqueeLabel::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    updateScrolling();
+}
+
+void MarqueeLabel::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    // 最小化和恢复只改变顶层窗口的状态，监听它以便恢复时重新启动时钟
+    if (watchedWindow != window()) {
+        if (watchedWindow) {
+            watchedWindow->removeEventFilter(this);
+        }
+        watchedWindow = window();
+        watchedWindow->installEventFilter(this);
+    }
+    updateScrolling();
+    if (scrolling) {
+        MarqueeClock::instance().resume();
+    }
+}
+
+void MarqueeLabel::hideEvent(QHideEvent *event) {
+    QWidget::hideEvent(event);
+    // 控件或所在窗口被隐藏时停止计时
+    if (scrolling) {
+        scrolling = false;
+        MarqueeClock::instance().detach(this);
+    }
+}
+
+bool MarqueeLabel::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == watchedWindow && event->type() == QEvent::WindowStateChange && scrolling && isOnScreen()) {
+        MarqueeClock::instance().resume();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void MarqueeLabel::changeEvent(QEvent *event) {
+    QWidget::changeEvent(event);
+    switch (event->type()) {
+    case QEvent::FontChange:
+    case QEvent::PaletteChange:
+    case QEvent::StyleChange:
+        rebuildCache();
+        break;
+    default:
+        break;
+    }
+}
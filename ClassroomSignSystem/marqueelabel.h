@@ -0,0 +1,58 @@
+#ifndef MARQUEELABEL_H
+#define MARQUEELABEL_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QPointer>
+#include <QStaticText>
+
+class MarqueeClock;
+
+// 自绘跑马灯控件：文本只排版一次并缓存为位图，滚动时仅按像素偏移重绘。
+// 所有实例共用一个动画时钟，文本放得下或控件不可见时不参与计时；
+// 需要滚动的控件都在最小化的窗口中时时钟停止，窗口恢复后再启动。
+class MarqueeLabel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MarqueeLabel(QWidget *parent = nullptr);
+    ~MarqueeLabel();
+
+    void setText(const QString &text);
+    QString text() const { return labelText; }
+    void setSpeed(int pixelsPerSecond);
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    friend class MarqueeClock;
+
+    void advance(qint64 elapsedMsecs); // 由 MarqueeClock 调用
+    bool isOnScreen() const;           // 可见且所在窗口未最小化
+    void rebuildCache();
+    void updateScrolling();
+    void drawTextAt(QPainter &painter, int x, int y);
+
+    QString labelText;
+    QPixmap textPixmap;      // 文本较短时使用的位图缓存
+    QStaticText staticText;  // 文本过长（位图超限）时的排版缓存
+    int textWidth;
+    int textHeight;
+    int gapWidth;            // 首尾相接时的间隔
+    int speed;               // 像素/秒
+    qreal offset;
+    bool scrolling;
+    QPointer<QWidget> watchedWindow;   // 监听其最小化状态的顶层窗口
+};
+
+#endif // MARQUEELABEL_H
@@ -1,4 +1,7 @@
 #include "networkworker.h"
+#include "localstore.h"
+#include "plansnapshot.h"
+#include "laneframes.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -8,385 +11,684 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QThread>
-#include <QDataStream>
-
-NetworkWorker::NetworkWorker(QObject *parent) : QObject(parent), expectedDataSize(0), receivingData(false)
+#include <QRandomGenerator>
+#include <QMetaObject>
+#include <QCoreApplication>
+
+// 轮询与退避参数：服务器未给出建议时的默认间隔、抖动比例、退避基数与上限
+static const int kDefaultPollMs = 10000;
+static const int kHorizonDays = 14;     // 向服务器请求的校历天数
+static const double kPollJitterRatio = 0.2;
+static const int kInitialSpreadMs = 3000;
+static const int kBackoffBaseMs = 2000;
+static const int kBackoffCeilingMs = 300000;
+// 保持打开的连接断开后，在该时间内随机重连（避免服务器重启后所有班牌同时连入）
+static const int kResubscribeSpreadMs = 2000;
+// 收到新版本通知后在该时间内随机拉取，整栋楼的班牌不会在同一时刻下载整份新课表
+static const int kVersionSpreadMs = 5000;
+// 签到上传：刷卡后稍等片刻再发，连续刷卡合成一批；每批条数上限使请求行远小于服务器的请求长度限制
+static const int kCheckinBatchDelayMs = 300;
+static const int kCheckinBatchSize = 200;
+static const int kCheckinAckTimeoutMs = 10000;
+
+NetworkWorker::NetworkWorker(DayPlanStore *planStore, QObject *parent)
+    : QObject(parent), receivingData(false), laneConnection(false), attemptFinished(true),
+      consecutiveFailures(0), advisedPollMs(kDefaultPollMs), currentEndpoint(-1), firstByteSeen(false),
+      requestSentAtMs(0), responseReceivedAtMs(0), lastSyncMs(-1), seenChangeId(0), reportInFlight(false), urgentChangeId(0),
+      checkinInFlight(0), planStore(planStore), snapshotChangeId(-1)
 {
+    config = SignConfig::load();
+    endpointPool.setEndpoints(config.endpoints);
+
     socket = new QTcpSocket(this);
     retryTimer = new QTimer(this);
     receiveTimer = new QTimer(this);
+    checkinTimer = new QTimer(this);
 
     socket->setReadBufferSize(50 * 1024 * 1024);
 
     connect(socket, &QTcpSocket::connected, this, &NetworkWorker::onConnected);
     connect(socket, &QTcpSocket::readyRead, this, &NetworkWorker::onReadyRead);
     connect(socket, &QTcpSocket::errorOccurred, this, &NetworkWorker::onError);
+    connect(socket, &QTcpSocket::disconnected, this, &NetworkWorker::onDisconnected);
     connect(retryTimer, &QTimer::timeout, this, &NetworkWorker::connectToServer);
     connect(receiveTimer, &QTimer::timeout, this, &NetworkWorker::onReceiveTimeout);
+    connect(checkinTimer, &QTimer::timeout, this, [this]() {
+        if (checkinInFlight != 0) {
+            qDebug() << "签到批次" << checkinInFlight << "未确认，重发";
+            checkinInFlight = 0;
+        }
+        uploadCheckins();
+    });
 
     receiveTimer->setSingleShot(true);
+    retryTimer->setSingleShot(true);
+    checkinTimer->setSingleShot(true);
 }
 
 void NetworkWorker::startSync() {
-    retryTimer->start(10000);
+    // 先用本地数据库中的数据填充界面，再开始与服务器同步
+    publishTables();
+    publishAnnouncements();
 
-    connectToServer();
+    // 同时上电的班牌先随机错开首次请求，避免同一时刻集中访问服务器
+    retryTimer->start(QRandomGenerator::global()->bounded(kInitialSpreadMs));
 }
 
-void NetworkWorker::connectToServer() {
-    // 如果正在连接或已连接，跳过
-    if(socket->state() == QAbstractSocket::ConnectedState ||
-        socket->state() == QAbstractSocket::ConnectingState) {
-        return;
+void NetworkWorker::scheduleNextPoll(bool succeeded) {
+    attemptFinished = true;
+
+    int delayMs;
+    if (succeeded) {
+        consecutiveFailures = 0;
+        // 在服务器建议的间隔上加 ±20% 的随机抖动
+        double factor = 1.0 + kPollJitterRatio * (QRandomGenerator::global()->generateDouble() * 2.0 - 1.0);
+        delayMs = int(advisedPollMs * factor);
+    } else {
+        // 指数退避，带上限；在 [backoff/2, backoff] 内随机取值
+        consecutiveFailures = qMin(consecutiveFailures + 1, 16);
+        qint64 backoff = qMin<qint64>(qint64(kBackoffBaseMs) << (consecutiveFailures - 1), kBackoffCeilingMs);
+        delayMs = int(backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1));
     }
 
-    qDebug() << "正在连接服务器...";
-    // 连接本地服务器 (127.0.0.1:12345)
-    socket->connectToHost("127.0.0.1", 12345);
+    qDebug() << "下次同步安排在" << delayMs << "毫秒后" << (succeeded ? "" : "(退避)");
+    retryTimer->start(delayMs);
 }
 
-void NetworkWorker::onConnected() {
-    qDebug() << "已连接服务器，发送同步请求...";
+void NetworkWorker::onSyncDisplayed(qint64 changeId, qint64 displayedAtMs) {
+    if (pendingTrace.isEmpty() || pendingTrace.value("change_id").toInteger() != changeId
+        || !pendingTrace.contains("applied_at_ms")) {
+        return;
+    }
 
-    // 重置接收状态
-    buffer.clear();
-    expectedDataSize = 0;
-    receivingData = true;
+    QJsonObject report = pendingTrace;
+    report["display_ms"] = qMax<qint64>(0, displayedAtMs - pendingTrace.value("applied_at_ms").toInteger());
+    report.remove("applied_at_ms");
+    pendingTrace = QJsonObject();
 
-    // 启动接收超时定时器（30秒）
-    receiveTimer->start(30000);
+    // 下一次请求时带给服务器；若之前的上报还没送出，以最新的变更为准
+    pendingReport = report;
+    qDebug() << "变更" << changeId << "已显示，下次同步时上报传播耗时";
+}
 
-    socket->write("GET_SCHEDULE");
-    socket->flush();
-    qDebug() << "请求已发送";
+void NetworkWorker::setPlanRoom(const QString &roomName) {
+    if (roomName == planRoom) {
+        return;
+    }
+    planRoom = roomName;
+    publishPlan();
 }
 
-void NetworkWorker::onReadyRead() {
-    if (!receivingData) {
-        qDebug() << "警告：在非接收状态下收到数据，忽略";
+void NetworkWorker::publishPlan() {
+    if (!planStore || planRoom.isEmpty()) {
         return;
     }
 
-    QByteArray data = socket->readAll();
-    buffer.append(data);
-    qDebug() << "接收到数据，本次接收:" << data.size() << "字节，当前缓冲区大小:" << buffer.size();
+    QSqlDatabase db = getDatabase();
+    if (!db.isValid() || !db.isOpen()) {
+        qDebug() << "NetworkWorker 线程中数据库不可用，无法构建课程计划";
+        return;
+    }
 
-    // 重置接收超时计时器（有新数据到达）
-    receiveTimer->start(30000);
+    planStore->publish(DayPlan::build(db, planRoom));
+    emit planUpdated();
+}
 
-    // 解析长度头（4字节大端 quint32）
-    if (expectedDataSize == 0 && buffer.size() >= 4) {
-        // 使用临时缓冲区解析长度，避免直接操作 buffer
-        QByteArray sizeHeader = buffer.left(4);
-        QDataStream ds(sizeHeader);
-        ds.setByteOrder(QDataStream::BigEndian);
-        quint32 size;
-        ds >> size;
-        expectedDataSize = static_cast<qint32>(size);
-        qDebug() << "预期数据大小:" << expectedDataSize << "字节";
+void NetworkWorker::publishTables() {
+    QSqlDatabase db = getDatabase();
+    if (!db.isValid() || !db.isOpen()) {
+        qDebug() << "NetworkWorker 线程中数据库不可用，无法读取本地表";
+        return;
+    }
 
-        // 移除长度头
-        buffer.remove(0, 4);
-        qDebug() << "移除头部后缓冲区大小:" << buffer.size() << "字节";
+    // 两张表在同一个读事务中读出，保证来自同一次同步
+    db.transaction();
+    ScheduleTablePtr schedules = ScheduleTable::load(db);
+    ClassroomTablePtr classrooms = ClassroomTable::load(db);
+    db.commit();
+
+    // 内容未变化的表沿用旧指针，界面线程据此跳过模型重置
+    bool changed = false;
+    if (!lastSchedules || lastSchedules->rows != schedules->rows) {
+        lastSchedules = schedules;
+        changed = true;
+    }
+    if (!lastClassrooms || lastClassrooms->rows != classrooms->rows) {
+        lastClassrooms = classrooms;
+        changed = true;
     }
 
-    // 检查是否接收完整
-    if (expectedDataSize > 0 && buffer.size() >= expectedDataSize) {
-        // 停止超时计时器
-        receiveTimer->stop();
+    if (changed) {
+        emit tablesUpdated(lastSchedules, lastClassrooms);
+    }
+}
 
-        QByteArray jsonData = buffer.left(expectedDataSize);
-        qDebug() << "数据接收完成，实际接收:" << jsonData.size() << "字节，预期:" << expectedDataSize << "字节";
-        qDebug() << "Socket状态:" << socket->state();
+void NetworkWorker::publishAnnouncements() {
+    QSqlDatabase db = getDatabase();
+    if (!db.isValid() || !db.isOpen()) {
+        qDebug() << "NetworkWorker 线程中数据库不可用，无法读取公告";
+        return;
+    }
+    // 公告的生效和过期由界面线程按时间推进，这里总是发出，空表表示清空公告栏
+    emit announcementsUpdated(AnnouncementTable::load(db));
+}
 
-        // 处理数据
-        updateLocalDb(jsonData);
+void NetworkWorker::connectToServer() {
+    // 新一轮同步：所有服务器都可再次尝试
+    triedEndpoints.fill(false, endpointPool.size());
+    attemptFinished = false;
+
+    // 分道连接仍然打开时直接在原连接上请求，失败后再走正常的切换流程
+    if (laneConnection && socket->state() == QAbstractSocket::ConnectedState && currentEndpoint >= 0) {
+        triedEndpoints[currentEndpoint] = true;
+        firstByteSeen = false;
+        attemptClock.start();
+        sendSyncRequest();
+        return;
+    }
+    tryNextEndpoint();
+}
 
-        // 清理状态
-        buffer.remove(0, expectedDataSize);
-        expectedDataSize = 0;
-        receivingData = false;
+void NetworkWorker::tryNextEndpoint() {
+    if (attemptFinished) {
+        return;
+    }
 
-        qDebug() << "准备断开连接...";
-        socket->disconnectFromHost();
-    } else if (expectedDataSize > 0) {
-        qDebug() << "等待更多数据，已接收:" << buffer.size() << "字节，需要:" << expectedDataSize << "字节"
-                 << "，剩余:" << (expectedDataSize - buffer.size()) << "字节";
+    int index = endpointPool.pick(QDateTime::currentMSecsSinceEpoch(), triedEndpoints);
+    if (index < 0) {
+        qDebug() << "所有服务器均不可用，保持本地数据显示";
+        scheduleNextPoll(false);
+        return;
     }
-}
+    triedEndpoints[index] = true;
+    currentEndpoint = index;
 
-void NetworkWorker::onError(QAbstractSocket::SocketError socketError) {
-    Q_UNUSED(socketError);
-    qDebug() << "网络错误/服务器离线，保持本地数据显示。Error:" << socket->errorString();
-    qDebug() << "Socket状态:" << socket->state();
+    // 残留的连接直接中止，保证每次尝试使用新连接
+    if (socket->state() != QAbstractSocket::UnconnectedState) {
+        socket->abort();
+    }
+    buffer.clear();
+    bulkBuffer.clear();
+    receivingData = false;
+    laneConnection = false;
+    firstByteSeen = false;
+
+    const ServerEndpoint &endpoint = endpointPool.endpoint(index);
+    // 连接阶段使用较短的超时，连不上时尽快切换到下一个服务器
+    receiveTimer->start(config.connectTimeoutMs);
+    attemptClock.start();
+    qDebug() << "正在连接服务器" << endpoint.host << endpoint.port << "...";
+    socket->connectToHost(endpoint.host, endpoint.port);
+}
 
-    // 停止接收超时计时器
+void NetworkWorker::failCurrentEndpoint() {
     receiveTimer->stop();
+    buffer.clear();
+    bulkBuffer.clear();
     receivingData = false;
 
-    if (socket->state() != QAbstractSocket::UnconnectedState) {
-        socket->disconnectFromHost();
+    if (attemptFinished) {
+        return;
     }
+
+    if (currentEndpoint >= 0) {
+        endpointPool.reportFailure(currentEndpoint, QDateTime::currentMSecsSinceEpoch());
+    }
+
+    // 在套接字信号处理函数中不直接重连，排队到事件循环再切换
+    QMetaObject::invokeMethod(this, &NetworkWorker::tryNextEndpoint, Qt::QueuedConnection);
 }
 
-void NetworkWorker::onReceiveTimeout() {
-    qDebug() << "警告：数据接收超时！已接收:" << buffer.size() << "字节，预期:" << expectedDataSize << "字节";
+void NetworkWorker::onConnected() {
+    qDebug() << "已连接服务器，发送同步请求...";
 
-    // 清理状态
+    // 重置接收状态
     buffer.clear();
-    expectedDataSize = 0;
-    receivingData = false;
+    bulkBuffer.clear();
+    sendSyncRequest();
+}
 
-    // 断开连接
-    if (socket->state() != QAbstractSocket::UnconnectedState) {
-        socket->disconnectFromHost();
+void NetworkWorker::sendSyncRequest() {
+    receivingData = true;
+
+    // 等待首个响应字节；服务器过载时不必等满接收超时
+    receiveTimer->start(config.firstByteTimeoutMs);
+
+    // 请求行附带班牌编号和上一次变更的传播耗时，旧版服务器只匹配命令字
+    QJsonObject args;
+    args["sign_id"] = config.signId;
+    args["accept"] = "columnar";  // 旧版服务器忽略此项，仍返回 JSON
+    args["lanes"] = true;         // 支持分道帧的服务器保持连接并可随时推送紧急公告
+    args["horizon_days"] = kHorizonDays; // 按校历展开的课程，放假、调课以此为准
+    // 身份与状态，服务器据此维护班牌状态表
+    args["room"] = planRoom;
+    args["app_version"] = QCoreApplication::applicationVersion();
+    args["data_version"] = seenChangeId;
+    if (lastSyncMs >= 0) {
+        args["last_sync_ms"] = lastSyncMs;
     }
+    reportInFlight = !pendingReport.isEmpty();
+    if (reportInFlight) {
+        args["report"] = pendingReport;
+    }
+    requestSentAtMs = QDateTime::currentMSecsSinceEpoch();
+    socket->write("GET_SCHEDULE " + QJsonDocument(args).toJson(QJsonDocument::Compact) + "\n");
+    socket->flush();
+    qDebug() << "请求已发送";
 }
 
-QSqlDatabase NetworkWorker::getDatabase()
-{
-    const QString connectionName = "NetworkWorkerConnection";
+void NetworkWorker::onReadyRead() {
+    QByteArray data = socket->readAll();
+    buffer.append(data);
 
-    QSqlDatabase db;
-    if (QSqlDatabase::contains(connectionName)) {
-        db = QSqlDatabase::database(connectionName);
-    } else {
-        db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
-        db.setDatabaseName("classroom.db");
+    if (receivingData) {
+        if (!firstByteSeen) {
+            firstByteSeen = true;
+            endpointPool.reportSuccess(currentEndpoint, attemptClock.elapsed());
+            qDebug() << "首字节延迟:" << attemptClock.elapsed() << "毫秒，平均:" << endpointPool.latencyMs(currentEndpoint);
+        }
+        // 重置接收超时计时器（有新数据到达）
+        receiveTimer->start(config.receiveTimeoutMs);
     }
 
-    if (!db.isOpen() && !db.open()) {
-        qDebug() << "NetworkWorker 线程中数据库打开失败:" << db.lastError().text();
+    // 依次处理已完整到达的帧；紧急公告可能夹在数据块之间，到达即处理
+    Lane::FrameType type;
+    QByteArray payload;
+    while (Lane::takeFrame(buffer, type, payload)) {
+        switch (type) {
+        case Lane::Urgent:
+            handleUrgent(payload);
+            break;
+        case Lane::Version:
+            handleVersion(payload);
+            break;
+        case Lane::Announcements:
+            handleAnnouncements(payload);
+            break;
+        case Lane::CheckinAck:
+            handleCheckinAck(payload);
+            break;
+        case Lane::Attendance:
+            handleAttendance(payload);
+            break;
+        case Lane::BulkChunk:
+            bulkBuffer.append(payload);
+            break;
+        case Lane::BulkEnd:
+            laneConnection = true;
+            bulkBuffer.append(payload);
+            payload = bulkBuffer;
+            bulkBuffer.clear();
+            finishSync(payload);
+            break;
+        case Lane::Legacy:
+            laneConnection = false;
+            finishSync(payload);
+            break;
+        default:
+            qDebug() << "未知的帧类型" << int(type) << "，忽略";
+            break;
+        }
+        if (socket->state() != QAbstractSocket::ConnectedState) {
+            return;
+        }
     }
 
-    return db;
+    if (receivingData) {
+        qDebug() << "等待更多数据，已接收:" << bulkBuffer.size() + buffer.size() << "字节，当前帧:"
+                 << Lane::pendingFrameSize(buffer) << "字节";
+    }
 }
 
-void NetworkWorker::updateLocalDb(const QByteArray &jsonData) {
-    qDebug() << "开始解析JSON数据...";
-    QJsonDocument doc = QJsonDocument::fromJson(jsonData);
-
-    if (doc.isNull()) {
-        qDebug() << "JSON解析失败，数据格式错误";
+void NetworkWorker::finishSync(const QByteArray &payload) {
+    if (!receivingData) {
+        qDebug() << "警告：在非接收状态下收到数据，忽略";
         return;
     }
 
-    if (doc.isObject()) {
-        qDebug() << "接收到对象格式的JSON数据";
-        QJsonObject rootObj = doc.object();
+    // 停止超时计时器
+    receiveTimer->stop();
+    receivingData = false;
+    qDebug() << "数据接收完成:" << payload.size() << "字节" << (laneConnection ? "(分道)" : "");
+
+    // 处理数据
+    responseReceivedAtMs = QDateTime::currentMSecsSinceEpoch();
+    if (reportInFlight) {
+        // 上报已随本次请求送达服务器
+        pendingReport = QJsonObject();
+        reportInFlight = false;
+    }
+    bool applied = updateLocalDb(payload);
+    if (applied) {
+        // 从发出请求到写库完成的总耗时，随下次请求上报
+        lastSyncMs = QDateTime::currentMSecsSinceEpoch() - requestSentAtMs;
+    } else if (currentEndpoint >= 0) {
+        // 响应无法解码或写库失败：本次同步不算成功，该服务器进入冷却，下次按退避间隔重试
+        endpointPool.reportFailure(currentEndpoint, QDateTime::currentMSecsSinceEpoch());
+    }
 
-        if (rootObj.contains("announcements")) {
-            QJsonArray announcements = rootObj["announcements"].toArray();
-            qDebug() << "公告数据数量:" << announcements.size();
-            saveAnnouncements(announcements);
-        }
+    // 旧协议每次同步后断开；分道连接保持打开以接收紧急公告，并用来上传积压的签到
+    if (!laneConnection) {
+        qDebug() << "准备断开连接...";
+        socket->disconnectFromHost();
+    } else if (!checkinTimer->isActive()) {
+        uploadCheckins();
+    }
 
-        if (rootObj.contains("schedules")) {
-            QJsonArray schedules = rootObj["schedules"].toArray();
-            qDebug() << "课程表数据数量:" << schedules.size();
-            saveSchedules(schedules);
-        }
+    scheduleNextPoll(applied);
+}
 
-        if (rootObj.contains("classrooms")) {
-            QJsonArray classrooms = rootObj["classrooms"].toArray();
-            qDebug() << "教室数据数量:" << classrooms.size();
-            saveClassrooms(classrooms);
-        }
-    } else if (doc.isArray()) {
-        qDebug() << "接收到数组格式的JSON数据";
-        QJsonArray array = doc.array();
-        qDebug() << "数组数据数量:" << array.size();
-        saveSchedules(array);
-    } else {
-        qDebug() << "数据格式错误，既不是对象也不是数组";
+void NetworkWorker::handleUrgent(const QByteArray &payload) {
+    QJsonObject ann = QJsonDocument::fromJson(payload).object();
+    if (ann.isEmpty()) {
+        qDebug() << "紧急公告格式错误，忽略";
+        return;
+    }
+
+    urgentChangeId = qMax(urgentChangeId, ann.value("change_id").toInteger());
+    emit urgentAnnouncement(ann["title"].toString(), ann["content"].toString());
+
+    qint64 sentAtMs = ann.value("sent_at_ms").toInteger();
+    if (sentAtMs > 0) {
+        qDebug() << "收到紧急公告，服务器发出后" << QDateTime::currentMSecsSinceEpoch() - sentAtMs << "毫秒送达";
+    }
+}
+
+void NetworkWorker::handleVersion(const QByteArray &payload) {
+    qint64 changeId = QJsonDocument::fromJson(payload).object().value("change_id").toInteger();
+    // 正在同步时不打断，本次同步结束后按服务器建议的间隔照常轮询
+    if (changeId <= seenChangeId || !attemptFinished) {
         return;
     }
+    int delayMs = QRandomGenerator::global()->bounded(kVersionSpreadMs) + 1;
+    if (!retryTimer->isActive() || retryTimer->remainingTime() > delayMs) {
+        qDebug() << "服务器已发布变更" << changeId << "，" << delayMs << "毫秒后同步";
+        retryTimer->start(delayMs);
+    }
 }
 
-void NetworkWorker::saveSchedules(const QJsonArray &array) {
-    qDebug() << "开始保存课程表数据...";
+void NetworkWorker::handleAnnouncements(const QByteArray &payload) {
+    QJsonObject update = QJsonDocument::fromJson(payload).object();
+    if (!update["announcements"].isArray()) {
+        qDebug() << "公告推送格式错误，忽略";
+        return;
+    }
+
     QSqlDatabase db = getDatabase();
     if (!db.isValid() || !db.isOpen()) {
         qDebug() << "NetworkWorker 线程中数据库不可用";
         return;
     }
-
-    db.transaction();
-
-    QSqlQuery query(db);
-    
-    // 删除旧表
-    query.exec("DROP TABLE IF EXISTS schedules");
-    qDebug() << "已删除旧的课程表";
-    
-    // 重新创建表结构
-    if (!query.exec("CREATE TABLE schedules ("
-                    "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                    "room_name TEXT, "
-                    "course_name TEXT, "
-                    "teacher TEXT, "
-                    "time_slot TEXT, "
-                    "start_time TEXT, "
-                    "end_time TEXT, "
-                    "weekday INTEGER, "
-                    "is_next INTEGER DEFAULT 0)")) {
-        qDebug() << "创建课程表失败:" << query.lastError().text();
-        db.rollback();
+    // 只替换公告表，课程表等其他表不受影响
+    QJsonObject tablesObj;
+    tablesObj["announcements"] = update["announcements"];
+    LocalStore::ApplyResult result = LocalStore::applySync(db, tablesObj);
+    if (!result.ok) {
+        qDebug() << "公告写入失败，已回滚:" << result.error;
         return;
     }
-    qDebug() << "已重新创建课程表";
 
-    QString sql = "INSERT INTO schedules (room_name, course_name, teacher, time_slot, start_time, end_time, weekday, is_next) VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
-    query.prepare(sql);
+    // 紧急通道刚推送的公告尚未包含在这次推送中时不覆盖它
+    if (update.value("change_id").toInteger() >= urgentChangeId) {
+        publishAnnouncements();
+    }
 
-    int successCount = 0;
-    for (const QJsonValue &value : array) {
-        QJsonObject obj = value.toObject();
+    qint64 sentAtMs = update.value("sent_at_ms").toInteger();
+    qDebug() << "公告已更新，当前有效" << result.announcements << "条，服务器发出后"
+             << (sentAtMs > 0 ? QDateTime::currentMSecsSinceEpoch() - sentAtMs : -1) << "毫秒送达";
+}
 
-        query.addBindValue(obj["room_name"].toString());
-        query.addBindValue(obj["course_name"].toString());
-        query.addBindValue(obj["teacher"].toString());
-        query.addBindValue(obj["time_slot"].toString());
-        query.addBindValue(obj["start_time"].toString());
-        query.addBindValue(obj["end_time"].toString());
-        query.addBindValue(obj["weekday"].toInt());
-        query.addBindValue(obj["is_next"].toInt());
-
-        if (!query.exec()) {
-            qDebug() << "插入失败:" << query.lastError().text();
-        } else {
-            successCount++;
-        }
+void NetworkWorker::recordCheckin(const QString &cardId, qint64 checkedAtMs) {
+    QSqlDatabase db = getDatabase();
+    if (!db.isValid() || !db.isOpen()) {
+        qDebug() << "NetworkWorker 线程中数据库不可用，签到未记录";
+        return;
+    }
+    if (!LocalStore::enqueueCheckin(db, cardId, planRoom, checkedAtMs)) {
+        return;
     }
+    emit checkinRecorded(cardId, LocalStore::pendingCheckinCount(db));
 
-    if (db.commit()) {
-        QString timeStr = QDateTime::currentDateTime().toString("HH:mm:ss");
-        emit dataUpdated("同步成功 (Server): " + timeStr);
-        qDebug() << "本地数据库已更新: " << successCount << " 条记录";
-    } else {
-        db.rollback();
-        qDebug() << "数据库写入失败";
+    // 没有批次在等待确认时稍后上传，这段时间内的刷卡并入同一批
+    if (checkinInFlight == 0 && !checkinTimer->isActive()) {
+        checkinTimer->start(kCheckinBatchDelayMs);
     }
 }
 
-void NetworkWorker::saveClassrooms(const QJsonArray &array) {
-    qDebug() << "开始保存教室数据...";
+void NetworkWorker::uploadCheckins() {
+    // 只在分道连接上上传；离线时记录留在本地队列，下一次同步成功后继续
+    if (checkinInFlight != 0 || !laneConnection || socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
     QSqlDatabase db = getDatabase();
     if (!db.isValid() || !db.isOpen()) {
-        qDebug() << "NetworkWorker 线程中数据库不可用";
+        return;
+    }
+    QVector<LocalStore::Checkin> checkins = LocalStore::pendingCheckins(db, kCheckinBatchSize);
+    if (checkins.isEmpty()) {
         return;
     }
 
-    db.transaction();
+    QJsonArray events;
+    for (const LocalStore::Checkin &checkin : checkins) {
+        QJsonObject event;
+        event["card"] = checkin.cardId;
+        event["at_ms"] = checkin.checkedAtMs;
+        if (checkin.room != planRoom) {
+            event["room"] = checkin.room;   // 刷卡后切换过教室
+        }
+        events.append(event);
+    }
+    QJsonObject args;
+    args["sign_id"] = config.signId;
+    args["room"] = planRoom;
+    args["batch"] = checkins.last().id;
+    args["events"] = events;
+
+    checkinInFlight = checkins.last().id;
+    checkinTimer->start(kCheckinAckTimeoutMs);
+    socket->write("CHECKIN " + QJsonDocument(args).toJson(QJsonDocument::Compact) + "\n");
+    qDebug() << "上传签到" << checkins.size() << "条，批次" << checkinInFlight;
+}
 
-    QSqlQuery query(db);
-    
-    // 删除旧表
-    query.exec("DROP TABLE IF EXISTS classrooms");
-    qDebug() << "已删除旧的教室表";
-    
-    // 重新创建表结构
-    if (!query.exec("CREATE TABLE classrooms ("
-                    "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                    "room_name TEXT UNIQUE, "
-                    "class_name TEXT, "
-                    "capacity INTEGER, "
-                    "building TEXT, "
-                    "floor INTEGER, "
-                    "current_class TEXT)")) {
-        qDebug() << "创建教室表失败:" << query.lastError().text();
-        db.rollback();
+void NetworkWorker::handleCheckinAck(const QByteArray &payload) {
+    QJsonObject ack = QJsonDocument::fromJson(payload).object();
+    qint64 batch = ack.value("batch").toInteger();
+    if (batch == 0 || batch != checkinInFlight) {
+        qDebug() << "收到过期的签到确认，忽略:" << batch;
         return;
     }
-    qDebug() << "已重新创建教室表";
+    checkinInFlight = 0;
+    checkinTimer->stop();
 
-    QString sql = "INSERT INTO classrooms (room_name, class_name, capacity, building, floor, current_class) VALUES (?, ?, ?, ?, ?, ?)";
-    query.prepare(sql);
+    if (!ack.value("ok").toBool()) {
+        int retryMs = qBound(1000, ack.value("retry_ms").toInt(kCheckinAckTimeoutMs), 60000);
+        qDebug() << "签到批次" << batch << "未被接收:" << ack.value("error").toString() << "，" << retryMs << "毫秒后重发";
+        checkinTimer->start(retryMs);
+        return;
+    }
 
-    int successCount = 0;
-    for (const QJsonValue &value : array) {
+    QSqlDatabase db = getDatabase();
+    if (!db.isValid() || !db.isOpen() || !LocalStore::removeCheckins(db, batch)) {
+        // 删除失败时下次会重发，服务器按唯一约束忽略
+        return;
+    }
+    qDebug() << "签到批次" << batch << "已确认，新写入" << ack.value("accepted").toInt()
+             << "条，重复" << ack.value("duplicates").toInt() << "条";
+    // 离线期间积压的签到一批接一批上传
+    uploadCheckins();
+}
+
+void NetworkWorker::handleAttendance(const QByteArray &payload) {
+    // 推送按同步请求中的教室筛选，切换教室后下一次同步前可能仍是旧教室的数据，这里再核对一次
+    const QJsonArray rooms = QJsonDocument::fromJson(payload).object().value("rooms").toArray();
+    for (const QJsonValue &value : rooms) {
         QJsonObject obj = value.toObject();
+        if (obj.value("room").toString() == planRoom) {
+            emit attendanceUpdated(planRoom, obj.value("present").toInt(), obj.value("capacity").toInt(),
+                                   obj.value("course").toString());
+            return;
+        }
+    }
+}
 
-        query.addBindValue(obj["room_name"].toString());
-        query.addBindValue(obj["class_name"].toString());
-        query.addBindValue(obj["capacity"].toInt());
-        query.addBindValue(obj["building"].toString());
-        query.addBindValue(obj["floor"].toInt());
-        query.addBindValue(obj["current_class"].toString());
+void NetworkWorker::onDisconnected() {
+    bool wasLane = laneConnection;
+    laneConnection = false;
+    buffer.clear();
+    bulkBuffer.clear();
+    // 未确认的批次留在本地队列，重连后重发，服务器按唯一约束忽略已写入的部分；
+    // 稍等再发，不认识 CHECKIN 的旧服务器会断开连接，不至于每次同步后都断开一次
+    if (checkinInFlight != 0) {
+        checkinInFlight = 0;
+        checkinTimer->start(kCheckinAckTimeoutMs);
+    }
 
-        if (!query.exec()) {
-            qDebug() << "插入教室数据失败:" << query.lastError().text();
-        } else {
-            successCount++;
+    // 空闲时被断开的分道连接：尽快重连，以免错过紧急公告；同步中的断开由 onError 处理
+    if (wasLane && attemptFinished) {
+        int delayMs = QRandomGenerator::global()->bounded(kResubscribeSpreadMs) + 1;
+        if (!retryTimer->isActive() || retryTimer->remainingTime() > delayMs) {
+            qDebug() << "分道连接已断开，" << delayMs << "毫秒后重连";
+            retryTimer->start(delayMs);
         }
     }
+}
+
+void NetworkWorker::onError(QAbstractSocket::SocketError socketError) {
+    Q_UNUSED(socketError);
+    // 同步完成后服务器关闭连接也会触发错误，只有未完成的同步才计为失败
+    if (attemptFinished) {
+        return;
+    }
+
+    qDebug() << "网络错误/服务器离线，切换下一个服务器。Error:" << socket->errorString();
+    qDebug() << "Socket状态:" << socket->state();
+    failCurrentEndpoint();
+}
+
+void NetworkWorker::onReceiveTimeout() {
+    qDebug() << "警告：服务器响应超时！已接收:" << bulkBuffer.size() + buffer.size() << "字节，当前帧:"
+             << Lane::pendingFrameSize(buffer) << "字节";
+    socket->abort();
+    failCurrentEndpoint();
+}
 
-    if (db.commit()) {
-        qDebug() << "教室数据已同步: " << successCount << " 条记录";
+QSqlDatabase NetworkWorker::getDatabase()
+{
+    const QString connectionName = "NetworkWorkerConnection";
+
+    QSqlDatabase db;
+    if (QSqlDatabase::contains(connectionName)) {
+        db = QSqlDatabase::database(connectionName);
     } else {
-        db.rollback();
-        qDebug() << "教室数据写入失败";
+        db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName("classroom.db");
+    }
+
+    if (!db.isOpen()) {
+        if (!db.open()) {
+            qDebug() << "NetworkWorker 线程中数据库打开失败:" << db.lastError().text();
+        } else {
+            LocalStore::configure(db);
+            LocalStore::ensureSchema(db);
+        }
     }
+
+    return db;
 }
 
-void NetworkWorker::saveAnnouncements(const QJsonArray &array) {
-    qDebug() << "开始保存公告数据...";
+bool NetworkWorker::updateLocalDb(const QByteArray &payload) {
+    QJsonObject rootObj;          // JSON 格式的完整响应
+    Columnar::Snapshot columnar;  // 列式格式的响应
+    bool isColumnar = Columnar::isColumnar(payload);
+
+    if (isColumnar) {
+        qDebug() << "开始解码列式数据...";
+        QString error;
+        if (!Columnar::decode(payload, columnar, &error)) {
+            qDebug() << "列式数据解码失败:" << error;
+            return false;
+        }
+        rootObj = columnar.meta;
+    } else {
+        qDebug() << "开始解析JSON数据...";
+        QJsonDocument doc = QJsonDocument::fromJson(payload);
+
+        if (doc.isNull()) {
+            qDebug() << "JSON解析失败，数据格式错误";
+            return false;
+        }
+
+        if (doc.isObject()) {
+            rootObj = doc.object();
+        } else if (doc.isArray()) {
+            // 旧版服务器只返回课程表数组
+            rootObj["schedules"] = doc.array();
+        } else {
+            qDebug() << "数据格式错误，既不是对象也不是数组";
+            return false;
+        }
+    }
+
+    // 服务器建议的下次轮询间隔，防御性地限制在 1 秒到 1 小时之间
+    if (rootObj.contains("next_poll_ms")) {
+        advisedPollMs = qBound(1000, rootObj["next_poll_ms"].toInt(kDefaultPollMs), 3600000);
+    }
+
     QSqlDatabase db = getDatabase();
     if (!db.isValid() || !db.isOpen()) {
         qDebug() << "NetworkWorker 线程中数据库不可用";
-        return;
+        return false;
     }
 
-    db.transaction();
-
-    QSqlQuery query(db);
-    
-    // 删除旧表
-    query.exec("DROP TABLE IF EXISTS announcements");
-    qDebug() << "已删除旧的公告表";
-    
-    // 重新创建表结构
-    if (!query.exec("CREATE TABLE announcements ("
-                    "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                    "title TEXT, "
-                    "content TEXT, "
-                    "priority INTEGER DEFAULT 0, "
-                    "publish_time TEXT, "
-                    "expire_time TEXT)")) {
-        qDebug() << "创建公告表失败:" << query.lastError().text();
-        db.rollback();
-        return;
+    // 所有表在同一个事务中替换，界面读取到的始终是某一次完整同步的结果
+    LocalStore::ApplyResult result = isColumnar ? LocalStore::applyColumnar(db, columnar)
+                                                : LocalStore::applySync(db, rootObj);
+    if (!result.ok) {
+        qDebug() << "数据库写入失败，已回滚:" << result.error;
+        return false;
+    }
+    qDebug() << "本地数据库已更新，课程:" << result.schedules << "教室:" << result.classrooms
+             << "公告:" << result.announcements << "日程:" << result.occurrences;
+
+    // 写库成功后才记录新的变更编号并开始追踪：写入失败时版本通知仍会触发重新同步，上报的 data_version 也不会超前；
+    // 启动后的第一次同步只记录基准
+    QJsonObject versionObj = rootObj["version"].toObject();
+    qint64 changeId = versionObj.value("change_id").toInteger();
+    if (changeId > seenChangeId) {
+        if (seenChangeId > 0) {
+            pendingTrace = versionObj;
+            pendingTrace["fetch_ms"] = responseReceivedAtMs - requestSentAtMs;
+        }
+        seenChangeId = changeId;
     }
-    qDebug() << "已重新创建公告表";
 
-    QString sql = "INSERT INTO announcements (title, content, priority, publish_time, expire_time) VALUES (?, ?, ?, ?, ?)";
-    query.prepare(sql);
+    qint64 appliedAtMs = QDateTime::currentMSecsSinceEpoch();
+    if (!pendingTrace.isEmpty() && !pendingTrace.contains("apply_ms")) {
+        pendingTrace["apply_ms"] = appliedAtMs - responseReceivedAtMs;
+        pendingTrace["applied_at_ms"] = appliedAtMs;
+    }
 
-    int successCount = 0;
-    for (const QJsonValue &value : array) {
-        QJsonObject obj = value.toObject();
+    // 紧急通道刚推送的公告尚未包含在本地数据中时不覆盖它
+    if (seenChangeId >= urgentChangeId) {
+        publishAnnouncements();
+    }
 
-        query.addBindValue(obj["title"].toString());
-        query.addBindValue(obj["content"].toString());
-        query.addBindValue(obj["priority"].toInt());
-        query.addBindValue(obj["publish_time"].toString());
-        query.addBindValue(obj["expire_time"].toString());
+    publishTables();
+    publishPlan();
 
-        if (!query.exec()) {
-            qDebug() << "插入公告数据失败:" << query.lastError().text();
-        } else {
-            successCount++;
-        }
-    }
+    // 在表格和课程计划之后发出，界面处理到这里时新数据已经显示
+    QString timeStr = QDateTime::currentDateTime().toString("HH:mm:ss");
+    emit dataUpdated("同步成功 (Server): " + timeStr, seenChangeId);
 
-    if (db.commit()) {
-        qDebug() << "公告数据已同步: " << successCount << " 条记录";
-        if (!array.isEmpty()) {
-            QJsonObject ann = array.first().toObject();
-            emit announcementUpdated(ann["title"].toString(), ann["content"].toString());
+    // 课程表或校历有变化时更新启动快照，下次启动无需等待数据库即可显示；
+    // 校历的变化不一定改动课程表，以变更编号判断
+    if (lastSchedules && (lastSchedules != snapshotSchedules || seenChangeId != snapshotChangeId)) {
+        if (PlanSnapshot::write(PlanSnapshot::defaultPath(), *lastSchedules, db)) {
+            snapshotSchedules = lastSchedules;
+            snapshotChangeId = seenChangeId;
         }
-    } else {
-        db.rollback();
-        qDebug() << "公告数据写入失败";
     }
+    return true;
 }
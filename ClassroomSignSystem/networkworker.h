@@ -5,41 +5,99 @@
 #include <QTcpSocket> // 新增
 #include <QTimer>
 #include <QSqlDatabase>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include "dayplan.h"
+#include "localtables.h"
+#include "signconfig.h"
+#include "endpointpool.h"
 
 class NetworkWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit NetworkWorker(QObject *parent = nullptr);
+    explicit NetworkWorker(DayPlanStore *planStore, QObject *parent = nullptr);
 
 public slots:
     void startSync();
+    void setPlanRoom(const QString &roomName); // 切换需要构建课程计划的教室
+    void onSyncDisplayed(qint64 changeId, qint64 displayedAtMs); // 界面已显示该变更，补全传播耗时
+    void recordCheckin(const QString &cardId, qint64 checkedAtMs); // 刷卡签到写入本地队列，稍后批量上传
 
 signals:
-    void dataUpdated(const QString &msg);
-    void announcementUpdated(const QString &title, const QString &content);
+    void dataUpdated(const QString &msg, qint64 changeId);
+    void announcementsUpdated(AnnouncementTablePtr announcements); // 本地公告表已替换，界面重新排入轮播
+    void urgentAnnouncement(const QString &title, const QString &content); // 紧急通道推送，不等待写库
+    void planUpdated();          // 新的课程计划已发布到 DayPlanStore
+    void tablesUpdated(ScheduleTablePtr schedules, ClassroomTablePtr classrooms); // 本地表内容有变化
+    void checkinRecorded(const QString &cardId, int pending); // 签到已写入本地队列，pending 为待上传条数
+    void attendanceUpdated(const QString &room, int present, int capacity, const QString &course); // 服务器推送的本教室出勤人数
 
 private slots:
     void connectToServer();      // 连接服务器
     void onConnected();          // 连接成功
     void onReadyRead();          // 读取数据
+    void onDisconnected();       // 保持打开的连接被服务器关闭时尽快重连
     void onError(QAbstractSocket::SocketError socketError); // 错误处理
-    void onReceiveTimeout();     // 接收超时
+    void onReceiveTimeout();     // 连接、首字节或接收超时
+    void tryNextEndpoint();      // 在本轮尚未尝试的服务器中选一个发起连接
+    void uploadCheckins();       // 分道连接空闲时上传下一批签到；等待确认超时后重发
 
 private:
-    void updateLocalDb(const QByteArray &jsonData);
-    void saveSchedules(const QJsonArray &array);
-    void saveClassrooms(const QJsonArray &array);
-    void saveAnnouncements(const QJsonArray &array);
+    void sendSyncRequest();      // 在已连接的套接字上发出同步请求
+    void finishSync(const QByteArray &payload); // 收到完整数据：写库并安排下一次同步
+    void handleUrgent(const QByteArray &payload);
+    void handleVersion(const QByteArray &payload);  // 服务器发布了新版本：随机延迟后提前同步
+    void handleAnnouncements(const QByteArray &payload); // 公告生效或过期：直接替换本地公告表
+    void handleCheckinAck(const QByteArray &payload); // 服务器已写入签到批次：删除本地记录，继续上传
+    void handleAttendance(const QByteArray &payload); // 出勤人数推送：取出本教室的一项交给界面
+    bool updateLocalDb(const QByteArray &payload); // 解码并写入本地数据库，失败返回 false
+    void publishPlan();          // 从本地数据库构建当前教室的课程计划并发布
+    void publishTables();        // 在工作线程中读出本地表，有变化时交给界面线程
+    void publishAnnouncements(); // 读出本地公告表交给界面线程轮播
+    void scheduleNextPoll(bool succeeded); // 按服务器建议间隔或退避策略安排下一次同步
+    void failCurrentEndpoint();  // 当前服务器失败，记入健康状态并立即切换到下一个
 
     QSqlDatabase getDatabase();
 
     QTcpSocket *socket;
-    QTimer *retryTimer;
+    QTimer *retryTimer;          // 单次定时器，每次同步结束后重新安排
     QTimer *receiveTimer;
-    QByteArray buffer;
-    qint32 expectedDataSize;
+    QByteArray buffer;           // 尚未凑成完整帧的数据
+    QByteArray bulkBuffer;       // 分道连接上已收到的数据块
     bool receivingData;
+    bool laneConnection;         // 服务器使用分道帧，连接在同步之间保持打开
+    bool attemptFinished;        // 本次同步是否已有结果（成功或失败），避免重复安排
+    int consecutiveFailures;     // 连续失败次数，用于指数退避
+    int advisedPollMs;           // 服务器在上次响应中建议的轮询间隔
+
+    SignConfig config;
+    EndpointPool endpointPool;
+    int currentEndpoint;         // 本次连接使用的服务器下标
+    QVector<bool> triedEndpoints; // 本轮同步已尝试过的服务器
+    QElapsedTimer attemptClock;  // 从发起连接开始计时，用于测量首字节延迟
+    bool firstByteSeen;
+
+    // 变更传播追踪：服务器下发的变更编号及各阶段时间，界面显示后在下次请求中上报
+    qint64 requestSentAtMs;
+    qint64 responseReceivedAtMs;
+    qint64 lastSyncMs;           // 上一次同步从请求到写库完成的耗时，-1 表示尚未同步成功
+    qint64 seenChangeId;         // 已应用的最新变更编号
+    QJsonObject pendingTrace;    // 正在追踪、尚未显示的变更
+    QJsonObject pendingReport;   // 等待随下次请求上报的结果
+    bool reportInFlight;         // 本次请求已附带 pendingReport
+    qint64 urgentChangeId;       // 最近一条紧急公告对应的变更，本地数据包含它之前不覆盖公告栏
+
+    // 签到上传：同一时间只有一个批次等待确认，批次以其中最后一条的本地编号标识
+    QTimer *checkinTimer;        // 凑批延迟、等待确认超时和失败后的重发共用
+    qint64 checkinInFlight;      // 等待确认的批次，0 表示没有
+
+    DayPlanStore *planStore;
+    QString planRoom;
+    ScheduleTablePtr lastSchedules;
+    ClassroomTablePtr lastClassrooms;
+    ScheduleTablePtr snapshotSchedules; // 最近一次写入启动快照的课程表
+    qint64 snapshotChangeId;     // 最近一次写入启动快照时的变更编号
 };
 
 #endif // NETWORKWORKER_H
@@ -0,0 +1,255 @@
+#include "plansnapshot.h"
+#include <QSaveFile>
+#include <QHash>
+#include <QDateTime>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include "schema.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(PlanSnapshot::SnapshotHeader) == 32, "快照头部布局改变时需要提升 kVersion");
+static_assert(sizeof(PlanSnapshot::SnapshotRecord) == 40, "快照记录布局改变时需要提升 kVersion");
+
+static const char kMagic[4] = {'C', 'S', 'P', 'S'};
+
+static quint32 fnv1a(const uchar *data, qint64 size) {
+    quint32 hash = 2166136261u;
+    for (qint64 i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool PlanSnapshot::write(const QString &path, const ScheduleTable &table, QSqlDatabase db) {
+    QVector<SnapshotRecord> records;
+    QVector<char16_t> strings;
+    QHash<QString, quint32> stringOffsets;
+    QVector<QString> roomOfRecord;
+    QVector<qint32> covered;
+
+    // 相同字符串只存一份
+    auto intern = [&](const QString &value, quint32 &offset, quint16 &length) {
+        QString clipped = value.left(0xFFFF);
+        auto it = stringOffsets.constFind(clipped);
+        if (it == stringOffsets.constEnd()) {
+            it = stringOffsets.insert(clipped, quint32(strings.size()));
+            for (QChar ch : clipped) {
+                strings.append(ch.unicode());
+            }
+        }
+        offset = it.value();
+        length = quint16(clipped.size());
+    };
+
+    auto addRecord = [&](const QString &room, const QString &course, const QString &teacher, const QString &timeSlot,
+                         const QString &startTime, const QString &endTime, int weekday, qint32 day) {
+        int startSecs = DayPlan::parseClock(startTime);
+        int endSecs = DayPlan::parseClock(endTime);
+        if (weekday < 1 || weekday > 7 || startSecs < 0 || endSecs <= startSecs) {
+            return;
+        }
+
+        SnapshotRecord record;
+        std::memset(&record, 0, sizeof(record));
+        intern(room, record.room, record.roomLen);
+        intern(course, record.course, record.courseLen);
+        intern(teacher, record.teacher, record.teacherLen);
+        intern(timeSlot, record.timeSlot, record.timeSlotLen);
+        record.startSecs = startSecs;
+        record.endSecs = endSecs;
+        record.day = day;
+        record.weekday = quint8(weekday);
+        records.append(record);
+        roomOfRecord.append(room.left(0xFFFF));
+    };
+
+    for (const ScheduleRow &row : table.rows) {
+        addRecord(row.roomName, row.courseName, row.teacher, row.timeSlot, row.startTime, row.endTime, row.weekday, 0);
+    }
+
+    // 校历：与 DayPlan::build 读取相同的两张表，启动时放假和调课同样生效
+    if (db.isValid() && db.isOpen()) {
+        QSqlQuery query(db);
+        if (query.exec(Schema::sql<Schema::CalendarDays, Schema::Side::Client, Schema::Statement::Select>())) {
+            while (query.next()) {
+                QDate date = QDate::fromString(query.value(Schema::CalendarDayCol::Date).toString(), Qt::ISODate);
+                if (date.isValid()) {
+                    covered.append(qint32(date.toJulianDay()));
+                }
+            }
+        } else {
+            qDebug() << "快照读取校历失败:" << query.lastError().text();
+        }
+
+        if (!covered.isEmpty()) {
+            if (!query.exec(Schema::sql<Schema::Occurrences, Schema::Side::Client, Schema::Statement::Select>())) {
+                qDebug() << "快照读取校历日程失败:" << query.lastError().text();
+            }
+            while (query.next()) {
+                QDate date = QDate::fromString(query.value(Schema::OccurrenceCol::Date).toString(), Qt::ISODate);
+                if (!date.isValid()) {
+                    continue;
+                }
+                addRecord(query.value(Schema::OccurrenceCol::RoomName).toString(),
+                          query.value(Schema::OccurrenceCol::CourseName).toString(),
+                          query.value(Schema::OccurrenceCol::Teacher).toString(),
+                          query.value(Schema::OccurrenceCol::TimeSlot).toString(),
+                          query.value(Schema::OccurrenceCol::StartTime).toString(),
+                          query.value(Schema::OccurrenceCol::EndTime).toString(),
+                          date.dayOfWeek(), qint32(date.toJulianDay()));
+            }
+        }
+    }
+
+    QVector<int> order(records.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        int cmp = QStringView(roomOfRecord[a]).compare(QStringView(roomOfRecord[b]));
+        if (cmp != 0) return cmp < 0;
+        if (records[a].day != records[b].day) return records[a].day < records[b].day;
+        if (records[a].weekday != records[b].weekday) return records[a].weekday < records[b].weekday;
+        return records[a].startSecs < records[b].startSecs;
+    });
+
+    QByteArray body;
+    body.reserve(records.size() * int(sizeof(SnapshotRecord)) + covered.size() * int(sizeof(qint32))
+                 + strings.size() * int(sizeof(char16_t)));
+    for (int index : order) {
+        body.append(reinterpret_cast<const char *>(&records[index]), sizeof(SnapshotRecord));
+    }
+    body.append(reinterpret_cast<const char *>(covered.constData()), covered.size() * sizeof(qint32));
+    body.append(reinterpret_cast<const char *>(strings.constData()), strings.size() * sizeof(char16_t));
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.recordCount = quint32(records.size());
+    header.stringUnits = quint32(strings.size());
+    header.coveredCount = quint32(covered.size());
+    header.checksum = fnv1a(reinterpret_cast<const uchar *>(body.constData()), body.size());
+    header.generatedAtMs = QDateTime::currentMSecsSinceEpoch();
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qDebug() << "无法写入课程表快照:" << out.errorString();
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(body);
+    if (!out.commit()) {
+        qDebug() << "课程表快照写入失败:" << out.errorString();
+        return false;
+    }
+
+    qDebug() << "课程表快照已更新:" << records.size() << "条记录，校历" << covered.size() << "天，" << sizeof(header) + body.size() << "字节";
+    return true;
+}
+
+bool PlanSnapshot::open(const QString &path) {
+    header = nullptr;
+    records = nullptr;
+    coveredDays = nullptr;
+    strings = nullptr;
+    if (file.isOpen()) {
+        file.close();
+    }
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size < qint64(sizeof(SnapshotHeader))) {
+        qDebug() << "课程表快照文件过短，忽略";
+        file.close();
+        return false;
+    }
+
+    const uchar *base = file.map(0, size);
+    if (!base) {
+        qDebug() << "课程表快照映射失败:" << file.errorString();
+        file.close();
+        return false;
+    }
+
+    const SnapshotHeader *candidate = reinterpret_cast<const SnapshotHeader *>(base);
+    qint64 expected = qint64(sizeof(SnapshotHeader))
+                      + qint64(candidate->recordCount) * qint64(sizeof(SnapshotRecord))
+                      + qint64(candidate->coveredCount) * qint64(sizeof(qint32))
+                      + qint64(candidate->stringUnits) * qint64(sizeof(char16_t));
+    if (std::memcmp(candidate->magic, kMagic, sizeof(kMagic)) != 0
+        || candidate->version != kVersion
+        || expected != size
+        || fnv1a(base + sizeof(SnapshotHeader), size - qint64(sizeof(SnapshotHeader))) != candidate->checksum) {
+        qDebug() << "课程表快照版本不符或已损坏，忽略";
+        file.close();
+        return false;
+    }
+
+    const SnapshotRecord *recordBase = reinterpret_cast<const SnapshotRecord *>(base + sizeof(SnapshotHeader));
+    const qint32 *dayBase = reinterpret_cast<const qint32 *>(recordBase + candidate->recordCount);
+    const char16_t *stringBase = reinterpret_cast<const char16_t *>(dayBase + candidate->coveredCount);
+
+    // 校验和只能发现损坏，写入端的错误偏移仍需逐条检查，避免越界读取
+    for (quint32 i = 0; i < candidate->recordCount; ++i) {
+        const SnapshotRecord &record = recordBase[i];
+        if (quint64(record.room) + record.roomLen > candidate->stringUnits
+            || quint64(record.course) + record.courseLen > candidate->stringUnits
+            || quint64(record.teacher) + record.teacherLen > candidate->stringUnits
+            || quint64(record.timeSlot) + record.timeSlotLen > candidate->stringUnits) {
+            qDebug() << "课程表快照记录越界，忽略";
+            file.close();
+            return false;
+        }
+    }
+
+    header = candidate;
+    records = recordBase;
+    coveredDays = dayBase;
+    strings = stringBase;
+    return true;
+}
+
+QStringView PlanSnapshot::text(quint32 offset, quint16 length) const {
+    return QStringView(strings + offset, length);
+}
+
+std::shared_ptr<const DayPlan> PlanSnapshot::planFor(const QString &roomName) const {
+    if (!header) {
+        return nullptr;
+    }
+
+    const SnapshotRecord *begin = records;
+    const SnapshotRecord *end = records + header->recordCount;
+    QStringView room(roomName);
+
+    const SnapshotRecord *first = std::lower_bound(begin, end, room, [this](const SnapshotRecord &record, QStringView key) {
+        return text(record.room, record.roomLen).compare(key) < 0;
+    });
+
+    QVector<PlanSlot> planSlots;
+    QVector<PlanSlot> datedSlots;
+    for (const SnapshotRecord *it = first; it != end && text(it->room, it->roomLen) == room; ++it) {
+        PlanSlot slot;
+        slot.weekday = it->weekday;
+        slot.startSecs = it->startSecs;
+        slot.endSecs = it->endSecs;
+        slot.courseName = text(it->course, it->courseLen).toString();
+        slot.teacher = text(it->teacher, it->teacherLen).toString();
+        slot.timeSlot = text(it->timeSlot, it->timeSlotLen).toString();
+        slot.day = it->day;
+        if (slot.day == 0) {
+            planSlots.append(slot);
+        } else {
+            datedSlots.append(slot);
+        }
+    }
+
+    QVector<qint64> covered(coveredDays, coveredDays + header->coveredCount);
+    return DayPlan::fromSlots(roomName, std::move(planSlots), std::move(datedSlots), covered);
+}
@@ -0,0 +1,72 @@
+#ifndef PLANSNAPSHOT_H
+#define PLANSNAPSHOT_H
+
+#include <QFile>
+#include <QString>
+#include <QSqlDatabase>
+#include <memory>
+#include "dayplan.h"
+#include "localtables.h"
+
+// 上一次成功同步的课程表的二进制快照，启动时直接内存映射使用，无需打开 SQLite。
+//
+// 文件布局：SnapshotHeader | SnapshotRecord[recordCount] | qint32 校历日期[coveredCount] | char16_t 字符串表[stringUnits]
+// 记录按 (教室, 日期, 星期, 开始时间) 排序，同一教室的课程连续存放，可二分查找。
+// 按星期重复的课程 day 为 0；校历展开的课程 day 为儒略日，与 DayPlan 一样只在校历覆盖的日期内生效。
+// 文件只在本机读写，数值按本机字节序存放；魔数或版本不符、校验和不对时整个文件视为无效。
+class PlanSnapshot
+{
+public:
+    static const quint32 kVersion = 2;
+
+    struct SnapshotHeader {
+        char magic[4];           // "CSPS"
+        quint32 version;
+        quint32 recordCount;
+        quint32 stringUnits;     // 字符串表长度（char16_t 个数）
+        quint32 checksum;        // 头部之后全部字节的 FNV-1a
+        quint32 coveredCount;    // 校历覆盖的日期数
+        qint64 generatedAtMs;    // 写入时间
+    };
+
+    struct SnapshotRecord {
+        quint32 room;            // 字符串在字符串表中的起始位置
+        quint32 course;
+        quint32 teacher;
+        quint32 timeSlot;
+        quint16 roomLen;
+        quint16 courseLen;
+        quint16 teacherLen;
+        quint16 timeSlotLen;
+        qint32 startSecs;
+        qint32 endSecs;
+        qint32 day;              // 校历日程所在日期（儒略日），按星期重复的课程为 0
+        quint8 weekday;
+        quint8 reserved[3];
+    };
+
+    static QString defaultPath() { return "classroom_plan.snap"; }
+
+    // 原子写入（先写临时文件再替换），失败时保留旧快照。
+    // db 有效时一并写入其中的校历覆盖日期和按日期展开的课程
+    static bool write(const QString &path, const ScheduleTable &table, QSqlDatabase db = QSqlDatabase());
+
+    bool open(const QString &path);
+    bool isValid() const { return header != nullptr; }
+    int recordCount() const { return header ? int(header->recordCount) : 0; }
+    qint64 generatedAtMs() const { return header ? header->generatedAtMs : 0; }
+
+    // 直接在映射内存上查找该教室的课程并构建课程计划
+    std::shared_ptr<const DayPlan> planFor(const QString &roomName) const;
+
+private:
+    QStringView text(quint32 offset, quint16 length) const;
+
+    QFile file;
+    const SnapshotHeader *header = nullptr;
+    const SnapshotRecord *records = nullptr;
+    const qint32 *coveredDays = nullptr;
+    const char16_t *strings = nullptr;
+};
+
+#endif // PLANSNAPSHOT_H
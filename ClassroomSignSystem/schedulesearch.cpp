@@ -0,0 +1,101 @@
+#include "schedulesearch.h"
+#include "localtables.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+static void appendUnique(QVector<int> &list, int id) {
+    // 取值编号按出现顺序递增分配，只需检查末尾即可去重并保持升序
+    if (list.isEmpty() || list.last() != id) {
+        list.append(id);
+    }
+}
+
+int ScheduleSearchIndex::addValue(const QString &value, int row) {
+    QString folded = value.toCaseFolded();
+    auto it = valueIds.constFind(folded);
+    int id;
+    if (it != valueIds.constEnd()) {
+        id = it.value();
+    } else {
+        id = values.size();
+        valueIds.insert(folded, id);
+        values.append(folded);
+        valueRows.append(QVector<int>());
+
+        for (int i = 0; i < folded.size(); ++i) {
+            appendUnique(unigrams[folded[i].unicode()], id);
+            if (i + 1 < folded.size()) {
+                appendUnique(bigrams[bigramKey(folded[i], folded[i + 1])], id);
+            }
+        }
+    }
+
+    QVector<int> &rows = valueRows[id];
+    if (rows.isEmpty() || rows.last() != row) {
+        rows.append(row);
+    }
+    return id;
+}
+
+void ScheduleSearchIndex::build(const QVector<ScheduleRow> &rows) {
+    values.clear();
+    valueRows.clear();
+    valueIds.clear();
+    bigrams.clear();
+    unigrams.clear();
+
+    for (int row = 0; row < rows.size(); ++row) {
+        addValue(rows[row].roomName, row);
+        addValue(rows[row].teacher, row);
+        addValue(rows[row].courseName, row);
+    }
+
+    // 构建完成后只读，释放辅助哈希
+    valueIds.clear();
+    valueIds.squeeze();
+}
+
+QVector<int> ScheduleSearchIndex::search(const QString &text) const {
+    QString query = text.toCaseFolded();
+    if (query.isEmpty()) {
+        return QVector<int>();
+    }
+
+    // 1. 找出各个 gram 的候选列表，按长度从短到长求交集
+    QVector<const QVector<int> *> lists;
+    if (query.size() == 1) {
+        auto it = unigrams.constFind(query[0].unicode());
+        if (it == unigrams.constEnd()) return QVector<int>();
+        lists.append(&it.value());
+    } else {
+        for (int i = 0; i + 1 < query.size(); ++i) {
+            auto it = bigrams.constFind(bigramKey(query[i], query[i + 1]));
+            if (it == bigrams.constEnd()) return QVector<int>();
+            lists.append(&it.value());
+        }
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> candidates = *lists.first();
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        QVector<int> merged;
+        std::set_intersection(candidates.cbegin(), candidates.cend(),
+                              lists[i]->cbegin(), lists[i]->cend(), std::back_inserter(merged));
+        candidates.swap(merged);
+    }
+
+    // 2. gram 全部出现不代表连续出现，逐个确认子串后汇总行号
+    QVector<int> result;
+    for (int id : std::as_const(candidates)) {
+        if (values[id].contains(query)) {
+            result += valueRows[id];
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef SCHEDULESEARCH_H
+#define SCHEDULESEARCH_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+struct ScheduleRow;
+
+// 课程表的内存 n-gram 索引，覆盖教室、教师、课程三个字段。
+// 索引建立在去重后的字段取值上：gram -> 取值，取值 -> 行号，
+// 查询时先用 gram 求交集得到候选取值，再逐个确认子串匹配。
+class ScheduleSearchIndex
+{
+public:
+    void build(const QVector<ScheduleRow> &rows);
+
+    // 返回匹配的行号（升序），大小写不敏感的子串匹配
+    QVector<int> search(const QString &text) const;
+
+private:
+    int addValue(const QString &value, int row);
+    static quint32 bigramKey(QChar a, QChar b) { return (quint32(a.unicode()) << 16) | b.unicode(); }
+
+    QVector<QString> values;              // 折叠大小写后的字段取值
+    QVector<QVector<int>> valueRows;      // 取值 -> 行号（升序）
+    QHash<QString, int> valueIds;
+    QHash<quint32, QVector<int>> bigrams;  // 双字 gram -> 取值编号（升序）
+    QHash<char16_t, QVector<int>> unigrams; // 单字 -> 取值编号，用于单字查询
+};
+
+#endif // SCHEDULESEARCH_H
@@ -0,0 +1,66 @@
+#include "signconfig.h"
+#include <QSettings>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QDebug>
+
+SignConfig SignConfig::load(const QString &path) {
+    SignConfig config;
+
+    if (QFileInfo::exists(path)) {
+        QSettings settings(path, QSettings::IniFormat);
+
+        // 逗号分隔的值会被 QSettings 解析为列表，单个地址时同样适用
+        const QStringList entries = settings.value("server/endpoints").toStringList();
+        for (const QString &entry : entries) {
+            QString text = entry.trimmed();
+            if (text.isEmpty()) continue;
+
+            ServerEndpoint endpoint;
+            int colon = text.lastIndexOf(':');
+            if (colon > 0) {
+                bool ok = false;
+                int port = text.mid(colon + 1).toInt(&ok);
+                if (!ok || port <= 0 || port > 65535) {
+                    qDebug() << "忽略无效的服务器地址:" << text;
+                    continue;
+                }
+                endpoint.host = text.left(colon);
+                endpoint.port = quint16(port);
+            } else {
+                endpoint.host = text;
+            }
+            config.endpoints.append(endpoint);
+        }
+
+        config.signId = settings.value("sign/id").toString().trimmed();
+        config.connectTimeoutMs = settings.value("server/connect_timeout_ms", config.connectTimeoutMs).toInt();
+        config.firstByteTimeoutMs = settings.value("server/first_byte_timeout_ms", config.firstByteTimeoutMs).toInt();
+        config.receiveTimeoutMs = settings.value("server/receive_timeout_ms", config.receiveTimeoutMs).toInt();
+        config.announcementDwellMs = settings.value("display/announcement_dwell_ms", config.announcementDwellMs).toInt();
+        config.room = settings.value("display/room").toString().trimmed();
+        config.checkinReader = settings.value("checkin/reader", config.checkinReader).toString().trimmed().toLower();
+        config.simulatedCheckinsPerMinute =
+            settings.value("checkin/simulated_per_minute", config.simulatedCheckinsPerMinute).toInt();
+    }
+
+    if (config.signId.isEmpty()) {
+        config.signId = QSysInfo::machineHostName();
+    }
+
+    if (config.endpoints.isEmpty()) {
+        config.endpoints.append(ServerEndpoint{"127.0.0.1", 12345});
+    }
+
+    qDebug() << "服务器地址数量:" << config.endpoints.size();
+    return config;
+}
+
+void SignConfig::saveRoom(const QString &room, const QString &path) {
+    QSettings settings(path, QSettings::IniFormat);
+    settings.setValue("display/room", room);
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qDebug() << "保存所选教室失败:" << path;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SIGNCONFIG_H
+#define SIGNCONFIG_H
+
+#include <QString>
+#include <QVector>
+
+// 服务器地址
+struct ServerEndpoint {
+    QString host;
+    quint16 port = 12345;
+};
+
+// 班牌本地配置，来自工作目录下的 sign_config.ini，文件不存在时使用默认值。
+//
+// [sign]
+// id=A-301
+//
+// [server]
+// endpoints=10.0.0.2:12345, 10.0.0.3:12345
+// connect_timeout_ms=3000
+// first_byte_timeout_ms=5000
+//
+// [display]
+// announcement_dwell_ms=8000
+// room=A-301                ; 上次选择的教室，切换教室时由班牌写入
+//
+// [checkin]
+// reader=keyboard           ; keyboard（模拟键盘输入的读卡器）、simulated（测试用，随机卡号）或 none
+// simulated_per_minute=30
+struct SignConfig {
+    QString signId;                     // 班牌编号，未配置时使用主机名
+    QVector<ServerEndpoint> endpoints;  // 按配置顺序排列
+    int connectTimeoutMs = 3000;        // 建立连接的超时，超时后立即切换下一个服务器
+    int firstByteTimeoutMs = 5000;      // 发出请求后等待首个响应字节的超时
+    int receiveTimeoutMs = 30000;       // 接收过程中两次数据之间的超时
+    int announcementDwellMs = 8000;     // 公告栏每条公告的停留时间
+    QString room;                       // 上次选择的教室，启动快照和教室列表到达前按它显示
+    QString checkinReader = "keyboard"; // 签到读卡器类型
+    int simulatedCheckinsPerMinute = 30; // 模拟读卡器每分钟产生的刷卡次数
+
+    static SignConfig load(const QString &path = "sign_config.ini");
+    static void saveRoom(const QString &room, const QString &path = "sign_config.ini");
+};
+
+#endif // SIGNCONFIG_H
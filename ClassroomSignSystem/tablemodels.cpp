@@ -0,0 +1,215 @@
+#include "tablemodels.h"
+#include <algorithm>
+
+ScheduleTableModel::ScheduleTableModel(QObject *parent) : QAbstractTableModel(parent)
+{
+}
+
+void ScheduleTableModel::setTable(ScheduleTablePtr newTable) {
+    // 工作线程在数据未变化时会复用同一个指针，这里无需再逐行比较
+    if (newTable == scheduleTable) {
+        return;
+    }
+    beginResetModel();
+    scheduleTable = std::move(newTable);
+    endResetModel();
+}
+
+int ScheduleTableModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid() || !scheduleTable) return 0;
+    return scheduleTable->rows.size();
+}
+
+int ScheduleTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ScheduleTableModel::data(const QModelIndex &index, int role) const {
+    if (!scheduleTable || !index.isValid() || index.row() >= scheduleTable->rows.size()) {
+        return QVariant();
+    }
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) {
+        return QVariant();
+    }
+
+    const ScheduleRow &row = scheduleTable->rows[index.row()];
+    switch (index.column()) {
+    case RoomColumn: return row.roomName;
+    case CourseColumn: return row.courseName;
+    case TeacherColumn: return row.teacher;
+    case TimeSlotColumn: return row.timeSlot;
+    default: return QVariant();
+    }
+}
+
+QVariant ScheduleTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case RoomColumn: return QString("教室");
+    case CourseColumn: return QString("课程");
+    case TeacherColumn: return QString("教师");
+    case TimeSlotColumn: return QString("时间段");
+    default: return QVariant();
+    }
+}
+
+ClassroomTableModel::ClassroomTableModel(QObject *parent) : QAbstractTableModel(parent)
+{
+}
+
+void ClassroomTableModel::setTable(ClassroomTablePtr newTable) {
+    if (newTable == classroomTable) {
+        return;
+    }
+    beginResetModel();
+    classroomTable = std::move(newTable);
+    endResetModel();
+}
+
+int ClassroomTableModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid() || !classroomTable) return 0;
+    return classroomTable->rows.size();
+}
+
+int ClassroomTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ClassroomTableModel::data(const QModelIndex &index, int role) const {
+    if (!classroomTable || !index.isValid() || index.row() >= classroomTable->rows.size()) {
+        return QVariant();
+    }
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) {
+        return QVariant();
+    }
+
+    const ClassroomRow &row = classroomTable->rows[index.row()];
+    switch (index.column()) {
+    case RoomColumn: return row.roomName;
+    case ClassColumn: return row.className;
+    case CapacityColumn: return row.capacity;
+    case BuildingColumn: return row.building;
+    case FloorColumn: return row.floor;
+    case CurrentClassColumn: return row.currentClass;
+    default: return QVariant();
+    }
+}
+
+QVariant ClassroomTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case RoomColumn: return QString("教室名称");
+    case ClassColumn: return QString("班级");
+    case CapacityColumn: return QString("容量");
+    case BuildingColumn: return QString("教学楼");
+    case FloorColumn: return QString("楼层");
+    case CurrentClassColumn: return QString("当前班级");
+    default: return QVariant();
+    }
+}
+
+RowSubsetProxyModel::RowSubsetProxyModel(QObject *parent) : QAbstractProxyModel(parent), showAll(true)
+{
+}
+
+void RowSubsetProxyModel::setSourceModel(QAbstractItemModel *model) {
+    beginResetModel();
+    if (sourceModel()) {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+    QAbstractProxyModel::setSourceModel(model);
+    rowMap.clear();
+    if (model) {
+        // 源模型整体替换后原行号失效，先清空，由调用方重新设置行集合
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { beginResetModel(); });
+        connect(model, &QAbstractItemModel::modelReset, this, [this]() {
+            rowMap.clear();
+            endResetModel();
+        });
+    }
+    endResetModel();
+}
+
+void RowSubsetProxyModel::setRows(const QVector<int> &sourceRows) {
+    beginResetModel();
+    rowMap = sourceRows;
+    showAll = false;
+    endResetModel();
+}
+
+void RowSubsetProxyModel::showAllRows() {
+    beginResetModel();
+    rowMap.clear();
+    showAll = true;
+    endResetModel();
+}
+
+QModelIndex RowSubsetProxyModel::mapToSource(const QModelIndex &proxyIndex) const {
+    if (!sourceModel() || !proxyIndex.isValid()) {
+        return QModelIndex();
+    }
+    if (showAll) {
+        return sourceModel()->index(proxyIndex.row(), proxyIndex.column());
+    }
+    if (proxyIndex.row() >= rowMap.size()) {
+        return QModelIndex();
+    }
+    return sourceModel()->index(rowMap[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex RowSubsetProxyModel::mapFromSource(const QModelIndex &sourceIndex) const {
+    if (!sourceModel() || !sourceIndex.isValid()) {
+        return QModelIndex();
+    }
+    if (showAll) {
+        return index(sourceIndex.row(), sourceIndex.column());
+    }
+    auto it = std::lower_bound(rowMap.cbegin(), rowMap.cend(), sourceIndex.row());
+    if (it == rowMap.cend() || *it != sourceIndex.row()) {
+        return QModelIndex();
+    }
+    return index(int(it - rowMap.cbegin()), sourceIndex.column());
+}
+
+QModelIndex RowSubsetProxyModel::index(int row, int column, const QModelIndex &parent) const {
+    if (parent.isValid() || row < 0 || column < 0 || row >= rowCount() || column >= columnCount()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex RowSubsetProxyModel::parent(const QModelIndex &child) const {
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int RowSubsetProxyModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid() || !sourceModel()) return 0;
+    return showAll ? sourceModel()->rowCount() : rowMap.size();
+}
+
+int RowSubsetProxyModel::columnCount(const QModelIndex &parent) const {
+    if (parent.isValid() || !sourceModel()) return 0;
+    return sourceModel()->columnCount();
+}
+
+QVariant RowSubsetProxyModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (!sourceModel()) {
+        return QVariant();
+    }
+    // 列标题直接取源模型的，否则行集合为空时基类映射不到源索引，表头退化成列号
+    if (orientation == Qt::Horizontal) {
+        return sourceModel()->headerData(section, orientation, role);
+    }
+    if (!showAll) {
+        if (section < 0 || section >= rowMap.size()) {
+            return QVariant();
+        }
+        section = rowMap[section];
+    }
+    return sourceModel()->headerData(section, orientation, role);
+}
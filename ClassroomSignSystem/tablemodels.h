@@ -0,0 +1,79 @@
+#ifndef TABLEMODELS_H
+#define TABLEMODELS_H
+
+#include <QAbstractTableModel>
+#include <QAbstractProxyModel>
+#include <QVector>
+#include "localtables.h"
+
+// 课程表视图模型，数据为工作线程准备好的不可变 ScheduleTable，替换时只做一次 O(1) 的重置
+class ScheduleTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { RoomColumn, CourseColumn, TeacherColumn, TimeSlotColumn, ColumnCount };
+
+    explicit ScheduleTableModel(QObject *parent = nullptr);
+
+    void setTable(ScheduleTablePtr newTable);
+    ScheduleTablePtr table() const { return scheduleTable; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    ScheduleTablePtr scheduleTable;
+};
+
+// 教室信息视图模型
+class ClassroomTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { RoomColumn, ClassColumn, CapacityColumn, BuildingColumn, FloorColumn, CurrentClassColumn, ColumnCount };
+
+    explicit ClassroomTableModel(QObject *parent = nullptr);
+
+    void setTable(ClassroomTablePtr newTable);
+    ClassroomTablePtr table() const { return classroomTable; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    ClassroomTablePtr classroomTable;
+};
+
+// 只显示源模型中指定行的代理模型。
+// 行号列表由调用方预先算好（例如按教室的索引），设置代价与结果行数成正比，与总行数无关。
+class RowSubsetProxyModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit RowSubsetProxyModel(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *model) override;
+    void setRows(const QVector<int> &sourceRows); // 源模型行号，需升序
+    void showAllRows();
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    QVector<int> rowMap;
+    bool showAll;
+};
+
+#endif // TABLEMODELS_H
@@ -0,0 +1,204 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+#include <QAtomicInt>
+#include <algorithm>
+#include "localstore.h"
+
+// 压力测试：写线程不停地整表同步，主线程（模拟界面）同时查询。
+// 要求：读端没有任何锁错误或缺表错误，每次读到的都是某一次同步的完整数据，查询延迟有上限。
+// 之后检查签到队列：同步不影响队列，按批取出、确认删除后剩余的记录和顺序正确。
+
+static const char *kDbPath = "test_localstore.db";
+static const int kRowsPerSync = 2000;
+static const int kRunMs = 5000;
+static const qint64 kMaxQueryMs = 200;
+static const int kCheckins = 500;
+static const int kCheckinBatch = 200;
+
+static QJsonObject makePayload(int version) {
+    QJsonArray schedules;
+    for (int i = 0; i < kRowsPerSync; ++i) {
+        QJsonObject obj;
+        obj["room_name"] = QString("Class %1").arg(100 + i % 50);
+        obj["course_name"] = QString("课程 %1").arg(i);
+        obj["teacher"] = QString("v%1").arg(version);  // 同一次同步的所有行带相同版本号
+        obj["time_slot"] = "08:00-09:40";
+        obj["start_time"] = "08:00";
+        obj["end_time"] = "09:40";
+        obj["weekday"] = 1 + i % 7;
+        obj["is_next"] = 0;
+        schedules.append(obj);
+    }
+
+    QJsonArray classrooms;
+    for (int i = 0; i < 50; ++i) {
+        QJsonObject obj;
+        obj["room_name"] = QString("Class %1").arg(100 + i);
+        obj["class_name"] = QString("v%1").arg(version);
+        obj["capacity"] = 50;
+        obj["building"] = "A栋";
+        obj["floor"] = 1 + i / 10;
+        obj["current_class"] = "";
+        classrooms.append(obj);
+    }
+
+    QJsonObject rootObj;
+    rootObj["schedules"] = schedules;
+    rootObj["classrooms"] = classrooms;
+    rootObj["announcements"] = QJsonArray();
+    return rootObj;
+}
+
+class SyncWriter : public QThread
+{
+public:
+    QAtomicInt stopFlag;
+    int syncCount = 0;
+    int failures = 0;
+
+protected:
+    void run() override {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "writer");
+        db.setDatabaseName(kDbPath);
+        if (!db.open() || !LocalStore::configure(db)) {
+            ++failures;
+            return;
+        }
+
+        int version = 1;
+        while (!stopFlag.loadRelaxed()) {
+            LocalStore::ApplyResult result = LocalStore::applySync(db, makePayload(++version));
+            if (result.ok) {
+                ++syncCount;
+            } else {
+                ++failures;
+                qDebug() << "写入失败:" << result.error;
+            }
+        }
+        db.close();
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile::remove(kDbPath);
+    QFile::remove(QString(kDbPath) + "-wal");
+    QFile::remove(QString(kDbPath) + "-shm");
+
+    int failed = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "reader");
+        db.setDatabaseName(kDbPath);
+        if (!db.open() || !LocalStore::configure(db) || !LocalStore::ensureSchema(db)) {
+            qDebug() << "错误: 无法初始化数据库:" << db.lastError().text();
+            return 1;
+        }
+        LocalStore::applySync(db, makePayload(1));
+
+        SyncWriter writer;
+        writer.start();
+
+        QVector<qint64> latencies;
+        int readErrors = 0;
+        int inconsistent = 0;
+        QElapsedTimer runClock;
+        runClock.start();
+
+        while (runClock.elapsed() < kRunMs) {
+            QElapsedTimer queryClock;
+            queryClock.start();
+
+            // 与界面相同的读取方式：一个读事务内读两张表
+            db.transaction();
+            QSqlQuery query(db);
+            bool ok = query.exec("SELECT COUNT(*), COUNT(DISTINCT teacher), MIN(teacher) FROM schedules") && query.next();
+            int rows = ok ? query.value(0).toInt() : 0;
+            int versions = ok ? query.value(1).toInt() : 0;
+            QString scheduleVersion = ok ? query.value(2).toString() : QString();
+            ok = ok && query.exec("SELECT COUNT(*), COUNT(DISTINCT class_name), MIN(class_name) FROM classrooms") && query.next();
+            QString classroomVersion = ok ? query.value(2).toString() : QString();
+            if (ok && (query.value(0).toInt() != 50 || query.value(1).toInt() != 1)) {
+                ++inconsistent;
+            }
+            db.commit();
+
+            latencies.append(queryClock.elapsed());
+
+            if (!ok) {
+                ++readErrors;
+                qDebug() << "读取失败:" << query.lastError().text();
+            } else if (rows != kRowsPerSync || versions != 1 || scheduleVersion != classroomVersion) {
+                ++inconsistent;
+            }
+        }
+
+        writer.stopFlag.storeRelaxed(1);
+        writer.wait();
+
+        std::sort(latencies.begin(), latencies.end());
+        qint64 p99 = latencies.isEmpty() ? 0 : latencies[int(latencies.size() * 0.99)];
+        qint64 worst = latencies.isEmpty() ? 0 : latencies.last();
+
+        qDebug() << "同步次数:" << writer.syncCount << "写入失败:" << writer.failures;
+        qDebug() << "查询次数:" << latencies.size() << "读取错误:" << readErrors << "不一致:" << inconsistent;
+        qDebug() << "查询延迟 p99:" << p99 << "毫秒，最大:" << worst << "毫秒";
+
+        if (writer.syncCount == 0 || writer.failures > 0) {
+            qDebug() << "失败: 写线程没有正常完成同步";
+            failed = 1;
+        }
+        if (readErrors > 0 || inconsistent > 0) {
+            qDebug() << "失败: 读端出现错误或读到不完整的数据";
+            failed = 1;
+        }
+        if (worst > kMaxQueryMs) {
+            qDebug() << "失败: 查询延迟超过" << kMaxQueryMs << "毫秒";
+            failed = 1;
+        }
+
+        // 签到队列：时间戳超出 int 范围，应原样读回
+        const qint64 baseMs = 1700000000000LL;
+        for (int i = 0; i < kCheckins; ++i) {
+            LocalStore::enqueueCheckin(db, QString("card-%1").arg(i), "Class 101", baseMs + i);
+        }
+        LocalStore::applySync(db, makePayload(0));
+
+        int uploaded = 0;
+        bool orderOk = true;
+        while (true) {
+            QVector<LocalStore::Checkin> batch = LocalStore::pendingCheckins(db, kCheckinBatch);
+            if (batch.isEmpty()) {
+                break;
+            }
+            for (const LocalStore::Checkin &checkin : batch) {
+                orderOk = orderOk && checkin.cardId == QString("card-%1").arg(uploaded)
+                          && checkin.checkedAtMs == baseMs + uploaded;
+                ++uploaded;
+            }
+            LocalStore::removeCheckins(db, batch.last().id);
+        }
+        qDebug() << "签到队列: 写入" << kCheckins << "条，分批取出" << uploaded << "条，剩余"
+                 << LocalStore::pendingCheckinCount(db) << "条";
+        if (uploaded != kCheckins || !orderOk || LocalStore::pendingCheckinCount(db) != 0) {
+            qDebug() << "失败: 签到队列的内容或顺序不正确";
+            failed = 1;
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("reader");
+    QSqlDatabase::removeDatabase("writer");
+
+    qDebug() << (failed ? "=== 测试失败 ===" : "=== 测试通过 ===");
+    return failed;
+}